@@ -0,0 +1,43 @@
+#pragma once
+
+#include <Arduino.h>
+#include "block_stats.h"
+#include "ring_buffer.h"
+
+// The ESP32 digital controller needs >= 20 kHz in total, i.e. 10 kHz per
+// channel with the two channels used here.
+#define ADC_SAMPLE_RATE_HZ 10000
+#define ADC_DMA_FRAME_CONVERSIONS 256 // conversions per DMA frame (both channels)
+#define ADC_DMA_BUFFER_FRAMES 4       // frames the driver can hold before overrunning
+#define ADC_BLOCK_QUEUE_LEN 64
+
+#define ADC_DMA_TASK_PRIORITY 4
+#define ADC_DMA_TASK_STACK 3072
+
+enum AdcChannel
+{
+  ADC_CHANNEL_MOTOR = 0,
+  ADC_CHANNEL_GAS,
+  ADC_CHANNEL_COUNT
+};
+
+// Statistics of one DMA frame, per channel, after the filter chains in
+// adc_filter.h: decimated samples in mV
+struct AdcBlock
+{
+  BlockStats channel[ADC_CHANNEL_COUNT];
+  uint16_t last[ADC_CHANNEL_COUNT];
+};
+
+// ADC DMA task (producer) -> sampling task (consumer)
+extern SpscRing<AdcBlock, ADC_BLOCK_QUEUE_LEN> adc_blocks;
+
+extern volatile uint32_t adc_dma_overruns; // frames lost because adc_blocks was full
+
+// Streams motor_pin and gas_pin through the ADC DMA controller. Each frame is
+// filtered, decimated and reduced to per-channel stats by a task on the given
+// core. Needs adc_calibration_begin() first.
+bool adc_dma_begin(uint8_t motor_pin, uint8_t gas_pin, BaseType_t core);
+
+// Retunes the gas low-pass; the DMA task applies it before its next frame.
+void adc_dma_set_gas_lowpass(float cutoff_hz);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <Arduino.h>
+#include <driver/adc.h>
+
+#include "adc_dma.h"
+#include "filters.h"
+
+// Attenuation per channel, shared by the DMA and analogRead() paths. The
+// motor shunt gets 2.5 dB (~1.25 V full scale): at 0 dB it saturated.
+#define ADC_MOTOR_ATTEN ADC_ATTEN_DB_2_5
+#define ADC_GAS_ATTEN ADC_ATTEN_DB_11
+#define ADC_DEFAULT_VREF_MV 1100 // used when the eFuse has no calibration
+
+// --- Filter chains: oversample locally, ship clean decimated values ---
+// DMA path, ADC_SAMPLE_RATE_HZ in per channel
+#define ADC_MOTOR_DECIMATION 8 // -> 1250 Hz
+#define ADC_GAS_DECIMATION 16  // -> 625 Hz
+#define ADC_GAS_LOWPASS_HZ 10  // MQ sensors respond in seconds
+typedef FilterChain<MedianFilter<3>, CicDecimator<ADC_MOTOR_DECIMATION, 3>> MotorDmaFilter;
+typedef FilterChain<MedianFilter<5>, CicDecimator<ADC_GAS_DECIMATION, 3>, Biquad> GasDmaFilter;
+
+// analogRead() path: a burst of conversions per reading, averaged to one
+#define ADC_POLLED_OVERSAMPLE 8
+typedef FilterChain<MedianFilter<3>, CicDecimator<ADC_POLLED_OVERSAMPLE, 1>> MotorPolledFilter;
+typedef FilterChain<MedianFilter<3>, CicDecimator<ADC_POLLED_OVERSAMPLE, 1>, MovingAverage<4>> GasPolledFilter;
+
+// Characterises both channels from the eFuse (two-point values or Vref,
+// whichever this chip was burnt with). Call once before reading.
+void adc_calibration_begin();
+
+// Filtered ADC counts -> millivolts at the pin
+uint16_t adc_to_mv(AdcChannel channel, int32_t raw);
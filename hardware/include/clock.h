@@ -0,0 +1,21 @@
+#pragma once
+
+#include <Arduino.h>
+
+// --- Device time ---
+// Samples are stamped with clock_us(), a monotonic microsecond counter.
+// SNTP does not step it; each sync only refreshes the offset to UTC, and
+// consumers compute wall time as timestamp_us + epoch_offset_us.
+#define SNTP_SERVER "pool.ntp.org"
+#define SNTP_SYNC_INTERVAL_MS 3600000 // re-sync hourly to follow crystal drift
+
+// esp_timer since boot. In low-power mode the RTC-backed system time instead,
+// which keeps counting through deep sleep.
+uint64_t clock_us();
+
+// Starts periodic SNTP polling. Call once the station has an IP.
+void clock_begin();
+
+// UTC (us since 1970) minus clock_us(), 0 until the first SNTP response.
+int64_t clock_epoch_offset_us();
+bool clock_synced();
@@ -0,0 +1,115 @@
+#pragma once
+
+// Serial logging: levels are build flags, see log.h and platformio.ini
+#define FLAME_PIN 12 // flame sensor - digital
+#define GAS_PIN 34   // MQ gas - analog
+#define DHT_PIN 33   // DHT22 sensor pin
+#define ADC_PIN 32   // motor current sensor - analog
+#define MPU_INT_PIN 27 // MPU6050 INT
+#define FLAME_RELAY_PIN -1 // relay/buzzer switched on flame, -1 = none
+
+// Battery mode: sample, buffer in RTC memory and sleep instead of streaming
+// (see power.h). Turns the streaming-only modes below off.
+#define LOW_POWER_MODE false
+
+// MPU6050 hardware FIFO at 1 kHz, burst-read on INT, instead of getEvent() per tick
+#define MPU_FIFO_MODE (!LOW_POWER_MODE)
+
+// The sampling periods, batching, deadbands, gas alarm level and gas
+// low-pass below are defaults: sensor/<device>/config changes them at runtime
+// (see runtime_config.h).
+
+// --- Sampling periods (us) ---
+#define MPU_PERIOD_US 5000         // 200 Hz
+#define MOTOR_PERIOD_US 2000       // 500 Hz
+#define FLAME_PERIOD_US 50000      // 20 Hz
+#define GAS_PERIOD_US 100000       // 10 Hz
+#define DHT_PERIOD_US 2000000      // 0.5 Hz, DHT22 limit
+#define PUBLISH_PERIOD_US 10000    // 100 Hz telemetry samples
+
+// Motor current and gas through the ADC DMA controller at ADC_SAMPLE_RATE_HZ
+// instead of one analogRead() burst per scheduler tick. Either way the
+// readings go through the filter chains in adc_filter.h and are published
+// in calibrated mV.
+#define ADC_CONTINUOUS_MODE (!LOW_POWER_MODE)
+
+// --- Flame fast path (flame.h) ---
+// FLAME_PIN on an edge interrupt, debounced, straight to the alarm topic
+// with an ack, instead of only the FLAME_PERIOD_US poll. The poll stays for
+// low-power mode.
+#define FLAME_INTERRUPT_MODE (!LOW_POWER_MODE)
+#define FLAME_ACTIVE_LEVEL HIGH // FLAME_PIN level while a flame is seen
+#define FLAME_DEBOUNCE_MS 20
+#define FLAME_ACK_TIMEOUT_MS 500 // resend the alarm if its ack has not come back
+
+// --- Telemetry wire formats ---
+// At 100 Hz only the batched frames are sustainable; the per-sample topics
+// are for debugging and low rates.
+#define TELEMETRY_PUBLISH_JSON false   // sensor/<device>/telemetry
+#define TELEMETRY_PUBLISH_BINARY false // .../telemetry/bin, packed TelemetryFrame
+#define TELEMETRY_BATCHING true        // .../telemetry/batch, see BATCH_* in network.h
+#define TELEMETRY_BATCH_COMPRESSION true // delta-coded batches, see batch_codec.h
+
+// --- Event-driven reporting ---
+// A sample is only queued when a channel moves by at least its deadband from
+// the last reported value, on heartbeat, or on an alarm edge.
+#define TELEMETRY_EVENT_DRIVEN true
+#define HEARTBEAT_MS 10000
+#define DEADBAND_ACCEL 1            // m/s^2
+#define DEADBAND_GYRO 1             // rad/s
+#define DEADBAND_TEMPERATURE 1      // degC, MPU6050 die
+#define DEADBAND_GAS 16             // mV
+#define DEADBAND_DHT_TEMPERATURE 0.2f // degC
+#define DEADBAND_DHT_HUMIDITY 1.0f    // %
+#define DEADBAND_MOTOR 3            // mV, interval mean
+#define DEADBAND_MOTOR_RMS 2        // mV
+#define GAS_ALARM_LEVEL 940         // mV, same as the dashboard DANGER level
+
+// --- Adaptive sampling (lib/activity) ---
+// The MPU6050 and motor current channels each switch between an idle,
+// normal and burst profile on their own activity level. Idle slows the
+// channel down (MPU FIFO at MPU_FIFO_LOW_RATE_HZ, no FFT); burst speeds it
+// up and reports every sample. Entering a burst first queues the
+// ACTIVITY_PRETRIGGER_SAMPLES samples held back before it.
+#define ADAPTIVE_SAMPLING true
+#define ACTIVITY_PERIOD_US 50000      // 20 Hz profile updates
+#define ACTIVITY_HOLD_MS 3000         // below an exit threshold this long to step down
+#define ACTIVITY_IDLE_PERIOD_SCALE 10 // idle: scheduler periods x10
+#define ACTIVITY_BURST_PERIOD_DIV 2   // burst: scheduler periods /2
+#define ACTIVITY_PRETRIGGER_SAMPLES 64 // power of two, telemetry samples
+// Vibration: RMS over the three axes of the last FFT window, m/s^2; the
+// motion interrupt set up in setup() also wakes the channel from idle.
+#define ACTIVITY_VIBRATION_NORMAL_ENTER 0.05f
+#define ACTIVITY_VIBRATION_NORMAL_EXIT 0.03f
+#define ACTIVITY_VIBRATION_BURST_ENTER 1.0f
+#define ACTIVITY_VIBRATION_BURST_EXIT 0.6f
+// Motor current: AC RMS over the update period, mV
+#define ACTIVITY_MOTOR_NORMAL_ENTER 5
+#define ACTIVITY_MOTOR_NORMAL_EXIT 3
+#define ACTIVITY_MOTOR_BURST_ENTER 40
+#define ACTIVITY_MOTOR_BURST_EXIT 25
+
+// --- Edge anomaly detection (lib/anomaly) ---
+// Every reading is scored as it is taken; rule edges go straight to
+// sensor/<device>/alarm. Rules are listed in main.cpp (anomaly_rules).
+#define ANOMALY_DETECTION true
+#define ANOMALY_EWMA_ALPHA 0.2f
+#define ANOMALY_WARMUP_SAMPLES 100    // readings per channel before its rules arm
+#define ANOMALY_BASELINE_SAMPLES 2000 // Welford memory, readings
+#define ANOMALY_RATE_WINDOW_MS 1000   // slope window of the rate rules
+#define ANOMALY_ZSCORE_RAISE 5.0f
+#define ANOMALY_ZSCORE_CLEAR 3.0f
+#define ANOMALY_GAS_RATE 160          // mV/s
+#define ANOMALY_MOTOR_RATE 120        // mV/s
+#define ANOMALY_TEMPERATURE_RATE 0.5f // degC/s, MPU6050 die and DHT22
+
+// --- Vibration features (FFT over the accelerometer stream) ---
+#define VIBRATION_WINDOW 256        // samples per FFT, 256 ms at 1 kHz
+#define VIBRATION_BAND_COUNT 4
+#define VIBRATION_BAND_EDGES_HZ {2, 10, 100, 250, 500}
+#define VIBRATION_SPECTRUM_BINS 16  // 0 = publish features only
+
+// --- Sampling task ---
+#define SAMPLING_TASK_CORE 1 // APP core, away from the WiFi stack
+#define SAMPLING_TASK_PRIORITY 3
+#define SAMPLING_TASK_STACK 4096
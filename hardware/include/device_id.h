@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+
+// --- Device identity and topic layout ---
+// A board is named by its factory MAC from eFuse, so the name is known
+// before WiFi starts and never changes. Everything it publishes or
+// subscribes to lives under sensor/<device_id>/:
+//
+//   telemetry           JSON sample            (TELEMETRY_PUBLISH_JSON)
+//   telemetry/bin       packed TelemetryFrame  (TELEMETRY_PUBLISH_BINARY)
+//   telemetry/batch     FrameBatcher frame     (TELEMETRY_BATCHING)
+//   vibration           FFT features
+//   alarm               alarm edges
+//   status              retained: birth on connect, LWT when lost
+//   diag                boot report
+//   diag/perf           perf.h metrics
+//   diag/ack            replay acks, echoed back to ourselves
+//   config...           runtime_config.h
+#define DEVICE_TOPIC_ROOT "sensor"
+#define DEVICE_ID_MAX 13    // 12 hex digits of the MAC
+#define DEVICE_TOPIC_MAX 48 // root, ID and the longest subtopic
+
+#define DEVICE_STATUS_ONLINE "online"
+#define DEVICE_STATUS_OFFLINE "offline" // LWT, published by the broker
+#define DEVICE_STATUS_SLEEP "sleep"     // clean disconnect in low-power mode
+
+// Reads the MAC. Safe to call more than once.
+void device_id_begin();
+
+// e.g. "a4cf12ab34cd"
+const char *device_id();
+
+// MQTT client ID, e.g. "esp32-a4cf12ab34cd"
+const char *device_client_id();
+
+// DEVICE_TOPIC_ROOT/<device_id>/<subtopic>. Returns false if it did not fit.
+bool device_topic(char *out, size_t out_len, const char *subtopic);
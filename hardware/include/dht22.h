@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Arduino.h>
+#include <driver/rmt.h>
+#include <esp_timer.h>
+
+#include "dht22_frame.h"
+
+#define DHT22_START_US 1200   // host start pulse, datasheet minimum is 1 ms
+#define DHT22_FRAME_TIMEOUT_MS 20 // a full frame takes ~5 ms after the start pulse
+
+struct Dht22Reading
+{
+  int16_t temperature_deci; // 0.1 degC, as sent by the sensor
+  uint16_t humidity_deci;   // 0.1 %RH
+  uint32_t timestamp_ms; // millis() when the measurement was triggered
+  bool valid;        // at least one good frame since boot
+};
+
+// DHT22 driver without busy-waiting or disabled interrupts. start() pulls the
+// line low and returns; an esp_timer callback releases it and arms the RMT
+// receiver, which captures the 40-bit frame in hardware. poll() decodes a
+// finished capture, if there is one.
+class Dht22Rmt
+{
+public:
+  bool begin(uint8_t pin, rmt_channel_t channel);
+
+  // Triggers a measurement. Ignored while one is still in flight.
+  void start();
+
+  // Non-blocking. Returns true when a new valid reading was decoded.
+  bool poll();
+
+  bool busy() const { return in_flight_; }
+  const Dht22Reading &latest() const { return latest_; }
+  uint32_t timeouts() const { return timeouts_; }
+  uint32_t checksum_errors() const { return checksum_errors_; }
+  uint32_t errors() const { return timeouts_ + checksum_errors_; }
+
+private:
+  static void release_line(void *arg);
+
+  gpio_num_t pin_ = GPIO_NUM_0;
+  rmt_channel_t channel_ = RMT_CHANNEL_0;
+  RingbufHandle_t rx_ring_ = nullptr;
+  esp_timer_handle_t start_timer_ = nullptr;
+
+  volatile bool in_flight_ = false;
+  uint32_t started_ms_ = 0;
+  Dht22Reading latest_ = {};
+  uint32_t timeouts_ = 0;
+  uint32_t checksum_errors_ = 0;
+};
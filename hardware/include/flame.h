@@ -0,0 +1,34 @@
+#pragma once
+
+#include <Arduino.h>
+#include "ring_buffer.h"
+
+// --- Flame fast path ---
+// FLAME_PIN edges raise an interrupt; a task of its own debounces them,
+// switches the local relay and hands the edge to the network task, which
+// sends it ahead of everything else (see publish_flame_alarm()).
+#define FLAME_TASK_PRIORITY 5 // above the MPU FIFO task, nothing holds a flame up
+#define FLAME_TASK_STACK 2048
+#define FLAME_EVENT_QUEUE_LEN 8
+
+// A debounced flame edge
+struct FlameEvent
+{
+  uint32_t seq;          // edges since boot, repeated if the alarm is resent
+  bool active;           // flame seen (true) or gone
+  uint64_t timestamp_us; // clock_us() of the first raw edge, before the debounce
+  int64_t edge_us;       // esp_timer_get_time() of the same edge, for latency
+};
+
+// Flame task (producer) -> network task (consumer)
+extern SpscRing<FlameEvent, FLAME_EVENT_QUEUE_LEN> flame_events;
+
+// Attaches the interrupt and starts the debounce task. relay_pin < 0 means
+// no local output.
+bool flame_begin(uint8_t pin, int relay_pin, BaseType_t core);
+
+// The debounced state, what telemetry reports
+bool flame_active();
+
+// Task notified (xTaskNotifyGive) after every event pushed to flame_events
+void flame_set_listener(TaskHandle_t task);
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+// --- I2C bus manager ---
+// One task owns the ESP-IDF I2C driver and runs the transactions devices
+// post to it, so a slow or hung device costs its caller a bounded wait and
+// never blocks the others' CPU work. A timed-out transaction triggers a bus
+// recovery: SCL is clocked by hand until a slave stuck mid-byte lets go of
+// SDA, a STOP is sent and every registered device is probed again.
+#define I2C_SDA_PIN 21
+#define I2C_SCL_PIN 22
+#define I2C_MAX_DEVICES 4
+#define I2C_MAX_CLOCK_HZ 1000000 // Fast-mode Plus
+#define I2C_TX_MAX 16            // register address plus written bytes, copied at submit
+#define I2C_TIMEOUT_MS 20        // default per-transaction limit
+#define I2C_RECOVERY_CLOCKS 9
+
+// Time on the wire for bytes at clock_hz, 9 clocks each (8 bits, ACK)
+#define I2C_WIRE_US(bytes, clock_hz) ((uint64_t)(bytes) * 9 * 1000000 / (clock_hz))
+
+#define I2C_TASK_PRIORITY 5 // above the MPU FIFO task it serves
+#define I2C_TASK_STACK 2560
+
+enum I2cResult : uint8_t
+{
+  I2C_OK = 0,
+  I2C_NACK,    // no ACK from the device (absent, busy, or a bad register)
+  I2C_TIMEOUT, // bus held or driver timeout; the bus has been recovered
+  I2C_ERROR,   // bad arguments, bus not started
+  I2C_BUSY,    // the device's last transaction has not been collected yet
+  I2C_PENDING,
+};
+
+// Since boot, read by the network task for the perf report
+struct I2cBusStats
+{
+  uint32_t transactions;
+  uint32_t nacks;
+  uint32_t timeouts;
+  uint32_t recoveries;        // devices whose state a cut-off transfer can corrupt
+                              // (e.g. a FIFO read) compare this and resync
+  uint32_t recovery_failures; // SDA or SCL still low after the recovery clocks
+  uint32_t recovery_us;       // duration of the last recovery, re-probe included
+  uint32_t recovery_max_us;
+  uint32_t wait_max_us;       // longest post -> start, i.e. time queued behind other devices
+};
+
+// One device address on the bus. Each device is used by a single task and
+// has at most one transaction in flight; transactions of different devices
+// queue in the bus task and run in turn.
+class I2cDevice
+{
+public:
+  // Registers the device with the bus. clock_hz up to I2C_MAX_CLOCK_HZ;
+  // the bus switches speed between devices as needed.
+  bool begin(uint8_t address, uint32_t clock_hz);
+
+  // Posts a write of tx, then (repeated start) a read into rx; either may
+  // be empty. Returns I2C_PENDING at once if it was accepted. rx must stay
+  // valid until wait() has returned the result.
+  I2cResult post(const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len,
+                 uint32_t timeout_ms = I2C_TIMEOUT_MS);
+
+  // Result of the posted transaction, I2C_PENDING if it is not done within
+  // wait_ms. Every transaction ends within its timeout plus whatever is
+  // queued ahead of it plus one recovery, so portMAX_DELAY is safe.
+  I2cResult wait(uint32_t wait_ms = portMAX_DELAY);
+
+  // post() + wait()
+  I2cResult transfer(const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len,
+                     uint32_t timeout_ms = I2C_TIMEOUT_MS);
+  bool write_register(uint8_t reg, uint8_t value);
+  // The timeout grows with len, so long reads (FIFOs) are not cut off
+  bool read_registers(uint8_t reg, uint8_t *buf, size_t len);
+
+  bool busy() const { return pending_.load(std::memory_order_acquire); } // posted, not finished
+  uint8_t address() const { return address_; }
+  bool online() const { return online_; } // ACKed the last transaction or probe
+
+private:
+  friend void i2c_bus_run(I2cDevice &device);
+  friend void i2c_bus_probe_all();
+
+  uint8_t address_ = 0;
+  uint32_t clock_hz_ = 0;
+  volatile bool online_ = false;
+  SemaphoreHandle_t done_ = nullptr;
+
+  // the transaction, owned by the bus task while pending_ is set
+  std::atomic<bool> pending_{false};
+  uint8_t tx_[I2C_TX_MAX];
+  size_t tx_len_ = 0;
+  uint8_t *rx_ = nullptr;
+  size_t rx_len_ = 0;
+  uint32_t timeout_ms_ = 0;
+  uint32_t posted_us_ = 0;
+  volatile I2cResult result_ = I2C_OK;
+};
+
+// Installs the driver on the pins and starts the bus task. A bus found
+// stuck at boot is recovered first.
+bool i2c_bus_begin(uint8_t sda_pin, uint8_t scl_pin, BaseType_t core);
+
+const I2cBusStats &i2c_bus_stats();
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <Arduino.h>
+#include "flash_journal.h"
+#include "telemetry.h"
+
+// --- Store-and-forward journal ---
+// While the broker is unreachable the network task moves queued samples to
+// the "journal" flash partition (partitions.csv) and replays them once the
+// link is back. 64-byte records: the 1.4 MiB partition holds ~22k samples.
+#define JOURNAL_PARTITION_LABEL "journal"
+#define JOURNAL_REPLAY_BATCH 40          // records per replay frame (46 fit BATCH_MAX_BYTES)
+#define JOURNAL_REPLAY_INTERVAL_MS 200   // ~200 samples/s on top of live traffic
+#define JOURNAL_ACK_TIMEOUT_MS 3000      // resend the frame if the ack echo does not return
+
+extern FlashJournal journal;
+
+// Mounts the partition and recovers the journal. false = no partition,
+// samples are then only held in RAM.
+bool journal_begin();
+
+bool journal_append(const TelemetrySample &sample);
@@ -0,0 +1,96 @@
+#pragma once
+
+// Structured logging with compile-time levels.
+//
+// Each source file names its module before including this header:
+//
+//   #define LOG_MODULE "net"
+//   #define LOG_MODULE_LEVEL LOG_LEVEL_NET
+//   #include "log.h"
+//
+// Levels are set per module with build flags in platformio.ini, e.g.
+// -D LOG_LEVEL=3 -D LOG_LEVEL_NET=4. Calls above the module level compile
+// to nothing, arguments included. Enabled calls format into a ring buffer
+// that a low-priority task drains to Serial, so the caller never waits on
+// the UART; lines that do not fit are dropped and counted.
+
+#include <stdint.h>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+#define LOG_LEVEL_TRACE 5 // per-sample output of the fast sensors
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// --- Per-module levels, default to LOG_LEVEL ---
+#ifndef LOG_LEVEL_SENSORS
+#define LOG_LEVEL_SENSORS LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_NET
+#define LOG_LEVEL_NET LOG_LEVEL
+#endif
+#ifndef LOG_LEVEL_POWER
+#define LOG_LEVEL_POWER LOG_LEVEL
+#endif
+
+#define LOG_BUFFER_BYTES 4096
+#define LOG_LINE_MAX 160
+#define LOG_TASK_PRIORITY 0 // idle priority, runs only when nothing else does
+#define LOG_TASK_STACK 2560
+#define LOG_TASK_CORE 0
+
+// Starts the drain task. Until then, enabled lines are written directly.
+void log_begin(unsigned long baud);
+
+void log_write(uint8_t level, const char *module, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+// Lines lost because the buffer was full
+uint32_t log_dropped();
+
+#ifndef LOG_MODULE
+#define LOG_MODULE "main"
+#endif
+#ifndef LOG_MODULE_LEVEL
+#define LOG_MODULE_LEVEL LOG_LEVEL
+#endif
+
+#define LOG_DISCARD(...) \
+  do                     \
+  {                      \
+  } while (0)
+
+#if LOG_MODULE_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) log_write(LOG_LEVEL_ERROR, LOG_MODULE, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) LOG_DISCARD(__VA_ARGS__)
+#endif
+
+#if LOG_MODULE_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) log_write(LOG_LEVEL_WARN, LOG_MODULE, __VA_ARGS__)
+#else
+#define LOG_WARN(...) LOG_DISCARD(__VA_ARGS__)
+#endif
+
+#if LOG_MODULE_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) log_write(LOG_LEVEL_INFO, LOG_MODULE, __VA_ARGS__)
+#else
+#define LOG_INFO(...) LOG_DISCARD(__VA_ARGS__)
+#endif
+
+#if LOG_MODULE_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) log_write(LOG_LEVEL_DEBUG, LOG_MODULE, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) LOG_DISCARD(__VA_ARGS__)
+#endif
+
+#if LOG_MODULE_LEVEL >= LOG_LEVEL_TRACE
+#define LOG_TRACE(...) log_write(LOG_LEVEL_TRACE, LOG_MODULE, __VA_ARGS__)
+#else
+#define LOG_TRACE(...) LOG_DISCARD(__VA_ARGS__)
+#endif
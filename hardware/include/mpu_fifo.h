@@ -0,0 +1,82 @@
+#pragma once
+
+#include <Arduino.h>
+#include "ring_buffer.h"
+
+#define MPU6050_ADDR 0x68
+#define MPU_I2C_CLOCK 400000 // the chip's limit, on the bus in i2c_bus.h
+
+#define MPU_FIFO_RATE_HZ 1000  // output data rate with the 184 Hz DLPF
+#define MPU_FIFO_LOW_RATE_HZ 100 // reduced rate (mpu_fifo_set_rate), 44 Hz DLPF
+#define MPU_FIFO_BLOCK 32      // samples per wake-up (448 bytes of the 1 KiB FIFO)
+#define MPU_FIFO_TIMEOUT_MS 50 // poll anyway if INT edges are missed
+#define MPU_FIFO_SWITCH_TIMEOUT_MS 200 // mpu_fifo_set_rate: a few retries of the write
+#define MPU_SAMPLE_QUEUE_LEN 1024
+
+#define MPU_FIFO_TASK_PRIORITY 4 // above sampling, the FIFO must not overflow
+#define MPU_FIFO_TASK_STACK 3072
+
+// Scale of the raw counts for the ranges set in setup()
+#define MPU_GRAVITY_M_S2 9.80665f
+#define MPU_ACCEL_LSB_PER_G 16384.0f // +-2 g
+#define MPU_GYRO_LSB_PER_DPS 65.5f   // +-500 deg/s
+#define MPU_TEMP_LSB_PER_C 340.0f
+#define MPU_TEMP_OFFSET_C 36.53f
+
+// Fixed-point units used from here on: mm/s^2, mrad/s, 0.01 degC. The Q16
+// multipliers fold at compile time, so scaling is one integer multiply.
+#define MPU_ACCEL_MM_S2_Q16 ((int32_t)(9806.65f * 65536 / MPU_ACCEL_LSB_PER_G + 0.5f))
+#define MPU_GYRO_MRAD_S_Q16 ((int32_t)(17.453293f * 65536 / MPU_GYRO_LSB_PER_DPS + 0.5f))
+#define MPU_TEMP_CENTI_Q16 ((int32_t)(100 * 65536 / MPU_TEMP_LSB_PER_C + 0.5f))
+#define MPU_TEMP_OFFSET_CENTI ((int32_t)(MPU_TEMP_OFFSET_C * 100 + 0.5f))
+
+inline int32_t mpu_scale_q16(int16_t counts, int32_t q16)
+{
+  return ((int32_t)counts * q16 + 32768) >> 16; // |counts * q16| < 2^31 for these ranges
+}
+inline int32_t mpu_accel_mm_s2(int16_t counts) { return mpu_scale_q16(counts, MPU_ACCEL_MM_S2_Q16); }
+inline int32_t mpu_gyro_mrad_s(int16_t counts) { return mpu_scale_q16(counts, MPU_GYRO_MRAD_S_Q16); }
+inline int32_t mpu_temp_centi(int16_t counts)
+{
+  return mpu_scale_q16(counts, MPU_TEMP_CENTI_Q16) + MPU_TEMP_OFFSET_CENTI;
+}
+
+// One FIFO frame or data-register read, raw counts from the chip
+struct MpuRawSample
+{
+  int16_t ax, ay, az;
+  int16_t temp;
+  int16_t gx, gy, gz;
+};
+
+// MPU FIFO task (producer) -> sampling task (consumer)
+extern SpscRing<MpuRawSample, MPU_SAMPLE_QUEUE_LEN> mpu_samples;
+
+extern volatile uint32_t mpu_fifo_overflows; // FIFO resets after the chip overran
+extern volatile bool mpu_motion_detected;    // MOT_INT seen since last cleared
+
+// Resets and sets up the chip: the ranges above and the latched motion
+// interrupt. Needs i2c_bus_begin() first; false if no MPU6050 answers.
+bool mpu_begin();
+
+// Whether the chip ACKed its last transaction (or the bus re-probe)
+bool mpu_online();
+
+// Burst-reads the current sample from the data registers, bypassing the
+// FIFO. This and mpu_motion_status() are for when the FIFO task is not
+// running: the chip is only ever driven from one task.
+bool mpu_read_raw(MpuRawSample &out);
+
+// Reads and so releases the latched motion interrupt; true if it had fired.
+bool mpu_motion_status();
+
+// Switches the MPU6050 to FIFO streaming (call after mpu_begin()) and starts
+// the task that burst-reads it on every INT wake-up.
+bool mpu_fifo_begin(uint8_t int_pin, BaseType_t core);
+
+// Output data rate, 1000 / n Hz. The FIFO task drains the samples taken at
+// the old rate, switches and resets the FIFO; this waits for it, up to
+// MPU_FIFO_SWITCH_TIMEOUT_MS. Once it returns true, every sample queued
+// after what is in mpu_samples now is at the new rate. False if the rate is
+// out of range, the FIFO task is not running or the switch timed out.
+bool mpu_fifo_set_rate(uint16_t rate_hz);
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "runtime_config.h"
+
+#define NETWORK_TASK_CORE 0 // same core as the WiFi/lwIP stack
+#define NETWORK_TASK_PRIORITY 1
+#define NETWORK_TASK_STACK 8192
+
+// TLS with client certificates on 8883 (see tls_client.h; certificates
+// and MQTT_SERVER_NAME in secrets.h), false for the plaintext port
+#define MQTT_TLS true
+#define MQTT_PORT (MQTT_TLS ? 8883 : 1883)
+#define MQTT_RETRY_MS 5000
+#define MQTT_CLEAN_SESSION false // persistent session, keyed by the per-device client ID
+#define WIFI_CONNECT_TIMEOUT_MS 5000
+#define WIFI_CACHE_NVS_NAMESPACE "wifi"
+#define NETWORK_POLL_MS 10
+// Payloads are streamed (beginPublish/write), so the PubSubClient buffer
+// only holds incoming messages (config updates) and outgoing topics.
+#define MQTT_BUFFER_SIZE (RUNTIME_CONFIG_JSON_MAX + 128)
+// Outgoing JSON, compressed batches: the pool in network.cpp is all the
+// payload memory the network task uses, allocated statically.
+#define FRAME_POOL_SIZE 2
+#define FRAME_POOL_FRAME_BYTES 2048 // vibration JSON with spectrum, largest payload
+#define PUBLISH_BURST 16 // samples sent per pass, so client.loop() keeps running while a backlog drains
+
+// Batch frame: header + BATCH_MAX_SAMPLES x (4 + sizeof(TelemetryFrame)) must
+// fit BATCH_MAX_BYTES (1800), i.e. at most 52 samples.
+#define BATCH_MAX_SAMPLES 50
+#define BATCH_MAX_AGE_MS 500
+// both are defaults, see runtime_config.h
+
+// Owns WiFi and MQTT. Drains telemetry_queue and publishes it, retrying the
+// same sample until the broker accepts it, so an outage only delays data.
+void network_task(void *arg);
+
+// Last association and DHCP lease. Reusing them skips the scan and DHCP,
+// which is most of the radio-on time of a wake-up.
+#define WIFI_CACHE_MAGIC 0x57494649u
+struct WifiCache
+{
+  uint32_t magic; // WIFI_CACHE_MAGIC when valid
+  uint8_t bssid[6];
+  int32_t channel;
+  uint32_t ip, gateway, subnet, dns;
+};
+
+// NVS copy of the cache, so a reset or brownout also takes the fast path
+void wifi_cache_load(WifiCache &cache);
+void wifi_cache_save(const WifiCache &cache);
+
+// Connects with the cached BSSID, channel and lease as static IP; falls back
+// to a full scan + DHCP (and refreshes the cache) if that does not associate.
+bool wifi_connect_fast(WifiCache &cache, uint32_t timeout_ms);
+
+// --- One-shot uplink (low-power mode, no network task) ---
+bool network_connect_once(WifiCache &cache, uint32_t timeout_ms);
+bool network_publish_batch(const uint8_t *data, size_t len);
+void network_shutdown(); // MQTT disconnect, radio off
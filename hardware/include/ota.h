@@ -0,0 +1,72 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "ota_transfer.h"
+
+// --- Firmware updates over MQTT (lib/ota, python/ota.py) ---
+// sensor/<device>/ota        manifest (OtaManifest), starts an update
+// sensor/<device>/ota/req    <offset u32, len u32>, the next chunk we want
+// sensor/<device>/ota/data   <offset u32> + bytes, the server's answer
+// sensor/<device>/ota/state  retained, JSON: where the update stands
+//
+// The image goes into the other app slot (partitions.csv, app0 / app1)
+// while this one keeps running; a delta is applied on the way against the
+// running slot. Only an image whose SHA-256 is signed with the key in
+// secrets.h (OTA_SIGNING_KEY) becomes the boot slot.
+//
+// The new image boots on trial: unless a telemetry publish succeeds within
+// OTA_HEALTH_TIMEOUT_MS it is marked invalid and the previous slot boots
+// again. An image that crashes or hits the watchdog during its trial is
+// rolled back by the bootloader if that was built with
+// CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE; in any case the trial boots are
+// counted in NVS and the previous slot boots after OTA_TRIAL_BOOTS. Boards
+// in low-power mode (power.h) take no updates, but their first uplink
+// after one confirms it.
+#ifndef FIRMWARE_VERSION
+#define FIRMWARE_VERSION "dev" // set by platformio.ini
+#endif
+
+#define OTA_CHUNK_BYTES 512        // per ota/data message, fits MQTT_BUFFER_SIZE
+#define OTA_RATE_BYTES_PER_S 8192  // keeps flash erases (which stall both cores' cache) sparse
+#define OTA_REQUEST_TIMEOUT_MS 3000
+#define OTA_MAX_ATTEMPTS 10        // per chunk, then the update is abandoned
+#define OTA_HEALTH_TIMEOUT_MS 120000
+#define OTA_TRIAL_BOOTS 3         // resets of an unconfirmed image, then it is rolled back
+#define OTA_REBOOT_DELAY_MS 2000   // for the rebooting state to go out
+#define OTA_NVS_NAMESPACE "ota"
+#define OTA_STATE_JSON_MAX 256
+
+enum OtaState : uint8_t
+{
+  OTA_IDLE = 0,    // running a confirmed image
+  OTA_TRIAL,       // first boot of a new image, not confirmed yet
+  OTA_DOWNLOADING,
+  OTA_REBOOTING,   // image verified and selected, restart pending
+  OTA_FAILED,      // last update abandoned, see error; this image keeps running
+};
+
+// Everything below runs on the network task.
+
+// At boot: confirms or starts the trial of this image, notices a rollback.
+void ota_begin();
+
+// A manifest on the ota topic. A rejected one only changes the state.
+void ota_handle_manifest(const uint8_t *payload, size_t len);
+
+// A chunk on ota/data
+void ota_handle_chunk(const uint8_t *payload, size_t len);
+
+// The chunk to request now, if one is due. backlog pauses the download
+// while telemetry is queued, so live data always goes first. Also runs the
+// restart once an image is selected.
+bool ota_poll(uint32_t now_ms, bool backlog, OtaRequest &request);
+
+// A telemetry publish went through: passes the trial of a new image.
+void ota_publish_succeeded();
+
+OtaState ota_state();
+
+// Increments on every change of what ota_format_state() reports
+uint32_t ota_state_version();
+size_t ota_format_state(char *out, size_t out_len);
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <Arduino.h>
+#include <hal/cpu_hal.h>
+
+#include "perf_histogram.h"
+#include "ring_buffer.h"
+
+// --- Performance metrics on sensor/<device>/diag/perf ---
+// Stages are timed in CPU cycles. The counter is per core, which is fine
+// because every task that records is pinned to one core.
+#define PERF_METRICS true
+#define PERF_REPORT_INTERVAL_MS 10000
+#define PERF_JSON_MAX 2048 // one whole FRAME_POOL_FRAME_BYTES frame
+
+enum PerfStage : uint8_t
+{
+  // sampling task
+  PERF_MPU = 0,
+  PERF_MOTOR,
+  PERF_FLAME,
+  PERF_GAS,
+  PERF_DHT,
+  PERF_ENQUEUE, // build_sample + deadband check + queue
+  PERF_ACTIVITY, // adaptive sampling profile update
+  PERF_JITTER,  // sampling task wake-up after its deadline
+  // network task
+  PERF_JSON,     // format_*_json
+  PERF_COMPRESS, // batch_compress
+  PERF_PUBLISH,  // client.publish
+  PERF_STAGE_COUNT
+};
+#define PERF_SAMPLING_STAGES PERF_JSON // stages below this belong to the sampling task
+
+// Adaptive sampling state the sampling task reports
+struct PerfActivity
+{
+  uint8_t mpu_profile; // ActivityProfile, at the end of the interval
+  uint8_t motor_profile;
+  uint32_t bursts;     // burst entries of either channel, since boot
+  uint32_t pretrigger; // pre-trigger samples queued, since boot
+};
+
+// One report interval of the sampling task, closed by perf_sampling_tick()
+struct PerfSnapshot
+{
+  uint32_t interval_ms;
+  PerfSummary stage[PERF_SAMPLING_STAGES];
+  uint32_t overruns; // scheduler deadlines missed by more than a period, total
+  PerfActivity activity;
+};
+
+// Sampling task (producer) -> network task (consumer)
+extern SpscRing<PerfSnapshot, 2> perf_snapshots;
+
+// Counters the network task keeps
+struct PerfNetworkStats
+{
+  int8_t rssi;
+  uint32_t wifi_reconnects;
+  uint32_t mqtt_reconnects;
+  uint8_t frames_peak;       // most pool frames in use at once
+  uint32_t frames_exhausted; // publishes deferred for lack of a frame
+  // flame fast path since the last report; latencies from the raw edge, us
+  uint32_t flame_alarms;     // acknowledged
+  uint32_t flame_resends;
+  uint32_t flame_publish_us; // largest edge -> alarm written to the socket
+  uint32_t flame_ack_us;     // largest edge -> ack echo back from the broker
+  // MQTT over TLS, since boot
+  uint32_t tls_handshakes;
+  uint32_t tls_resumed;
+  uint32_t tls_failures;
+  uint32_t tls_last_ms; // duration of the last handshake
+};
+
+static inline uint32_t perf_cycles()
+{
+  return cpu_hal_get_cycle_count();
+}
+
+// Only from the task that owns the stage
+void perf_record(PerfStage stage, uint32_t cycles);
+
+// perf_record() of the cycles since start = perf_cycles()
+static inline void perf_record_since(PerfStage stage, uint32_t start)
+{
+  if (PERF_METRICS)
+  {
+    perf_record(stage, perf_cycles() - start);
+  }
+}
+
+// Sampling task, once per pass: every PERF_REPORT_INTERVAL_MS its stages are
+// summarised into perf_snapshots and restarted.
+void perf_sampling_tick(uint32_t overruns, const PerfActivity &activity);
+
+// Heap state once every task has done its one-time allocations (the network
+// task calls it at the first MQTT connect). Reports then show "heap_growth",
+// the bytes allocated since: it should hover around zero, what is left is
+// the WiFi stack's own packet buffers.
+void perf_heap_baseline();
+
+// Network task: the snapshot plus its own stages (restarted here), heap,
+// stacks, RSSI and drop counters as JSON. Returns the length written.
+size_t perf_format_json(const PerfSnapshot &snapshot, const PerfNetworkStats &net, char *out,
+                        size_t out_len);
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <Arduino.h>
+#include "telemetry.h"
+
+// --- Low-power duty cycling ---
+// One sample per wake-up into RTC slow memory; WiFi only comes up to flush.
+// Samples are stamped with clock_us(), which then runs on the RTC timer.
+#define LOW_POWER_SAMPLE_PERIOD_MS 5000
+#define LOW_POWER_FLUSH_SAMPLES 12   // flush once a minute
+#define LOW_POWER_BUFFER_SAMPLES 48  // kept across failed flushes, oldest dropped
+#define LOW_POWER_WIFI_TIMEOUT_MS 3000
+#define LOW_POWER_DEEP_SLEEP true    // false = light sleep, RAM and tasks kept
+#define LOW_POWER_WAKE_ON_MOTION true
+#define LOW_POWER_LOG_DRAIN_MS 5
+
+// Stores one frame in RTC memory. Returns how many frames are buffered.
+size_t rtc_buffer_add(uint64_t timestamp_us, const TelemetryFrame &frame);
+
+// Brings the radio up with the cached association, publishes the buffered
+// frames as batches and turns the radio off again. Frames that were not
+// sent stay buffered.
+bool rtc_buffer_flush();
+
+// Sleeps until the next sample is due or the MPU6050 motion INT fires
+// (active low on motion_pin). Deep sleep does not return: the board
+// restarts in setup().
+void low_power_sleep(uint8_t motion_pin);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <Arduino.h>
+#include "ring_buffer.h"
+#include "settings.h"
+
+// --- Remote configuration (lib/settings) ---
+// sensor/<device>/config        JSON, e.g. {"publish_period_us":5000}, partial updates
+// sensor/<device>/config/bin    packed Settings, complete
+// sensor/<device>/config/state  retained, the settings in effect (JSON)
+// sensor/<device>/config/error  why the last update was rejected
+#define RUNTIME_CONFIG_NVS_NAMESPACE "config"
+#define RUNTIME_CONFIG_JSON_MAX 512
+#define RUNTIME_CONFIG_QUEUE_LEN 2
+
+// Network task (receives updates) -> sampling task (applies them)
+extern SpscRing<Settings, RUNTIME_CONFIG_QUEUE_LEN> settings_updates;
+
+// Defaults from config.h, replaced by the NVS copy if it is valid. Call
+// once in setup(), before the tasks start.
+void runtime_config_begin();
+
+// The settings in effect. After setup() only the network task reads it.
+const Settings &runtime_config();
+
+// Validates an update, persists it to NVS and queues it for the sampling
+// task. On failure nothing changes and error says why.
+bool runtime_config_update(const uint8_t *payload, size_t len, bool binary, char *error,
+                           size_t error_len);
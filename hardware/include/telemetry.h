@@ -0,0 +1,136 @@
+#pragma once
+
+#include <Arduino.h>
+#include "ring_buffer.h"
+#include "vibration.h"
+
+// Samples waiting for the network task. At 100 Hz this bridges ~5 s of outage.
+#define TELEMETRY_QUEUE_LEN 512
+
+// One snapshot of every sensor, as published on the telemetry topic.
+struct TelemetrySample
+{
+  uint64_t timestamp_us; // clock_us() at acquisition
+  int32_t acceleration_x, acceleration_y, acceleration_z; // mm/s^2
+  int32_t gyro_x, gyro_y, gyro_z;                         // mrad/s
+  int32_t temperature;                                    // 0.01 degC, MPU6050 die
+  int flame_status;
+  int gas_level; // mV, filtered and calibrated (adc_filter.h)
+  int16_t dht_temperature_deci; // 0.1 degC
+  uint16_t dht_humidity_deci;   // 0.1 %
+  int motor_adc_value; // mV
+  // motor ADC over the publish interval, in 0.1 mV
+  uint16_t motor_mean_deci;
+  uint16_t motor_rms_deci;  // AC RMS around the mean
+  uint16_t motor_peak_deci; // largest deviation from the mean
+  bool alarm;       // an alarm edge was raised on this sample, flush right away
+};
+
+enum AlarmType : uint8_t
+{
+  ALARM_FLAME = 0,
+  ALARM_GAS,
+  ALARM_ZSCORE, // anomaly rules, see lib/anomaly
+  ALARM_RATE,
+};
+
+// Signals scored by the anomaly detector
+enum AnomalyChannel : uint8_t
+{
+  ANOMALY_GAS = 0,
+  ANOMALY_MOTOR,           // ADC block mean (or single reading)
+  ANOMALY_VIBRATION,       // RMS over the three axes, per FFT window
+  ANOMALY_TEMPERATURE,     // MPU6050 die
+  ANOMALY_DHT_TEMPERATURE,
+  ANOMALY_CHANNEL_COUNT
+};
+
+// Edge of an alarm condition, published on its own topic ahead of telemetry
+struct AlarmEvent
+{
+  uint64_t timestamp_us; // clock_us()
+  AlarmType type;
+  bool active; // raised (true) or cleared
+  float value;
+  // anomaly alarms only
+  AnomalyChannel channel;
+  float score; // z-score or rate, units per second
+  uint32_t seq; // fast-path flame edges: repeated on a resend, 0 otherwise
+};
+
+#define TELEMETRY_JSON_MAX 448
+
+// --- Binary wire format ---
+// Bump on any layout change; python/telemetry.py decodes by this byte.
+#define TELEMETRY_SCHEMA_VERSION 3
+#define TELEMETRY_FLAG_FLAME 0x01
+// Schema of the batch frame wrapping TelemetryFrame records (FrameBatcher)
+#define TELEMETRY_BATCH_VERSION 2
+// Same header, ReplayRecord records: samples replayed from the flash journal
+#define TELEMETRY_REPLAY_BATCH_VERSION 3
+// Either of them compressed (version | BATCH_COMPRESSED_FLAG, see
+// lib/batcher/batch_codec.h) when TELEMETRY_BATCH_COMPRESSION is on.
+// Field widths of their records, in wire order:
+#define TELEMETRY_FRAME_FIELDS 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2
+#define TELEMETRY_REPLAY_FIELDS 4, TELEMETRY_FRAME_FIELDS
+
+// Little-endian packed frame, same content as the JSON payload.
+// Fixed-point fields keep the JSON precision without floats on the wire.
+// v2: acceleration in mm/s^2, gyro in mrad/s, temperature in 0.01 degC
+// (v1 had them truncated to whole units).
+// v3: gas and motor in calibrated mV instead of raw ADC counts.
+struct __attribute__((packed)) TelemetryFrame
+{
+  uint8_t version; // TELEMETRY_SCHEMA_VERSION
+  uint8_t flags;   // TELEMETRY_FLAG_*
+  int16_t acceleration[3]; // mm/s^2, +-32 m/s^2
+  int16_t gyro[3];         // mrad/s
+  int16_t temperature;     // 0.01 degC
+  uint16_t gas_level;             // mV
+  int16_t dht_temperature_centi; // 0.01 degC
+  uint16_t dht_humidity_centi;   // 0.01 %
+  uint16_t motor_adc;       // mV
+  uint16_t motor_mean_deci; // 0.1 mV
+  uint16_t motor_rms_deci;
+  uint16_t motor_peak_deci;
+};
+static_assert(sizeof(TelemetryFrame) == 30, "TelemetryFrame layout is part of the wire format");
+
+// Journal sequence number in front of the frame, so the backend can drop
+// records it already has (a replay whose ack was lost is sent again).
+struct __attribute__((packed)) ReplayRecord
+{
+  uint32_t seq;
+  TelemetryFrame frame;
+};
+
+#define ALARM_QUEUE_LEN 16
+#define ALARM_JSON_MAX 192
+
+// Feature frames waiting for the network task (one per FFT window)
+#define VIBRATION_QUEUE_LEN 4
+
+// Sampling task (producer) -> network task (consumer)
+extern SpscRing<TelemetrySample, TELEMETRY_QUEUE_LEN> telemetry_queue;
+extern SpscRing<VibrationFeatures, VIBRATION_QUEUE_LEN> vibration_queue;
+extern SpscRing<AlarmEvent, ALARM_QUEUE_LEN> alarm_queue;
+
+// Formats a sample as the JSON payload. Returns the length written, 0 if it
+// did not fit.
+size_t format_telemetry_json(const TelemetrySample &sample, char *out, size_t out_len);
+
+// Formats an alarm edge as JSON. Returns the length written, 0 if it did
+// not fit.
+size_t format_alarm_json(const AlarmEvent &event, char *out, size_t out_len);
+
+// Copies text into the body of a JSON string: quotes, backslashes and
+// control characters escaped, cut short (never mid-escape) if out is too
+// small. Returns out.
+const char *json_escape(const char *text, char *out, size_t out_len);
+
+// Packs a sample into the binary frame. Returns sizeof(TelemetryFrame).
+size_t encode_telemetry_binary(const TelemetrySample &sample, TelemetryFrame &frame);
+
+// Formats one window of vibration features (and the decimated spectrum, if
+// enabled) as JSON. Returns the length written, 0 if it did not fit.
+size_t format_vibration_json(const VibrationFeatures &features, char *out, size_t out_len);
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/pk.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/x509_crt.h>
+
+// --- MQTT over TLS ---
+// TLS 1.2, ECDHE-ECDSA-AES128-GCM-SHA256 on P-256 only: the AES and SHA
+// engines and the MPI accelerator behind ECDSA are the ones the ESP32 has,
+// and a P-256 chain is a fraction of the RSA-2048 verify time.
+//
+// The session (ticket or ID) of the last handshake is kept in RTC memory
+// and NVS, so a reconnect after an AP drop, light or deep sleep or a reset
+// resumes it: two round trips and no certificate work instead of the full
+// handshake.
+#define TLS_CONNECT_TIMEOUT_MS 3000
+#define TLS_HANDSHAKE_TIMEOUT_MS 10000
+#define TLS_IO_TIMEOUT_MS 5000 // a write that cannot get out in this time drops the link
+#define TLS_SESSION_MAX 1024   // serialized session, peer certificate included
+#define TLS_SESSION_NVS_NAMESPACE "tls"
+
+struct TlsStats
+{
+  uint32_t handshakes; // successful, since boot
+  uint32_t resumed;    // of them, abbreviated
+  uint32_t failures;
+  uint32_t last_ms;    // duration of the last successful one
+  bool last_resumed;
+};
+
+// Arduino Client over mbedTLS, for PubSubClient. The configuration, keys
+// and record buffers are set up once in begin(); a reconnect only resets
+// the session, so it does not allocate them again.
+class TlsClient : public Client
+{
+public:
+  TlsClient();
+
+  // PEM strings; server_name is checked against the broker certificate
+  // (and sent as SNI), since the broker is usually dialled by IP.
+  bool begin(const char *ca_pem, const char *cert_pem, const char *key_pem, const char *server_name);
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char *host, uint16_t port) override;
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t *buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t *buf, size_t size) override;
+  int peek() override;
+  void flush() override {}
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override { return connected(); }
+
+  const TlsStats &stats() const { return stats_; }
+
+private:
+  bool open_socket(IPAddress ip, uint16_t port);
+  bool handshake();
+  bool wait_socket(bool readable, uint32_t timeout_ms);
+
+  bool ready_ = false;
+  int fd_ = -1;
+  int peeked_ = -1;
+  TlsStats stats_ = {};
+
+  mbedtls_entropy_context entropy_;
+  mbedtls_ctr_drbg_context drbg_;
+  mbedtls_x509_crt ca_;
+  mbedtls_x509_crt cert_;
+  mbedtls_pk_context key_;
+  mbedtls_ssl_config conf_;
+  mbedtls_ssl_context ssl_;
+};
@@ -0,0 +1,104 @@
+#include "activity.h"
+
+bool ActivityController::begin(const ActivityThresholds &thresholds, ActivityProfile initial)
+{
+  enabled_ = false;
+  const ActivityThresholds &t = thresholds;
+  if (t.normal_exit > t.normal_enter || t.burst_exit > t.burst_enter ||
+      t.normal_enter > t.burst_enter || initial >= ACTIVITY_PROFILE_COUNT)
+  {
+    return false;
+  }
+  thresholds_ = thresholds;
+  profile_ = initial;
+  below_ = false;
+  bursts_ = 0;
+  enabled_ = true;
+  return true;
+}
+
+bool ActivityController::step_to(ActivityProfile profile)
+{
+  below_ = false; // the next step down waits a full hold again
+  if (profile == profile_)
+  {
+    return false;
+  }
+  if (profile == ACTIVITY_BURST)
+  {
+    bursts_++;
+  }
+  profile_ = profile;
+  return true;
+}
+
+bool ActivityController::update(float level, uint32_t now_ms)
+{
+  if (!enabled_)
+  {
+    return false;
+  }
+
+  if (level >= thresholds_.burst_enter)
+  {
+    return step_to(ACTIVITY_BURST);
+  }
+  if (profile_ == ACTIVITY_IDLE && level >= thresholds_.normal_enter)
+  {
+    return step_to(ACTIVITY_NORMAL);
+  }
+  if (profile_ == ACTIVITY_IDLE)
+  {
+    return false;
+  }
+
+  float exit = profile_ == ACTIVITY_BURST ? thresholds_.burst_exit : thresholds_.normal_exit;
+  if (level >= exit)
+  {
+    below_ = false;
+    return false;
+  }
+  if (!below_)
+  {
+    below_ = true;
+    below_since_ms_ = now_ms;
+    return false;
+  }
+  if (now_ms - below_since_ms_ < thresholds_.hold_ms)
+  {
+    return false;
+  }
+  return step_to((ActivityProfile)(profile_ - 1));
+}
+
+bool ActivityController::wake(uint32_t now_ms)
+{
+  if (!enabled_)
+  {
+    return false;
+  }
+  if (profile_ == ACTIVITY_IDLE)
+  {
+    return step_to(ACTIVITY_NORMAL);
+  }
+  if (profile_ == ACTIVITY_NORMAL && below_)
+  {
+    below_since_ms_ = now_ms; // a burst still ends on its level alone
+  }
+  return false;
+}
+
+const char *activity_profile_name(ActivityProfile profile)
+{
+  switch (profile)
+  {
+  case ACTIVITY_IDLE:
+    return "idle";
+  case ACTIVITY_NORMAL:
+    return "normal";
+  case ACTIVITY_BURST:
+    return "burst";
+  default:
+    return "?";
+  }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum ActivityProfile : uint8_t
+{
+  ACTIVITY_IDLE = 0, // reduced rate, only enough to notice the next event
+  ACTIVITY_NORMAL,
+  ACTIVITY_BURST,    // full rate, every sample reported
+  ACTIVITY_PROFILE_COUNT
+};
+
+// Levels are in the unit of whatever the channel feeds to update().
+struct ActivityThresholds
+{
+  float normal_enter; // idle -> normal at or above this
+  float normal_exit;  // normal -> idle below this, <= normal_enter
+  float burst_enter;  // -> burst at or above this, >= normal_enter
+  float burst_exit;   // burst -> normal below this, <= burst_enter
+  uint32_t hold_ms;   // a level must stay below the exit threshold this long
+};
+
+// Idle/normal/burst profile of one channel, with hysteresis both ways: a
+// higher profile is entered on the first level at its enter threshold, a
+// lower one only after the level has stayed below the exit threshold for
+// hold_ms, one step at a time.
+class ActivityController
+{
+public:
+  // Returns false if the thresholds are not ordered (controller disabled).
+  bool begin(const ActivityThresholds &thresholds, ActivityProfile initial = ACTIVITY_NORMAL);
+
+  // One level per update. Returns true when the profile changed.
+  bool update(float level, uint32_t now_ms);
+
+  // Wake-up from outside the level, e.g. a motion interrupt: at least
+  // NORMAL, and a pending drop to IDLE waits a full hold again. Returns
+  // true on a change.
+  bool wake(uint32_t now_ms);
+
+  ActivityProfile profile() const { return profile_; }
+  uint32_t bursts() const { return bursts_; } // burst entries since begin()
+
+private:
+  bool step_to(ActivityProfile profile);
+
+  ActivityThresholds thresholds_ = {};
+  bool enabled_ = false;
+  ActivityProfile profile_ = ACTIVITY_NORMAL;
+  bool below_ = false;
+  uint32_t below_since_ms_ = 0;
+  uint32_t bursts_ = 0;
+};
+
+const char *activity_profile_name(ActivityProfile profile);
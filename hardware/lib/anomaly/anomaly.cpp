@@ -0,0 +1,169 @@
+#include "anomaly.h"
+
+void StreamingStats::reset()
+{
+  count = 0;
+  mean = 0;
+  m2 = 0;
+  ewma = 0;
+  last = 0;
+  last_ms = 0;
+  rate_ref = 0;
+  rate_ref_ms = 0;
+  window_head = 0;
+  window_fill = 0;
+}
+
+void StreamingStats::add(float value, float ewma_alpha, uint32_t baseline_max)
+{
+  if (count < baseline_max)
+  {
+    count++;
+  }
+  else
+  {
+    // drop one average sample's worth of spread to make room
+    m2 -= m2 / count;
+  }
+  float delta = value - mean;
+  mean += delta / count;
+  m2 += delta * (value - mean);
+
+  ewma = count == 1 ? value : ewma + ewma_alpha * (value - ewma);
+  last = value;
+
+  window[window_head] = value;
+  window_head = (window_head + 1) % ANOMALY_ROLLING_WINDOW;
+  if (window_fill < ANOMALY_ROLLING_WINDOW)
+  {
+    window_fill++;
+  }
+}
+
+float StreamingStats::rolling_min() const
+{
+  float lo = window_fill ? window[0] : 0;
+  for (uint8_t i = 1; i < window_fill; i++)
+  {
+    lo = fminf(lo, window[i]);
+  }
+  return lo;
+}
+
+float StreamingStats::rolling_max() const
+{
+  float hi = window_fill ? window[0] : 0;
+  for (uint8_t i = 1; i < window_fill; i++)
+  {
+    hi = fmaxf(hi, window[i]);
+  }
+  return hi;
+}
+
+bool AnomalyDetector::begin(const AnomalyRule *rules, size_t rule_count, float ewma_alpha,
+                            uint32_t warmup_samples, uint32_t baseline_samples, uint32_t rate_window_ms)
+{
+  rule_count_ = 0;
+  for (size_t i = 0; i < ANOMALY_MAX_CHANNELS; i++)
+  {
+    stats_[i].reset();
+  }
+  if (rule_count > ANOMALY_MAX_RULES)
+  {
+    return false;
+  }
+  for (size_t i = 0; i < rule_count; i++)
+  {
+    if (rules[i].channel >= ANOMALY_MAX_CHANNELS)
+    {
+      return false;
+    }
+    rules_[i] = rules[i];
+    active_[i] = false;
+  }
+  rule_count_ = rule_count;
+  ewma_alpha_ = ewma_alpha;
+  warmup_ = warmup_samples;
+  baseline_ = baseline_samples > 1 ? baseline_samples : 2;
+  rate_window_ms_ = rate_window_ms ? rate_window_ms : 1;
+  return true;
+}
+
+size_t AnomalyDetector::add(uint8_t channel, float value, uint32_t now_ms, AnomalyEvent *events, size_t max_events)
+{
+  if (channel >= ANOMALY_MAX_CHANNELS)
+  {
+    return 0;
+  }
+  StreamingStats &s = stats_[channel];
+
+  // rules see the baseline before this reading, the rate the EWMA after it.
+  // The slope is taken over at least rate_window_ms: reading to reading it
+  // would mostly be noise for the fast channels.
+  size_t n = 0;
+  bool frozen = false;
+  float ewma = s.count == 0 ? value : s.ewma + ewma_alpha_ * (value - s.ewma);
+  uint32_t dt_ms = now_ms - s.rate_ref_ms;
+  bool rate_due = s.count > 0 && dt_ms >= rate_window_ms_;
+  for (size_t i = 0; i < rule_count_ && s.count >= warmup_; i++)
+  {
+    const AnomalyRule &rule = rules_[i];
+    if (rule.channel != channel)
+    {
+      continue;
+    }
+
+    float score;
+    if (rule.type == ANOMALY_ZSCORE)
+    {
+      score = fabsf(value - s.mean) / fmaxf(s.stddev(), rule.min_stddev);
+    }
+    else if (rate_due)
+    {
+      score = fabsf(ewma - s.rate_ref) * 1000.0f / dt_ms;
+    }
+    else
+    {
+      continue;
+    }
+
+    bool edge = active_[i] ? score < rule.clear : score >= rule.raise;
+    if (edge)
+    {
+      active_[i] = !active_[i];
+      if (n < max_events)
+      {
+        events[n].channel = channel;
+        events[n].rule = i;
+        events[n].type = rule.type;
+        events[n].active = active_[i];
+        events[n].value = value;
+        events[n].score = score;
+        n++;
+      }
+    }
+    frozen = frozen || (rule.type == ANOMALY_ZSCORE && active_[i]);
+  }
+
+  if (frozen)
+  {
+    // EWMA, last value and the rolling window keep moving, the baseline not
+    uint32_t count = s.count;
+    float mean = s.mean, m2 = s.m2;
+    s.add(value, ewma_alpha_, baseline_);
+    s.count = count;
+    s.mean = mean;
+    s.m2 = m2;
+  }
+  else
+  {
+    s.add(value, ewma_alpha_, baseline_);
+  }
+  s.last_ms = now_ms;
+  if (s.count == 1 || rate_due)
+  {
+    s.rate_ref = s.ewma;
+    s.rate_ref_ms = now_ms;
+  }
+  return n;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ANOMALY_MAX_CHANNELS 8
+#define ANOMALY_MAX_RULES 16
+#define ANOMALY_ROLLING_WINDOW 32 // samples behind the rolling min/max
+
+// Per-channel statistics in fixed memory, one update per reading.
+struct StreamingStats
+{
+  uint32_t count;
+  float mean; // Welford
+  float m2;
+  float ewma;
+  float last;
+  uint32_t last_ms;
+  float rate_ref; // EWMA at rate_ref_ms, start of the current slope window
+  uint32_t rate_ref_ms;
+  float window[ANOMALY_ROLLING_WINDOW];
+  uint8_t window_head;
+  uint8_t window_fill;
+
+  void reset();
+
+  // Welford update; once count reaches baseline_max, old samples fade out
+  // as if the baseline were a sliding window of that length.
+  void add(float value, float ewma_alpha, uint32_t baseline_max);
+
+  float variance() const { return count > 1 ? m2 / (count - 1) : 0; }
+  float stddev() const { return sqrtf(variance()); }
+  float rolling_min() const;
+  float rolling_max() const;
+};
+
+enum AnomalyRuleType : uint8_t
+{
+  ANOMALY_ZSCORE = 0, // |x - mean| / stddev against the learned baseline
+  ANOMALY_RATE,       // EWMA slope over the rate window, units per second
+};
+
+struct AnomalyRule
+{
+  uint8_t channel;
+  AnomalyRuleType type;
+  float raise; // score at which the rule fires
+  float clear; // score below which it clears again (hysteresis)
+  float min_stddev; // z-score floor for near-constant signals
+};
+
+struct AnomalyEvent
+{
+  uint8_t channel;
+  uint8_t rule; // index into the rule table
+  AnomalyRuleType type;
+  bool active;  // raised (true) or cleared
+  float value;  // reading that caused the edge
+  float score;
+};
+
+// Runs the rule table against each reading as it arrives and reports rule
+// edges. A channel's baseline is frozen while any of its z-score rules is
+// active, so an anomaly is not learned as the new normal.
+class AnomalyDetector
+{
+public:
+  // Returns false if the table is too large for the fixed buffers.
+  bool begin(const AnomalyRule *rules, size_t rule_count, float ewma_alpha,
+             uint32_t warmup_samples, uint32_t baseline_samples, uint32_t rate_window_ms);
+
+  // Feeds one reading. Writes up to max_events edges to events and
+  // returns how many.
+  size_t add(uint8_t channel, float value, uint32_t now_ms, AnomalyEvent *events, size_t max_events);
+
+  const StreamingStats &stats(uint8_t channel) const { return stats_[channel]; }
+
+private:
+  AnomalyRule rules_[ANOMALY_MAX_RULES];
+  bool active_[ANOMALY_MAX_RULES];
+  size_t rule_count_ = 0;
+  StreamingStats stats_[ANOMALY_MAX_CHANNELS];
+  float ewma_alpha_ = 0.1f;
+  uint32_t warmup_ = 0;
+  uint32_t baseline_ = 0;
+  uint32_t rate_window_ms_ = 1000;
+};
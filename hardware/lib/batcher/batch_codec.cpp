@@ -0,0 +1,224 @@
+#include <string.h>
+
+#include "batch_codec.h"
+
+static uint32_t get_le(const uint8_t *p, uint8_t size)
+{
+  uint32_t v = 0;
+  for (uint8_t i = 0; i < size; i++)
+  {
+    v |= (uint32_t)p[i] << (8 * i);
+  }
+  return v;
+}
+
+static void put_le(uint8_t *p, uint32_t v, uint8_t size)
+{
+  for (uint8_t i = 0; i < size; i++)
+  {
+    p[i] = (v >> (8 * i)) & 0xFF;
+  }
+}
+
+static uint32_t width_mask(uint8_t size)
+{
+  return size >= 4 ? 0xFFFFFFFFu : (1u << (8 * size)) - 1;
+}
+
+// Wrapped difference of two size-byte fields as a signed value
+static int32_t field_delta(uint32_t value, uint32_t prev, uint8_t size)
+{
+  uint32_t d = (value - prev) & width_mask(size);
+  uint32_t sign = 1u << (8 * size - 1);
+  return (int32_t)((d ^ sign) - sign); // sign-extend from the field width
+}
+
+static uint64_t zigzag(int64_t v)
+{
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static bool put_varint(uint8_t *out, size_t out_len, size_t &pos, uint64_t v)
+{
+  do
+  {
+    if (pos >= out_len)
+    {
+      return false;
+    }
+    uint8_t byte = v & 0x7F;
+    v >>= 7;
+    out[pos++] = v ? byte | 0x80 : byte;
+  } while (v);
+  return true;
+}
+
+static bool get_varint(const uint8_t *data, size_t len, size_t &pos, uint64_t &v)
+{
+  v = 0;
+  for (uint8_t shift = 0; shift < 64; shift += 7)
+  {
+    if (pos >= len)
+    {
+      return false;
+    }
+    uint8_t byte = data[pos++];
+    v |= (uint64_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+static size_t record_size(const uint8_t *field_sizes, size_t field_count)
+{
+  size_t size = 0;
+  for (size_t f = 0; f < field_count; f++)
+  {
+    if (field_sizes[f] == 0 || field_sizes[f] > 4)
+    {
+      return 0;
+    }
+    size += field_sizes[f];
+  }
+  return size;
+}
+
+size_t batch_compress(const uint8_t *frame, size_t len, const uint8_t *field_sizes,
+                      size_t field_count, uint8_t *out, size_t out_len)
+{
+  size_t rec = record_size(field_sizes, field_count);
+  if (rec == 0 || field_count > BATCH_CODEC_MAX_FIELDS || len < BATCH_HEADER_BYTES ||
+      out_len < BATCH_HEADER_BYTES || (frame[0] & BATCH_COMPRESSED_FLAG))
+  {
+    return 0;
+  }
+  uint8_t count = frame[1];
+  if (len != BATCH_HEADER_BYTES + count * (4 + rec))
+  {
+    return 0;
+  }
+  // never worth it past the raw size, which also bounds the work below
+  if (out_len > len - 1)
+  {
+    out_len = len - 1;
+  }
+
+  memcpy(out, frame, BATCH_HEADER_BYTES);
+  out[0] |= BATCH_COMPRESSED_FLAG;
+  size_t pos = BATCH_HEADER_BYTES;
+  const size_t mask_bytes = (field_count + 7) / 8;
+
+  uint32_t prev[BATCH_CODEC_MAX_FIELDS] = {};
+  int64_t prev_dt = 0;
+  uint32_t prev_t = 0;
+  const uint8_t *p = frame + BATCH_HEADER_BYTES;
+  for (uint8_t r = 0; r < count; r++)
+  {
+    uint32_t t = get_le(p, 4);
+    int64_t dt = (int64_t)t - prev_t;
+    if (!put_varint(out, out_len, pos, zigzag(dt - prev_dt)))
+    {
+      return 0;
+    }
+    prev_t = t;
+    prev_dt = dt;
+    p += 4;
+
+    if (pos + mask_bytes > out_len)
+    {
+      return 0;
+    }
+    uint8_t *mask = &out[pos];
+    memset(mask, 0, mask_bytes);
+    pos += mask_bytes;
+    for (size_t f = 0; f < field_count; f++)
+    {
+      uint32_t v = get_le(p, field_sizes[f]);
+      p += field_sizes[f];
+      int32_t delta = field_delta(v, prev[f], field_sizes[f]);
+      prev[f] = v;
+      if (delta == 0)
+      {
+        continue;
+      }
+      mask[f / 8] |= 1 << (f % 8);
+      if (!put_varint(out, out_len, pos, zigzag(delta)))
+      {
+        return 0;
+      }
+    }
+  }
+  return pos;
+}
+
+size_t batch_decompress(const uint8_t *data, size_t len, const uint8_t *field_sizes,
+                        size_t field_count, uint8_t *out, size_t out_len)
+{
+  size_t rec = record_size(field_sizes, field_count);
+  if (rec == 0 || field_count > BATCH_CODEC_MAX_FIELDS || len < BATCH_HEADER_BYTES ||
+      !(data[0] & BATCH_COMPRESSED_FLAG))
+  {
+    return 0;
+  }
+  uint8_t count = data[1];
+  size_t size = BATCH_HEADER_BYTES + count * (4 + rec);
+  if (size > out_len)
+  {
+    return 0;
+  }
+
+  memcpy(out, data, BATCH_HEADER_BYTES);
+  out[0] &= ~BATCH_COMPRESSED_FLAG;
+  size_t pos = BATCH_HEADER_BYTES;
+  const size_t mask_bytes = (field_count + 7) / 8;
+
+  uint32_t prev[BATCH_CODEC_MAX_FIELDS] = {};
+  int64_t prev_dt = 0;
+  int64_t t = 0;
+  uint8_t *p = out + BATCH_HEADER_BYTES;
+  for (uint8_t r = 0; r < count; r++)
+  {
+    uint64_t v;
+    if (!get_varint(data, len, pos, v))
+    {
+      return 0;
+    }
+    prev_dt += unzigzag(v);
+    t += prev_dt;
+    if (t < 0 || t > UINT32_MAX)
+    {
+      return 0;
+    }
+    put_le(p, (uint32_t)t, 4);
+    p += 4;
+
+    if (pos + mask_bytes > len)
+    {
+      return 0;
+    }
+    const uint8_t *mask = &data[pos];
+    pos += mask_bytes;
+    for (size_t f = 0; f < field_count; f++)
+    {
+      if (mask[f / 8] & (1 << (f % 8)))
+      {
+        if (!get_varint(data, len, pos, v))
+        {
+          return 0;
+        }
+        prev[f] = (prev[f] + (uint32_t)unzigzag(v)) & width_mask(field_sizes[f]);
+      }
+      put_le(p, prev[f], field_sizes[f]);
+      p += field_sizes[f];
+    }
+  }
+  return pos == len ? size : 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "frame_batcher.h"
+
+// Lossless compression of a FrameBatcher frame. Consecutive samples barely
+// differ, so instead of fixed-width records the compressed frame carries,
+// after the unchanged 18-byte header (version | BATCH_COMPRESSED_FLAG):
+//
+//   count x {
+//     varint  zig-zag delta-of-delta of dt_us (first record: dt_us itself)
+//     mask    ceil(fields / 8) bytes, bit i set if field i changed
+//     varint  zig-zag delta of every changed field, in field order
+//   }
+//
+// Records are described by their field widths (1, 2 or 4 bytes); deltas
+// wrap in the field width, so signed and unsigned fields need no flag.
+// Unchanged fields cost one mask bit: slow channels (DHT22, flags, the
+// replay sequence step) are almost free.
+#define BATCH_COMPRESSED_FLAG 0x80
+#define BATCH_CODEC_MAX_FIELDS 32
+
+// Writes the compressed form of frame into out. Returns its length, or 0
+// if it does not fit out_len (or would not be smaller): send frame as is.
+// No allocation; out is the only scratch memory.
+size_t batch_compress(const uint8_t *frame, size_t len, const uint8_t *field_sizes,
+                      size_t field_count, uint8_t *out, size_t out_len);
+
+// Inverse of batch_compress. Returns the frame length, 0 if data is malformed.
+size_t batch_decompress(const uint8_t *data, size_t len, const uint8_t *field_sizes,
+                        size_t field_count, uint8_t *out, size_t out_len);
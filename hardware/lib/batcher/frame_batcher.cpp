@@ -0,0 +1,83 @@
+#include <string.h>
+
+#include "frame_batcher.h"
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+  put_u16(p, v & 0xFFFF);
+  put_u16(p + 2, v >> 16);
+}
+
+static void put_u64(uint8_t *p, uint64_t v)
+{
+  put_u32(p, v & 0xFFFFFFFF);
+  put_u32(p + 4, v >> 32);
+}
+
+void FrameBatcher::begin(uint8_t version, uint8_t max_records, uint32_t max_age_ms)
+{
+  version_ = version;
+  set_limits(max_records, max_age_ms);
+  clear();
+}
+
+void FrameBatcher::set_limits(uint8_t max_records, uint32_t max_age_ms)
+{
+  max_records_ = max_records ? max_records : 1;
+  max_age_us_ = (uint64_t)max_age_ms * 1000;
+}
+
+void FrameBatcher::clear()
+{
+  count_ = 0;
+  urgent_ = false;
+  size_ = BATCH_HEADER_BYTES;
+  buffer_[0] = version_;
+  buffer_[1] = 0;
+  set_epoch_offset(0);
+}
+
+void FrameBatcher::set_epoch_offset(int64_t offset_us)
+{
+  put_u64(&buffer_[10], (uint64_t)offset_us);
+}
+
+bool FrameBatcher::append(uint64_t timestamp_us, const void *record, size_t len, bool urgent)
+{
+  if (count_ >= max_records_ || size_ + 4 + len > sizeof(buffer_))
+  {
+    return false;
+  }
+  if (count_ == 0)
+  {
+    base_us_ = timestamp_us;
+    put_u64(&buffer_[2], base_us_);
+  }
+  // records arrive in order; anything earlier or ~71 min later starts a new frame
+  if (timestamp_us < base_us_ || timestamp_us - base_us_ > UINT32_MAX)
+  {
+    return false;
+  }
+
+  put_u32(&buffer_[size_], (uint32_t)(timestamp_us - base_us_));
+  memcpy(&buffer_[size_ + 4], record, len);
+  size_ += 4 + len;
+  buffer_[1] = ++count_;
+  urgent_ = urgent_ || urgent;
+  return true;
+}
+
+bool FrameBatcher::should_flush(uint64_t now_us) const
+{
+  if (count_ == 0)
+  {
+    return false;
+  }
+  return urgent_ || count_ >= max_records_ || now_us - base_us_ >= max_age_us_;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef BATCH_MAX_BYTES
+#define BATCH_MAX_BYTES 1800
+#endif
+
+#define BATCH_HEADER_BYTES 18
+
+// Packs several fixed-size records into one MQTT frame:
+//
+//   uint8  version
+//   uint8  count
+//   uint64 base timestamp (us, first record)
+//   int64  epoch offset (us, device time -> UTC, 0 = not synced)
+//   count x { uint32 dt_us since base, record bytes }
+//
+// All little-endian. The frame is flushed on size, on age, or right away
+// when a record is appended as urgent (alarm edge).
+class FrameBatcher
+{
+public:
+  void begin(uint8_t version, uint8_t max_records, uint32_t max_age_ms);
+
+  // Takes effect from the next should_flush(); an open frame that is now
+  // over the limit is due right away.
+  void set_limits(uint8_t max_records, uint32_t max_age_ms);
+
+  // Appends one record. Returns false if it does not fit (frame full, record
+  // too far from the base timestamp) - flush and append again.
+  bool append(uint64_t timestamp_us, const void *record, size_t len, bool urgent = false);
+
+  // Size, age or urgency says the frame should go out now.
+  bool should_flush(uint64_t now_us) const;
+
+  // Written into the header; set it right before sending so the frame
+  // carries the latest clock correction.
+  void set_epoch_offset(int64_t offset_us);
+
+  bool empty() const { return count_ == 0; }
+  uint8_t count() const { return count_; }
+  const uint8_t *data() const { return buffer_; }
+  size_t size() const { return size_; }
+  void clear();
+
+private:
+  uint8_t version_ = 0;
+  uint8_t max_records_ = 1;
+  uint64_t max_age_us_ = 0;
+
+  uint8_t count_ = 0;
+  bool urgent_ = false;
+  uint64_t base_us_ = 0;
+  size_t size_ = 0;
+  uint8_t buffer_[BATCH_MAX_BYTES];
+};
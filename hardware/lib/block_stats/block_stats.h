@@ -0,0 +1,95 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+// Integer accumulator for a block of ADC samples. Blocks merge exactly, so a
+// DMA frame can be reduced once and then folded into the publish interval.
+struct BlockStats
+{
+  uint32_t count;
+  uint64_t sum;
+  uint64_t sum_sq;
+  uint16_t min;
+  uint16_t max;
+
+  void reset()
+  {
+    count = 0;
+    sum = 0;
+    sum_sq = 0;
+    min = UINT16_MAX;
+    max = 0;
+  }
+
+  void add(uint16_t value)
+  {
+    count++;
+    sum += value;
+    sum_sq += (uint32_t)value * value;
+    if (value < min)
+    {
+      min = value;
+    }
+    if (value > max)
+    {
+      max = value;
+    }
+  }
+
+  void merge(const BlockStats &other)
+  {
+    count += other.count;
+    sum += other.sum;
+    sum_sq += other.sum_sq;
+    if (other.min < min)
+    {
+      min = other.min;
+    }
+    if (other.max > max)
+    {
+      max = other.max;
+    }
+  }
+
+  float mean() const { return count ? (float)sum / count : 0; }
+
+  // Integer results in 0.1 counts, rounded, for the telemetry path
+  uint32_t mean_deci() const { return count ? (sum * 10 + count / 2) / count : 0; }
+
+  // RMS of the signal around its mean, i.e. the AC component. Exact in
+  // 64 bits for blocks of up to ~100k 12-bit samples.
+  uint32_t ac_rms_deci() const
+  {
+    if (count == 0)
+    {
+      return 0;
+    }
+    uint64_t spread = (uint64_t)count * sum_sq - sum * sum; // count^2 * variance
+    return (isqrt(spread * 100) + count / 2) / count;
+  }
+
+  static uint32_t isqrt(uint64_t v)
+  {
+    uint64_t root = 0;
+    uint64_t bit = 1ull << 62;
+    while (bit > v)
+    {
+      bit >>= 2;
+    }
+    while (bit != 0)
+    {
+      if (v >= root + bit)
+      {
+        v -= root + bit;
+        root = (root >> 1) + bit;
+      }
+      else
+      {
+        root >>= 1;
+      }
+      bit >>= 2;
+    }
+    return (uint32_t)root;
+  }
+};
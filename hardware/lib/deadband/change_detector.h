@@ -0,0 +1,61 @@
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Per-channel deadband around the last reported value, plus a heartbeat.
+// A deadband of 0 reports any change; a negative one never triggers a report
+// (the channel still goes out with the others).
+template <size_t N>
+class ChangeDetector
+{
+public:
+  void begin(const float (&deadband)[N], uint32_t heartbeat_ms)
+  {
+    for (size_t i = 0; i < N; i++)
+    {
+      deadband_[i] = deadband[i];
+    }
+    heartbeat_ms_ = heartbeat_ms;
+    has_reported_ = false;
+  }
+
+  bool should_report(const float (&values)[N], uint32_t now_ms) const
+  {
+    if (!has_reported_ || now_ms - last_report_ms_ >= heartbeat_ms_)
+    {
+      return true;
+    }
+    for (size_t i = 0; i < N; i++)
+    {
+      if (deadband_[i] < 0)
+      {
+        continue;
+      }
+      float delta = fabsf(values[i] - reported_[i]);
+      if (deadband_[i] == 0 ? delta > 0 : delta >= deadband_[i])
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void reported(const float (&values)[N], uint32_t now_ms)
+  {
+    for (size_t i = 0; i < N; i++)
+    {
+      reported_[i] = values[i];
+    }
+    last_report_ms_ = now_ms;
+    has_reported_ = true;
+  }
+
+private:
+  float deadband_[N] = {};
+  float reported_[N] = {};
+  uint32_t heartbeat_ms_ = 0;
+  uint32_t last_report_ms_ = 0;
+  bool has_reported_ = false;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Pulse timings of one DHT22 transmission: the 80/80 us response followed
+// by 40 bits, each a ~50 us low and a 26-28 us (0) or 70 us (1) high.
+struct Dht22Pulse
+{
+  uint16_t low_us;
+  uint16_t high_us;
+};
+
+enum Dht22Status
+{
+  DHT22_OK = 0,
+  DHT22_NO_RESPONSE, // response pulse not found or frame too short
+  DHT22_CHECKSUM,
+};
+
+// Decodes captured pulses into tenths of degC / tenths of %RH.
+inline Dht22Status dht22_decode(const Dht22Pulse *pulses, size_t count,
+                                int16_t *temperature_deci, uint16_t *humidity_deci)
+{
+  size_t start = 0;
+  while (start < count &&
+         !(pulses[start].low_us >= 60 && pulses[start].low_us <= 100 &&
+           pulses[start].high_us >= 60 && pulses[start].high_us <= 100))
+  {
+    start++;
+  }
+  // bits are pulses start+1 .. start+40
+  if (start + 40 >= count)
+  {
+    return DHT22_NO_RESPONSE;
+  }
+
+  uint8_t bytes[5] = {0, 0, 0, 0, 0};
+  for (size_t bit = 0; bit < 40; bit++)
+  {
+    // a high longer than ~48 us is a 1
+    if (pulses[start + 1 + bit].high_us > 48)
+    {
+      bytes[bit / 8] |= 0x80 >> (bit % 8);
+    }
+  }
+  if ((uint8_t)(bytes[0] + bytes[1] + bytes[2] + bytes[3]) != bytes[4])
+  {
+    return DHT22_CHECKSUM;
+  }
+
+  *humidity_deci = (bytes[0] << 8) | bytes[1];
+  int16_t t = ((bytes[2] & 0x7F) << 8) | bytes[3];
+  *temperature_deci = (bytes[2] & 0x80) ? -t : t;
+  return DHT22_OK;
+}
@@ -0,0 +1,13 @@
+#include <math.h>
+
+#include "filters.h"
+
+void Biquad::lowpass(float cutoff_hz, float sample_hz, float q)
+{
+  float w0 = 2 * (float)M_PI * cutoff_hz / sample_hz;
+  float cos_w0 = cosf(w0);
+  float alpha = sinf(w0) / (2 * q);
+  float a0 = 1 + alpha;
+  float b1 = (1 - cos_w0) / a0;
+  set(b1 / 2, b1, b1 / 2, -2 * cos_w0 / a0, (1 - alpha) / a0);
+}
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Integer sample filters for the ADC channels, composed at compile time:
+//
+//   FilterChain<MedianFilter<5>, CicDecimator<16, 3>, Biquad> gas;
+//
+// Every stage has process(in, out), which returns false while it has no
+// output for this input (a decimator between outputs); the chain stops there.
+
+static inline int32_t filter_div_round(int32_t num, int32_t den)
+{
+  return (num >= 0 ? num + den / 2 : num - den / 2) / den;
+}
+
+// Boxcar average of the last N inputs (of all inputs so far while filling)
+template <size_t N>
+class MovingAverage
+{
+public:
+  static const uint32_t decimation = 1;
+
+  void reset()
+  {
+    sum_ = 0;
+    count_ = 0;
+    next_ = 0;
+  }
+
+  bool process(int32_t in, int32_t &out)
+  {
+    if (count_ == N)
+    {
+      sum_ -= window_[next_];
+    }
+    else
+    {
+      count_++;
+    }
+    window_[next_] = in;
+    next_ = (next_ + 1) % N;
+    sum_ += in;
+    out = filter_div_round(sum_, count_);
+    return true;
+  }
+
+private:
+  int32_t window_[N] = {};
+  int32_t sum_ = 0;
+  size_t count_ = 0;
+  size_t next_ = 0;
+};
+
+// Median of the last N inputs; removes single-sample spikes without
+// smearing steps like an average does
+template <size_t N>
+class MedianFilter
+{
+  static_assert(N % 2 == 1, "MedianFilter needs an odd window");
+
+public:
+  static const uint32_t decimation = 1;
+
+  void reset()
+  {
+    count_ = 0;
+    next_ = 0;
+  }
+
+  bool process(int32_t in, int32_t &out)
+  {
+    window_[next_] = in;
+    next_ = (next_ + 1) % N;
+    if (count_ < N)
+    {
+      count_++;
+    }
+
+    // insertion sort of a copy; N is a handful of samples
+    int32_t sorted[N];
+    for (size_t i = 0; i < count_; i++)
+    {
+      int32_t v = window_[i];
+      size_t j = i;
+      for (; j > 0 && sorted[j - 1] > v; j--)
+      {
+        sorted[j] = sorted[j - 1];
+      }
+      sorted[j] = v;
+    }
+    out = sorted[count_ / 2];
+    return true;
+  }
+
+private:
+  int32_t window_[N] = {};
+  size_t count_ = 0;
+  size_t next_ = 0;
+};
+
+// Second-order IIR section, transposed direct form II. Passes the input
+// through until configured; the state is primed with the first input so a
+// low-pass does not start by ramping up from zero.
+class Biquad
+{
+public:
+  static const uint32_t decimation = 1;
+
+  // Coefficients normalised to a0 = 1
+  void set(float b0, float b1, float b2, float a1, float a2)
+  {
+    b0_ = b0;
+    b1_ = b1;
+    b2_ = b2;
+    a1_ = a1;
+    a2_ = a2;
+    reset();
+  }
+
+  // Butterworth (q = 1/sqrt(2)) or resonant low-pass, RBJ cookbook
+  void lowpass(float cutoff_hz, float sample_hz, float q = 0.70710678f);
+
+  void reset() { primed_ = false; }
+
+  bool process(int32_t in, int32_t &out)
+  {
+    float x = (float)in;
+    if (!primed_)
+    {
+      float dc_gain = (b0_ + b1_ + b2_) / (1 + a1_ + a2_);
+      float y = x * dc_gain;
+      z2_ = b2_ * x - a2_ * y;
+      z1_ = b1_ * x - a1_ * y + z2_;
+      primed_ = true;
+    }
+    float y = b0_ * x + z1_;
+    z1_ = b1_ * x - a1_ * y + z2_;
+    z2_ = b2_ * x - a2_ * y;
+    out = (int32_t)(y >= 0 ? y + 0.5f : y - 0.5f);
+    return true;
+  }
+
+private:
+  float b0_ = 1, b1_ = 0, b2_ = 0, a1_ = 0, a2_ = 0;
+  float z1_ = 0, z2_ = 0;
+  bool primed_ = false;
+};
+
+static constexpr uint32_t cic_gain(uint32_t r, uint32_t order)
+{
+  return order == 0 ? 1 : r * cic_gain(r, order - 1);
+}
+
+// Cascaded integrator-comb decimator: ORDER integrators at the input rate,
+// ORDER combs at 1/R of it, no multiplies. The output is normalised by the
+// R^ORDER gain, so it stays in input units. Integrators wrap in 32 bits,
+// which is exact as long as the gain leaves room for 16-bit inputs.
+template <uint32_t R, uint32_t ORDER>
+class CicDecimator
+{
+  static_assert(R >= 1 && ORDER >= 1, "CicDecimator needs R >= 1 and ORDER >= 1");
+  static_assert(cic_gain(R, ORDER) <= (1u << 16), "CIC gain overflows the 32-bit integrators");
+
+public:
+  static const uint32_t decimation = R;
+
+  void reset()
+  {
+    for (uint32_t s = 0; s < ORDER; s++)
+    {
+      integrator_[s] = 0;
+      comb_[s] = 0;
+    }
+    phase_ = 0;
+  }
+
+  bool process(int32_t in, int32_t &out)
+  {
+    uint32_t v = (uint32_t)in;
+    for (uint32_t s = 0; s < ORDER; s++)
+    {
+      integrator_[s] += v;
+      v = integrator_[s];
+    }
+    if (++phase_ < R)
+    {
+      return false;
+    }
+    phase_ = 0;
+
+    for (uint32_t s = 0; s < ORDER; s++)
+    {
+      uint32_t delayed = comb_[s];
+      comb_[s] = v;
+      v -= delayed;
+    }
+    out = filter_div_round((int32_t)v, (int32_t)cic_gain(R, ORDER));
+    return true;
+  }
+
+private:
+  uint32_t integrator_[ORDER] = {};
+  uint32_t comb_[ORDER] = {};
+  uint32_t phase_ = 0;
+};
+
+template <typename... Stages>
+class FilterChain;
+
+template <size_t I, typename Chain>
+struct FilterStage;
+
+// Empty chain: pass-through
+template <>
+class FilterChain<>
+{
+public:
+  static const uint32_t decimation = 1;
+
+  void reset() {}
+
+  bool process(int32_t in, int32_t &out)
+  {
+    out = in;
+    return true;
+  }
+};
+
+template <typename Head, typename... Tail>
+class FilterChain<Head, Tail...>
+{
+public:
+  typedef Head HeadStage;
+  typedef FilterChain<Tail...> TailChain;
+
+  // input samples per output sample
+  static const uint32_t decimation = Head::decimation * TailChain::decimation;
+
+  void reset()
+  {
+    head.reset();
+    tail.reset();
+  }
+
+  bool process(int32_t in, int32_t &out)
+  {
+    int32_t mid;
+    return head.process(in, mid) && tail.process(mid, out);
+  }
+
+  // The I-th stage, e.g. to configure a Biquad: chain.stage<2>().lowpass(...)
+  template <size_t I>
+  typename FilterStage<I, FilterChain>::type &stage()
+  {
+    return FilterStage<I, FilterChain>::get(*this);
+  }
+
+  Head head;
+  TailChain tail;
+};
+
+template <size_t I, typename Chain>
+struct FilterStage
+{
+  typedef FilterStage<I - 1, typename Chain::TailChain> Next;
+  typedef typename Next::type type;
+  static type &get(Chain &chain) { return Next::get(chain.tail); }
+};
+
+template <typename Chain>
+struct FilterStage<0, Chain>
+{
+  typedef typename Chain::HeadStage type;
+  static type &get(Chain &chain) { return chain.head; }
+};
@@ -0,0 +1,188 @@
+#include <string.h>
+
+#include "flash_journal.h"
+
+#define SLOTS_PER_SECTOR (JOURNAL_SECTOR_BYTES / JOURNAL_RECORD_BYTES)
+
+uint32_t journal_crc32(const void *data, size_t len, uint32_t crc)
+{
+  // bitwise CRC-32 (IEEE), ~60 bytes per record does not need a table
+  const uint8_t *p = (const uint8_t *)data;
+  crc = ~crc;
+  while (len--)
+  {
+    crc ^= *p++;
+    for (int i = 0; i < 8; i++)
+    {
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+static uint32_t record_crc(const JournalRecord &record)
+{
+  uint32_t crc = journal_crc32(&record.seq, sizeof(record.seq));
+  return journal_crc32(&record.timestamp_us, offsetof(JournalRecord, crc) - offsetof(JournalRecord, timestamp_us), crc);
+}
+
+bool FlashJournal::read_slot(uint32_t slot, JournalRecord &record)
+{
+  if (!flash_->read(slot * JOURNAL_RECORD_BYTES, &record, sizeof(record)))
+  {
+    return false;
+  }
+  return record.seq != JOURNAL_SEQ_ERASED && record.len <= JOURNAL_PAYLOAD_MAX &&
+         record.crc == record_crc(record);
+}
+
+bool FlashJournal::slot_blank(uint32_t slot)
+{
+  uint32_t words[JOURNAL_RECORD_BYTES / sizeof(uint32_t)];
+  if (!flash_->read(slot * JOURNAL_RECORD_BYTES, words, sizeof(words)))
+  {
+    return false;
+  }
+  for (uint32_t word : words)
+  {
+    if (word != 0xFFFFFFFFu)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool FlashJournal::begin(JournalFlash *flash)
+{
+  flash_ = flash;
+  slots_ = (flash->size() / JOURNAL_SECTOR_BYTES) * SLOTS_PER_SECTOR;
+  if (slots_ < 2 * SLOTS_PER_SECTOR)
+  {
+    slots_ = 0;
+    return false;
+  }
+
+  // newest record -> head, oldest unacked one -> tail
+  uint32_t newest_seq = 0, oldest_unacked_seq = JOURNAL_SEQ_ERASED;
+  uint32_t newest_slot = 0, oldest_slot = 0;
+  uint16_t newest_boot = 0;
+  bool any = false, any_unacked = false;
+  for (uint32_t slot = 0; slot < slots_; slot++)
+  {
+    JournalRecord record;
+    if (!read_slot(slot, record))
+    {
+      continue;
+    }
+    if (!any || record.seq > newest_seq)
+    {
+      newest_seq = record.seq;
+      newest_slot = slot;
+      newest_boot = record.boot_id;
+      any = true;
+    }
+    if (record.acked != 0 && record.seq < oldest_unacked_seq)
+    {
+      oldest_unacked_seq = record.seq;
+      oldest_slot = slot;
+      any_unacked = true;
+    }
+  }
+
+  head_ = any ? next(newest_slot) : 0;
+  // a write cut short by a reset leaves a slot that is neither valid nor
+  // erased; writing over it would corrupt the next record too. A new
+  // sector is erased before use anyway.
+  while (head_ % SLOTS_PER_SECTOR != 0 && !slot_blank(head_))
+  {
+    head_ = next(head_);
+  }
+  next_seq_ = any ? newest_seq + 1 : 1;
+  boot_id_ = newest_boot + 1;
+  tail_ = any_unacked ? oldest_slot : head_;
+  pending_ = (head_ + slots_ - tail_) % slots_;
+  if (any_unacked && pending_ == 0)
+  {
+    pending_ = slots_; // completely full
+  }
+  dropped_ = 0;
+  corrupt_ = 0;
+  return true;
+}
+
+bool FlashJournal::append(const void *payload, size_t len, uint64_t timestamp_us, int64_t epoch_offset_us)
+{
+  if (slots_ == 0 || len > JOURNAL_PAYLOAD_MAX)
+  {
+    return false;
+  }
+
+  if (head_ % SLOTS_PER_SECTOR == 0)
+  {
+    // entering a sector: if it still holds pending records, they are lost
+    uint32_t sector_end = head_ + SLOTS_PER_SECTOR;
+    while (pending_ > 0 && tail_ >= head_ && tail_ < sector_end)
+    {
+      tail_ = next(tail_);
+      pending_--;
+      dropped_++;
+    }
+    if (!flash_->erase_sector(head_ * JOURNAL_RECORD_BYTES))
+    {
+      return false;
+    }
+  }
+
+  JournalRecord record;
+  memset(&record, 0xFF, sizeof(record));
+  record.seq = next_seq_;
+  record.timestamp_us = timestamp_us;
+  record.epoch_offset_us = epoch_offset_us;
+  record.boot_id = boot_id_;
+  record.len = len;
+  record.reserved = 0;
+  memcpy(record.payload, payload, len);
+  record.crc = record_crc(record);
+  if (!flash_->write(head_ * JOURNAL_RECORD_BYTES, &record, sizeof(record)))
+  {
+    return false;
+  }
+
+  next_seq_++;
+  head_ = next(head_);
+  pending_++;
+  return true;
+}
+
+size_t FlashJournal::read_pending(JournalEntry *out, size_t max)
+{
+  size_t count = 0;
+  uint32_t slot = tail_;
+  for (uint32_t span = 1; span <= pending_ && count < max; span++, slot = next(slot))
+  {
+    if (!read_slot(slot, out[count].record))
+    {
+      corrupt_++;
+      continue;
+    }
+    out[count].span = span;
+    count++;
+  }
+  return count;
+}
+
+void FlashJournal::consume(uint32_t span)
+{
+  static const uint32_t acked = 0;
+  if (span > pending_)
+  {
+    span = pending_;
+  }
+  for (uint32_t i = 0; i < span; i++)
+  {
+    flash_->write(tail_ * JOURNAL_RECORD_BYTES + offsetof(JournalRecord, acked), &acked, sizeof(acked));
+    tail_ = next(tail_);
+  }
+  pending_ -= span;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define JOURNAL_SECTOR_BYTES 4096 // erase unit
+#define JOURNAL_RECORD_BYTES 64
+#define JOURNAL_PAYLOAD_MAX 32
+#define JOURNAL_SEQ_ERASED 0xFFFFFFFFu
+
+// One fixed-size slot. Erased flash reads as all ones, so a slot is free
+// while seq is JOURNAL_SEQ_ERASED; acked is cleared in place (1 -> 0 needs
+// no erase) once the record was delivered.
+struct __attribute__((packed)) JournalRecord
+{
+  uint32_t seq;   // increasing across reboots, for dedupe on the backend
+  uint32_t acked; // 0xFFFFFFFF until replayed, then 0
+  uint64_t timestamp_us;
+  int64_t epoch_offset_us; // at capture, 0 if the clock was not synced yet
+  uint16_t boot_id;        // resolves epoch_offset_us == 0 in the same boot
+  uint8_t len;
+  uint8_t reserved;
+  uint8_t payload[JOURNAL_PAYLOAD_MAX];
+  uint32_t crc; // CRC-32 of every field except acked and crc
+};
+static_assert(sizeof(JournalRecord) == JOURNAL_RECORD_BYTES, "journal slots are fixed size");
+
+// Raw flash region the journal lives in; offsets are relative to its start.
+class JournalFlash
+{
+public:
+  virtual ~JournalFlash() {}
+  virtual size_t size() const = 0;
+  virtual bool read(uint32_t offset, void *dst, size_t len) = 0;
+  virtual bool write(uint32_t offset, const void *src, size_t len) = 0;
+  virtual bool erase_sector(uint32_t offset) = 0;
+};
+
+// A pending record and how many slots from the tail it reaches (corrupt
+// slots in between are counted but skipped).
+struct JournalEntry
+{
+  JournalRecord record;
+  uint32_t span;
+};
+
+// Append-only ring of fixed-size records over whole flash sectors. The head
+// erases one sector ahead of itself as it wraps, so every sector is erased
+// equally often. When the ring is full the oldest sector is dropped.
+class FlashJournal
+{
+public:
+  // Scans the region to recover head, tail and the next sequence number.
+  bool begin(JournalFlash *flash);
+
+  bool append(const void *payload, size_t len, uint64_t timestamp_us, int64_t epoch_offset_us);
+
+  // Reads up to max pending records, oldest first, without consuming them.
+  size_t read_pending(JournalEntry *out, size_t max);
+
+  // Marks the first span pending slots delivered and moves the tail past them.
+  void consume(uint32_t span);
+
+  uint32_t pending() const { return pending_; }
+  uint16_t boot_id() const { return boot_id_; }
+  uint32_t dropped() const { return dropped_; }
+  uint32_t corrupt() const { return corrupt_; }
+
+private:
+  bool read_slot(uint32_t slot, JournalRecord &record);
+  bool slot_blank(uint32_t slot);
+  uint32_t next(uint32_t slot) const { return slot + 1 < slots_ ? slot + 1 : 0; }
+
+  JournalFlash *flash_ = nullptr;
+  uint32_t slots_ = 0;
+  uint32_t head_ = 0; // next slot to write
+  uint32_t tail_ = 0; // oldest pending slot
+  uint32_t pending_ = 0;
+  uint32_t next_seq_ = 1;
+  uint16_t boot_id_ = 0;
+  uint32_t dropped_ = 0;
+  uint32_t corrupt_ = 0;
+};
+
+uint32_t journal_crc32(const void *data, size_t len, uint32_t crc = 0);
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed set of outgoing payload buffers, allocated with the pool (static
+// storage). A frame is leased, filled in place and published straight
+// from its buffer; nothing is copied or heap-allocated on the way.
+//
+//   FramePool<2, 2048>::Lease frame(pool);
+//   if (frame) { frame->len = format_...(frame->text(), frame->capacity); ... }
+//
+// Not thread-safe: one task owns a pool.
+template <size_t N, size_t SIZE>
+class FramePool
+{
+  static_assert(N >= 1 && N <= 32, "FramePool tracks its frames in a 32-bit mask");
+
+public:
+  struct Frame
+  {
+    static const size_t capacity = SIZE;
+    uint8_t data[SIZE];
+    size_t len;
+
+    char *text() { return (char *)data; }
+  };
+
+  // A frame for the lifetime of the lease; empty (false) if the pool ran dry
+  class Lease
+  {
+  public:
+    explicit Lease(FramePool &pool) : pool_(pool), frame_(pool.acquire()) {}
+    ~Lease()
+    {
+      if (frame_ != nullptr)
+      {
+        pool_.release(frame_);
+      }
+    }
+    Lease(const Lease &) = delete;
+    Lease &operator=(const Lease &) = delete;
+
+    explicit operator bool() const { return frame_ != nullptr; }
+    Frame *operator->() const { return frame_; }
+    Frame *get() const { return frame_; }
+
+  private:
+    FramePool &pool_;
+    Frame *frame_;
+  };
+
+  Frame *acquire()
+  {
+    for (size_t i = 0; i < N; i++)
+    {
+      if (!(used_ & (1u << i)))
+      {
+        used_ |= 1u << i;
+        frames_[i].len = 0;
+        size_t in_use = this->in_use();
+        peak_ = in_use > peak_ ? in_use : peak_;
+        return &frames_[i];
+      }
+    }
+    exhausted_++;
+    return nullptr;
+  }
+
+  void release(Frame *frame)
+  {
+    size_t i = frame - frames_;
+    if (i < N)
+    {
+      used_ &= ~(1u << i);
+    }
+  }
+
+  size_t in_use() const { return __builtin_popcount(used_); }
+  size_t peak() const { return peak_; }       // most frames leased at once
+  uint32_t exhausted() const { return exhausted_; } // acquires that found none free
+
+private:
+  Frame frames_[N];
+  uint32_t used_ = 0;
+  size_t peak_ = 0;
+  uint32_t exhausted_ = 0;
+};
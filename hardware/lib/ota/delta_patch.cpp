@@ -0,0 +1,180 @@
+#include <string.h>
+
+#include "delta_patch.h"
+
+#define DELTA_OP_INSERT 1 // low bit of the op tag, 0 is a copy
+
+void DeltaPatcher::begin(DeltaSource *source, DeltaSink *sink)
+{
+  source_ = source;
+  sink_ = sink;
+  state_ = DELTA_HEADER;
+  error_ = nullptr;
+  header_ = {};
+  header_len_ = 0;
+  varint_ = 0;
+  varint_shift_ = 0;
+  op_len_ = 0;
+  source_pos_ = 0;
+  written_ = 0;
+}
+
+bool DeltaPatcher::fail(const char *error)
+{
+  state_ = DELTA_FAILED;
+  error_ = error;
+  return false;
+}
+
+bool DeltaPatcher::take_varint(uint8_t byte)
+{
+  if (varint_shift_ > 63)
+  {
+    return fail("varint too long");
+  }
+  varint_ |= (uint64_t)(byte & 0x7F) << varint_shift_;
+  varint_shift_ += 7;
+  return (byte & 0x80) == 0;
+}
+
+bool DeltaPatcher::emit(const uint8_t *data, size_t len)
+{
+  if (len > header_.image_size - written_)
+  {
+    return fail("patch writes past the image size");
+  }
+  if (!sink_->write(data, len))
+  {
+    return fail("image write failed");
+  }
+  written_ += len;
+  if (written_ == header_.image_size)
+  {
+    state_ = DELTA_DONE;
+  }
+  return true;
+}
+
+bool DeltaPatcher::copy(int64_t offset_delta)
+{
+  int64_t from = (int64_t)source_pos_ + offset_delta;
+  if (from < 0 || from + op_len_ > header_.base_size)
+  {
+    return fail("copy outside the base image");
+  }
+  uint32_t pos = (uint32_t)from;
+  uint32_t left = op_len_;
+  while (left > 0)
+  {
+    size_t n = left < sizeof(buffer_) ? left : sizeof(buffer_);
+    if (!source_->read(pos, buffer_, n))
+    {
+      return fail("base read failed");
+    }
+    if (!emit(buffer_, n))
+    {
+      return false;
+    }
+    pos += n;
+    left -= n;
+  }
+  source_pos_ = pos;
+  if (state_ != DELTA_DONE)
+  {
+    state_ = DELTA_OP;
+  }
+  return true;
+}
+
+bool DeltaPatcher::start_op(uint64_t tag)
+{
+  uint64_t len = tag >> 1;
+  if (len == 0 || len > header_.image_size - written_)
+  {
+    return fail("bad op length");
+  }
+  op_len_ = (uint32_t)len;
+  state_ = (tag & 1) == DELTA_OP_INSERT ? DELTA_INSERT : DELTA_COPY_OFFSET;
+  return true;
+}
+
+bool DeltaPatcher::feed(const uint8_t *data, size_t len)
+{
+  const uint8_t *p = data;
+  const uint8_t *end = data + len;
+  while (p < end)
+  {
+    switch (state_)
+    {
+    case DELTA_HEADER:
+    {
+      size_t n = sizeof(header_) - header_len_;
+      n = n < (size_t)(end - p) ? n : (size_t)(end - p);
+      memcpy((uint8_t *)&header_ + header_len_, p, n);
+      header_len_ += n;
+      p += n;
+      if (header_len_ == sizeof(header_))
+      {
+        if (header_.magic != DELTA_PATCH_MAGIC)
+        {
+          return fail("not a delta patch");
+        }
+        state_ = header_.image_size == 0 ? DELTA_DONE : DELTA_OP;
+      }
+      break;
+    }
+    case DELTA_OP:
+      if (take_varint(*p++))
+      {
+        uint64_t tag = varint_;
+        varint_ = 0;
+        varint_shift_ = 0;
+        if (!start_op(tag))
+        {
+          return false;
+        }
+      }
+      else if (state_ == DELTA_FAILED)
+      {
+        return false;
+      }
+      break;
+    case DELTA_COPY_OFFSET:
+      if (take_varint(*p++))
+      {
+        uint64_t zz = varint_;
+        varint_ = 0;
+        varint_shift_ = 0;
+        if (!copy((int64_t)(zz >> 1) ^ -(int64_t)(zz & 1)))
+        {
+          return false;
+        }
+      }
+      else if (state_ == DELTA_FAILED)
+      {
+        return false;
+      }
+      break;
+    case DELTA_INSERT:
+    {
+      size_t n = op_len_ < (size_t)(end - p) ? op_len_ : (size_t)(end - p);
+      if (!emit(p, n))
+      {
+        return false;
+      }
+      p += n;
+      op_len_ -= n;
+      if (op_len_ == 0 && state_ != DELTA_DONE)
+      {
+        state_ = DELTA_OP;
+      }
+      break;
+    }
+    case DELTA_DONE:
+      return fail("data after the end of the image");
+    case DELTA_FAILED:
+      return false;
+    }
+  }
+  return state_ != DELTA_FAILED;
+}
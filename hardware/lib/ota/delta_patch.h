@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Delta from the running image (base) to a new one, made by python/ota.py.
+// A firmware rebuild moves code around but keeps most of it, so the new
+// image is mostly runs copied from the base plus short literal inserts:
+//
+//   header  magic, base size, image size (DeltaPatchHeader)
+//   ops {
+//     varint  len << 1 | kind
+//     COPY:   varint zig-zag source offset, relative to the end of the
+//             previous copy; len bytes from the base
+//     INSERT: len literal bytes
+//   }
+//
+// until image size bytes are out. The patcher takes the patch in pieces of
+// any size as they arrive and writes the image out in order, so neither
+// needs to be held in RAM.
+#define DELTA_PATCH_MAGIC 0x31504444u // "DDP1"
+#define DELTA_COPY_CHUNK 256            // base bytes read per step of a copy
+
+struct __attribute__((packed)) DeltaPatchHeader
+{
+  uint32_t magic;
+  uint32_t base_size;
+  uint32_t image_size;
+};
+
+// The running image, offsets from its start
+class DeltaSource
+{
+public:
+  virtual ~DeltaSource() {}
+  virtual bool read(uint32_t offset, void *dst, size_t len) = 0;
+};
+
+// Where the new image goes, written sequentially
+class DeltaSink
+{
+public:
+  virtual ~DeltaSink() {}
+  virtual bool write(const void *src, size_t len) = 0;
+};
+
+class DeltaPatcher
+{
+public:
+  void begin(DeltaSource *source, DeltaSink *sink);
+
+  // Consumes the next piece of the patch. Returns false once the patch is
+  // malformed or a read or write failed; the patcher then stays failed.
+  bool feed(const uint8_t *data, size_t len);
+
+  // The header was read and the whole image written
+  bool complete() const { return state_ == DELTA_DONE; }
+  bool failed() const { return state_ == DELTA_FAILED; }
+  const char *error() const { return error_; }
+
+  uint32_t base_size() const { return header_.base_size; }
+  uint32_t image_size() const { return header_.image_size; }
+  uint32_t written() const { return written_; }
+
+private:
+  enum State : uint8_t
+  {
+    DELTA_HEADER,
+    DELTA_OP,
+    DELTA_COPY_OFFSET,
+    DELTA_INSERT,
+    DELTA_DONE,
+    DELTA_FAILED,
+  };
+
+  bool fail(const char *error);
+  bool take_varint(uint8_t byte); // true once the varint is complete
+  bool start_op(uint64_t tag);
+  bool copy(int64_t offset_delta);
+  bool emit(const uint8_t *data, size_t len);
+
+  DeltaSource *source_ = nullptr;
+  DeltaSink *sink_ = nullptr;
+  State state_ = DELTA_FAILED;
+  const char *error_ = "not started";
+
+  DeltaPatchHeader header_ = {};
+  size_t header_len_ = 0;
+  uint64_t varint_ = 0;
+  uint8_t varint_shift_ = 0;
+  uint32_t op_len_ = 0;
+  uint32_t source_pos_ = 0; // end of the last copy
+  uint32_t written_ = 0;
+  uint8_t buffer_[DELTA_COPY_CHUNK];
+};
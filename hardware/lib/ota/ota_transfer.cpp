@@ -0,0 +1,124 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ota_transfer.h"
+
+static bool fail(char *error, size_t error_len, const char *fmt, ...)
+{
+  if (error_len > 0)
+  {
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(error, error_len, fmt, args);
+    va_end(args);
+  }
+  return false;
+}
+
+bool ota_manifest_parse(const uint8_t *data, size_t len, OtaManifest &out, char *error,
+                        size_t error_len)
+{
+  OtaManifest m;
+  if (len != sizeof(m))
+  {
+    return fail(error, error_len, "manifest must be %u bytes, got %u", (unsigned)sizeof(m),
+                (unsigned)len);
+  }
+  memcpy(&m, data, sizeof(m));
+  if (m.version != OTA_MANIFEST_VERSION)
+  {
+    return fail(error, error_len, "unknown manifest version %u", m.version);
+  }
+  if ((m.flags & ~OTA_FLAG_DELTA) != 0)
+  {
+    return fail(error, error_len, "unknown flags 0x%02x", m.flags);
+  }
+  if (m.image_size == 0 || m.transfer_size == 0)
+  {
+    return fail(error, error_len, "empty image");
+  }
+  bool delta = m.flags & OTA_FLAG_DELTA;
+  if (!delta && m.transfer_size != m.image_size)
+  {
+    return fail(error, error_len, "a full image transfers image_size bytes");
+  }
+  if (delta && m.base_size == 0)
+  {
+    return fail(error, error_len, "delta without a base");
+  }
+  if (memchr(m.firmware_version, '\0', sizeof(m.firmware_version)) == nullptr ||
+      m.firmware_version[0] == '\0')
+  {
+    return fail(error, error_len, "bad firmware version");
+  }
+  if (m.signature_len < 8 || m.signature_len > sizeof(m.signature))
+  {
+    return fail(error, error_len, "bad signature length %u", m.signature_len);
+  }
+  out = m;
+  return true;
+}
+
+void OtaTransfer::begin(uint32_t size, uint32_t chunk_bytes, uint32_t bytes_per_s,
+                        uint32_t timeout_ms, uint32_t now_ms)
+{
+  size_ = size;
+  chunk_bytes_ = chunk_bytes;
+  bytes_per_s_ = bytes_per_s;
+  timeout_ms_ = timeout_ms;
+  start_ms_ = now_ms;
+  received_ = 0;
+  in_flight_ = false;
+  request_ = {};
+  request_ms_ = now_ms;
+  due_ms_ = now_ms;
+  attempts_ = 0;
+  retries_ = 0;
+}
+
+bool OtaTransfer::next_request(uint32_t now_ms, OtaRequest &request)
+{
+  if (done())
+  {
+    return false;
+  }
+  if (in_flight_)
+  {
+    if (now_ms - request_ms_ < timeout_ms_)
+    {
+      return false;
+    }
+    retries_++; // same chunk again, no extra wait
+  }
+  else
+  {
+    if ((int32_t)(now_ms - due_ms_) < 0)
+    {
+      return false;
+    }
+    uint32_t left = size_ - received_;
+    request_ = {received_, left < chunk_bytes_ ? left : chunk_bytes_};
+    attempts_ = 0;
+  }
+  in_flight_ = true;
+  request_ms_ = now_ms;
+  attempts_++;
+  request = request_;
+  return true;
+}
+
+bool OtaTransfer::accept(uint32_t offset, size_t len)
+{
+  if (!in_flight_ || offset != request_.offset || len != request_.len)
+  {
+    return false;
+  }
+  in_flight_ = false;
+  received_ += len;
+  // the budget is spent from when the chunk was asked for, so the time the
+  // answer took counts towards it
+  uint32_t cost_ms = bytes_per_s_ > 0 ? (uint32_t)((uint64_t)len * 1000 / bytes_per_s_) : 0;
+  due_ms_ = request_ms_ + cost_ms;
+  return true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Update manifest, sensor/<device>/ota (python/ota.py push) ---
+// Describes the image and how it is sent: whole, or as a delta_patch.h
+// patch against the first base_size bytes of the running image. The
+// signature is ECDSA P-256 over the SHA-256 of the new image, so whatever
+// path it took, only an image built and signed by us is booted.
+#define OTA_MANIFEST_VERSION 1
+#define OTA_FLAG_DELTA 0x01
+#define OTA_VERSION_MAX 32
+#define OTA_SIGNATURE_MAX 72 // DER, P-256
+
+struct __attribute__((packed)) OtaManifest
+{
+  uint8_t version; // OTA_MANIFEST_VERSION
+  uint8_t flags;
+  uint16_t reserved;
+  uint32_t image_size;    // bytes written to the update partition
+  uint32_t transfer_size; // bytes downloaded: the image, or the patch
+  uint32_t base_size;     // delta: running image bytes the patch reads
+  uint8_t image_sha256[32];
+  uint8_t base_sha256[32];              // delta: of those base_size bytes
+  char firmware_version[OTA_VERSION_MAX]; // NUL-terminated
+  uint8_t signature_len;
+  uint8_t signature[OTA_SIGNATURE_MAX];
+};
+
+// Checks a manifest message for consistency; the partition sizes and the
+// signature are for the caller. On failure out is unchanged and error says why.
+bool ota_manifest_parse(const uint8_t *data, size_t len, OtaManifest &out, char *error,
+                        size_t error_len);
+
+// --- Chunked download over MQTT ---
+// The device asks for one chunk at a time on ota/req and the server answers
+// on ota/data, so the device sets the pace: a request goes out only once
+// the previous chunk was written and the rate budget allows, and is
+// repeated if its answer does not arrive.
+struct OtaRequest
+{
+  uint32_t offset;
+  uint32_t len;
+};
+
+class OtaTransfer
+{
+public:
+  void begin(uint32_t size, uint32_t chunk_bytes, uint32_t bytes_per_s, uint32_t timeout_ms,
+             uint32_t now_ms);
+
+  // The chunk to ask for now, if one is due: nothing is in flight (or the
+  // request timed out) and the previous chunk's share of the rate budget
+  // has passed.
+  bool next_request(uint32_t now_ms, OtaRequest &request);
+
+  // A chunk from the server. True if it is the one asked for, which is then
+  // counted as received; repeats and stale chunks return false.
+  bool accept(uint32_t offset, size_t len);
+
+  bool done() const { return received_ == size_; }
+  uint32_t size() const { return size_; }
+  uint32_t received() const { return received_; }
+  uint32_t retries() const { return retries_; }                // since begin()
+  uint32_t attempts() const { return attempts_; }              // for the chunk in flight
+  uint32_t elapsed_ms(uint32_t now_ms) const { return now_ms - start_ms_; }
+
+private:
+  uint32_t size_ = 0;
+  uint32_t chunk_bytes_ = 0;
+  uint32_t bytes_per_s_ = 0;
+  uint32_t timeout_ms_ = 0;
+  uint32_t start_ms_ = 0;
+
+  uint32_t received_ = 0;
+  bool in_flight_ = false;
+  OtaRequest request_ = {};
+  uint32_t request_ms_ = 0;
+  uint32_t due_ms_ = 0; // earliest time for the next request
+  uint32_t attempts_ = 0;
+  uint32_t retries_ = 0;
+};
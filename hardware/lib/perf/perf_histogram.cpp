@@ -0,0 +1,71 @@
+#include <string.h>
+
+#include "perf_histogram.h"
+
+void PerfHistogram::reset()
+{
+  count_ = 0;
+  sum_ = 0;
+  min_ = UINT32_MAX;
+  max_ = 0;
+  memset(buckets_, 0, sizeof(buckets_));
+}
+
+// Bucket index -> [low, low + width)
+static void bucket_range(size_t index, uint32_t &low, uint32_t &width)
+{
+  if (index < 16)
+  {
+    low = index;
+    width = 1;
+    return;
+  }
+  uint32_t exponent = (index - 16) / 8 + 4;
+  uint32_t mantissa = (index - 16) % 8;
+  width = 1u << (exponent - 3);
+  low = (8 + mantissa) * width;
+}
+
+uint32_t PerfHistogram::percentile(float fraction) const
+{
+  if (count_ == 0)
+  {
+    return 0;
+  }
+  // saturated buckets undercount, so rank against the bucket total
+  uint32_t total = 0;
+  for (size_t i = 0; i < PERF_HISTOGRAM_BUCKETS; i++)
+  {
+    total += buckets_[i];
+  }
+  uint32_t rank = (uint32_t)(fraction * total + 0.5f);
+  if (rank == 0)
+  {
+    rank = 1;
+  }
+
+  uint32_t seen = 0;
+  for (size_t i = 0; i < PERF_HISTOGRAM_BUCKETS; i++)
+  {
+    seen += buckets_[i];
+    if (seen >= rank)
+    {
+      uint32_t low, width;
+      bucket_range(i, low, width);
+      uint32_t mid = low + (width - 1) / 2;
+      return mid < min_ ? min_ : mid > max_ ? max_ : mid;
+    }
+  }
+  return max_;
+}
+
+PerfSummary PerfHistogram::summary() const
+{
+  PerfSummary s;
+  s.count = count_;
+  s.min = count_ ? min_ : 0;
+  s.avg = count_ ? (uint32_t)(sum_ / count_) : 0;
+  s.max = max_;
+  s.p99 = percentile(0.99f);
+  return s;
+}
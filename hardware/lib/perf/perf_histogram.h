@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Log-linear buckets: exact below 16, then 8 per power of two, so any
+// percentile is within ~6% of the true value. Counts saturate at 65535.
+#define PERF_HISTOGRAM_BUCKETS 240
+
+struct PerfSummary
+{
+  uint32_t count;
+  uint32_t min;
+  uint32_t avg;
+  uint32_t max;
+  uint32_t p99;
+};
+
+// Fixed-memory distribution of durations (any unit), one add() per event
+class PerfHistogram
+{
+public:
+  void reset();
+
+  void add(uint32_t value)
+  {
+    count_++;
+    sum_ += value;
+    if (value < min_)
+    {
+      min_ = value;
+    }
+    if (value > max_)
+    {
+      max_ = value;
+    }
+    uint16_t &bucket = buckets_[bucket_index(value)];
+    if (bucket != UINT16_MAX)
+    {
+      bucket++;
+    }
+  }
+
+  uint32_t count() const { return count_; }
+
+  // Midpoint of the bucket holding the given fraction (0..1) of events,
+  // clamped to the observed min/max
+  uint32_t percentile(float fraction) const;
+
+  PerfSummary summary() const;
+
+  static size_t bucket_index(uint32_t value)
+  {
+    if (value < 16)
+    {
+      return value;
+    }
+    uint32_t exponent = 31 - __builtin_clz(value); // >= 4
+    uint32_t mantissa = (value >> (exponent - 3)) & 7;
+    return 16 + (exponent - 4) * 8 + mantissa;
+  }
+
+private:
+  uint32_t count_ = 0;
+  uint64_t sum_ = 0;
+  uint32_t min_ = UINT32_MAX;
+  uint32_t max_ = 0;
+  uint16_t buckets_[PERF_HISTOGRAM_BUCKETS] = {};
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Lock-free single-producer / single-consumer ring buffer.
+// One task may push, one (other) task may peek/pop, no locks needed.
+// N must be a power of two; indices run freely and are masked on access.
+template <typename T, size_t N>
+class SpscRing
+{
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+  // Producer side. Returns false (and counts a drop) when the ring is full.
+  bool push(const T &item)
+  {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= N)
+    {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    items_[head & (N - 1)] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Oldest item, or nullptr when empty. The item stays in the
+  // ring until pop(), so a failed send can simply be retried later.
+  T *peek()
+  {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire))
+    {
+      return nullptr;
+    }
+    return &items_[tail & (N - 1)];
+  }
+
+  void pop()
+  {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail != head_.load(std::memory_order_acquire))
+    {
+      tail_.store(tail + 1, std::memory_order_release);
+    }
+  }
+
+  bool pop(T &out)
+  {
+    T *item = peek();
+    if (item == nullptr)
+    {
+      return false;
+    }
+    out = *item;
+    pop();
+    return true;
+  }
+
+  size_t size() const
+  {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+  bool empty() const { return size() == 0; }
+  size_t capacity() const { return N; }
+  uint32_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+  T items_[N];
+  std::atomic<size_t> head_{0}; // written by the producer only
+  std::atomic<size_t> tail_{0}; // written by the consumer only
+  std::atomic<uint32_t> dropped_{0};
+};
+
+// Last N items seen by a single task; push() overwrites the oldest once
+// full. N must be a power of two.
+template <typename T, size_t N>
+class HistoryRing
+{
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "HistoryRing capacity must be a power of two");
+
+public:
+  void push(const T &item) { items_[head_++ & (N - 1)] = item; }
+
+  size_t size() const { return head_ < N ? head_ : N; }
+
+  // 0 is the oldest item still held, size() - 1 the newest
+  const T &operator[](size_t i) const { return items_[(head_ - size() + i) & (N - 1)]; }
+
+  void clear() { head_ = 0; }
+
+private:
+  T items_[N];
+  size_t head_ = 0;
+};
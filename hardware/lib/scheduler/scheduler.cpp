@@ -0,0 +1,61 @@
+#include "scheduler.h"
+
+// wrap-safe "a is at or after b" for 32-bit microsecond timestamps
+static inline bool time_reached(uint32_t now, uint32_t deadline)
+{
+  return (int32_t)(now - deadline) >= 0;
+}
+
+void scheduler_start(ScheduledTask *tasks, size_t count, uint32_t now_us)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    tasks[i].next_due_us = now_us;
+    tasks[i].overruns = 0;
+  }
+}
+
+size_t scheduler_run(ScheduledTask *tasks, size_t count, uint32_t now_us)
+{
+  size_t ran = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    ScheduledTask &task = tasks[i];
+    if (!time_reached(now_us, task.next_due_us))
+    {
+      continue;
+    }
+
+    task.run();
+    ran++;
+
+    // Keep the original phase so the period does not drift with run time.
+    // If we are more than a full period late, skip the missed slots instead
+    // of running the task back to back to catch up.
+    task.next_due_us += task.period_us;
+    if (time_reached(now_us, task.next_due_us))
+    {
+      task.overruns++;
+      task.next_due_us = now_us + task.period_us;
+    }
+  }
+  return ran;
+}
+
+uint32_t scheduler_idle_us(const ScheduledTask *tasks, size_t count, uint32_t now_us)
+{
+  uint32_t idle = UINT32_MAX;
+  for (size_t i = 0; i < count; i++)
+  {
+    if (time_reached(now_us, tasks[i].next_due_us))
+    {
+      return 0;
+    }
+    uint32_t left = tasks[i].next_due_us - now_us;
+    if (left < idle)
+    {
+      idle = left;
+    }
+  }
+  return idle;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Cooperative per-sensor scheduler. Every task has its own period and
+// deadline, so fast sensors are not held back by slow ones.
+struct ScheduledTask
+{
+  const char *name;
+  void (*run)();
+  uint32_t period_us;
+  uint32_t next_due_us; // deadline of the next run
+  uint32_t overruns;    // deadlines missed by more than one period
+};
+
+// Arms every task so its first run happens at now_us.
+void scheduler_start(ScheduledTask *tasks, size_t count, uint32_t now_us);
+
+// Runs every task whose deadline has passed. Call it as often as possible.
+// Returns the number of tasks that were run.
+size_t scheduler_run(ScheduledTask *tasks, size_t count, uint32_t now_us);
+
+// Microseconds until the earliest deadline (0 if something is already due).
+uint32_t scheduler_idle_us(const ScheduledTask *tasks, size_t count, uint32_t now_us);
@@ -0,0 +1,344 @@
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "settings.h"
+
+enum FieldType : uint8_t
+{
+  FIELD_U8,
+  FIELD_U16,
+  FIELD_U32,
+  FIELD_F32,
+};
+
+struct SettingsField
+{
+  const char *name;
+  FieldType type;
+  size_t offset;
+  float min;
+  float max;
+};
+
+#define FIELD(name, type, min, max) {#name, type, offsetof(Settings, name), min, max}
+#define DEADBAND_FIELD(name, index, max) \
+  {name, FIELD_F32, offsetof(Settings, deadband) + (index) * sizeof(float), -1, max}
+
+// A negative deadband never triggers a report (see ChangeDetector)
+static const SettingsField fields[] = {
+    FIELD(mpu_period_us, FIELD_U32, 1000, 1000000),
+    FIELD(motor_period_us, FIELD_U32, 500, 1000000),
+    FIELD(flame_period_us, FIELD_U32, 1000, 10000000),
+    FIELD(gas_period_us, FIELD_U32, 10000, 10000000),
+    FIELD(dht_period_us, FIELD_U32, 2000000, 60000000), // DHT22 limit
+    FIELD(publish_period_us, FIELD_U32, 5000, 60000000),
+    FIELD(batch_max_samples, FIELD_U8, 1, SETTINGS_BATCH_MAX_SAMPLES),
+    FIELD(batch_max_age_ms, FIELD_U32, 0, 60000),
+    FIELD(heartbeat_ms, FIELD_U32, 0, 3600000),
+    DEADBAND_FIELD("deadband_accel", SETTINGS_DEADBAND_ACCEL, 100),
+    DEADBAND_FIELD("deadband_gyro", SETTINGS_DEADBAND_GYRO, 100),
+    DEADBAND_FIELD("deadband_temperature", SETTINGS_DEADBAND_TEMPERATURE, 100),
+    DEADBAND_FIELD("deadband_gas", SETTINGS_DEADBAND_GAS, 3300),
+    DEADBAND_FIELD("deadband_dht_temperature", SETTINGS_DEADBAND_DHT_TEMPERATURE, 100),
+    DEADBAND_FIELD("deadband_dht_humidity", SETTINGS_DEADBAND_DHT_HUMIDITY, 100),
+    DEADBAND_FIELD("deadband_motor", SETTINGS_DEADBAND_MOTOR, 3300),
+    DEADBAND_FIELD("deadband_motor_rms", SETTINGS_DEADBAND_MOTOR_RMS, 3300),
+    FIELD(gas_alarm_level, FIELD_U16, 0, 3300),
+    FIELD(gas_lowpass_hz, FIELD_F32, 0.1f, 250), // below Nyquist of the 625 Hz gas stream
+};
+static const size_t field_count = sizeof(fields) / sizeof(fields[0]);
+
+static bool fail(char *error, size_t error_len, const char *fmt, ...)
+{
+  if (error_len > 0)
+  {
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(error, error_len, fmt, args);
+    va_end(args);
+  }
+  return false;
+}
+
+// Fields are unaligned in the packed struct, hence the memcpy. Doubles
+// hold every uint32 exactly; this is not a hot path.
+static double get_field(const Settings &settings, const SettingsField &field)
+{
+  const uint8_t *p = (const uint8_t *)&settings + field.offset;
+  switch (field.type)
+  {
+  case FIELD_U8:
+    return *p;
+  case FIELD_U16:
+  {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  case FIELD_U32:
+  {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  default:
+  {
+    float v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  }
+}
+
+static void set_field(Settings &settings, const SettingsField &field, double value)
+{
+  uint8_t *p = (uint8_t *)&settings + field.offset;
+  switch (field.type)
+  {
+  case FIELD_U8:
+    *p = (uint8_t)value;
+    break;
+  case FIELD_U16:
+  {
+    uint16_t v = (uint16_t)value;
+    memcpy(p, &v, sizeof(v));
+    break;
+  }
+  case FIELD_U32:
+  {
+    uint32_t v = (uint32_t)value;
+    memcpy(p, &v, sizeof(v));
+    break;
+  }
+  default:
+  {
+    float v = (float)value;
+    memcpy(p, &v, sizeof(v));
+    break;
+  }
+  }
+}
+
+static bool in_range(const SettingsField &field, double value)
+{
+  return value >= field.min && value <= field.max; // false for NaN
+}
+
+bool settings_validate(const Settings &settings, char *error, size_t error_len)
+{
+  if (settings.version != SETTINGS_VERSION)
+  {
+    return fail(error, error_len, "settings version %u, expected %u", settings.version,
+                SETTINGS_VERSION);
+  }
+  for (size_t i = 0; i < field_count; i++)
+  {
+    if (!in_range(fields[i], get_field(settings, fields[i])))
+    {
+      return fail(error, error_len, "%s out of range [%g, %g]", fields[i].name, fields[i].min,
+                  fields[i].max);
+    }
+  }
+  return true;
+}
+
+static const char *skip_space(const char *p)
+{
+  while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+  {
+    p++;
+  }
+  return p;
+}
+
+static const char *skip_digits(const char *p)
+{
+  while (*p >= '0' && *p <= '9')
+  {
+    p++;
+  }
+  return p;
+}
+
+// End of the JSON number at p, or p if there is none. strtod alone would
+// also take hex, inf, nan, a leading '+' or '.5'.
+static const char *json_number_end(const char *p)
+{
+  const char *start = p;
+  if (*p == '-')
+  {
+    p++;
+  }
+  if (*p == '0')
+  {
+    p++;
+  }
+  else if (*p >= '1' && *p <= '9')
+  {
+    p = skip_digits(p);
+  }
+  else
+  {
+    return start;
+  }
+  if (*p == '.')
+  {
+    const char *digits = p + 1;
+    p = skip_digits(digits);
+    if (p == digits)
+    {
+      return start;
+    }
+  }
+  if (*p == 'e' || *p == 'E')
+  {
+    const char *digits = p + 1;
+    if (*digits == '+' || *digits == '-')
+    {
+      digits++;
+    }
+    p = skip_digits(digits);
+    if (p == digits)
+    {
+      return start;
+    }
+  }
+  return p;
+}
+
+static const SettingsField *find_field(const char *name, size_t len)
+{
+  for (size_t i = 0; i < field_count; i++)
+  {
+    if (strlen(fields[i].name) == len && memcmp(fields[i].name, name, len) == 0)
+    {
+      return &fields[i];
+    }
+  }
+  return nullptr;
+}
+
+bool settings_parse_json(const char *json, Settings &settings, char *error, size_t error_len)
+{
+  Settings next = settings;
+  const char *p = skip_space(json);
+  if (*p != '{')
+  {
+    return fail(error, error_len, "expected a JSON object");
+  }
+  p = skip_space(p + 1);
+
+  while (*p != '}')
+  {
+    if (*p != '"')
+    {
+      return fail(error, error_len, "expected a key at offset %u", (unsigned)(p - json));
+    }
+    const char *key = p + 1;
+    const char *key_end = strchr(key, '"');
+    if (key_end == nullptr)
+    {
+      return fail(error, error_len, "unterminated key");
+    }
+    size_t key_len = key_end - key;
+    const SettingsField *field = find_field(key, key_len);
+    if (field == nullptr)
+    {
+      return fail(error, error_len, "unknown setting '%.*s'", (int)key_len, key);
+    }
+
+    p = skip_space(key_end + 1);
+    if (*p != ':')
+    {
+      return fail(error, error_len, "expected ':' after '%s'", field->name);
+    }
+    p = skip_space(p + 1);
+    const char *number_end = json_number_end(p);
+    if (number_end == p)
+    {
+      return fail(error, error_len, "%s must be a number", field->name);
+    }
+    double value = strtod(p, nullptr);
+    if (field->type != FIELD_F32 && value != floor(value))
+    {
+      return fail(error, error_len, "%s must be an integer", field->name);
+    }
+    if (!in_range(*field, value))
+    {
+      return fail(error, error_len, "%s out of range [%g, %g]", field->name, field->min, field->max);
+    }
+    set_field(next, *field, value);
+
+    p = skip_space(number_end);
+    if (*p == ',')
+    {
+      p = skip_space(p + 1);
+      if (*p == '}')
+      {
+        return fail(error, error_len, "trailing ',' after '%s'", field->name);
+      }
+    }
+    else if (*p != '}')
+    {
+      return fail(error, error_len, "expected ',' or '}' after '%s'", field->name);
+    }
+  }
+  if (*skip_space(p + 1) != '\0')
+  {
+    return fail(error, error_len, "trailing data after the object");
+  }
+
+  if (!settings_validate(next, error, error_len))
+  {
+    return false;
+  }
+  settings = next;
+  return true;
+}
+
+bool settings_parse_binary(const uint8_t *data, size_t len, Settings &settings, char *error,
+                           size_t error_len)
+{
+  if (len != sizeof(Settings))
+  {
+    return fail(error, error_len, "binary settings must be %u bytes, got %u",
+                (unsigned)sizeof(Settings), (unsigned)len);
+  }
+  Settings next;
+  memcpy(&next, data, sizeof(next));
+  if (!settings_validate(next, error, error_len))
+  {
+    return false;
+  }
+  settings = next;
+  return true;
+}
+
+size_t settings_format_json(const Settings &settings, char *out, size_t out_len)
+{
+  size_t pos = 0;
+  for (size_t i = 0; i < field_count; i++)
+  {
+    const SettingsField &field = fields[i];
+    double value = get_field(settings, field);
+    int len = field.type == FIELD_F32
+                  ? snprintf(out + pos, out_len - pos, "%s\"%s\":%g", i ? "," : "{", field.name, value)
+                  : snprintf(out + pos, out_len - pos, "%s\"%s\":%lu", i ? "," : "{", field.name,
+                             (unsigned long)value);
+    if (len < 0 || (size_t)len >= out_len - pos)
+    {
+      return 0;
+    }
+    pos += len;
+  }
+  if (pos + 2 > out_len)
+  {
+    return 0;
+  }
+  out[pos++] = '}';
+  out[pos] = '\0';
+  return pos;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Runtime-tunable settings. They start from the compile-time defaults in
+// config.h and can be changed by a config message on sensor/<device>/config.
+// The struct is also the binary update format (.../config/bin) and
+// the NVS record, so bump SETTINGS_VERSION on any layout change.
+#define SETTINGS_VERSION 1
+
+// Upper limit of batch_max_samples; a full batch must fit BATCH_MAX_BYTES
+#ifndef SETTINGS_BATCH_MAX_SAMPLES
+#define SETTINGS_BATCH_MAX_SAMPLES 50
+#endif
+
+enum SettingsDeadband : uint8_t
+{
+  SETTINGS_DEADBAND_ACCEL = 0,
+  SETTINGS_DEADBAND_GYRO,
+  SETTINGS_DEADBAND_TEMPERATURE,
+  SETTINGS_DEADBAND_GAS,
+  SETTINGS_DEADBAND_DHT_TEMPERATURE,
+  SETTINGS_DEADBAND_DHT_HUMIDITY,
+  SETTINGS_DEADBAND_MOTOR,
+  SETTINGS_DEADBAND_MOTOR_RMS,
+  SETTINGS_DEADBAND_COUNT
+};
+
+struct __attribute__((packed)) Settings
+{
+  uint8_t version; // SETTINGS_VERSION
+  // sampling periods, us
+  uint32_t mpu_period_us;
+  uint32_t motor_period_us;
+  uint32_t flame_period_us;
+  uint32_t gas_period_us;
+  uint32_t dht_period_us;
+  uint32_t publish_period_us;
+  // batching
+  uint8_t batch_max_samples;
+  uint32_t batch_max_age_ms;
+  // event-driven reporting, in the units of the DEADBAND_* defines
+  uint32_t heartbeat_ms;
+  float deadband[SETTINGS_DEADBAND_COUNT];
+  uint16_t gas_alarm_level; // mV
+  // filters
+  float gas_lowpass_hz;
+};
+
+// Range checks of every field. On failure, error names the first bad field.
+bool settings_validate(const Settings &settings, char *error, size_t error_len);
+
+// Applies a flat JSON object of numbers, e.g. {"publish_period_us":5000},
+// on top of settings. Keys that are not given keep their value. The
+// result is validated; settings is only changed if all of it is accepted.
+// json must be NUL-terminated.
+bool settings_parse_json(const char *json, Settings &settings, char *error, size_t error_len);
+
+// A complete packed Settings record of the current version
+bool settings_parse_binary(const uint8_t *data, size_t len, Settings &settings, char *error,
+                           size_t error_len);
+
+// Every field as one JSON object, in the format settings_parse_json takes.
+// Returns the length written, 0 if it did not fit.
+size_t settings_format_json(const Settings &settings, char *out, size_t out_len);
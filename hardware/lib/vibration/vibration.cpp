@@ -0,0 +1,184 @@
+#include <math.h>
+
+#include "vibration.h"
+
+static const float PI_F = 3.14159265358979f;
+
+bool VibrationAnalyzer::begin(const VibrationConfig &config)
+{
+  enabled_ = false;
+  uint16_t n = config.window;
+  if (n < 16 || n > VIBRATION_MAX_WINDOW || (n & (n - 1)) != 0 ||
+      config.sample_rate_hz <= 0 || config.band_count > VIBRATION_MAX_BANDS ||
+      config.spectrum_bins > VIBRATION_MAX_SPECTRUM_BINS || config.spectrum_bins > n / 2)
+  {
+    return false;
+  }
+  config_ = config;
+  fill_ = 0;
+
+  window_power_ = 0;
+  for (uint16_t i = 0; i < n; i++)
+  {
+    hann_[i] = 0.5f - 0.5f * cosf(2 * PI_F * i / n);
+    window_power_ += hann_[i] * hann_[i];
+  }
+  for (uint16_t i = 0; i < n / 2; i++)
+  {
+    cos_[i] = cosf(2 * PI_F * i / n);
+    sin_[i] = -sinf(2 * PI_F * i / n);
+  }
+  enabled_ = true;
+  return true;
+}
+
+bool VibrationAnalyzer::add(const float sample[VIBRATION_AXES], VibrationFeatures &out)
+{
+  if (!enabled_)
+  {
+    return false;
+  }
+  for (int a = 0; a < VIBRATION_AXES; a++)
+  {
+    samples_[a][fill_] = sample[a];
+  }
+  if (++fill_ < config_.window)
+  {
+    return false;
+  }
+  fill_ = 0;
+
+  out.window = config_.window;
+  out.sample_rate_hz = config_.sample_rate_hz;
+  out.band_count = config_.band_count;
+  out.spectrum_bins = config_.spectrum_bins;
+  for (int a = 0; a < VIBRATION_AXES; a++)
+  {
+    analyze_axis(samples_[a], out.axis[a]);
+  }
+  return true;
+}
+
+// In-place iterative radix-2 FFT of re_/im_ over config_.window points.
+void VibrationAnalyzer::fft()
+{
+  uint16_t n = config_.window;
+
+  for (uint16_t i = 1, j = 0; i < n; i++)
+  {
+    uint16_t bit = n >> 1;
+    for (; j & bit; bit >>= 1)
+    {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j)
+    {
+      float t = re_[i];
+      re_[i] = re_[j];
+      re_[j] = t;
+      t = im_[i];
+      im_[i] = im_[j];
+      im_[j] = t;
+    }
+  }
+
+  for (uint16_t len = 2; len <= n; len <<= 1)
+  {
+    uint16_t half = len >> 1;
+    uint16_t step = n / len;
+    for (uint16_t start = 0; start < n; start += len)
+    {
+      for (uint16_t k = 0; k < half; k++)
+      {
+        float wr = cos_[k * step];
+        float wi = sin_[k * step];
+        uint16_t a = start + k;
+        uint16_t b = a + half;
+        float tr = re_[b] * wr - im_[b] * wi;
+        float ti = re_[b] * wi + im_[b] * wr;
+        re_[b] = re_[a] - tr;
+        im_[b] = im_[a] - ti;
+        re_[a] += tr;
+        im_[a] += ti;
+      }
+    }
+  }
+}
+
+void VibrationAnalyzer::analyze_axis(const float *x, AxisFeatures &out)
+{
+  uint16_t n = config_.window;
+
+  float mean = 0;
+  for (uint16_t i = 0; i < n; i++)
+  {
+    mean += x[i];
+  }
+  mean /= n;
+
+  float sum_sq = 0;
+  float peak = 0;
+  for (uint16_t i = 0; i < n; i++)
+  {
+    float v = x[i] - mean;
+    sum_sq += v * v;
+    if (fabsf(v) > peak)
+    {
+      peak = fabsf(v);
+    }
+    re_[i] = v * hann_[i];
+    im_[i] = 0;
+  }
+  out.rms = sqrtf(sum_sq / n);
+  out.peak = peak;
+  out.crest_factor = out.rms > 0 ? peak / out.rms : 0;
+
+  fft();
+
+  // One-sided power per bin, scaled so the bins sum to the mean square
+  // of the signal (Parseval, corrected for the Hann window).
+  float scale = 2.0f / (n * window_power_);
+  float bin_hz = config_.sample_rate_hz / n;
+  uint16_t bins = n / 2;
+
+  for (uint8_t b = 0; b < config_.band_count; b++)
+  {
+    out.band_energy[b] = 0;
+  }
+  for (uint8_t s = 0; s < config_.spectrum_bins; s++)
+  {
+    out.spectrum[s] = 0;
+  }
+
+  float peak_power = 0;
+  out.peak_hz = 0;
+  for (uint16_t k = 1; k < bins; k++)
+  {
+    float power = (re_[k] * re_[k] + im_[k] * im_[k]) * scale;
+    float hz = k * bin_hz;
+
+    if (power > peak_power)
+    {
+      peak_power = power;
+      out.peak_hz = hz;
+    }
+    for (uint8_t b = 0; b < config_.band_count; b++)
+    {
+      if (hz >= config_.band_edges_hz[b] && hz < config_.band_edges_hz[b + 1])
+      {
+        out.band_energy[b] += power;
+        break;
+      }
+    }
+    if (config_.spectrum_bins > 0)
+    {
+      out.spectrum[(uint32_t)k * config_.spectrum_bins / bins] += power;
+    }
+  }
+
+  for (uint8_t s = 0; s < config_.spectrum_bins; s++)
+  {
+    out.spectrum[s] = sqrtf(out.spectrum[s]);
+  }
+}
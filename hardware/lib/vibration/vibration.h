@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define VIBRATION_AXES 3
+#define VIBRATION_MAX_WINDOW 512 // FFT length upper bound, sizes the static buffers
+#define VIBRATION_MAX_BANDS 8
+#define VIBRATION_MAX_SPECTRUM_BINS 32
+
+struct VibrationConfig
+{
+  uint16_t window;     // samples per FFT, power of two <= VIBRATION_MAX_WINDOW
+  float sample_rate_hz;
+  uint8_t band_count;  // <= VIBRATION_MAX_BANDS
+  float band_edges_hz[VIBRATION_MAX_BANDS + 1]; // band i is [edge i, edge i+1)
+  uint8_t spectrum_bins; // decimated spectrum size, 0 = features only
+};
+
+struct AxisFeatures
+{
+  float rms;          // AC RMS, mean removed
+  float peak;         // largest |x - mean| in the window
+  float crest_factor; // peak / rms
+  float peak_hz;      // strongest spectral line, DC excluded
+  float band_energy[VIBRATION_MAX_BANDS];   // mean square per band, sums to ~rms^2
+  float spectrum[VIBRATION_MAX_SPECTRUM_BINS]; // RMS per equal-width bin
+};
+
+struct VibrationFeatures
+{
+  uint64_t timestamp_us; // end of the window, stamped by the caller
+  uint16_t window;
+  float sample_rate_hz;
+  uint8_t band_count;
+  uint8_t spectrum_bins;
+  AxisFeatures axis[VIBRATION_AXES];
+};
+
+// Collects accelerometer samples into fixed windows and turns each full
+// window into per-axis features with a Hann-windowed radix-2 FFT. Float only:
+// the ESP32 has a single-precision FPU, so this is cheaper than fixed point.
+class VibrationAnalyzer
+{
+public:
+  // Returns false if the config is out of range (analyzer stays disabled).
+  bool begin(const VibrationConfig &config);
+
+  // Adds one sample (one value per axis). Returns true when this sample
+  // completed a window; the features are then written to out.
+  bool add(const float sample[VIBRATION_AXES], VibrationFeatures &out);
+
+  // Drops a partly filled window, e.g. after a gap in the sample stream.
+  void reset() { fill_ = 0; }
+
+  const VibrationConfig &config() const { return config_; }
+
+private:
+  void fft();
+  void analyze_axis(const float *x, AxisFeatures &out);
+
+  VibrationConfig config_ = {};
+  bool enabled_ = false;
+  uint16_t fill_ = 0;
+  float window_power_ = 0; // sum of w[n]^2
+
+  float samples_[VIBRATION_AXES][VIBRATION_MAX_WINDOW];
+  float hann_[VIBRATION_MAX_WINDOW];
+  float re_[VIBRATION_MAX_WINDOW];
+  float im_[VIBRATION_MAX_WINDOW];
+  float cos_[VIBRATION_MAX_WINDOW / 2];
+  float sin_[VIBRATION_MAX_WINDOW / 2];
+};
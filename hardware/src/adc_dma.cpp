@@ -0,0 +1,136 @@
+#include <driver/adc.h>
+
+#include "adc_dma.h"
+#include "adc_filter.h"
+
+#define FRAME_BYTES (ADC_DMA_FRAME_CONVERSIONS * SOC_ADC_DIGI_RESULT_BYTES)
+
+SpscRing<AdcBlock, ADC_BLOCK_QUEUE_LEN> adc_blocks;
+
+volatile uint32_t adc_dma_overruns = 0;
+
+// ADC1 channel number -> AdcChannel, -1 for unused channels
+static int8_t channel_map[8];
+
+// Run in the DMA task; only the decimated, calibrated output reaches the stats
+static MotorDmaFilter motor_filter;
+static GasDmaFilter gas_filter;
+static volatile float gas_lowpass_request = 0; // Hz, picked up between frames
+
+static void adc_dma_task(void *arg)
+{
+  static uint8_t frame[FRAME_BYTES];
+
+  for (;;)
+  {
+    uint32_t len = 0;
+    if (adc_digi_read_bytes(frame, sizeof(frame), &len, portMAX_DELAY) != ESP_OK)
+    {
+      continue;
+    }
+
+    float lowpass_hz = gas_lowpass_request;
+    if (lowpass_hz > 0)
+    {
+      gas_filter.stage<2>().lowpass(lowpass_hz, ADC_SAMPLE_RATE_HZ / ADC_GAS_DECIMATION);
+      gas_lowpass_request = 0;
+    }
+
+    AdcBlock block;
+    for (int c = 0; c < ADC_CHANNEL_COUNT; c++)
+    {
+      block.channel[c].reset();
+      block.last[c] = 0;
+    }
+    for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= len; i += SOC_ADC_DIGI_RESULT_BYTES)
+    {
+      const adc_digi_output_data_t *out = (const adc_digi_output_data_t *)&frame[i];
+      int8_t c = out->type1.channel < 8 ? channel_map[out->type1.channel] : -1;
+      if (c < 0)
+      {
+        continue;
+      }
+      int32_t filtered;
+      bool ready = c == ADC_CHANNEL_MOTOR ? motor_filter.process(out->type1.data, filtered)
+                                          : gas_filter.process(out->type1.data, filtered);
+      if (!ready)
+      {
+        continue;
+      }
+      uint16_t mv = adc_to_mv((AdcChannel)c, filtered);
+      block.channel[c].add(mv);
+      block.last[c] = mv;
+    }
+
+    if (!adc_blocks.push(block))
+    {
+      adc_dma_overruns++;
+    }
+  }
+}
+
+void adc_dma_set_gas_lowpass(float cutoff_hz)
+{
+  gas_lowpass_request = cutoff_hz;
+}
+
+bool adc_dma_begin(uint8_t motor_pin, uint8_t gas_pin, BaseType_t core)
+{
+  int8_t motor_channel = digitalPinToAnalogChannel(motor_pin);
+  int8_t gas_channel = digitalPinToAnalogChannel(gas_pin);
+  // only ADC1 can run alongside WiFi
+  if (motor_channel < 0 || motor_channel > 7 || gas_channel < 0 || gas_channel > 7)
+  {
+    return false;
+  }
+  for (int i = 0; i < 8; i++)
+  {
+    channel_map[i] = -1;
+  }
+  channel_map[motor_channel] = ADC_CHANNEL_MOTOR;
+  channel_map[gas_channel] = ADC_CHANNEL_GAS;
+
+  adc_digi_init_config_t init_config = {};
+  init_config.max_store_buf_size = FRAME_BYTES * ADC_DMA_BUFFER_FRAMES;
+  init_config.conv_num_each_intr = FRAME_BYTES;
+  init_config.adc1_chan_mask = BIT(motor_channel) | BIT(gas_channel);
+  init_config.adc2_chan_mask = 0;
+  if (adc_digi_initialize(&init_config) != ESP_OK)
+  {
+    return false;
+  }
+
+  // Same attenuation as the analogRead() path
+  static adc_digi_pattern_config_t pattern[ADC_CHANNEL_COUNT];
+  pattern[ADC_CHANNEL_MOTOR].atten = ADC_MOTOR_ATTEN;
+  pattern[ADC_CHANNEL_MOTOR].channel = motor_channel;
+  pattern[ADC_CHANNEL_GAS].atten = ADC_GAS_ATTEN;
+  pattern[ADC_CHANNEL_GAS].channel = gas_channel;
+  for (int c = 0; c < ADC_CHANNEL_COUNT; c++)
+  {
+    pattern[c].unit = 0; // ADC1
+    pattern[c].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+  }
+
+  adc_digi_configuration_t config = {};
+  config.conv_limit_en = true; // required on the ESP32
+  config.conv_limit_num = 250;
+  config.pattern_num = ADC_CHANNEL_COUNT;
+  config.adc_pattern = pattern;
+  config.sample_freq_hz = ADC_SAMPLE_RATE_HZ * ADC_CHANNEL_COUNT;
+  config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+  if (adc_digi_controller_configure(&config) != ESP_OK)
+  {
+    adc_digi_deinitialize();
+    return false;
+  }
+
+  motor_filter.reset();
+  gas_filter.reset();
+  gas_filter.stage<2>().lowpass(ADC_GAS_LOWPASS_HZ, ADC_SAMPLE_RATE_HZ / ADC_GAS_DECIMATION);
+
+  xTaskCreatePinnedToCore(adc_dma_task, "adc_dma", ADC_DMA_TASK_STACK, nullptr,
+                          ADC_DMA_TASK_PRIORITY, nullptr, core);
+  return adc_digi_start() == ESP_OK;
+}
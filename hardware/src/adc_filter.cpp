@@ -0,0 +1,40 @@
+#include <esp_adc_cal.h>
+
+#define LOG_MODULE "sensors"
+#define LOG_MODULE_LEVEL LOG_LEVEL_SENSORS
+#include "log.h"
+
+#include "adc_filter.h"
+
+static esp_adc_cal_characteristics_t characteristics[ADC_CHANNEL_COUNT];
+
+static const char *calibration_source(esp_adc_cal_value_t source)
+{
+  switch (source)
+  {
+  case ESP_ADC_CAL_VAL_EFUSE_TP:
+    return "eFuse two-point";
+  case ESP_ADC_CAL_VAL_EFUSE_VREF:
+    return "eFuse Vref";
+  default:
+    return "default Vref";
+  }
+}
+
+void adc_calibration_begin()
+{
+  const adc_atten_t atten[ADC_CHANNEL_COUNT] = {ADC_MOTOR_ATTEN, ADC_GAS_ATTEN};
+  esp_adc_cal_value_t source = ESP_ADC_CAL_VAL_DEFAULT_VREF;
+  for (int c = 0; c < ADC_CHANNEL_COUNT; c++)
+  {
+    source = esp_adc_cal_characterize(ADC_UNIT_1, atten[c], ADC_WIDTH_BIT_12,
+                                      ADC_DEFAULT_VREF_MV, &characteristics[c]);
+  }
+  LOG_INFO("ADC calibration: %s", calibration_source(source));
+}
+
+uint16_t adc_to_mv(AdcChannel channel, int32_t raw)
+{
+  uint32_t counts = raw < 0 ? 0 : raw > 4095 ? 4095 : (uint32_t)raw;
+  return (uint16_t)esp_adc_cal_raw_to_voltage(counts, &characteristics[channel]);
+}
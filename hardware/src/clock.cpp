@@ -0,0 +1,74 @@
+#include <esp_sntp.h>
+#include <esp_timer.h>
+#include <sys/time.h>
+
+#include "config.h"
+
+#define LOG_MODULE "clock"
+#define LOG_MODULE_LEVEL LOG_LEVEL_NET
+#include "log.h"
+
+#include "clock.h"
+
+// RTC memory, so a low-power wake-up starts with the last known offset
+RTC_DATA_ATTR static int64_t epoch_offset_us = 0;
+static portMUX_TYPE clock_mux = portMUX_INITIALIZER_UNLOCKED;
+
+uint64_t clock_us()
+{
+  if (LOW_POWER_MODE)
+  {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+  }
+  return (uint64_t)esp_timer_get_time();
+}
+
+int64_t clock_epoch_offset_us()
+{
+  portENTER_CRITICAL(&clock_mux);
+  int64_t offset = epoch_offset_us;
+  portEXIT_CRITICAL(&clock_mux);
+  return offset;
+}
+
+bool clock_synced()
+{
+  return clock_epoch_offset_us() != 0;
+}
+
+// Replaces the weak lwIP hook that would settimeofday(): the system clock
+// keeps running undisturbed and only the offset follows the server.
+extern "C" void sntp_sync_time(struct timeval *tv)
+{
+  int64_t utc_us = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+  int64_t offset = utc_us - (int64_t)clock_us();
+
+  portENTER_CRITICAL(&clock_mux);
+  int64_t previous = epoch_offset_us;
+  epoch_offset_us = offset;
+  portEXIT_CRITICAL(&clock_mux);
+
+  sntp_set_sync_status(SNTP_SYNC_STATUS_COMPLETED);
+  if (previous == 0)
+  {
+    LOG_INFO("SNTP synced, epoch offset %lld us", (long long)offset);
+  }
+  else
+  {
+    LOG_DEBUG("SNTP resynced, offset moved %lld us", (long long)(offset - previous));
+  }
+}
+
+void clock_begin()
+{
+  if (sntp_enabled())
+  {
+    return;
+  }
+  sntp_setoperatingmode(SNTP_OPMODE_POLL);
+  sntp_setservername(0, SNTP_SERVER);
+  sntp_set_sync_interval(SNTP_SYNC_INTERVAL_MS);
+  sntp_init();
+}
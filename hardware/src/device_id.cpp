@@ -0,0 +1,35 @@
+#include <esp_system.h>
+
+#include "device_id.h"
+
+static char id[DEVICE_ID_MAX];
+static char client_id[DEVICE_ID_MAX + 6]; // "esp32-" prefix
+
+void device_id_begin()
+{
+  if (id[0] != '\0')
+  {
+    return;
+  }
+  uint8_t mac[6];
+  esp_efuse_mac_get_default(mac); // the station MAC, as WiFi.macAddress() reports it
+  snprintf(id, sizeof(id), "%02x%02x%02x%02x%02x%02x", mac[0], mac[1], mac[2], mac[3], mac[4],
+           mac[5]);
+  snprintf(client_id, sizeof(client_id), "esp32-%s", id);
+}
+
+const char *device_id()
+{
+  return id;
+}
+
+const char *device_client_id()
+{
+  return client_id;
+}
+
+bool device_topic(char *out, size_t out_len, const char *subtopic)
+{
+  int len = snprintf(out, out_len, DEVICE_TOPIC_ROOT "/%s/%s", id, subtopic);
+  return len > 0 && (size_t)len < out_len;
+}
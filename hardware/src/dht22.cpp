@@ -0,0 +1,121 @@
+#include "dht22.h"
+
+#define RMT_CLK_DIV 80          // 1 us per tick from the 80 MHz APB clock
+#define RMT_IDLE_US 200         // line high this long ends the frame
+#define RMT_FILTER_TICKS 240    // APB ticks, not RMT ticks: 3 us (8-bit, 255 max)
+#define RMT_RX_RING_BYTES 512   // ~64 items, one frame is 42
+#define MAX_PULSES 64
+
+bool Dht22Rmt::begin(uint8_t pin, rmt_channel_t channel)
+{
+  pin_ = (gpio_num_t)pin;
+  channel_ = channel;
+
+  rmt_config_t config = {};
+  config.rmt_mode = RMT_MODE_RX;
+  config.channel = channel;
+  config.gpio_num = pin_;
+  config.clk_div = RMT_CLK_DIV;
+  config.mem_block_num = 1;
+  config.rx_config.filter_en = true;
+  config.rx_config.filter_ticks_thresh = RMT_FILTER_TICKS;
+  config.rx_config.idle_threshold = RMT_IDLE_US;
+  if (rmt_config(&config) != ESP_OK ||
+      rmt_driver_install(channel, RMT_RX_RING_BYTES, 0) != ESP_OK ||
+      rmt_get_ringbuf_handle(channel, &rx_ring_) != ESP_OK)
+  {
+    return false;
+  }
+
+  // Open drain on the same pin: RMT keeps listening through the GPIO
+  // matrix while we drive the start pulse.
+  gpio_set_direction(pin_, GPIO_MODE_INPUT_OUTPUT_OD);
+  gpio_set_pull_mode(pin_, GPIO_PULLUP_ONLY);
+  gpio_set_level(pin_, 1);
+
+  esp_timer_create_args_t timer_args = {};
+  timer_args.callback = release_line;
+  timer_args.arg = this;
+  timer_args.dispatch_method = ESP_TIMER_TASK;
+  timer_args.name = "dht22";
+  return esp_timer_create(&timer_args, &start_timer_) == ESP_OK;
+}
+
+void Dht22Rmt::release_line(void *arg)
+{
+  Dht22Rmt *self = (Dht22Rmt *)arg;
+  // the sensor answers ~20-40 us after release, well after rx starts
+  rmt_rx_start(self->channel_, true);
+  gpio_set_level(self->pin_, 1);
+}
+
+void Dht22Rmt::start()
+{
+  if (in_flight_ || start_timer_ == nullptr)
+  {
+    return;
+  }
+  in_flight_ = true;
+  started_ms_ = millis();
+  gpio_set_level(pin_, 0);
+  esp_timer_start_once(start_timer_, DHT22_START_US);
+}
+
+bool Dht22Rmt::poll()
+{
+  if (!in_flight_)
+  {
+    return false;
+  }
+
+  size_t size = 0;
+  rmt_item32_t *items = (rmt_item32_t *)xRingbufferReceive(rx_ring_, &size, 0);
+  if (items == nullptr)
+  {
+    if (millis() - started_ms_ > DHT22_FRAME_TIMEOUT_MS)
+    {
+      rmt_rx_stop(channel_);
+      timeouts_++;
+      in_flight_ = false;
+    }
+    return false;
+  }
+
+  Dht22Pulse pulses[MAX_PULSES];
+  size_t count = size / sizeof(rmt_item32_t);
+  if (count > MAX_PULSES)
+  {
+    count = MAX_PULSES;
+  }
+  for (size_t i = 0; i < count; i++)
+  {
+    // idle level is high, so every item is a low pulse followed by a high one
+    pulses[i].low_us = items[i].level0 == 0 ? items[i].duration0 : items[i].duration1;
+    pulses[i].high_us = items[i].level0 == 0 ? items[i].duration1 : items[i].duration0;
+  }
+  vRingbufferReturnItem(rx_ring_, items);
+  rmt_rx_stop(channel_);
+  in_flight_ = false;
+
+  int16_t temperature_deci;
+  uint16_t humidity_deci;
+  Dht22Status status = dht22_decode(pulses, count, &temperature_deci, &humidity_deci);
+  if (status != DHT22_OK)
+  {
+    if (status == DHT22_CHECKSUM)
+    {
+      checksum_errors_++;
+    }
+    else
+    {
+      timeouts_++;
+    }
+    return false;
+  }
+
+  latest_.temperature_deci = temperature_deci;
+  latest_.humidity_deci = humidity_deci;
+  latest_.timestamp_ms = started_ms_;
+  latest_.valid = true;
+  return true;
+}
@@ -0,0 +1,119 @@
+#include <esp_timer.h>
+
+#define LOG_MODULE "flame"
+#define LOG_MODULE_LEVEL LOG_LEVEL_SENSORS
+#include "log.h"
+
+#include "clock.h"
+#include "config.h"
+#include "flame.h"
+
+SpscRing<FlameEvent, FLAME_EVENT_QUEUE_LEN> flame_events;
+
+static uint8_t flame_pin;
+static int flame_relay_pin = -1;
+static TaskHandle_t flame_task_handle = nullptr;
+static TaskHandle_t listener = nullptr;
+static volatile bool stable_active = false;
+
+// esp_timer_get_time() of the first edge since the last debounce, 0 if none
+static int64_t first_edge_us = 0;
+static portMUX_TYPE edge_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool read_active()
+{
+  return digitalRead(flame_pin) == FLAME_ACTIVE_LEVEL;
+}
+
+// Only stamps the edge; a bouncing comparator output would otherwise wake
+// the task on every transition.
+static void IRAM_ATTR flame_isr()
+{
+  portENTER_CRITICAL_ISR(&edge_mux);
+  bool first = first_edge_us == 0;
+  if (first)
+  {
+    first_edge_us = esp_timer_get_time();
+  }
+  portEXIT_CRITICAL_ISR(&edge_mux);
+
+  if (first)
+  {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(flame_task_handle, &woken);
+    portYIELD_FROM_ISR(woken);
+  }
+}
+
+// An edge counts once the pin still shows the new level FLAME_DEBOUNCE_MS
+// later; chatter that settles back is ignored.
+static void flame_task(void *arg)
+{
+  uint32_t seq = 0;
+  for (;;)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    vTaskDelay(pdMS_TO_TICKS(FLAME_DEBOUNCE_MS));
+
+    portENTER_CRITICAL(&edge_mux);
+    int64_t edge_us = first_edge_us;
+    first_edge_us = 0; // edges from here on start the next window
+    portEXIT_CRITICAL(&edge_mux);
+
+    bool active = read_active();
+    if (active == stable_active)
+    {
+      continue;
+    }
+    stable_active = active;
+
+    // the local output does not wait for the network
+    if (flame_relay_pin >= 0)
+    {
+      digitalWrite(flame_relay_pin, active ? HIGH : LOW);
+    }
+
+    FlameEvent event;
+    event.seq = ++seq;
+    event.active = active;
+    event.edge_us = edge_us;
+    event.timestamp_us = clock_us() - (uint64_t)(esp_timer_get_time() - edge_us);
+    flame_events.push(event); // dropped and counted if the network task is stuck
+    if (listener != nullptr)
+    {
+      xTaskNotifyGive(listener);
+    }
+    LOG_WARN("%s", active ? "🔥🔥🔥 FIRE DETECTED! 🔥🔥🔥" : "Flame gone");
+  }
+}
+
+bool flame_begin(uint8_t pin, int relay_pin, BaseType_t core)
+{
+  flame_pin = pin;
+  flame_relay_pin = relay_pin;
+  pinMode(pin, INPUT);
+  stable_active = read_active();
+  if (relay_pin >= 0)
+  {
+    pinMode(relay_pin, OUTPUT);
+    digitalWrite(relay_pin, stable_active ? HIGH : LOW);
+  }
+
+  if (xTaskCreatePinnedToCore(flame_task, "flame", FLAME_TASK_STACK, nullptr, FLAME_TASK_PRIORITY,
+                              &flame_task_handle, core) != pdPASS)
+  {
+    return false;
+  }
+  attachInterrupt(digitalPinToInterrupt(pin), flame_isr, CHANGE);
+  return true;
+}
+
+bool flame_active()
+{
+  return stable_active;
+}
+
+void flame_set_listener(TaskHandle_t task)
+{
+  listener = task;
+}
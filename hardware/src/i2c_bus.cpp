@@ -0,0 +1,324 @@
+#include <driver/gpio.h>
+#include <driver/i2c.h>
+
+#define LOG_MODULE "i2c"
+#define LOG_MODULE_LEVEL LOG_LEVEL_SENSORS
+#include "log.h"
+
+#include "i2c_bus.h"
+
+#define I2C_PORT I2C_NUM_0
+#define PROBE_TIMEOUT_MS 5
+#define RECOVERY_HALF_PERIOD_US 5 // 100 kHz while clocking by hand
+
+static uint8_t sda;
+static uint8_t scl;
+static uint32_t clock_hz = 0; // currently programmed
+static TaskHandle_t bus_task_handle = nullptr;
+static I2cBusStats stats = {};
+
+static I2cDevice *devices[I2C_MAX_DEVICES];
+static volatile size_t device_count = 0;
+
+// start, address, write, start, address, read, stop; no heap per transaction
+static uint8_t cmd_buffer[I2C_LINK_RECOMMENDED_SIZE(7)];
+
+static bool configure(uint32_t hz)
+{
+  i2c_config_t conf = {};
+  conf.mode = I2C_MODE_MASTER;
+  conf.sda_io_num = sda;
+  conf.scl_io_num = scl;
+  conf.sda_pullup_en = GPIO_PULLUP_ENABLE;
+  conf.scl_pullup_en = GPIO_PULLUP_ENABLE;
+  conf.master.clk_speed = hz;
+  if (i2c_param_config(I2C_PORT, &conf) != ESP_OK)
+  {
+    return false;
+  }
+  clock_hz = hz;
+  return true;
+}
+
+static bool install(uint32_t hz)
+{
+  return configure(hz) && i2c_driver_install(I2C_PORT, I2C_MODE_MASTER, 0, 0, 0) == ESP_OK;
+}
+
+static esp_err_t execute(uint8_t address, const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len,
+                         uint32_t timeout_ms)
+{
+  i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(cmd_buffer, sizeof(cmd_buffer));
+  if (cmd == nullptr)
+  {
+    return ESP_ERR_NO_MEM;
+  }
+  i2c_master_start(cmd);
+  if (tx_len > 0 || rx_len == 0) // an empty write is a probe
+  {
+    i2c_master_write_byte(cmd, (address << 1) | I2C_MASTER_WRITE, true);
+    if (tx_len > 0)
+    {
+      i2c_master_write(cmd, tx, tx_len, true);
+    }
+    if (rx_len > 0)
+    {
+      i2c_master_start(cmd);
+    }
+  }
+  if (rx_len > 0)
+  {
+    i2c_master_write_byte(cmd, (address << 1) | I2C_MASTER_READ, true);
+    i2c_master_read(cmd, rx, rx_len, I2C_MASTER_LAST_NACK);
+  }
+  i2c_master_stop(cmd);
+  esp_err_t err = i2c_master_cmd_begin(I2C_PORT, cmd, pdMS_TO_TICKS(timeout_ms));
+  i2c_cmd_link_delete_static(cmd);
+  return err;
+}
+
+static void release_line(uint8_t pin)
+{
+  gpio_set_level((gpio_num_t)pin, 1);
+  delayMicroseconds(RECOVERY_HALF_PERIOD_US);
+}
+
+static void pull_line(uint8_t pin)
+{
+  gpio_set_level((gpio_num_t)pin, 0);
+  delayMicroseconds(RECOVERY_HALF_PERIOD_US);
+}
+
+// Bus clear (I2C spec 3.1.16): a slave that lost a clock mid-byte still
+// drives SDA low and lets go within nine clocks. A STOP then leaves every
+// slave idle. Returns true if both lines end up high.
+static bool clock_out()
+{
+  const uint8_t pins[] = {sda, scl};
+  for (uint8_t pin : pins)
+  {
+    gpio_reset_pin((gpio_num_t)pin); // GPIO function: off the I2C matrix signals
+    gpio_set_direction((gpio_num_t)pin, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_pull_mode((gpio_num_t)pin, GPIO_PULLUP_ONLY);
+    release_line(pin);
+  }
+  for (int i = 0; i < I2C_RECOVERY_CLOCKS && gpio_get_level((gpio_num_t)sda) == 0; i++)
+  {
+    pull_line(scl);
+    release_line(scl);
+  }
+  pull_line(sda);
+  release_line(sda); // SDA rising while SCL is high: STOP
+  return gpio_get_level((gpio_num_t)sda) == 1 && gpio_get_level((gpio_num_t)scl) == 1;
+}
+
+void i2c_bus_probe_all()
+{
+  for (size_t i = 0; i < device_count; i++)
+  {
+    I2cDevice &device = *devices[i];
+    if (device.clock_hz_ != clock_hz)
+    {
+      configure(device.clock_hz_);
+    }
+    device.online_ = execute(device.address_, nullptr, 0, nullptr, 0, PROBE_TIMEOUT_MS) == ESP_OK;
+  }
+}
+
+static void recover()
+{
+  uint32_t start = micros();
+  i2c_driver_delete(I2C_PORT);
+  bool released = clock_out();
+  bool installed = install(clock_hz);
+  if (installed)
+  {
+    i2c_bus_probe_all();
+  }
+
+  uint32_t us = micros() - start;
+  stats.recovery_us = us;
+  if (us > stats.recovery_max_us)
+  {
+    stats.recovery_max_us = us;
+  }
+  if (!released || !installed)
+  {
+    stats.recovery_failures++;
+  }
+  stats.recoveries++; // last, once the devices are reachable again
+  LOG_WARN("Bus recovered in %lu us (%s)", (unsigned long)us,
+           released && installed ? "lines released" : "still held");
+}
+
+void i2c_bus_run(I2cDevice &device)
+{
+  uint32_t wait_us = micros() - device.posted_us_;
+  if (wait_us > stats.wait_max_us)
+  {
+    stats.wait_max_us = wait_us;
+  }
+  if (device.clock_hz_ != clock_hz)
+  {
+    configure(device.clock_hz_);
+  }
+
+  esp_err_t err = execute(device.address_, device.tx_, device.tx_len_, device.rx_, device.rx_len_,
+                          device.timeout_ms_);
+  stats.transactions++;
+  I2cResult result = I2C_OK;
+  if (err == ESP_FAIL)
+  {
+    result = I2C_NACK;
+    stats.nacks++;
+  }
+  else if (err != ESP_OK)
+  {
+    result = I2C_TIMEOUT;
+    stats.timeouts++;
+  }
+  device.online_ = result == I2C_OK;
+  if (result == I2C_TIMEOUT)
+  {
+    recover(); // probes this device again too
+  }
+
+  device.result_ = result;
+  device.pending_.store(false, std::memory_order_release);
+  xSemaphoreGive(device.done_);
+}
+
+// Serves the devices round robin, so one that posts back to back cannot
+// starve the others.
+static void i2c_bus_task(void *arg)
+{
+  size_t next = 0;
+  for (;;)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    bool any = true;
+    while (any)
+    {
+      any = false;
+      size_t count = device_count;
+      for (size_t n = 0; n < count; n++)
+      {
+        I2cDevice &device = *devices[(next + n) % count];
+        if (device.busy())
+        {
+          i2c_bus_run(device);
+          next = (next + n + 1) % count;
+          any = true;
+          break;
+        }
+      }
+    }
+  }
+}
+
+bool i2c_bus_begin(uint8_t sda_pin, uint8_t scl_pin, BaseType_t core)
+{
+  if (bus_task_handle != nullptr)
+  {
+    return true;
+  }
+  sda = sda_pin;
+  scl = scl_pin;
+  if (!clock_out())
+  {
+    LOG_WARN("Bus held low at boot");
+  }
+  if (!install(400000)) // until a device asks for its own speed
+  {
+    return false;
+  }
+  return xTaskCreatePinnedToCore(i2c_bus_task, "i2c", I2C_TASK_STACK, nullptr, I2C_TASK_PRIORITY,
+                                 &bus_task_handle, core) == pdPASS;
+}
+
+const I2cBusStats &i2c_bus_stats()
+{
+  return stats;
+}
+
+bool I2cDevice::begin(uint8_t address, uint32_t clock_hz)
+{
+  if (clock_hz == 0 || clock_hz > I2C_MAX_CLOCK_HZ || device_count >= I2C_MAX_DEVICES)
+  {
+    return false;
+  }
+  if (done_ == nullptr)
+  {
+    done_ = xSemaphoreCreateBinary();
+    if (done_ == nullptr)
+    {
+      return false;
+    }
+    devices[device_count] = this;
+    device_count = device_count + 1; // published after the slot is filled
+  }
+  address_ = address;
+  clock_hz_ = clock_hz;
+  return true;
+}
+
+I2cResult I2cDevice::post(const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len,
+                          uint32_t timeout_ms)
+{
+  if (bus_task_handle == nullptr || done_ == nullptr || tx_len > I2C_TX_MAX)
+  {
+    return I2C_ERROR;
+  }
+  if (busy())
+  {
+    return I2C_BUSY;
+  }
+  xSemaphoreTake(done_, 0); // a result nobody waited for
+  if (tx_len > 0)
+  {
+    memcpy(tx_, tx, tx_len);
+  }
+  tx_len_ = tx_len;
+  rx_ = rx;
+  rx_len_ = rx_len;
+  timeout_ms_ = timeout_ms;
+  result_ = I2C_PENDING;
+  posted_us_ = micros();
+  pending_.store(true, std::memory_order_release);
+  xTaskNotifyGive(bus_task_handle);
+  return I2C_PENDING;
+}
+
+I2cResult I2cDevice::wait(uint32_t wait_ms)
+{
+  if (done_ == nullptr)
+  {
+    return I2C_ERROR;
+  }
+  TickType_t ticks = wait_ms == portMAX_DELAY ? portMAX_DELAY : pdMS_TO_TICKS(wait_ms);
+  if (result_ != I2C_PENDING || xSemaphoreTake(done_, ticks) == pdTRUE)
+  {
+    return result_;
+  }
+  return I2C_PENDING;
+}
+
+I2cResult I2cDevice::transfer(const uint8_t *tx, size_t tx_len, uint8_t *rx, size_t rx_len,
+                              uint32_t timeout_ms)
+{
+  I2cResult result = post(tx, tx_len, rx, rx_len, timeout_ms);
+  return result == I2C_PENDING ? wait() : result;
+}
+
+bool I2cDevice::write_register(uint8_t reg, uint8_t value)
+{
+  const uint8_t tx[2] = {reg, value};
+  return transfer(tx, sizeof(tx), nullptr, 0) == I2C_OK;
+}
+
+bool I2cDevice::read_registers(uint8_t reg, uint8_t *buf, size_t len)
+{
+  // address, register, address again, then the data
+  uint32_t wire_ms = (uint32_t)(I2C_WIRE_US(3 + len, clock_hz_) / 1000);
+  return transfer(&reg, 1, buf, len, I2C_TIMEOUT_MS + wire_ms) == I2C_OK;
+}
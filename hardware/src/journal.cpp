@@ -0,0 +1,66 @@
+#include <esp_partition.h>
+
+#include "config.h"
+
+#define LOG_MODULE "journal"
+#define LOG_MODULE_LEVEL LOG_LEVEL_NET
+#include "log.h"
+
+#include "clock.h"
+#include "journal.h"
+
+// Note: erases and writes stall both cores' flash cache; a sector erase
+// (~40 ms) happens once every 64 records.
+class PartitionFlash : public JournalFlash
+{
+public:
+  explicit PartitionFlash(const esp_partition_t *partition) : partition_(partition) {}
+
+  size_t size() const override { return partition_->size; }
+  bool read(uint32_t offset, void *dst, size_t len) override
+  {
+    return esp_partition_read(partition_, offset, dst, len) == ESP_OK;
+  }
+  bool write(uint32_t offset, const void *src, size_t len) override
+  {
+    return esp_partition_write(partition_, offset, src, len) == ESP_OK;
+  }
+  bool erase_sector(uint32_t offset) override
+  {
+    return esp_partition_erase_range(partition_, offset, JOURNAL_SECTOR_BYTES) == ESP_OK;
+  }
+
+private:
+  const esp_partition_t *partition_;
+};
+
+FlashJournal journal;
+
+bool journal_begin()
+{
+  const esp_partition_t *partition = esp_partition_find_first(
+      ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, JOURNAL_PARTITION_LABEL);
+  if (partition == nullptr)
+  {
+    LOG_WARN("No '%s' partition, outages are only buffered in RAM", JOURNAL_PARTITION_LABEL);
+    return false;
+  }
+
+  static PartitionFlash flash(partition);
+  uint32_t start = millis();
+  if (!journal.begin(&flash))
+  {
+    LOG_ERROR("Journal partition too small");
+    return false;
+  }
+  LOG_INFO("Journal: %lu records pending, boot %u, scan %lu ms", (unsigned long)journal.pending(),
+           journal.boot_id(), (unsigned long)(millis() - start));
+  return true;
+}
+
+bool journal_append(const TelemetrySample &sample)
+{
+  TelemetryFrame frame;
+  encode_telemetry_binary(sample, frame);
+  return journal.append(&frame, sizeof(frame), sample.timestamp_us, clock_epoch_offset_us());
+}
@@ -0,0 +1,80 @@
+#include <Arduino.h>
+#include <atomic>
+#include <freertos/ringbuf.h>
+#include <stdarg.h>
+
+#include "log.h"
+
+static RingbufHandle_t log_ring = nullptr;
+static std::atomic<uint32_t> dropped_lines{0}; // any task may log
+
+static const char level_letters[] = {'-', 'E', 'W', 'I', 'D', 'T'};
+
+static void log_task(void *arg)
+{
+  for (;;)
+  {
+    size_t len = 0;
+    char *line = (char *)xRingbufferReceive(log_ring, &len, portMAX_DELAY);
+    if (line == nullptr)
+    {
+      continue;
+    }
+    Serial.write((const uint8_t *)line, len);
+    vRingbufferReturnItem(log_ring, line);
+  }
+}
+
+void log_begin(unsigned long baud)
+{
+  if (LOG_LEVEL == LOG_LEVEL_NONE && LOG_LEVEL_SENSORS == LOG_LEVEL_NONE &&
+      LOG_LEVEL_NET == LOG_LEVEL_NONE && LOG_LEVEL_POWER == LOG_LEVEL_NONE)
+  {
+    return;
+  }
+  Serial.begin(baud);
+  log_ring = xRingbufferCreate(LOG_BUFFER_BYTES, RINGBUF_TYPE_NOSPLIT);
+  if (log_ring != nullptr)
+  {
+    xTaskCreatePinnedToCore(log_task, "log", LOG_TASK_STACK, nullptr,
+                            LOG_TASK_PRIORITY, nullptr, LOG_TASK_CORE);
+  }
+}
+
+void log_write(uint8_t level, const char *module, const char *fmt, ...)
+{
+  char line[LOG_LINE_MAX];
+  int len = snprintf(line, sizeof(line), "%lu %c [%s] ", (unsigned long)millis(),
+                     level_letters[level < sizeof(level_letters) ? level : 0], module);
+
+  va_list args;
+  va_start(args, fmt);
+  int body = vsnprintf(line + len, sizeof(line) - len - 1, fmt, args);
+  va_end(args);
+  if (body < 0)
+  {
+    return;
+  }
+  len += body;
+  if (len > (int)sizeof(line) - 2)
+  {
+    len = sizeof(line) - 2; // truncated
+  }
+  line[len++] = '\n';
+
+  if (log_ring == nullptr)
+  {
+    Serial.write((const uint8_t *)line, len);
+    return;
+  }
+  // never wait: a full buffer costs a line, not sensor timing
+  if (xRingbufferSend(log_ring, line, len, 0) != pdTRUE)
+  {
+    dropped_lines.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+uint32_t log_dropped()
+{
+  return dropped_lines.load(std::memory_order_relaxed);
+}
@@ -1,312 +1,876 @@
 #include <Arduino.h>
-#include <WiFi.h>
-#include <PubSubClient.h>
 
-#include <Adafruit_MPU6050.h>
-#include <Adafruit_Sensor.h>
-#include <Wire.h>
-#include "DHTesp.h"
-
-#include "secrets.h"
-
-#define DEBUG true
-#define FLAME_PIN 12 // flame sensor - digital
-#define GAS_PIN 34   // MQ gas - analog
-#define DHT_PIN 33   // DHT22 sensor pin
-#define ADC_PIN 32   // motor current sensor - analog
-
-// --- WiFi and MQTT Variables ---
-const char *ssid = WIFI_SSID;
-const char *password = WIFI_PASSWORD;
-const char *mqtt_server = MQTT_SERVER_IP;
-
-const char *topic = "sensor/all";
-
-WiFiClient espClient;
-PubSubClient client(espClient);
-long lastMsg = 0;
+#define LOG_MODULE "sensors"
+#define LOG_MODULE_LEVEL LOG_LEVEL_SENSORS
+#include "log.h"
+
+#include "activity.h"
+#include "adc_dma.h"
+#include "adc_filter.h"
+#include "anomaly.h"
+#include "dht22.h"
+#include "block_stats.h"
+#include "change_detector.h"
+#include "clock.h"
+#include "config.h"
+#include "flame.h"
+#include "i2c_bus.h"
+#include "mpu_fifo.h"
+#include "network.h"
+#include "perf.h"
+#include "power.h"
+#include "runtime_config.h"
+#include "scheduler.h"
+#include "telemetry.h"
+#include "vibration.h"
 
 // --- MPU6050 Variables ---
-Adafruit_MPU6050 mpu;
-int acceleration_x, acceleration_y, acceleration_z;
-int gyro_x, gyro_y, gyro_z;
-int temperature;
+// Driven through the I2C bus task; samples are read as raw counts and
+// scaled in fixed point (see mpu_fifo.h).
+bool mpu_ready = false;
+int32_t acceleration_x, acceleration_y, acceleration_z; // mm/s^2
+int32_t gyro_x, gyro_y, gyro_z;                         // mrad/s
+int32_t temperature;                                    // 0.01 degC
+VibrationAnalyzer vibration;
 
 // --- Flame Sensor Variables ---
 int flame_status = 1;
 
 // --- Gas Sensor Variables ---
-int gas_level = 0;
+int gas_level = 0; // mV
+GasPolledFilter gas_filter;
 
 // --- DHT22 Variables ---
-DHTesp dht;
-float dht_temperature = 0;
-float dht_humidity = 0;
+Dht22Rmt dht;
+int16_t dht_temperature = 0; // 0.1 degC
+uint16_t dht_humidity = 0;   // 0.1 %
 
 // --- Mototr Current Sensor Variables ---
-int motor_adc_value = 0;
+int motor_adc_value = 0; // mV
+MotorPolledFilter motor_filter;
+BlockStats motor_stats; // since the last publish
+
+// --- Continuous ADC ---
+BlockStats gas_stats; // since the last publish
 
-void setup_wifi()
+// --- Event-driven reporting ---
+enum ReportChannel
 {
-  delay(10);
+  REPORT_ACCEL_X,
+  REPORT_ACCEL_Y,
+  REPORT_ACCEL_Z,
+  REPORT_GYRO_X,
+  REPORT_GYRO_Y,
+  REPORT_GYRO_Z,
+  REPORT_TEMPERATURE,
+  REPORT_FLAME,
+  REPORT_GAS,
+  REPORT_DHT_TEMPERATURE,
+  REPORT_DHT_HUMIDITY,
+  REPORT_MOTOR,
+  REPORT_MOTOR_RMS,
+  REPORT_CHANNEL_COUNT
+};
+ChangeDetector<REPORT_CHANNEL_COUNT> change_detector;
+int reported_flame_status = -1;
+bool gas_alarm_active = false;
+uint16_t gas_alarm_level = GAS_ALARM_LEVEL; // mV, runtime setting
+
+// --- Edge anomaly detection ---
+const AnomalyRule anomaly_rules[] = {
+    // channel, rule, raise, clear, z-score stddev floor
+    {ANOMALY_GAS, ANOMALY_ZSCORE, ANOMALY_ZSCORE_RAISE, ANOMALY_ZSCORE_CLEAR, 4},
+    {ANOMALY_GAS, ANOMALY_RATE, ANOMALY_GAS_RATE, ANOMALY_GAS_RATE / 2, 0},
+    {ANOMALY_MOTOR, ANOMALY_ZSCORE, ANOMALY_ZSCORE_RAISE, ANOMALY_ZSCORE_CLEAR, 2},
+    {ANOMALY_MOTOR, ANOMALY_RATE, ANOMALY_MOTOR_RATE, ANOMALY_MOTOR_RATE / 2, 0},
+    {ANOMALY_VIBRATION, ANOMALY_ZSCORE, ANOMALY_ZSCORE_RAISE, ANOMALY_ZSCORE_CLEAR, 0.05f},
+    {ANOMALY_TEMPERATURE, ANOMALY_RATE, ANOMALY_TEMPERATURE_RATE, ANOMALY_TEMPERATURE_RATE / 2, 0},
+    {ANOMALY_DHT_TEMPERATURE, ANOMALY_RATE, ANOMALY_TEMPERATURE_RATE, ANOMALY_TEMPERATURE_RATE / 2, 0},
+};
+AnomalyDetector anomaly;
+bool anomaly_edge = false; // marks the next telemetry sample as an alarm
+
+// --- Adaptive sampling ---
+enum ActivityChannel
+{
+  ACTIVITY_MPU,
+  ACTIVITY_MOTOR,
+  ACTIVITY_CHANNEL_COUNT
+};
+const char *activity_channel_names[ACTIVITY_CHANNEL_COUNT] = {"mpu", "motor"};
+const ActivityThresholds activity_thresholds[ACTIVITY_CHANNEL_COUNT] = {
+    // normal enter/exit, burst enter/exit, hold
+    {ACTIVITY_VIBRATION_NORMAL_ENTER, ACTIVITY_VIBRATION_NORMAL_EXIT, ACTIVITY_VIBRATION_BURST_ENTER,
+     ACTIVITY_VIBRATION_BURST_EXIT, ACTIVITY_HOLD_MS},
+    {ACTIVITY_MOTOR_NORMAL_ENTER, ACTIVITY_MOTOR_NORMAL_EXIT, ACTIVITY_MOTOR_BURST_ENTER,
+     ACTIVITY_MOTOR_BURST_EXIT, ACTIVITY_HOLD_MS},
+};
+ActivityController activity[ACTIVITY_CHANNEL_COUNT];
+float vibration_level = 0; // RMS of the latest FFT window, m/s^2
+BlockStats motor_activity; // motor readings since the last profile update
+HistoryRing<TelemetrySample, ACTIVITY_PRETRIGGER_SAMPLES> pretrigger; // held back by the deadband
+uint64_t last_queued_us = 0;  // newest sample handed to telemetry_queue
+bool burst_started = false;   // the next sample goes out with the pre-trigger history
+uint32_t pretrigger_queued = 0;
+
+// --- Tasks ---
+void sampling_task(void *arg); // defined below the sensor functions
+void apply_settings(const Settings &settings);
+
+void setup()
+{
+  log_begin(115200);
+
+  // --- MPU6050 Setup ---
+  // Every bus transaction has a timeout, so a missing or hung chip only
+  // turns the MPU channel off; the other sensors still run.
+  if (!i2c_bus_begin(I2C_SDA_PIN, I2C_SCL_PIN, SAMPLING_TASK_CORE))
+  {
+    LOG_ERROR("Failed to start the I2C bus");
+  }
+  mpu_ready = mpu_begin(); // ranges and the latched motion interrupt
+  if (!mpu_ready)
+  {
+    LOG_ERROR("Failed to find MPU6050 chip, motion channel off");
+  }
+  else
+  {
+    LOG_INFO("MPU6050 Found!");
+  }
+  if (mpu_ready && MPU_FIFO_MODE && !mpu_fifo_begin(MPU_INT_PIN, SAMPLING_TASK_CORE))
+  {
+    LOG_ERROR("Failed to start MPU6050 FIFO");
+  }
+
+  VibrationConfig vibration_config = {
+      VIBRATION_WINDOW,
+      MPU_FIFO_MODE ? (float)MPU_FIFO_RATE_HZ : 1e6f / MPU_PERIOD_US,
+      VIBRATION_BAND_COUNT,
+      VIBRATION_BAND_EDGES_HZ,
+      VIBRATION_SPECTRUM_BINS,
+  };
+  if (!vibration.begin(vibration_config))
+  {
+    LOG_WARN("Invalid vibration config, FFT features disabled");
+  }
+
+  // Digital sensors
+  pinMode(FLAME_PIN, INPUT);
+  if (FLAME_INTERRUPT_MODE && !flame_begin(FLAME_PIN, FLAME_RELAY_PIN, SAMPLING_TASK_CORE))
+  {
+    LOG_ERROR("Failed to start the flame interrupt, polling only");
+  }
+
+  // Analog sensors
+  pinMode(14, INPUT);
 
-  if (DEBUG)
+  if (!dht.begin(DHT_PIN, RMT_CHANNEL_0))
   {
-    Serial.println();
-    Serial.print("Connecting to WiFi: ");
-    Serial.println(ssid);
+    LOG_ERROR("Failed to set up DHT22 capture");
   }
+  pinMode(ADC_PIN, INPUT);
+  analogSetPinAttenuation(ADC_PIN, (adc_attenuation_t)ADC_MOTOR_ATTEN);
+  analogSetPinAttenuation(GAS_PIN, (adc_attenuation_t)ADC_GAS_ATTEN);
+  adc_calibration_begin();
 
-  WiFi.begin(ssid, password);
+  motor_stats.reset();
+  gas_stats.reset();
+  motor_activity.reset();
 
-  while (WiFi.status() != WL_CONNECTED)
+  for (int c = 0; c < ACTIVITY_CHANNEL_COUNT; c++)
   {
-    delay(500);
-    if (DEBUG)
+    if (!activity[c].begin(activity_thresholds[c]))
     {
-      Serial.print(".");
+      LOG_ERROR("Invalid activity thresholds for %s, fixed rate", activity_channel_names[c]);
     }
   }
 
-  if (DEBUG)
+  runtime_config_begin();
+
+  if (!anomaly.begin(anomaly_rules, sizeof(anomaly_rules) / sizeof(anomaly_rules[0]),
+                     ANOMALY_EWMA_ALPHA, ANOMALY_WARMUP_SAMPLES, ANOMALY_BASELINE_SAMPLES,
+                     ANOMALY_RATE_WINDOW_MS))
+  {
+    LOG_ERROR("Invalid anomaly rule table, edge detection disabled");
+  }
+
+  if (ADC_CONTINUOUS_MODE && !adc_dma_begin(ADC_PIN, GAS_PIN, SAMPLING_TASK_CORE))
   {
-    Serial.println("");
-    Serial.println("WiFi connected");
-    Serial.println("ESP32 IP Address: ");
-    Serial.println(WiFi.localIP());
+    LOG_ERROR("Failed to start continuous ADC");
   }
+  apply_settings(runtime_config());
+
+  if (LOW_POWER_MODE)
+  {
+    return; // loop() runs the duty cycle, no tasks
+  }
+
+  xTaskCreatePinnedToCore(sampling_task, "sampling", SAMPLING_TASK_STACK, nullptr,
+                          SAMPLING_TASK_PRIORITY, nullptr, SAMPLING_TASK_CORE);
+  xTaskCreatePinnedToCore(network_task, "network", NETWORK_TASK_STACK, nullptr,
+                          NETWORK_TASK_PRIORITY, nullptr, NETWORK_TASK_CORE);
 }
 
-void reconnect()
+// Scores one reading and queues an alarm for every rule edge, right away
+// rather than at the next telemetry tick.
+void check_anomaly(AnomalyChannel channel, float value)
 {
-  // Loop to reconnect to MQTT
-  while (!client.connected())
+  if (!ANOMALY_DETECTION)
   {
-    if (DEBUG)
-    {
-      Serial.print("Connecting to MQTT...");
-    }
-    // Trying to connect with ID "ESP32Client"
-    if (client.connect("ESP32Client"))
+    return;
+  }
+  AnomalyEvent events[4];
+  size_t n = anomaly.add(channel, value, millis(), events, 4);
+  for (size_t i = 0; i < n; i++)
+  {
+    AlarmEvent event;
+    event.timestamp_us = clock_us();
+    event.type = events[i].type == ANOMALY_ZSCORE ? ALARM_ZSCORE : ALARM_RATE;
+    event.active = events[i].active;
+    event.value = events[i].value;
+    event.channel = channel;
+    event.score = events[i].score;
+    event.seq = 0;
+    alarm_queue.push(event);
+    anomaly_edge = true;
+
+    const StreamingStats &stats = anomaly.stats(channel);
+    LOG_WARN("Anomaly rule %u on channel %u %s: value %.2f score %.2f (mean %.2f, sd %.2f, range %.2f..%.2f)",
+             events[i].rule, channel, events[i].active ? "raised" : "cleared", value, events[i].score,
+             stats.mean, stats.stddev(), stats.rolling_min(), stats.rolling_max());
+  }
+}
+
+// Feeds one accelerometer sample (m/s^2) to the FFT stage and queues the
+// features whenever a window completes.
+void add_vibration_sample(float x, float y, float z)
+{
+  static VibrationFeatures features;
+  const float sample[VIBRATION_AXES] = {x, y, z};
+  if (vibration.add(sample, features))
+  {
+    features.timestamp_us = clock_us();
+    vibration_queue.push(features);
+
+    float power = 0;
+    for (int axis = 0; axis < VIBRATION_AXES; axis++)
     {
-      if (DEBUG)
-      {
-        Serial.println("connected!");
-      }
+      power += features.axis[axis].rms * features.axis[axis].rms;
     }
-    else
+    vibration_level = sqrtf(power);
+    check_anomaly(ANOMALY_VIBRATION, vibration_level);
+  }
+}
+
+// Newest raw sample -> fixed-point telemetry values
+void set_mpu_values(const MpuRawSample &sample)
+{
+  acceleration_x = mpu_accel_mm_s2(sample.ax);
+  acceleration_y = mpu_accel_mm_s2(sample.ay);
+  acceleration_z = mpu_accel_mm_s2(sample.az);
+
+  gyro_x = mpu_gyro_mrad_s(sample.gx);
+  gyro_y = mpu_gyro_mrad_s(sample.gy);
+  gyro_z = mpu_gyro_mrad_s(sample.gz);
+
+  temperature = mpu_temp_centi(sample.temp);
+  check_anomaly(ANOMALY_TEMPERATURE, temperature * 0.01f);
+}
+
+// The FFT stage runs on the FPU in m/s^2
+void add_vibration_counts(const MpuRawSample &sample)
+{
+  const float scale = MPU_GRAVITY_M_S2 / MPU_ACCEL_LSB_PER_G;
+  add_vibration_sample(sample.ax * scale, sample.ay * scale, sample.az * scale);
+}
+
+// Idle runs the chip at a reduced rate, too slow for the FFT bands
+bool vibration_enabled()
+{
+  return activity[ACTIVITY_MPU].profile() != ACTIVITY_IDLE;
+}
+
+void read_mpu_fifo()
+{
+  // The FIFO task has already burst-read the chip; every queued frame goes
+  // through the FFT stage, the newest one is also kept for telemetry.
+  MpuRawSample sample;
+  bool any = false;
+  bool fft = vibration_enabled();
+  while (mpu_samples.pop(sample))
+  {
+    if (fft)
     {
-      if (DEBUG)
-      {
-        Serial.print("error, rc=");
-        Serial.print(client.state());
-        Serial.println(" trying again in 5 seconds");
-      }
-      // Wait 5 seconds before retrying
-      delay(5000);
+      add_vibration_counts(sample);
     }
+    any = true;
+  }
+  if (any)
+  {
+    set_mpu_values(sample);
   }
 }
 
-void setup()
+void get_mpu_data()
 {
-  if (DEBUG)
+  if (!mpu_ready)
   {
-    Serial.begin(115200);
-    while (!Serial)
+    return;
+  }
+  if (MPU_FIFO_MODE)
+  {
+    read_mpu_fifo();
+  }
+  else
+  {
+    MpuRawSample sample;
+    if (!mpu_read_raw(sample))
+    {
+      LOG_WARN("MPU6050 read failed");
+      return;
+    }
+    set_mpu_values(sample);
+    if (vibration_enabled())
     {
-      delay(10);
+      add_vibration_counts(sample);
     }
   }
 
-  setup_wifi();
-  client.setServer(mqtt_server, 1883);
+  LOG_TRACE("Acceleration X: %ld, Y: %ld, Z: %ld mm/s^2", (long)acceleration_x, (long)acceleration_y,
+            (long)acceleration_z);
+  LOG_TRACE("Rotation X: %ld, Y: %ld, Z: %ld mrad/s", (long)gyro_x, (long)gyro_y, (long)gyro_z);
+  LOG_TRACE("Temperature: %ld cdegC", (long)temperature);
+}
 
-  // --- MPU6050 Setup ---
-  if (!mpu.begin())
+// With the interrupt on, the edges are handled in flame.cpp; this only
+// copies the debounced state into telemetry.
+void get_flame_data()
+{
+  if (FLAME_INTERRUPT_MODE)
   {
-    Serial.println("Failed to find MPU6050 chip");
-    while (1)
+    flame_status = flame_active();
+    return;
+  }
+  flame_status = digitalRead(FLAME_PIN) == FLAME_ACTIVE_LEVEL;
+
+  if (flame_status)
+  {
+    LOG_DEBUG("🔥🔥🔥 FIRE DETECTED! 🔥🔥🔥");
+  }
+  else
+  {
+    LOG_DEBUG("Safe: No flame detected.");
+  }
+}
+
+// Folds the DMA frames reduced since the last call into the interval stats.
+void read_adc_blocks()
+{
+  AdcBlock block;
+  while (adc_blocks.pop(block))
+  {
+    motor_stats.merge(block.channel[ADC_CHANNEL_MOTOR]);
+    motor_activity.merge(block.channel[ADC_CHANNEL_MOTOR]);
+    gas_stats.merge(block.channel[ADC_CHANNEL_GAS]);
+    if (block.channel[ADC_CHANNEL_MOTOR].count)
     {
-      delay(10);
+      motor_adc_value = block.last[ADC_CHANNEL_MOTOR];
+      check_anomaly(ANOMALY_MOTOR, block.channel[ADC_CHANNEL_MOTOR].mean());
+    }
+    if (block.channel[ADC_CHANNEL_GAS].count)
+    {
+      gas_level = block.last[ADC_CHANNEL_GAS];
+      check_anomaly(ANOMALY_GAS, block.channel[ADC_CHANNEL_GAS].mean());
     }
   }
-  if (DEBUG)
+}
+
+// One reading: a burst of ADC_POLLED_OVERSAMPLE conversions through the
+// channel's chain, which decimates it to a single value
+template <typename Chain>
+uint16_t read_filtered_mv(uint8_t pin, AdcChannel channel, Chain &chain)
+{
+  static_assert(Chain::decimation == ADC_POLLED_OVERSAMPLE, "one output per burst");
+  int32_t filtered = 0;
+  for (int i = 0; i < ADC_POLLED_OVERSAMPLE; i++)
   {
-    Serial.println("MPU6050 Found!");
+    chain.process(analogRead(pin), filtered);
   }
+  return adc_to_mv(channel, filtered);
+}
 
-  // setupt motion detection
-  mpu.setHighPassFilter(MPU6050_HIGHPASS_0_63_HZ);
-  mpu.setMotionDetectionThreshold(1);
-  mpu.setMotionDetectionDuration(20);
-  mpu.setInterruptPinLatch(true); // Keep it latched.  Will turn off when reinitialized.
-  mpu.setInterruptPinPolarity(true);
-  mpu.setMotionInterrupt(true);
+void get_gas_data()
+{
+  if (ADC_CONTINUOUS_MODE)
+  {
+    read_adc_blocks();
+  }
+  else
+  {
+    gas_level = read_filtered_mv(GAS_PIN, ADC_CHANNEL_GAS, gas_filter);
+    gas_stats.add(gas_level);
+    check_anomaly(ANOMALY_GAS, gas_level);
+  }
+  LOG_DEBUG("Gas Level: %d mV", gas_level);
+}
 
-  // Digital sensors
-  pinMode(FLAME_PIN, INPUT);
+// Picks up the frame captured since the last trigger, if any.
+void update_dht_reading()
+{
+  uint32_t errors = dht.errors();
+  if (dht.poll())
+  {
+    dht_humidity = dht.latest().humidity_deci;
+    dht_temperature = dht.latest().temperature_deci;
+    check_anomaly(ANOMALY_DHT_TEMPERATURE, dht_temperature * 0.1f);
+    LOG_DEBUG("Temperature (°C): %d.%d", dht_temperature / 10, abs(dht_temperature % 10));
+    LOG_DEBUG("Humidity (%%): %u.%u", dht_humidity / 10, dht_humidity % 10);
+  }
+  else if (dht.errors() != errors)
+  {
+    LOG_WARN("Failed to read from DHT sensor! (timeouts %u, checksum %u)",
+             (unsigned)dht.timeouts(), (unsigned)dht.checksum_errors());
+  }
+}
 
-  // Analog sensors
-  pinMode(14, INPUT);
+// Never blocks: the frame triggered here is decoded on the next call,
+// DHT_PERIOD_US later.
+void get_dht_data()
+{
+  update_dht_reading();
+  dht.start();
+}
 
-  dht.setup(DHT_PIN, DHTesp::DHT22);
-  pinMode(ADC_PIN, INPUT);
-  analogSetPinAttenuation(ADC_PIN, ADC_0db);
+void get_motor_current_data()
+{
+  if (ADC_CONTINUOUS_MODE)
+  {
+    read_adc_blocks();
+  }
+  else
+  {
+    motor_adc_value = read_filtered_mv(ADC_PIN, ADC_CHANNEL_MOTOR, motor_filter);
+    motor_stats.add(motor_adc_value);
+    motor_activity.add(motor_adc_value);
+    check_anomaly(ANOMALY_MOTOR, motor_adc_value);
+  }
+  LOG_TRACE("Motor: %d mV", motor_adc_value);
 }
 
-void get_mpu_data()
+void queue_alarm(AlarmType type, bool active, int32_t value, uint64_t timestamp_us)
+{
+  AlarmEvent event;
+  event.timestamp_us = timestamp_us;
+  event.type = type;
+  event.active = active;
+  event.value = value;
+  event.channel = ANOMALY_GAS; // unused for threshold alarms
+  event.score = 0;
+  event.seq = 0;
+  alarm_queue.push(event);
+}
+
+// Snapshot of the latest readings; closes the motor/gas interval stats.
+void build_sample(TelemetrySample &sample)
 {
-  /* Get new sensor events with the readings */
-  sensors_event_t a, g, temp;
-  mpu.getEvent(&a, &g, &temp);
-
-  acceleration_x = a.acceleration.x;
-  acceleration_y = a.acceleration.y;
-  acceleration_z = a.acceleration.z;
-
-  gyro_x = g.gyro.x;
-  gyro_y = g.gyro.y;
-  gyro_z = g.gyro.z;
-
-  temperature = temp.temperature;
-
-  if (DEBUG)
-  {
-    Serial.print("Acceleration X: ");
-    Serial.print(acceleration_x);
-    Serial.print(", Y: ");
-    Serial.print(acceleration_y);
-    Serial.print(", Z: ");
-    Serial.print(acceleration_z);
-    Serial.println(" m/s^2");
-
-    Serial.print("Rotation X: ");
-    Serial.print(gyro_x);
-    Serial.print(", Y: ");
-    Serial.print(gyro_y);
-    Serial.print(", Z: ");
-    Serial.print(gyro_z);
-    Serial.println(" rad/s");
-
-    Serial.print("Temperature: ");
-    Serial.print(temperature);
-    Serial.println(" degC");
-    Serial.println("");
+  sample.timestamp_us = clock_us();
+  sample.acceleration_x = acceleration_x;
+  sample.acceleration_y = acceleration_y;
+  sample.acceleration_z = acceleration_z;
+  sample.gyro_x = gyro_x;
+  sample.gyro_y = gyro_y;
+  sample.gyro_z = gyro_z;
+  sample.temperature = temperature;
+  sample.flame_status = flame_status;
+  // interval mean rather than one instantaneous reading
+  sample.gas_level = gas_stats.count ? (gas_stats.mean_deci() + 5) / 10 : gas_level;
+  sample.dht_temperature_deci = dht_temperature;
+  sample.dht_humidity_deci = dht_humidity;
+  sample.motor_adc_value = motor_adc_value;
+  sample.motor_mean_deci = motor_stats.mean_deci();
+  sample.motor_rms_deci = motor_stats.ac_rms_deci();
+  if (motor_stats.count)
+  {
+    uint32_t above = motor_stats.max * 10 - sample.motor_mean_deci;
+    uint32_t below = sample.motor_mean_deci - motor_stats.min * 10;
+    sample.motor_peak_deci = above > below ? above : below;
+  }
+  else
+  {
+    sample.motor_peak_deci = 0;
   }
+  motor_stats.reset();
+  gas_stats.reset();
+  sample.alarm = false;
 }
 
-void get_flame_data()
+bool any_burst()
 {
-  flame_status = digitalRead(FLAME_PIN);
+  for (int c = 0; c < ACTIVITY_CHANNEL_COUNT; c++)
+  {
+    if (activity[c].profile() == ACTIVITY_BURST)
+    {
+      return true;
+    }
+  }
+  return false;
+}
 
-  if (DEBUG)
+// The samples the deadband held back since the last queued one, oldest
+// first, so the start of a burst is published and not just its trigger.
+void queue_pretrigger()
+{
+  for (size_t i = 0; i < pretrigger.size(); i++)
   {
-    if (flame_status)
+    if (pretrigger[i].timestamp_us > last_queued_us)
     {
-      Serial.println("🔥🔥🔥 FIRE DETECTED! 🔥🔥🔥");
+      telemetry_queue.push(pretrigger[i]);
+      pretrigger_queued++;
     }
-    else
+  }
+  pretrigger.clear();
+}
+
+// Takes one telemetry sample every PUBLISH_PERIOD_US. It is only queued if a
+// channel left its deadband, on heartbeat, on an alarm edge, or while a
+// channel is in its burst profile.
+void enqueue_telemetry()
+{
+  TelemetrySample sample;
+  build_sample(sample);
+
+  // Alarms: any flame edge, gas crossing gas_alarm_level in either direction.
+  // The flame fast path has already sent its own alarm for the edge.
+  if (reported_flame_status >= 0 && sample.flame_status != reported_flame_status)
+  {
+    if (!FLAME_INTERRUPT_MODE)
     {
-      Serial.println("Safe: No flame detected.");
+      queue_alarm(ALARM_FLAME, sample.flame_status != 0, sample.flame_status, sample.timestamp_us);
     }
+    sample.alarm = true;
+  }
+  reported_flame_status = sample.flame_status;
+
+  if (anomaly_edge)
+  {
+    sample.alarm = true;
+    anomaly_edge = false;
+  }
+
+  if ((sample.gas_level > gas_alarm_level) != gas_alarm_active)
+  {
+    gas_alarm_active = !gas_alarm_active;
+    queue_alarm(ALARM_GAS, gas_alarm_active, sample.gas_level, sample.timestamp_us);
+    sample.alarm = true;
+  }
+
+  // the alarm flag flushes the batch with the history in it
+  if (burst_started)
+  {
+    burst_started = false;
+    queue_pretrigger();
+    sample.alarm = true;
+  }
+
+  // in the units of the DEADBAND_* settings
+  const float values[REPORT_CHANNEL_COUNT] = {
+      sample.acceleration_x * 0.001f, sample.acceleration_y * 0.001f, sample.acceleration_z * 0.001f,
+      sample.gyro_x * 0.001f, sample.gyro_y * 0.001f, sample.gyro_z * 0.001f,
+      sample.temperature * 0.01f,
+      (float)sample.flame_status,
+      (float)sample.gas_level,
+      sample.dht_temperature_deci * 0.1f,
+      sample.dht_humidity_deci * 0.1f,
+      sample.motor_mean_deci * 0.1f,
+      sample.motor_rms_deci * 0.1f,
+  };
+  uint32_t now_ms = (uint32_t)(sample.timestamp_us / 1000);
+  if (!sample.alarm && !any_burst() && !change_detector.should_report(values, now_ms))
+  {
+    pretrigger.push(sample);
+    return;
   }
+  change_detector.reported(values, now_ms);
+
+  // Never blocks: if the network task is far behind, the sample is dropped
+  // and counted instead of stalling acquisition.
+  telemetry_queue.push(sample);
+  last_queued_us = sample.timestamp_us;
 }
 
-void get_gas_data()
+// --- Scheduler ---
+// Fast sensors first so a slow read never delays them by a whole pass.
+enum SamplingTask
+{
+  TASK_MPU = 0,
+  TASK_MOTOR,
+  TASK_FLAME,
+  TASK_GAS,
+  TASK_DHT,
+  TASK_ACTIVITY,
+  TASK_PUBLISH,
+  TASK_COUNT
+};
+
+void update_activity(); // defined below apply_settings()
+
+// Scheduler entry that times one run of the task function (see perf.h)
+template <void (*Run)(), PerfStage Stage>
+void timed()
 {
-  gas_level = analogRead(GAS_PIN); // 0–4095 na ESP32
-  if (DEBUG)
+  uint32_t start = perf_cycles();
+  Run();
+  perf_record_since(Stage, start);
+}
+
+ScheduledTask tasks[TASK_COUNT] = {
+    {"mpu", timed<get_mpu_data, PERF_MPU>, MPU_PERIOD_US, 0, 0},
+    {"motor", timed<get_motor_current_data, PERF_MOTOR>, MOTOR_PERIOD_US, 0, 0},
+    {"flame", timed<get_flame_data, PERF_FLAME>, FLAME_PERIOD_US, 0, 0},
+    {"gas", timed<get_gas_data, PERF_GAS>, GAS_PERIOD_US, 0, 0},
+    {"dht", timed<get_dht_data, PERF_DHT>, DHT_PERIOD_US, 0, 0},
+    {"activity", timed<update_activity, PERF_ACTIVITY>, ACTIVITY_PERIOD_US, 0, 0},
+    {"publish", timed<enqueue_telemetry, PERF_ENQUEUE>, PUBLISH_PERIOD_US, 0, 0},
+};
+const size_t task_count = sizeof(tasks) / sizeof(tasks[0]);
+uint32_t base_period_us[TASK_COUNT]; // from the settings, before the profile scaling
+
+uint32_t scaled_period(uint32_t period_us, ActivityProfile profile)
+{
+  if (profile == ACTIVITY_IDLE)
   {
-    Serial.print("Gas Level: ");
-    Serial.println(gas_level);
+    return period_us * ACTIVITY_IDLE_PERIOD_SCALE;
   }
+  if (profile == ACTIVITY_BURST)
+  {
+    return period_us / ACTIVITY_BURST_PERIOD_DIV;
+  }
+  return period_us;
 }
 
-void get_dht_data()
+// Each channel's task runs at its own profile, telemetry at the pace of the
+// busier channel.
+void apply_activity_periods()
+{
+  for (size_t i = 0; i < task_count; i++)
+  {
+    tasks[i].period_us = base_period_us[i];
+  }
+  ActivityProfile mpu_profile = activity[ACTIVITY_MPU].profile();
+  ActivityProfile motor_profile = activity[ACTIVITY_MOTOR].profile();
+  tasks[TASK_MPU].period_us = scaled_period(base_period_us[TASK_MPU], mpu_profile);
+  tasks[TASK_MOTOR].period_us = scaled_period(base_period_us[TASK_MOTOR], motor_profile);
+  tasks[TASK_PUBLISH].period_us = scaled_period(base_period_us[TASK_PUBLISH],
+                                                mpu_profile > motor_profile ? mpu_profile : motor_profile);
+}
+
+// Sampling-side part of a config update, applied between scheduler passes.
+// New periods take effect after each task's next run.
+void apply_settings(const Settings &settings)
 {
-  TempAndHumidity data = dht.getTempAndHumidity();
-  if (isnan(data.temperature) || isnan(data.humidity))
+  base_period_us[TASK_MPU] = settings.mpu_period_us;
+  base_period_us[TASK_MOTOR] = settings.motor_period_us;
+  base_period_us[TASK_FLAME] = settings.flame_period_us;
+  base_period_us[TASK_GAS] = settings.gas_period_us;
+  base_period_us[TASK_DHT] = settings.dht_period_us;
+  base_period_us[TASK_ACTIVITY] = ACTIVITY_PERIOD_US;
+  base_period_us[TASK_PUBLISH] = settings.publish_period_us;
+  apply_activity_periods();
+
+  float db[SETTINGS_DEADBAND_COUNT]; // copied out, Settings is packed
+  memcpy(db, settings.deadband, sizeof(db));
+  const float deadband[REPORT_CHANNEL_COUNT] = {
+      db[SETTINGS_DEADBAND_ACCEL], db[SETTINGS_DEADBAND_ACCEL], db[SETTINGS_DEADBAND_ACCEL],
+      db[SETTINGS_DEADBAND_GYRO], db[SETTINGS_DEADBAND_GYRO], db[SETTINGS_DEADBAND_GYRO],
+      db[SETTINGS_DEADBAND_TEMPERATURE],
+      0, // any flame edge
+      db[SETTINGS_DEADBAND_GAS],
+      db[SETTINGS_DEADBAND_DHT_TEMPERATURE],
+      db[SETTINGS_DEADBAND_DHT_HUMIDITY],
+      db[SETTINGS_DEADBAND_MOTOR],
+      db[SETTINGS_DEADBAND_MOTOR_RMS],
+  };
+  change_detector.begin(deadband, settings.heartbeat_ms); // next sample goes out as a report
+  gas_alarm_level = settings.gas_alarm_level;
+
+  if (ADC_CONTINUOUS_MODE)
   {
-    if (DEBUG)
+    adc_dma_set_gas_lowpass(settings.gas_lowpass_hz);
+  }
+}
+
+// The MPU channel wakes on the motion interrupt or the vibration level and
+// changes the FIFO rate with its profile; the motor channel follows its AC
+// RMS. The DMA conversion rate is fixed, so there only the task period and
+// the reporting change.
+void update_activity()
+{
+  if (!ADAPTIVE_SAMPLING)
+  {
+    return;
+  }
+  uint32_t now_ms = millis();
+  ActivityProfile before[ACTIVITY_CHANNEL_COUNT];
+  for (int c = 0; c < ACTIVITY_CHANNEL_COUNT; c++)
+  {
+    before[c] = activity[c].profile();
+  }
+
+  bool motion = MPU_FIFO_MODE ? mpu_motion_detected : mpu_ready && mpu_motion_status();
+  mpu_motion_detected = false;
+  activity[ACTIVITY_MPU].update(vibration_level, now_ms);
+  if (motion)
+  {
+    activity[ACTIVITY_MPU].wake(now_ms);
+  }
+  if (motor_activity.count)
+  {
+    activity[ACTIVITY_MOTOR].update(motor_activity.ac_rms_deci() * 0.1f, now_ms);
+    motor_activity.reset();
+  }
+
+  bool changed = false;
+  for (int c = 0; c < ACTIVITY_CHANNEL_COUNT; c++)
+  {
+    ActivityProfile profile = activity[c].profile();
+    if (profile == before[c])
     {
-      Serial.println("Failed to read from DHT sensor!");
+      continue;
     }
+    changed = true;
+    burst_started |= profile == ACTIVITY_BURST;
+    LOG_INFO("%s activity: %s -> %s", activity_channel_names[c], activity_profile_name(before[c]),
+             activity_profile_name(profile));
   }
-  else
+  if (!changed)
+  {
+    return;
+  }
+
+  ActivityProfile mpu_profile = activity[ACTIVITY_MPU].profile();
+  if ((mpu_profile == ACTIVITY_IDLE) != (before[ACTIVITY_MPU] == ACTIVITY_IDLE))
   {
-    dht_humidity = data.humidity;
-    dht_temperature = data.temperature;
-    if (DEBUG)
+    if (MPU_FIFO_MODE &&
+        !mpu_fifo_set_rate(mpu_profile == ACTIVITY_IDLE ? MPU_FIFO_LOW_RATE_HZ : MPU_FIFO_RATE_HZ))
+    {
+      LOG_WARN("MPU6050 rate switch not confirmed");
+    }
+    // what is queued was taken at the old rate: only the newest sample is
+    // kept, for telemetry, and the FFT starts a fresh window
+    MpuRawSample sample;
+    bool any = false;
+    while (mpu_samples.pop(sample))
+    {
+      any = true;
+    }
+    if (any)
     {
-      Serial.print("Temperature (°C): ");
-      Serial.println(dht_temperature, 1);
-      Serial.print("Humidity (%): ");
-      Serial.println(dht_humidity, 1);
+      set_mpu_values(sample);
     }
+    vibration.reset();
+    vibration_level = 0;
   }
+  apply_activity_periods();
 }
 
-void get_motor_current_data()
+// Runs every sensor on its own deadline, pinned to a core without WiFi work.
+void sampling_task(void *arg)
 {
-  motor_adc_value = analogRead(ADC_PIN);
-  if (DEBUG)
+  const uint32_t cycles_per_us = getCpuFrequencyMhz();
+  scheduler_start(tasks, task_count, micros());
+
+  for (;;)
   {
-    Serial.print("Motor: ");
-    Serial.println(motor_adc_value);
+    Settings update;
+    while (settings_updates.pop(update))
+    {
+      apply_settings(update);
+      LOG_INFO("Applied runtime settings");
+    }
+
+    scheduler_run(tasks, task_count, micros());
+
+    if (PERF_METRICS)
+    {
+      uint32_t overruns = 0;
+      for (size_t i = 0; i < task_count; i++)
+      {
+        overruns += tasks[i].overruns;
+      }
+      PerfActivity stats;
+      stats.mpu_profile = activity[ACTIVITY_MPU].profile();
+      stats.motor_profile = activity[ACTIVITY_MOTOR].profile();
+      stats.bursts = activity[ACTIVITY_MPU].bursts() + activity[ACTIVITY_MOTOR].bursts();
+      stats.pretrigger = pretrigger_queued;
+      perf_sampling_tick(overruns, stats);
+    }
+
+    uint32_t now_us = micros();
+    uint32_t idle_us = scheduler_idle_us(tasks, task_count, now_us);
+    if (idle_us >= 1000)
+    {
+      vTaskDelay(pdMS_TO_TICKS(idle_us / 1000));
+    }
+    else if (idle_us > 0)
+    {
+      delayMicroseconds(idle_us);
+    }
+
+    // jitter: how far the wake-up landed from the deadline, either way
+    if (PERF_METRICS && idle_us > 0)
+    {
+      int32_t error_us = (int32_t)(micros() - (now_us + idle_us));
+      perf_record(PERF_JITTER, (uint32_t)abs(error_us) * cycles_per_us);
+    }
   }
 }
 
-void loop()
+// One low-power wake-up: read every sensor once, buffer the sample in RTC
+// memory, flush when the buffer is full (or on a flame edge), sleep.
+void low_power_cycle()
 {
-  if (!client.connected())
-  {
-    reconnect();
-  }
-  client.loop();
-
-  long now = millis();
-
-  if (now - lastMsg > 1000)
-  {
-    lastMsg = now;
-
-    // if (mpu.getMotionInterruptStatus())
-    // {
-    //   get_mpu_data();
-    // }
-    get_mpu_data();
-    get_flame_data();
-    get_gas_data();
-    get_dht_data();
-    get_motor_current_data();
-
-    char msg[256];
-    snprintf(msg, 256,
-             "{\"acceleration_x\":%d,\"acceleration_y\":%d,\"acceleration_z\":%d,"
-             "\"gyro_x\":%d,\"gyro_y\":%d,\"gyro_z\":%d,"
-             "\"temperature\":%d,"
-             "\"flame_status\":%d,"
-             "\"gas_level\":%d,"
-             "\"temperature_out\":%.2f,"
-             "\"humidity_out\":%.2f,"
-             "\"motor_adc\":%d"
-             "}",
-             acceleration_x, acceleration_y, acceleration_z,
-             gyro_x, gyro_y, gyro_z,
-             temperature,
-             flame_status,
-             gas_level,
-             dht_temperature,
-             dht_humidity,
-             motor_adc_value);
-
-    if (DEBUG)
-    {
-      Serial.print("Sending JSON: ");
-      Serial.println(msg);
-    }
+  RTC_DATA_ATTR static int8_t last_flame_status = -1;
 
-    client.publish(topic, msg);
+  if (mpu_ready)
+  {
+    mpu_motion_status(); // releases the latched INT used as wake source
+  }
+  dht.start(); // captured in the background while the other sensors are read
+  get_mpu_data();
+  get_flame_data();
+  get_gas_data();
+  get_motor_current_data();
+  while (dht.busy()) // poll() gives up after DHT22_FRAME_TIMEOUT_MS
+  {
+    vTaskDelay(1);
+    update_dht_reading();
+  }
+
+  TelemetrySample sample;
+  build_sample(sample);
+
+  TelemetryFrame frame;
+  encode_telemetry_binary(sample, frame);
+  size_t buffered = rtc_buffer_add(sample.timestamp_us, frame);
+
+  bool flame_edge = last_flame_status >= 0 && sample.flame_status != last_flame_status;
+  last_flame_status = sample.flame_status;
+  if (buffered >= LOW_POWER_FLUSH_SAMPLES || flame_edge)
+  {
+    rtc_buffer_flush();
+  }
+
+  low_power_sleep(MPU_INT_PIN);
+}
+
+void loop()
+{
+  if (LOW_POWER_MODE)
+  {
+    // only reached again after light sleep; deep sleep restarts in setup()
+    low_power_cycle();
+    return;
   }
+  // all work happens in sampling_task and network_task
+  vTaskDelete(nullptr);
 }
@@ -0,0 +1,285 @@
+#include "i2c_bus.h"
+#include "mpu_fifo.h"
+
+// --- MPU6050 registers ---
+#define REG_SMPLRT_DIV 0x19
+#define REG_CONFIG 0x1A
+#define REG_GYRO_CONFIG 0x1B
+#define REG_ACCEL_CONFIG 0x1C
+#define REG_MOT_THR 0x1F
+#define REG_MOT_DUR 0x20
+#define REG_FIFO_EN 0x23
+#define REG_INT_PIN_CFG 0x37
+#define REG_INT_ENABLE 0x38
+#define REG_INT_STATUS 0x3A
+#define REG_ACCEL_XOUT_H 0x3B
+#define REG_USER_CTRL 0x6A
+#define REG_PWR_MGMT_1 0x6B
+#define REG_FIFO_COUNTH 0x72
+#define REG_FIFO_R_W 0x74
+#define REG_WHO_AM_I 0x75
+
+#define FIFO_EN_ALL 0xF8 // TEMP, XG, YG, ZG, ACCEL
+#define INT_PIN_ACTIVE_LOW 0x80
+#define INT_PIN_LATCH 0x20
+#define INT_DATA_RDY 0x01
+#define INT_FIFO_OFLOW 0x10
+#define INT_MOTION 0x40
+#define USER_CTRL_FIFO_EN 0x40
+#define USER_CTRL_FIFO_RESET 0x04
+#define PWR_RESET 0x80
+#define PWR_CLOCK_PLL_GYRO_X 0x01
+#define WHO_AM_I_MPU6050 0x68
+
+// Ranges the MPU_*_LSB_* scales in mpu_fifo.h are for, and the motion
+// interrupt: 0.63 Hz high-pass, 2 mg threshold for 20 ms
+#define ACCEL_CONFIG_2G_HPF_0_63HZ 0x04
+#define GYRO_CONFIG_500DPS 0x08
+#define MOTION_THRESHOLD 1
+#define MOTION_DURATION_MS 20
+
+#define FIFO_SIZE 1024
+#define FRAME_BYTES 14 // accel, temp, gyro in register order
+// One bus transaction per chunk, short enough not to hold up other devices
+// on the bus for long; the driver has no per-transfer size limit
+#define CHUNK_FRAMES 32
+
+static_assert(I2C_WIRE_US(3 + CHUNK_FRAMES * FRAME_BYTES, MPU_I2C_CLOCK) < I2C_TIMEOUT_MS * 1000,
+              "a FIFO chunk must fit the default I2C timeout");
+
+SpscRing<MpuRawSample, MPU_SAMPLE_QUEUE_LEN> mpu_samples;
+
+volatile uint32_t mpu_fifo_overflows = 0;
+volatile bool mpu_motion_detected = false;
+
+static I2cDevice device;
+static TaskHandle_t mpu_task_handle = nullptr;
+static volatile uint32_t frames_since_wake = 0;
+static volatile uint16_t requested_rate_hz = MPU_FIFO_RATE_HZ;
+static uint16_t rate_hz = MPU_FIFO_RATE_HZ;
+static SemaphoreHandle_t rate_switched = nullptr; // given once requested_rate_hz is in effect
+static volatile bool rate_waiting = false;
+
+static bool write_register(uint8_t reg, uint8_t value)
+{
+  return device.write_register(reg, value);
+}
+
+static bool read_registers(uint8_t reg, uint8_t *buf, size_t len)
+{
+  return device.read_registers(reg, buf, len);
+}
+
+// Frames and the data registers share the ACCEL, TEMP, GYRO big-endian layout
+static void parse_frame(const uint8_t *f, MpuRawSample &sample)
+{
+  sample.ax = (int16_t)((f[0] << 8) | f[1]);
+  sample.ay = (int16_t)((f[2] << 8) | f[3]);
+  sample.az = (int16_t)((f[4] << 8) | f[5]);
+  sample.temp = (int16_t)((f[6] << 8) | f[7]);
+  sample.gx = (int16_t)((f[8] << 8) | f[9]);
+  sample.gy = (int16_t)((f[10] << 8) | f[11]);
+  sample.gz = (int16_t)((f[12] << 8) | f[13]);
+}
+
+bool mpu_read_raw(MpuRawSample &out)
+{
+  uint8_t buf[FRAME_BYTES];
+  if (!read_registers(REG_ACCEL_XOUT_H, buf, sizeof(buf)))
+  {
+    return false;
+  }
+  parse_frame(buf, out);
+  return true;
+}
+
+static void reset_fifo()
+{
+  write_register(REG_USER_CTRL, 0);
+  write_register(REG_USER_CTRL, USER_CTRL_FIFO_RESET);
+  write_register(REG_USER_CTRL, USER_CTRL_FIFO_EN);
+}
+
+// Data-ready fires once per sample; only every MPU_FIFO_BLOCK-th edge wakes the task.
+static void IRAM_ATTR mpu_int_isr()
+{
+  if (++frames_since_wake < MPU_FIFO_BLOCK)
+  {
+    return;
+  }
+  frames_since_wake = 0;
+
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(mpu_task_handle, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+static void drain_fifo()
+{
+  uint8_t status;
+  if (read_registers(REG_INT_STATUS, &status, 1))
+  {
+    if (status & INT_MOTION)
+    {
+      mpu_motion_detected = true;
+    }
+    if (status & INT_FIFO_OFLOW)
+    {
+      // the frame boundary is lost once the FIFO wraps
+      mpu_fifo_overflows++;
+      reset_fifo();
+      return;
+    }
+  }
+
+  uint8_t count_bytes[2];
+  if (!read_registers(REG_FIFO_COUNTH, count_bytes, 2))
+  {
+    return;
+  }
+  uint16_t frames = ((count_bytes[0] << 8) | count_bytes[1]) / FRAME_BYTES;
+
+  static uint8_t buf[CHUNK_FRAMES * FRAME_BYTES];
+  while (frames > 0)
+  {
+    uint8_t chunk = frames < CHUNK_FRAMES ? frames : CHUNK_FRAMES;
+    if (!read_registers(REG_FIFO_R_W, buf, chunk * FRAME_BYTES))
+    {
+      return;
+    }
+    for (uint8_t i = 0; i < chunk; i++)
+    {
+      MpuRawSample sample;
+      parse_frame(&buf[i * FRAME_BYTES], sample);
+      mpu_samples.push(sample);
+    }
+    frames -= chunk;
+  }
+}
+
+// DLPF_CFG 1 (184 Hz) at full rate, 3 (44 Hz) below 400 Hz so the reduced
+// rate does not alias; both keep the 1 kHz base the divider counts from.
+static bool write_rate(uint16_t hz)
+{
+  return write_register(REG_CONFIG, hz >= 400 ? 0x01 : 0x03) &&
+         write_register(REG_SMPLRT_DIV, 1000 / hz - 1);
+}
+
+// Ranges, clock and the motion interrupt (latched, active low: the
+// low-power wake-up source). Leaves the sample rate to write_rate().
+static bool configure_sensor()
+{
+  return write_register(REG_PWR_MGMT_1, PWR_CLOCK_PLL_GYRO_X) &&
+         write_register(REG_ACCEL_CONFIG, ACCEL_CONFIG_2G_HPF_0_63HZ) &&
+         write_register(REG_GYRO_CONFIG, GYRO_CONFIG_500DPS) &&
+         write_register(REG_MOT_THR, MOTION_THRESHOLD) &&
+         write_register(REG_MOT_DUR, MOTION_DURATION_MS) &&
+         write_register(REG_INT_PIN_CFG, INT_PIN_ACTIVE_LOW | INT_PIN_LATCH) &&
+         write_register(REG_INT_ENABLE, INT_MOTION);
+}
+
+static bool configure_fifo()
+{
+  bool ok = write_rate(rate_hz) &&
+            // INT pulses active low, so each data-ready edge is seen
+            write_register(REG_INT_PIN_CFG, INT_PIN_ACTIVE_LOW) &&
+            write_register(REG_INT_ENABLE, INT_DATA_RDY | INT_FIFO_OFLOW | INT_MOTION) &&
+            write_register(REG_FIFO_EN, FIFO_EN_ALL);
+  if (ok)
+  {
+    reset_fifo();
+  }
+  return ok;
+}
+
+static void mpu_fifo_task(void *arg)
+{
+  uint32_t recoveries = i2c_bus_stats().recoveries;
+  for (;;)
+  {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MPU_FIFO_TIMEOUT_MS));
+
+    // A recovery may have cut a FIFO read short (the frame boundary is
+    // lost) or followed a brown-out of the chip: set it up again.
+    if (i2c_bus_stats().recoveries != recoveries)
+    {
+      recoveries = i2c_bus_stats().recoveries;
+      configure_sensor() && configure_fifo();
+      continue;
+    }
+    drain_fifo();
+
+    uint16_t hz = requested_rate_hz;
+    if (hz != rate_hz && write_rate(hz))
+    {
+      rate_hz = hz;
+      reset_fifo(); // nothing at the old rate is left behind in the chip
+    }
+    if (rate_waiting && hz == rate_hz)
+    {
+      rate_waiting = false;
+      xSemaphoreGive(rate_switched);
+    }
+  }
+}
+
+bool mpu_fifo_set_rate(uint16_t hz)
+{
+  if (hz == 0 || hz > 1000 || mpu_task_handle == nullptr)
+  {
+    return false;
+  }
+  xSemaphoreTake(rate_switched, 0); // from a switch that timed out
+  requested_rate_hz = hz;
+  rate_waiting = true;
+  xTaskNotifyGive(mpu_task_handle);
+  return xSemaphoreTake(rate_switched, pdMS_TO_TICKS(MPU_FIFO_SWITCH_TIMEOUT_MS)) == pdTRUE;
+}
+
+bool mpu_begin()
+{
+  uint8_t id = 0;
+  if (!device.begin(MPU6050_ADDR, MPU_I2C_CLOCK) || !read_registers(REG_WHO_AM_I, &id, 1) ||
+      id != WHO_AM_I_MPU6050)
+  {
+    return false;
+  }
+  if (!write_register(REG_PWR_MGMT_1, PWR_RESET))
+  {
+    return false;
+  }
+  delay(100); // registers are back to defaults after this
+  return configure_sensor() && write_rate(rate_hz);
+}
+
+bool mpu_online()
+{
+  return device.online();
+}
+
+bool mpu_motion_status()
+{
+  uint8_t status = 0;
+  return read_registers(REG_INT_STATUS, &status, 1) && (status & INT_MOTION) != 0;
+}
+
+bool mpu_fifo_begin(uint8_t int_pin, BaseType_t core)
+{
+  // 1 kHz base rate needs the DLPF on (DLPF_CFG = 1 -> 184 Hz)
+  if (!configure_fifo())
+  {
+    return false;
+  }
+  rate_switched = xSemaphoreCreateBinary();
+  if (rate_switched == nullptr)
+  {
+    return false;
+  }
+
+  xTaskCreatePinnedToCore(mpu_fifo_task, "mpu_fifo", MPU_FIFO_TASK_STACK, nullptr,
+                          MPU_FIFO_TASK_PRIORITY, &mpu_task_handle, core);
+
+  pinMode(int_pin, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(int_pin), mpu_int_isr, FALLING);
+  return true;
+}
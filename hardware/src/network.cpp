@@ -0,0 +1,1065 @@
+#include <WiFi.h>
+#include <PubSubClient.h>
+#include <Preferences.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <stdarg.h>
+
+#include "secrets.h"
+#include "config.h"
+
+#define LOG_MODULE "net"
+#define LOG_MODULE_LEVEL LOG_LEVEL_NET
+#include "log.h"
+
+#include "batch_codec.h"
+#include "clock.h"
+#include "device_id.h"
+#include "flame.h"
+#include "frame_batcher.h"
+#include "frame_pool.h"
+#include "journal.h"
+#include "network.h"
+#include "ota.h"
+#include "perf.h"
+#include "runtime_config.h"
+#include "telemetry.h"
+#include "tls_client.h"
+
+// --- WiFi and MQTT Variables ---
+const char *ssid = WIFI_SSID;
+const char *password = WIFI_PASSWORD;
+const char *mqtt_server = MQTT_SERVER_IP;
+
+// sensor/<device_id>/..., see device_id.h
+char topic[DEVICE_TOPIC_MAX];
+char binary_topic[DEVICE_TOPIC_MAX];
+char batch_topic[DEVICE_TOPIC_MAX];
+char vibration_topic[DEVICE_TOPIC_MAX];
+char alarm_topic[DEVICE_TOPIC_MAX];
+char status_topic[DEVICE_TOPIC_MAX];
+char diag_topic[DEVICE_TOPIC_MAX];
+char perf_topic[DEVICE_TOPIC_MAX];
+char ack_topic[DEVICE_TOPIC_MAX];
+// runtime_config.h
+char config_topic[DEVICE_TOPIC_MAX];
+char config_binary_topic[DEVICE_TOPIC_MAX];
+char config_state_topic[DEVICE_TOPIC_MAX];
+char config_error_topic[DEVICE_TOPIC_MAX];
+// ota.h
+char ota_topic[DEVICE_TOPIC_MAX];
+char ota_data_topic[DEVICE_TOPIC_MAX];
+char ota_request_topic[DEVICE_TOPIC_MAX];
+char ota_state_topic[DEVICE_TOPIC_MAX];
+
+uint32_t wifi_reconnects = 0;
+uint32_t mqtt_reconnects = 0;
+
+struct BootTiming
+{
+  uint32_t wifi_ms; // millis() since reset when associated
+  uint32_t mqtt_ms; // ... when the broker accepted the first connect
+  bool fast_path;   // the cached association was used
+};
+BootTiming boot_timing = {};
+
+WiFiClient plain_client;
+TlsClient tls_client;
+Client &transport = MQTT_TLS ? (Client &)tls_client : (Client &)plain_client;
+PubSubClient client(transport);
+FrameBatcher batcher;
+FrameBatcher replay_batcher;
+bool journal_ready = false;
+
+typedef FramePool<FRAME_POOL_SIZE, FRAME_POOL_FRAME_BYTES> NetworkFramePool;
+typedef NetworkFramePool::Lease FrameLease;
+static NetworkFramePool frame_pool;
+static_assert(PERF_JSON_MAX <= FRAME_POOL_FRAME_BYTES, "perf report must fit a pool frame");
+static_assert(RUNTIME_CONFIG_JSON_MAX <= FRAME_POOL_FRAME_BYTES, "settings must fit a pool frame");
+// an ota/data message: fixed header, topic, packet ID, offset, chunk
+static_assert(5 + 2 + DEVICE_TOPIC_MAX + 2 + 4 + OTA_CHUNK_BYTES <= MQTT_BUFFER_SIZE,
+              "OTA chunks must fit the MQTT buffer");
+static_assert(sizeof(OtaManifest) + DEVICE_TOPIC_MAX + 9 <= MQTT_BUFFER_SIZE,
+              "the OTA manifest must fit the MQTT buffer");
+
+// the queue head stays queued until every enabled path has taken it
+static bool head_batched = false;
+
+// Replay frame waiting for its ack echo
+struct ReplayState
+{
+  bool in_flight;
+  uint32_t seq;  // last journal sequence number in the frame
+  uint32_t span; // journal slots it covers
+  uint32_t sent_ms;
+};
+static ReplayState replay = {};
+
+// Head of flame_events waiting for its ack echo, and the latencies since
+// the last perf report
+struct FlameAlarmState
+{
+  bool in_flight;
+  bool resend;
+  uint32_t sent_ms;
+};
+static FlameAlarmState flame_alarm = {};
+static PerfNetworkStats flame_stats = {};
+
+// Reply to the last config message, sent from publish_pending() since the
+// message callback runs inside client.loop()
+struct ConfigReply
+{
+  bool state_pending; // publish the settings in effect
+  bool error_pending;
+  char error[96];
+};
+static ConfigReply config_reply = {};
+
+// ota_state_version() last published on ota_state_topic
+static uint32_t ota_state_sent = 0;
+static bool ota_state_resend = false; // after connect
+
+void spill_to_journal();
+
+// Streams the payload to the socket from where it lies, without the copy
+// into the PubSubClient buffer that publish() makes. Timed as PERF_PUBLISH.
+static bool mqtt_publish(const char *topic_name, const uint8_t *payload, size_t len,
+                         bool retained = false)
+{
+  uint32_t start = perf_cycles();
+  bool ok = client.beginPublish(topic_name, len, retained);
+  if (ok && client.write(payload, len) != len)
+  {
+    // half a packet is on the wire; only a new connection recovers
+    transport.stop();
+    ok = false;
+  }
+  ok = ok && client.endPublish() == 1;
+  perf_record_since(PERF_PUBLISH, start);
+  return ok;
+}
+
+static bool mqtt_publish(const char *topic_name, const char *payload)
+{
+  return mqtt_publish(topic_name, (const uint8_t *)payload, strlen(payload));
+}
+
+static bool mqtt_publish(const char *topic_name, const NetworkFramePool::Frame *frame,
+                         bool retained = false)
+{
+  return mqtt_publish(topic_name, frame->data, frame->len, retained);
+}
+
+// snprintf into a pool frame; false (frame empty) if it did not fit
+static bool format_frame(NetworkFramePool::Frame *frame, const char *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  int len = vsnprintf(frame->text(), frame->capacity, fmt, args);
+  va_end(args);
+  frame->len = len > 0 && (size_t)len < frame->capacity ? len : 0;
+  return frame->len > 0;
+}
+
+static const uint8_t frame_fields[] = {TELEMETRY_FRAME_FIELDS};
+static const uint8_t replay_fields[] = {TELEMETRY_REPLAY_FIELDS};
+
+// A batch frame on batch_topic, compressed into a pool frame when that
+// makes it smaller, otherwise sent straight from the batcher buffer
+static bool publish_batch_frame(const uint8_t *data, size_t len)
+{
+  FrameLease compressed(frame_pool);
+  if (TELEMETRY_BATCH_COMPRESSION && compressed)
+  {
+    uint32_t start = perf_cycles();
+    if (data[0] == TELEMETRY_BATCH_VERSION)
+    {
+      compressed->len = batch_compress(data, len, frame_fields, sizeof(frame_fields),
+                                       compressed->data, compressed->capacity);
+    }
+    else if (data[0] == TELEMETRY_REPLAY_BATCH_VERSION)
+    {
+      compressed->len = batch_compress(data, len, replay_fields, sizeof(replay_fields),
+                                       compressed->data, compressed->capacity);
+    }
+    perf_record_since(PERF_COMPRESS, start);
+  }
+  if (compressed && compressed->len > 0)
+  {
+    LOG_TRACE("Batch compressed %u -> %u bytes", (unsigned)len, (unsigned)compressed->len);
+    return mqtt_publish(batch_topic, compressed.get());
+  }
+  return mqtt_publish(batch_topic, data, len);
+}
+
+static bool wait_connected(uint32_t timeout_ms)
+{
+  uint32_t start = millis();
+  while (WiFi.status() != WL_CONNECTED)
+  {
+    if (millis() - start > timeout_ms)
+    {
+      return false;
+    }
+    delay(5);
+  }
+  return true;
+}
+
+bool wifi_connect_fast(WifiCache &cache, uint32_t timeout_ms)
+{
+  WiFi.persistent(false);
+  WiFi.mode(WIFI_STA);
+
+  if (cache.magic == WIFI_CACHE_MAGIC)
+  {
+    WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.subnet),
+                IPAddress(cache.dns));
+    WiFi.begin(ssid, password, cache.channel, cache.bssid);
+    if (wait_connected(timeout_ms))
+    {
+      return true;
+    }
+
+    // AP moved or lease changed: forget it and do the slow path once
+    LOG_WARN("Cached WiFi association failed, full connect");
+    cache.magic = 0;
+    WiFi.disconnect();
+    WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+  }
+
+  WiFi.begin(ssid, password);
+  if (!wait_connected(timeout_ms))
+  {
+    return false;
+  }
+
+  memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+  cache.channel = WiFi.channel();
+  cache.ip = WiFi.localIP();
+  cache.gateway = WiFi.gatewayIP();
+  cache.subnet = WiFi.subnetMask();
+  cache.dns = WiFi.dnsIP();
+  cache.magic = WIFI_CACHE_MAGIC;
+  return true;
+}
+
+void wifi_cache_load(WifiCache &cache)
+{
+  memset(&cache, 0, sizeof(cache));
+  Preferences prefs;
+  if (prefs.begin(WIFI_CACHE_NVS_NAMESPACE, true))
+  {
+    if (prefs.getBytes("cache", &cache, sizeof(cache)) != sizeof(cache))
+    {
+      memset(&cache, 0, sizeof(cache));
+    }
+    prefs.end();
+  }
+}
+
+void wifi_cache_save(const WifiCache &cache)
+{
+  Preferences prefs;
+  if (prefs.begin(WIFI_CACHE_NVS_NAMESPACE, false))
+  {
+    prefs.putBytes("cache", &cache, sizeof(cache));
+    prefs.end();
+  }
+}
+
+void build_topics()
+{
+  device_id_begin();
+  device_topic(topic, sizeof(topic), "telemetry");
+  device_topic(binary_topic, sizeof(binary_topic), "telemetry/bin");
+  device_topic(batch_topic, sizeof(batch_topic), "telemetry/batch");
+  device_topic(vibration_topic, sizeof(vibration_topic), "vibration");
+  device_topic(alarm_topic, sizeof(alarm_topic), "alarm");
+  device_topic(status_topic, sizeof(status_topic), "status");
+  device_topic(diag_topic, sizeof(diag_topic), "diag");
+  device_topic(perf_topic, sizeof(perf_topic), "diag/perf");
+  device_topic(ack_topic, sizeof(ack_topic), "diag/ack");
+  device_topic(config_topic, sizeof(config_topic), "config");
+  device_topic(config_binary_topic, sizeof(config_binary_topic), "config/bin");
+  device_topic(config_state_topic, sizeof(config_state_topic), "config/state");
+  device_topic(config_error_topic, sizeof(config_error_topic), "config/error");
+  device_topic(ota_topic, sizeof(ota_topic), "ota");
+  device_topic(ota_data_topic, sizeof(ota_data_topic), "ota/data");
+  device_topic(ota_request_topic, sizeof(ota_request_topic), "ota/req");
+  device_topic(ota_state_topic, sizeof(ota_state_topic), "ota/state");
+}
+
+void setup_wifi()
+{
+  LOG_INFO("Connecting to WiFi: %s", ssid);
+
+  WifiCache cache;
+  wifi_cache_load(cache);
+  WifiCache loaded = cache;
+
+  // Only this task waits here; sampling keeps running on the other core.
+  while (!wifi_connect_fast(cache, WIFI_CONNECT_TIMEOUT_MS))
+  {
+    LOG_DEBUG("WiFi not connected yet, retrying");
+    spill_to_journal();
+  }
+  boot_timing.wifi_ms = millis();
+
+  // the cache is only rewritten if the association or lease changed
+  boot_timing.fast_path = loaded.magic == WIFI_CACHE_MAGIC && memcmp(&loaded, &cache, sizeof(cache)) == 0;
+  if (!boot_timing.fast_path)
+  {
+    wifi_cache_save(cache);
+  }
+
+  clock_begin();
+
+  IPAddress ip = WiFi.localIP();
+  LOG_INFO("WiFi connected%s, ESP32 IP Address: %u.%u.%u.%u",
+           boot_timing.fast_path ? " (cached association)" : "", ip[0], ip[1], ip[2], ip[3]);
+}
+
+// Retained on the status topic: the birth message on every connect, and
+// the will the broker publishes for us if the connection drops
+static const char *status_will = "{\"state\":\"" DEVICE_STATUS_OFFLINE "\"}";
+
+bool publish_status(const char *state)
+{
+  FrameLease frame(frame_pool);
+  IPAddress ip = WiFi.localIP();
+  return frame &&
+         format_frame(frame.get(),
+                      "{\"state\":\"%s\",\"client_id\":\"%s\",\"ip\":\"%u.%u.%u.%u\",\"schema\":%u,"
+                      "\"firmware\":\"%s\"}",
+                      state, device_client_id(), ip[0], ip[1], ip[2], ip[3],
+                      TELEMETRY_SCHEMA_VERSION, FIRMWARE_VERSION) &&
+         mqtt_publish(status_topic, frame.get(), true);
+}
+
+// Once per boot; the TLS context is kept across reconnects
+void setup_mqtt()
+{
+  if (MQTT_TLS && !tls_client.begin(MQTT_CA_CERT, MQTT_CLIENT_CERT, MQTT_CLIENT_KEY, MQTT_SERVER_NAME))
+  {
+    LOG_ERROR("Bad CA, certificate or key in secrets.h, MQTT will not connect");
+  }
+  client.setServer(mqtt_server, MQTT_PORT);
+  client.setBufferSize(MQTT_BUFFER_SIZE);
+}
+
+bool reconnect()
+{
+  LOG_INFO("Connecting to MQTT as %s...", device_client_id());
+  // Unique per-device ID; a persistent session keeps QoS 1 subscriptions
+  // and their queued messages across reconnects.
+  if (client.connect(device_client_id(), nullptr, nullptr, status_topic, 1, true, status_will,
+                     MQTT_CLEAN_SESSION))
+  {
+    LOG_INFO("connected!");
+    if (!publish_status(DEVICE_STATUS_ONLINE))
+    {
+      LOG_WARN("Birth message not sent");
+    }
+    client.subscribe(ack_topic);
+    client.subscribe(config_topic, 1);
+    client.subscribe(config_binary_topic, 1);
+    client.subscribe(ota_topic, 1);
+    client.subscribe(ota_data_topic, 1);
+    config_reply.state_pending = true;
+    ota_state_resend = true;
+    replay.in_flight = false; // an echo in flight died with the old session
+    flame_alarm.in_flight = false;
+    if (boot_timing.mqtt_ms == 0)
+    {
+      boot_timing.mqtt_ms = millis();
+      perf_heap_baseline(); // WiFi, lwIP and the MQTT client are all set up now
+    }
+    else
+    {
+      mqtt_reconnects++;
+    }
+    return true;
+  }
+
+  LOG_WARN("error, rc=%d trying again in %d seconds", client.state(), MQTT_RETRY_MS / 1000);
+  return false;
+}
+
+// Time from reset to the first publish, sent once as the first message
+// after boot so it does not wait behind any backlog.
+bool publish_boot_report()
+{
+  static bool sent = false;
+  if (sent)
+  {
+    return true;
+  }
+
+  FrameLease frame(frame_pool);
+  uint32_t first_publish_ms = millis();
+  if (!frame ||
+      !format_frame(frame.get(),
+                    "{\"client_id\":\"%s\",\"reset_reason\":%d,\"wifi_fast_path\":%s,"
+                    "\"wifi_ms\":%lu,\"tls_ms\":%lu,\"tls_resumed\":%s,\"mqtt_ms\":%lu,"
+                    "\"first_publish_ms\":%lu}",
+                    device_client_id(), (int)esp_reset_reason(),
+                    boot_timing.fast_path ? "true" : "false", (unsigned long)boot_timing.wifi_ms,
+                    (unsigned long)tls_client.stats().last_ms,
+                    tls_client.stats().last_resumed ? "true" : "false",
+                    (unsigned long)boot_timing.mqtt_ms, (unsigned long)first_publish_ms) ||
+      !mqtt_publish(diag_topic, frame.get()))
+  {
+    return false;
+  }
+  LOG_INFO("Boot report: %.*s", (int)frame->len, frame->text());
+  sent = true;
+  return true;
+}
+
+// Settings in effect (retained) after connect or an accepted update, or
+// the reason an update was rejected.
+bool publish_config_reply()
+{
+  FrameLease frame(frame_pool);
+  if (!frame)
+  {
+    return false;
+  }
+  if (config_reply.error_pending)
+  {
+    // the error quotes the offending key from the update
+    char error[2 * sizeof(config_reply.error)];
+    json_escape(config_reply.error, error, sizeof(error));
+    if (format_frame(frame.get(), "{\"error\":\"%s\"}", error) &&
+        !mqtt_publish(config_error_topic, frame.get()))
+    {
+      return false;
+    }
+    config_reply.error_pending = false;
+  }
+  if (config_reply.state_pending)
+  {
+    frame->len = settings_format_json(runtime_config(), frame->text(), frame->capacity);
+    if (frame->len > 0 && !mqtt_publish(config_state_topic, frame.get(), true))
+    {
+      return false;
+    }
+    config_reply.state_pending = false;
+  }
+  return true;
+}
+
+// Flame edges go out before anything else. Like journal replays they are
+// confirmed by a token on ack_topic ("f<seq>") behind the alarm, and resent
+// until it comes back, since PubSubClient only publishes at QoS 0. The
+// dashboard drops repeats by seq.
+bool publish_flame_alarm()
+{
+  FlameEvent *event = flame_events.peek();
+  if (event == nullptr)
+  {
+    return true;
+  }
+  uint32_t now = millis();
+  if (flame_alarm.in_flight)
+  {
+    if (now - flame_alarm.sent_ms < FLAME_ACK_TIMEOUT_MS)
+    {
+      return true;
+    }
+    LOG_WARN("No ack for flame alarm %lu, resending", (unsigned long)event->seq);
+    flame_alarm.in_flight = false;
+    flame_alarm.resend = true;
+    flame_stats.flame_resends++;
+  }
+
+  FrameLease frame(frame_pool);
+  if (!frame)
+  {
+    return false;
+  }
+  AlarmEvent alarm;
+  alarm.timestamp_us = event->timestamp_us;
+  alarm.type = ALARM_FLAME;
+  alarm.active = event->active;
+  alarm.value = event->active;
+  alarm.channel = ANOMALY_GAS; // unused for threshold alarms
+  alarm.score = 0;
+  alarm.seq = event->seq;
+  frame->len = format_alarm_json(alarm, frame->text(), frame->capacity);
+  if (frame->len == 0)
+  {
+    // would not fit on a resend either: without the token it never clears
+    LOG_ERROR("Flame alarm %lu over %u bytes, dropped", (unsigned long)event->seq,
+              (unsigned)frame->capacity);
+    flame_events.pop();
+    flame_alarm = {};
+    return true;
+  }
+
+  char token[12];
+  snprintf(token, sizeof(token), "f%lu", (unsigned long)event->seq);
+  if (!mqtt_publish(alarm_topic, frame.get()) || !mqtt_publish(ack_topic, token))
+  {
+    return false;
+  }
+  uint32_t latency_us = (uint32_t)(esp_timer_get_time() - event->edge_us);
+  if (!flame_alarm.resend && latency_us > flame_stats.flame_publish_us)
+  {
+    flame_stats.flame_publish_us = latency_us;
+  }
+  flame_alarm.in_flight = true;
+  flame_alarm.sent_ms = now;
+  LOG_INFO("Sent flame alarm %lu, %lu us after the edge", (unsigned long)event->seq,
+           (unsigned long)latency_us);
+  return true;
+}
+
+// The broker echoed the token: the alarm before it was delivered
+void handle_flame_ack(uint32_t seq)
+{
+  FlameEvent *event = flame_events.peek();
+  if (!flame_alarm.in_flight || event == nullptr || event->seq != seq)
+  {
+    return;
+  }
+  uint32_t latency_us = (uint32_t)(esp_timer_get_time() - event->edge_us);
+  if (latency_us > flame_stats.flame_ack_us)
+  {
+    flame_stats.flame_ack_us = latency_us;
+  }
+  flame_stats.flame_alarms++;
+  flame_events.pop();
+  flame_alarm = {};
+}
+
+// Alarm edges skip every queue, batch and heartbeat.
+bool publish_alarms()
+{
+  AlarmEvent *event;
+  while ((event = alarm_queue.peek()) != nullptr)
+  {
+    FrameLease frame(frame_pool);
+    if (!frame)
+    {
+      return false;
+    }
+    uint32_t start = perf_cycles();
+    frame->len = format_alarm_json(*event, frame->text(), frame->capacity);
+    perf_record_since(PERF_JSON, start);
+    if (frame->len > 0 && !mqtt_publish(alarm_topic, frame.get()))
+    {
+      return false;
+    }
+    if (frame->len == 0)
+    {
+      LOG_ERROR("Alarm JSON over %u bytes, dropped", (unsigned)frame->capacity);
+    }
+    else
+    {
+      LOG_INFO("Sent alarm: %.*s", (int)frame->len, frame->text());
+    }
+    alarm_queue.pop();
+  }
+  return true;
+}
+
+// Vibration frames are rare and small in number, send them first.
+bool publish_vibration()
+{
+  VibrationFeatures *features;
+  while ((features = vibration_queue.peek()) != nullptr)
+  {
+    FrameLease frame(frame_pool);
+    if (!frame)
+    {
+      return false;
+    }
+    uint32_t start = perf_cycles();
+    frame->len = format_vibration_json(*features, frame->text(), frame->capacity);
+    perf_record_since(PERF_JSON, start);
+    if (frame->len > 0 && !mqtt_publish(vibration_topic, frame.get()))
+    {
+      return false;
+    }
+    vibration_queue.pop();
+  }
+  return true;
+}
+
+// Timing and health since the last report, every PERF_REPORT_INTERVAL_MS.
+// The network stages restart when the report is formatted, even if the
+// publish then fails.
+bool publish_perf_report()
+{
+  PerfSnapshot *snapshot = perf_snapshots.peek();
+  if (snapshot == nullptr)
+  {
+    return true;
+  }
+  FrameLease frame(frame_pool);
+  if (!frame)
+  {
+    return false;
+  }
+  PerfNetworkStats net = flame_stats;
+  net.rssi = (int8_t)WiFi.RSSI();
+  net.wifi_reconnects = wifi_reconnects;
+  net.mqtt_reconnects = mqtt_reconnects;
+  net.frames_peak = (uint8_t)frame_pool.peak();
+  net.frames_exhausted = frame_pool.exhausted();
+  const TlsStats &tls = tls_client.stats();
+  net.tls_handshakes = tls.handshakes;
+  net.tls_resumed = tls.resumed;
+  net.tls_failures = tls.failures;
+  net.tls_last_ms = tls.last_ms;
+  frame->len = perf_format_json(*snapshot, net, frame->text(), PERF_JSON_MAX);
+  flame_stats = {};
+  if (frame->len > 0 && !mqtt_publish(perf_topic, frame.get()))
+  {
+    return false;
+  }
+  if (frame->len == 0)
+  {
+    LOG_WARN("Perf report over %u bytes, dropped", (unsigned)PERF_JSON_MAX);
+  }
+  perf_snapshots.pop();
+  return true;
+}
+
+// Sends one sample on every enabled per-sample topic.
+bool publish_sample(const TelemetrySample &sample)
+{
+  if (TELEMETRY_PUBLISH_BINARY)
+  {
+    TelemetryFrame frame;
+    size_t len = encode_telemetry_binary(sample, frame);
+    if (!mqtt_publish(binary_topic, (const uint8_t *)&frame, len))
+    {
+      return false;
+    }
+  }
+  if (TELEMETRY_PUBLISH_JSON)
+  {
+    FrameLease frame(frame_pool);
+    if (!frame)
+    {
+      return false;
+    }
+    uint32_t start = perf_cycles();
+    frame->len = format_telemetry_json(sample, frame->text(), frame->capacity);
+    perf_record_since(PERF_JSON, start);
+    if (frame->len > 0 && !mqtt_publish(topic, frame.get()))
+    {
+      return false;
+    }
+    if (frame->len == 0)
+    {
+      LOG_WARN("Telemetry JSON over %u bytes, dropped", (unsigned)frame->capacity);
+    }
+    else
+    {
+      LOG_DEBUG("Sent JSON: %.*s", (int)frame->len, frame->text());
+    }
+  }
+  if (TELEMETRY_PUBLISH_BINARY || TELEMETRY_PUBLISH_JSON)
+  {
+    ota_publish_succeeded();
+  }
+  return true;
+}
+
+bool flush_batch()
+{
+  if (batcher.empty())
+  {
+    return true;
+  }
+  batcher.set_epoch_offset(clock_epoch_offset_us());
+  if (!publish_batch_frame(batcher.data(), batcher.size()))
+  {
+    return false;
+  }
+  LOG_DEBUG("Sent batch: %u samples, %u bytes", batcher.count(), (unsigned)batcher.size());
+  batcher.clear();
+  ota_publish_succeeded();
+  return true;
+}
+
+// Link is down: move queued samples to flash rather than letting the RAM
+// queue overflow. Without a journal partition they just stay queued.
+void spill_to_journal()
+{
+  if (!journal_ready)
+  {
+    return;
+  }
+  while (telemetry_queue.peek() != nullptr)
+  {
+    // a head that already sits in the open batch goes out with it
+    if (!head_batched && !journal_append(*telemetry_queue.peek()))
+    {
+      LOG_WARN("Journal write failed, keeping samples in RAM");
+      return;
+    }
+    telemetry_queue.pop();
+    head_batched = false;
+  }
+}
+
+// Resolves the UTC offset of a journalled record: captured before the first
+// SNTP sync, the current offset still applies if it is from this boot.
+static int64_t replay_epoch_offset(const JournalRecord &record)
+{
+  if (record.epoch_offset_us == 0 && record.boot_id == journal.boot_id())
+  {
+    return clock_epoch_offset_us();
+  }
+  return record.epoch_offset_us;
+}
+
+// Sends the oldest journalled records as one frame, then a token on
+// ack_topic, which we are subscribed to. PubSubClient only publishes at
+// QoS 0, but the broker handles a connection in order: once the token comes
+// back, the frame before it was accepted and the records are truncated.
+void replay_journal()
+{
+  static JournalEntry entries[JOURNAL_REPLAY_BATCH];
+
+  if (!journal_ready || journal.pending() == 0)
+  {
+    return;
+  }
+  uint32_t now = millis();
+  if (replay.in_flight)
+  {
+    if (now - replay.sent_ms < JOURNAL_ACK_TIMEOUT_MS)
+    {
+      return;
+    }
+    LOG_WARN("No ack for journal seq %lu, resending", (unsigned long)replay.seq);
+    replay.in_flight = false;
+  }
+  if (now - replay.sent_ms < JOURNAL_REPLAY_INTERVAL_MS)
+  {
+    return;
+  }
+
+  size_t count = journal.read_pending(entries, JOURNAL_REPLAY_BATCH);
+  if (count == 0)
+  {
+    // nothing but corrupt slots left
+    journal.consume(journal.pending());
+    return;
+  }
+
+  // one frame carries one UTC offset and increasing timestamps
+  replay_batcher.clear();
+  int64_t frame_offset = replay_epoch_offset(entries[0].record);
+  uint32_t span = 0, seq = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    const JournalRecord &record = entries[i].record;
+    if (replay_epoch_offset(record) != frame_offset)
+    {
+      break;
+    }
+    if (record.len == sizeof(TelemetryFrame))
+    {
+      ReplayRecord out;
+      out.seq = record.seq;
+      memcpy(&out.frame, record.payload, sizeof(out.frame));
+      if (!replay_batcher.append(record.timestamp_us, &out, sizeof(out)))
+      {
+        break;
+      }
+    }
+    span = entries[i].span;
+    seq = record.seq;
+  }
+  replay_batcher.set_epoch_offset(frame_offset);
+
+  char token[12];
+  snprintf(token, sizeof(token), "%lu", (unsigned long)seq);
+  if ((!replay_batcher.empty() && !publish_batch_frame(replay_batcher.data(), replay_batcher.size())) ||
+      !mqtt_publish(ack_topic, token))
+  {
+    return;
+  }
+  replay = {true, seq, span, now};
+  LOG_DEBUG("Replayed %u journal records up to seq %lu, %lu pending", replay_batcher.count(),
+            (unsigned long)seq, (unsigned long)journal.pending());
+}
+
+void handle_config_message(const uint8_t *payload, unsigned int length, bool binary)
+{
+  if (!runtime_config_update(payload, length, binary, config_reply.error, sizeof(config_reply.error)))
+  {
+    LOG_WARN("Rejected config update: %s", config_reply.error);
+    config_reply.error_pending = true;
+    return;
+  }
+  // the batcher is ours, the rest is applied by the sampling task
+  const Settings &settings = runtime_config();
+  batcher.set_limits(settings.batch_max_samples, settings.batch_max_age_ms);
+  config_reply.state_pending = true;
+  LOG_INFO("Accepted config update");
+}
+
+// The update state when it changed (retained), then the next chunk
+// request if one is due. While telemetry is queued the download waits.
+bool publish_ota()
+{
+  uint32_t version = ota_state_version();
+  if (version != ota_state_sent || ota_state_resend)
+  {
+    FrameLease frame(frame_pool);
+    if (!frame)
+    {
+      return false;
+    }
+    frame->len = ota_format_state(frame->text(), frame->capacity);
+    if (frame->len > 0 && !mqtt_publish(ota_state_topic, frame.get(), true))
+    {
+      return false;
+    }
+    ota_state_sent = version;
+    ota_state_resend = false;
+  }
+
+  OtaRequest request;
+  if (!ota_poll(millis(), telemetry_queue.size() > PUBLISH_BURST, request))
+  {
+    return true;
+  }
+  uint8_t payload[8];
+  memcpy(payload, &request.offset, 4);
+  memcpy(payload + 4, &request.len, 4);
+  return mqtt_publish(ota_request_topic, payload, sizeof(payload)); // resent on timeout
+}
+
+void on_mqtt_message(char *topic_name, uint8_t *payload, unsigned int length)
+{
+  if (strcmp(topic_name, ota_data_topic) == 0)
+  {
+    ota_handle_chunk(payload, length);
+    return;
+  }
+  if (strcmp(topic_name, ota_topic) == 0)
+  {
+    ota_handle_manifest(payload, length);
+    return;
+  }
+  if (strcmp(topic_name, config_topic) == 0 || strcmp(topic_name, config_binary_topic) == 0)
+  {
+    handle_config_message(payload, length, strcmp(topic_name, config_binary_topic) == 0);
+    return;
+  }
+  if (strcmp(topic_name, ack_topic) != 0)
+  {
+    return;
+  }
+  char text[12];
+  size_t len = length < sizeof(text) - 1 ? length : sizeof(text) - 1;
+  memcpy(text, payload, len);
+  text[len] = '\0';
+  if (text[0] == 'f')
+  {
+    handle_flame_ack(strtoul(text + 1, nullptr, 10));
+    return;
+  }
+  if (!replay.in_flight || strtoul(text, nullptr, 10) != replay.seq)
+  {
+    return;
+  }
+
+  journal.consume(replay.span);
+  replay.in_flight = false;
+  if (journal.pending() == 0)
+  {
+    LOG_INFO("Journal replay complete");
+  }
+}
+
+// Adds a sample to the open batch, flushing first if it is full.
+// Returns false if the sample could not be added.
+bool batch_sample(const TelemetrySample &sample)
+{
+  TelemetryFrame frame;
+  encode_telemetry_binary(sample, frame);
+  // an alarm edge goes out with this very frame
+  bool urgent = sample.alarm;
+
+  if (!batcher.append(sample.timestamp_us, &frame, sizeof(frame), urgent))
+  {
+    if (!flush_batch() ||
+        !batcher.append(sample.timestamp_us, &frame, sizeof(frame), urgent))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void publish_pending()
+{
+  if (!publish_flame_alarm() || !publish_boot_report() || !publish_alarms() || !publish_config_reply() || !publish_vibration() ||
+      !publish_perf_report())
+  {
+    return;
+  }
+
+  for (int i = 0; i < PUBLISH_BURST; i++)
+  {
+    // an edge that came in during the burst does not wait for its end
+    if (!publish_flame_alarm())
+    {
+      return;
+    }
+    TelemetrySample *sample = telemetry_queue.peek();
+    if (sample == nullptr)
+    {
+      break;
+    }
+
+    // keep the sample queued on failure, it is retried after reconnect
+    if (TELEMETRY_BATCHING)
+    {
+      if (!head_batched && !batch_sample(*sample))
+      {
+        return;
+      }
+      head_batched = true;
+      // While draining a backlog, age counts in sample time, so replayed
+      // samples still travel in full frames.
+      if (batcher.should_flush(sample->timestamp_us) && !flush_batch())
+      {
+        return;
+      }
+    }
+    if (!publish_sample(*sample))
+    {
+      return;
+    }
+    telemetry_queue.pop();
+    head_batched = false;
+  }
+
+  if (TELEMETRY_BATCHING && telemetry_queue.empty() && batcher.should_flush(clock_us()))
+  {
+    flush_batch();
+  }
+
+  // backlog last, rate limited, so live data is never held up by it
+  replay_journal();
+  publish_ota();
+}
+
+// Sleeps NETWORK_POLL_MS, or less if a flame edge comes in
+static void network_wait()
+{
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(NETWORK_POLL_MS));
+}
+
+void network_task(void *arg)
+{
+  flame_set_listener(xTaskGetCurrentTaskHandle());
+  journal_ready = journal_begin();
+  ota_begin();
+  build_topics();
+  setup_wifi();
+  setup_mqtt();
+  client.setCallback(on_mqtt_message);
+  batcher.begin(TELEMETRY_BATCH_VERSION, runtime_config().batch_max_samples,
+                runtime_config().batch_max_age_ms);
+  replay_batcher.begin(TELEMETRY_REPLAY_BATCH_VERSION, JOURNAL_REPLAY_BATCH, UINT32_MAX);
+
+  uint32_t attempt_ms = millis() - MQTT_RETRY_MS;
+  bool wifi_up = true; // setup_wifi() returned associated
+  for (;;)
+  {
+    if ((WiFi.status() == WL_CONNECTED) != wifi_up)
+    {
+      wifi_up = !wifi_up;
+      if (wifi_up)
+      {
+        wifi_reconnects++;
+      }
+    }
+    if (!wifi_up)
+    {
+      // the WiFi driver reconnects on its own, journal while waiting
+      spill_to_journal();
+      network_wait();
+      continue;
+    }
+
+    if (!client.connected())
+    {
+      spill_to_journal();
+      // a flame alarm waiting for the broker shortens the backoff
+      uint32_t backoff_ms = flame_events.empty() ? MQTT_RETRY_MS : FLAME_ACK_TIMEOUT_MS;
+      if (millis() - attempt_ms < backoff_ms)
+      {
+        network_wait();
+        continue;
+      }
+      attempt_ms = millis();
+      if (!reconnect())
+      {
+        continue;
+      }
+    }
+    client.loop();
+
+    publish_pending();
+    network_wait();
+  }
+}
+
+bool network_connect_once(WifiCache &cache, uint32_t timeout_ms)
+{
+  // RTC memory is empty after power-on, start from the NVS copy then
+  if (cache.magic != WIFI_CACHE_MAGIC)
+  {
+    wifi_cache_load(cache);
+  }
+  WifiCache loaded = cache;
+  if (!wifi_connect_fast(cache, timeout_ms))
+  {
+    return false;
+  }
+  if (memcmp(&loaded, &cache, sizeof(cache)) != 0)
+  {
+    wifi_cache_save(cache);
+  }
+  clock_begin(); // the RTC-held offset covers wake-ups that miss the reply
+  ota_begin();
+  build_topics();
+  setup_mqtt();
+  return reconnect();
+}
+
+bool network_publish_batch(const uint8_t *data, size_t len)
+{
+  if (!publish_batch_frame(data, len))
+  {
+    return false;
+  }
+  ota_publish_succeeded();
+  return true;
+}
+
+void network_shutdown()
+{
+  // a clean disconnect does not fire the will
+  if (client.connected())
+  {
+    publish_status(DEVICE_STATUS_SLEEP);
+  }
+  client.disconnect();
+  WiFi.disconnect(true);
+  WiFi.mode(WIFI_OFF);
+}
@@ -0,0 +1,509 @@
+#include <Preferences.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <mbedtls/pk.h>
+#include <mbedtls/sha256.h>
+#include <stdarg.h>
+
+#include "secrets.h"
+
+#define LOG_MODULE "ota"
+#define LOG_MODULE_LEVEL LOG_LEVEL_NET
+#include "log.h"
+
+#include "delta_patch.h"
+#include "ota.h"
+#include "telemetry.h"
+
+#define OTA_ERROR_MAX 64
+#define OTA_PROGRESS_STEPS 10 // state updates during a download
+
+// initArduino() marks the running image valid unless the application says
+// it confirms it itself, which ota_publish_succeeded() does
+extern "C" bool verifyRollbackLater()
+{
+  return true;
+}
+
+static OtaState state = OTA_IDLE;
+static uint32_t state_version = 0;
+static char error[OTA_ERROR_MAX];
+static char target[OTA_VERSION_MAX];      // version of the update in progress or the last one
+static char rolled_back[OTA_VERSION_MAX]; // an update that did not pass its trial
+
+static const esp_partition_t *running = nullptr;
+static const esp_partition_t *update = nullptr;
+static OtaManifest manifest;
+static OtaTransfer transfer;
+static DeltaPatcher patcher;
+static esp_ota_handle_t handle;
+static bool handle_open = false;
+static mbedtls_sha256_context sha;
+static uint32_t written = 0;
+static uint32_t progress_step = 0;
+static uint32_t reboot_at_ms = 0;
+
+static esp_timer_handle_t health_timer = nullptr;
+static bool bootloader_rollback = false; // the bootloader has this image pending verify
+
+// The update slot, written in order; hashed on the way for the signature
+class UpdateSink : public DeltaSink
+{
+public:
+  bool write(const void *src, size_t len) override
+  {
+    if (len > manifest.image_size - written || esp_ota_write(handle, src, len) != ESP_OK)
+    {
+      return false;
+    }
+    mbedtls_sha256_update_ret(&sha, (const unsigned char *)src, len);
+    written += len;
+    return true;
+  }
+};
+
+class RunningSource : public DeltaSource
+{
+public:
+  bool read(uint32_t offset, void *dst, size_t len) override
+  {
+    return esp_partition_read(running, offset, dst, len) == ESP_OK;
+  }
+};
+
+static UpdateSink sink;
+static RunningSource source;
+
+static void set_state(OtaState next)
+{
+  state = next;
+  state_version++;
+}
+
+// error says why
+static void abandon()
+{
+  if (handle_open)
+  {
+    esp_ota_abort(handle);
+    handle_open = false;
+  }
+  LOG_WARN("Update to %s abandoned: %s", target, error);
+  set_state(OTA_FAILED);
+}
+
+static void fail(const char *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(error, sizeof(error), fmt, args);
+  va_end(args);
+  abandon();
+}
+
+// The version we rebooted into, until its trial is over
+static void save_pending(const char *version)
+{
+  Preferences prefs;
+  if (prefs.begin(OTA_NVS_NAMESPACE, false))
+  {
+    if (version != nullptr)
+    {
+      prefs.putBytes("pending", version, strlen(version) + 1);
+    }
+    else
+    {
+      prefs.remove("pending");
+    }
+    prefs.remove("trials");
+    prefs.end();
+  }
+}
+
+static void load_pending(char *out, size_t len)
+{
+  out[0] = '\0';
+  Preferences prefs;
+  if (prefs.begin(OTA_NVS_NAMESPACE, true))
+  {
+    if (prefs.getBytes("pending", out, len) == 0)
+    {
+      out[0] = '\0';
+    }
+    prefs.end();
+  }
+  out[len - 1] = '\0';
+}
+
+// Boots of the pending version so far, this one included
+static uint8_t count_trial_boot()
+{
+  uint8_t boots = 0;
+  Preferences prefs;
+  if (prefs.begin(OTA_NVS_NAMESPACE, false))
+  {
+    boots = prefs.getUChar("trials", 0);
+    if (boots < 0xFF)
+    {
+      boots++;
+    }
+    prefs.putUChar("trials", boots);
+    prefs.end();
+  }
+  return boots;
+}
+
+static void roll_back()
+{
+  if (bootloader_rollback)
+  {
+    esp_ota_mark_app_invalid_rollback_and_reboot(); // returns only if there is nothing to roll back to
+  }
+  // without bootloader support: boot the other slot, the pending version
+  // left in NVS tells the previous image what happened
+  const esp_partition_t *previous = esp_ota_get_next_update_partition(nullptr);
+  if (previous != nullptr && esp_ota_set_boot_partition(previous) == ESP_OK)
+  {
+    esp_restart();
+  }
+  LOG_ERROR("No previous image to roll back to");
+}
+
+// Runs on the esp_timer task, so it fires even if the network task hangs
+static void health_check_failed(void *arg)
+{
+  LOG_ERROR("No telemetry published %u s after the update, rolling back",
+            (unsigned)(OTA_HEALTH_TIMEOUT_MS / 1000));
+  roll_back();
+}
+
+void ota_begin()
+{
+  running = esp_ota_get_running_partition();
+  char pending[OTA_VERSION_MAX];
+  load_pending(pending, sizeof(pending));
+
+  esp_ota_img_states_t image_state = ESP_OTA_IMG_UNDEFINED;
+  bootloader_rollback = running != nullptr &&
+                        esp_ota_get_state_partition(running, &image_state) == ESP_OK &&
+                        image_state == ESP_OTA_IMG_PENDING_VERIFY;
+
+  if (bootloader_rollback || (pending[0] != '\0' && strcmp(pending, FIRMWARE_VERSION) == 0))
+  {
+    snprintf(target, sizeof(target), "%s", FIRMWARE_VERSION);
+    // a reset before the health check ends the trial without a verdict and
+    // the next boot starts another; counted, so a crash loop ends as well
+    // when the bootloader was built without rollback support
+    uint8_t boots = count_trial_boot();
+    if (boots > OTA_TRIAL_BOOTS)
+    {
+      LOG_ERROR("Firmware %s reset %u times on trial, rolling back", FIRMWARE_VERSION,
+                (unsigned)(boots - 1));
+      roll_back();
+    }
+    const esp_timer_create_args_t args = {health_check_failed, nullptr, ESP_TIMER_TASK, "ota_health",
+                                          false};
+    if (esp_timer_create(&args, &health_timer) == ESP_OK)
+    {
+      esp_timer_start_once(health_timer, (uint64_t)OTA_HEALTH_TIMEOUT_MS * 1000);
+    }
+    set_state(OTA_TRIAL);
+    LOG_INFO("Firmware %s on trial in %s", FIRMWARE_VERSION, running ? running->label : "?");
+  }
+  else if (pending[0] != '\0')
+  {
+    // updates never reinstall the running version, so this is the old image
+    snprintf(rolled_back, sizeof(rolled_back), "%s", pending);
+    save_pending(nullptr);
+    state_version++;
+    LOG_WARN("Update to %s was rolled back, running %s", rolled_back, FIRMWARE_VERSION);
+  }
+}
+
+void ota_publish_succeeded()
+{
+  if (state != OTA_TRIAL)
+  {
+    return;
+  }
+  if (health_timer != nullptr)
+  {
+    esp_timer_stop(health_timer);
+  }
+  if (bootloader_rollback)
+  {
+    esp_ota_mark_app_valid_cancel_rollback();
+  }
+  save_pending(nullptr);
+  set_state(OTA_IDLE);
+  LOG_INFO("Firmware %s confirmed", FIRMWARE_VERSION);
+}
+
+static bool hash_running(uint32_t len, uint8_t digest[32])
+{
+  static uint8_t buffer[1024];
+  mbedtls_sha256_context ctx;
+  mbedtls_sha256_init(&ctx);
+  mbedtls_sha256_starts_ret(&ctx, 0);
+  bool ok = true;
+  for (uint32_t offset = 0; ok && offset < len; offset += sizeof(buffer))
+  {
+    size_t n = len - offset < sizeof(buffer) ? len - offset : sizeof(buffer);
+    ok = esp_partition_read(running, offset, buffer, n) == ESP_OK;
+    if (ok)
+    {
+      mbedtls_sha256_update_ret(&ctx, buffer, n);
+    }
+  }
+  mbedtls_sha256_finish_ret(&ctx, digest);
+  mbedtls_sha256_free(&ctx);
+  return ok;
+}
+
+static bool signature_valid(const uint8_t digest[32])
+{
+#ifdef OTA_SIGNING_KEY
+  static const char key[] = OTA_SIGNING_KEY;
+  mbedtls_pk_context pk;
+  mbedtls_pk_init(&pk);
+  bool ok = mbedtls_pk_parse_public_key(&pk, (const unsigned char *)key, sizeof(key)) == 0 &&
+            mbedtls_pk_verify(&pk, MBEDTLS_MD_SHA256, digest, 32, manifest.signature,
+                              manifest.signature_len) == 0;
+  mbedtls_pk_free(&pk);
+  return ok;
+#else
+  return false;
+#endif
+}
+
+void ota_handle_manifest(const uint8_t *payload, size_t len)
+{
+  if (state == OTA_DOWNLOADING || state == OTA_REBOOTING)
+  {
+    LOG_WARN("Update to %s already in progress, manifest ignored", target);
+    return;
+  }
+  if (state == OTA_TRIAL)
+  {
+    LOG_WARN("Firmware %s is still on trial, manifest ignored", FIRMWARE_VERSION);
+    return;
+  }
+  OtaManifest next;
+  snprintf(target, sizeof(target), "?");
+  if (!ota_manifest_parse(payload, len, next, error, sizeof(error)))
+  {
+    abandon();
+    return;
+  }
+  snprintf(target, sizeof(target), "%s", next.firmware_version);
+  if (strcmp(next.firmware_version, FIRMWARE_VERSION) == 0)
+  {
+    fail("already running %s", FIRMWARE_VERSION);
+    return;
+  }
+#ifndef OTA_SIGNING_KEY
+  fail("no OTA_SIGNING_KEY in secrets.h");
+  return;
+#endif
+  update = esp_ota_get_next_update_partition(nullptr);
+  if (running == nullptr || update == nullptr || next.image_size > update->size)
+  {
+    fail("image does not fit the update slot");
+    return;
+  }
+  bool delta = next.flags & OTA_FLAG_DELTA;
+  if (delta)
+  {
+    uint8_t digest[32];
+    if (next.base_size > running->size || !hash_running(next.base_size, digest) ||
+        memcmp(digest, next.base_sha256, sizeof(digest)) != 0)
+    {
+      fail("patch is for another base image");
+      return;
+    }
+  }
+
+  // erases sector by sector as the writes arrive, spreading the stalls out
+  if (esp_ota_begin(update, OTA_WITH_SEQUENTIAL_WRITES, &handle) != ESP_OK)
+  {
+    fail("cannot open %s", update->label);
+    return;
+  }
+  handle_open = true;
+  manifest = next;
+  written = 0;
+  progress_step = 0;
+  mbedtls_sha256_init(&sha);
+  mbedtls_sha256_starts_ret(&sha, 0);
+  if (delta)
+  {
+    patcher.begin(&source, &sink);
+  }
+  transfer.begin(manifest.transfer_size, OTA_CHUNK_BYTES, OTA_RATE_BYTES_PER_S,
+                 OTA_REQUEST_TIMEOUT_MS, millis());
+  error[0] = '\0';
+  rolled_back[0] = '\0';
+  set_state(OTA_DOWNLOADING);
+  LOG_INFO("Updating to %s in %s: %lu bytes%s", target, update->label,
+           (unsigned long)manifest.transfer_size, delta ? " of delta" : "");
+}
+
+static void finish()
+{
+  if ((manifest.flags & OTA_FLAG_DELTA) && !patcher.complete())
+  {
+    fail("patch ended before the image");
+    return;
+  }
+  if (written != manifest.image_size)
+  {
+    fail("image is %lu bytes, expected %lu", (unsigned long)written,
+         (unsigned long)manifest.image_size);
+    return;
+  }
+  uint8_t digest[32];
+  mbedtls_sha256_finish_ret(&sha, digest);
+  mbedtls_sha256_free(&sha);
+  if (memcmp(digest, manifest.image_sha256, sizeof(digest)) != 0)
+  {
+    fail("image hash mismatch");
+    return;
+  }
+  if (!signature_valid(digest))
+  {
+    fail("bad signature");
+    return;
+  }
+  handle_open = false; // esp_ota_end() frees it either way
+  if (esp_ota_end(handle) != ESP_OK)
+  {
+    fail("not a valid app image");
+    return;
+  }
+  if (esp_ota_set_boot_partition(update) != ESP_OK)
+  {
+    fail("cannot select %s", update->label);
+    return;
+  }
+  save_pending(manifest.firmware_version);
+  reboot_at_ms = millis() + OTA_REBOOT_DELAY_MS;
+  set_state(OTA_REBOOTING);
+  LOG_INFO("Image %s verified in %lu s, %lu retries, rebooting into %s", target,
+           (unsigned long)(transfer.elapsed_ms(millis()) / 1000), (unsigned long)transfer.retries(),
+           update->label);
+}
+
+void ota_handle_chunk(const uint8_t *payload, size_t len)
+{
+  uint32_t offset;
+  if (state != OTA_DOWNLOADING || len <= sizeof(offset))
+  {
+    return;
+  }
+  memcpy(&offset, payload, sizeof(offset));
+  const uint8_t *data = payload + sizeof(offset);
+  size_t n = len - sizeof(offset);
+  if (!transfer.accept(offset, n))
+  {
+    return; // a repeat, or an answer to a request we gave up on
+  }
+
+  bool ok = (manifest.flags & OTA_FLAG_DELTA) ? patcher.feed(data, n) : sink.write(data, n);
+  if (!ok)
+  {
+    fail("%s", (manifest.flags & OTA_FLAG_DELTA) ? patcher.error() : "image write failed");
+    return;
+  }
+  if (transfer.done())
+  {
+    finish();
+    return;
+  }
+  uint32_t step = (uint32_t)((uint64_t)transfer.received() * OTA_PROGRESS_STEPS / transfer.size());
+  if (step != progress_step)
+  {
+    progress_step = step;
+    state_version++;
+  }
+}
+
+bool ota_poll(uint32_t now_ms, bool backlog, OtaRequest &request)
+{
+  if (state == OTA_REBOOTING && (int32_t)(now_ms - reboot_at_ms) >= 0)
+  {
+    LOG_INFO("Restarting into %s", target);
+    esp_restart();
+  }
+  if (state != OTA_DOWNLOADING || backlog || !transfer.next_request(now_ms, request))
+  {
+    return false;
+  }
+  if (transfer.attempts() > OTA_MAX_ATTEMPTS)
+  {
+    fail("no answer for offset %lu", (unsigned long)request.offset);
+    return false;
+  }
+  return true;
+}
+
+OtaState ota_state()
+{
+  return state;
+}
+
+uint32_t ota_state_version()
+{
+  return state_version;
+}
+
+static const char *state_name(OtaState s)
+{
+  switch (s)
+  {
+  case OTA_IDLE:
+    return "idle";
+  case OTA_TRIAL:
+    return "trial";
+  case OTA_DOWNLOADING:
+    return "downloading";
+  case OTA_REBOOTING:
+    return "rebooting";
+  case OTA_FAILED:
+    return "failed";
+  default:
+    return "?";
+  }
+}
+
+size_t ota_format_state(char *out, size_t out_len)
+{
+  // target and error carry the version string from the manifest
+  char escaped[2 * OTA_ERROR_MAX];
+  int len = snprintf(out, out_len, "{\"state\":\"%s\",\"firmware\":\"%s\",\"partition\":\"%s\"",
+                     state_name(state), FIRMWARE_VERSION, running ? running->label : "?");
+  if (len > 0 && (size_t)len < out_len && state != OTA_IDLE && state != OTA_TRIAL)
+  {
+    len += snprintf(out + len, out_len - len,
+                    ",\"target\":\"%s\",\"received\":%lu,\"size\":%lu,\"retries\":%lu",
+                    json_escape(target, escaped, sizeof(escaped)),
+                    (unsigned long)transfer.received(), (unsigned long)transfer.size(),
+                    (unsigned long)transfer.retries());
+  }
+  if (len > 0 && (size_t)len < out_len && state == OTA_FAILED)
+  {
+    len += snprintf(out + len, out_len - len, ",\"error\":\"%s\"",
+                    json_escape(error, escaped, sizeof(escaped)));
+  }
+  if (len > 0 && (size_t)len < out_len && rolled_back[0] != '\0')
+  {
+    len += snprintf(out + len, out_len - len, ",\"rolled_back\":\"%s\"",
+                    json_escape(rolled_back, escaped, sizeof(escaped)));
+  }
+  if (len > 0 && (size_t)len < out_len)
+  {
+    len += snprintf(out + len, out_len - len, "}");
+  }
+  return len > 0 && (size_t)len < out_len ? len : 0;
+}
@@ -0,0 +1,196 @@
+#include <stdarg.h>
+#include <esp_heap_caps.h>
+#include <esp_system.h>
+
+#include "activity.h"
+#include "adc_dma.h"
+#include "clock.h"
+#include "flame.h"
+#include "i2c_bus.h"
+#include "journal.h"
+#include "log.h"
+#include "mpu_fifo.h"
+#include "perf.h"
+#include "telemetry.h"
+
+SpscRing<PerfSnapshot, 2> perf_snapshots;
+
+static PerfHistogram histograms[PERF_STAGE_COUNT];
+
+static bool heap_baseline_set = false;
+static multi_heap_info_t heap_baseline;
+
+static const char *stage_names[PERF_STAGE_COUNT] = {
+    "mpu", "motor", "flame", "gas", "dht", "enqueue", "activity", "jitter", "json", "compress", "publish"};
+static const char *task_names[] = {"sampling", "network", "mpu_fifo", "adc_dma", "flame", "i2c", "log"};
+
+void perf_heap_baseline()
+{
+  heap_caps_get_info(&heap_baseline, MALLOC_CAP_8BIT);
+  heap_baseline_set = true;
+}
+
+void perf_record(PerfStage stage, uint32_t cycles)
+{
+  histograms[stage].add(cycles);
+}
+
+void perf_sampling_tick(uint32_t overruns, const PerfActivity &activity)
+{
+  static bool started = false;
+  static uint32_t started_ms = 0;
+  uint32_t now = millis();
+  if (!started)
+  {
+    started = true;
+    started_ms = now;
+    return;
+  }
+  if (now - started_ms < PERF_REPORT_INTERVAL_MS)
+  {
+    return;
+  }
+
+  PerfSnapshot snapshot;
+  snapshot.interval_ms = now - started_ms;
+  for (int s = 0; s < PERF_SAMPLING_STAGES; s++)
+  {
+    snapshot.stage[s] = histograms[s].summary();
+    histograms[s].reset();
+  }
+  snapshot.overruns = overruns;
+  snapshot.activity = activity;
+  perf_snapshots.push(snapshot); // dropped and counted if the network task is behind
+  started_ms = now;
+}
+
+// snprintf that appends at *pos and reports overflow
+static bool append(char *out, size_t out_len, size_t *pos, const char *fmt, ...)
+{
+  if (*pos >= out_len)
+  {
+    return false;
+  }
+  va_list args;
+  va_start(args, fmt);
+  int len = vsnprintf(out + *pos, out_len - *pos, fmt, args);
+  va_end(args);
+  if (len < 0 || (size_t)len >= out_len - *pos)
+  {
+    *pos = out_len;
+    return false;
+  }
+  *pos += len;
+  return true;
+}
+
+// Cycles as microseconds with two decimals, integer formatting only
+static bool append_us(char *out, size_t out_len, size_t *pos, const char *key, uint32_t cycles,
+                      uint32_t cycles_per_us)
+{
+  uint32_t centi_us = (uint32_t)((uint64_t)cycles * 100 / cycles_per_us);
+  return append(out, out_len, pos, ",\"%s\":%lu.%02lu", key, (unsigned long)(centi_us / 100),
+                (unsigned long)(centi_us % 100));
+}
+
+static bool append_stage(char *out, size_t out_len, size_t *pos, int index,
+                         const PerfSummary &s, uint32_t cycles_per_us)
+{
+  return append(out, out_len, pos, "%s\"%s\":{\"n\":%lu", index ? "," : "", stage_names[index],
+                (unsigned long)s.count) &&
+         append_us(out, out_len, pos, "min_us", s.min, cycles_per_us) &&
+         append_us(out, out_len, pos, "avg_us", s.avg, cycles_per_us) &&
+         append_us(out, out_len, pos, "max_us", s.max, cycles_per_us) &&
+         append_us(out, out_len, pos, "p99_us", s.p99, cycles_per_us) &&
+         append(out, out_len, pos, "}");
+}
+
+size_t perf_format_json(const PerfSnapshot &snapshot, const PerfNetworkStats &net, char *out,
+                        size_t out_len)
+{
+  uint32_t cycles_per_us = getCpuFrequencyMhz();
+  size_t pos = 0;
+  bool ok = append(out, out_len, &pos,
+                   "{\"uptime_ms\":%lu,\"interval_ms\":%lu,\"cpu_mhz\":%lu,\"stages\":{",
+                   (unsigned long)millis(), (unsigned long)snapshot.interval_ms,
+                   (unsigned long)cycles_per_us);
+
+  for (int s = 0; s < PERF_STAGE_COUNT && ok; s++)
+  {
+    PerfSummary summary;
+    if (s < PERF_SAMPLING_STAGES)
+    {
+      summary = snapshot.stage[s];
+    }
+    else
+    {
+      summary = histograms[s].summary();
+      histograms[s].reset();
+    }
+    ok = append_stage(out, out_len, &pos, s, summary, cycles_per_us);
+  }
+
+  multi_heap_info_t heap;
+  heap_caps_get_info(&heap, MALLOC_CAP_8BIT);
+  long growth = heap_baseline_set ? (long)heap.total_allocated_bytes -
+                                        (long)heap_baseline.total_allocated_bytes
+                                  : 0;
+  ok = ok && append(out, out_len, &pos,
+                    "},\"overruns\":%lu,"
+                    "\"activity\":{\"mpu\":\"%s\",\"motor\":\"%s\",\"bursts\":%lu,\"pretrigger\":%lu},"
+                    "\"heap_free\":%lu,\"heap_min\":%lu,\"heap_largest\":%lu,"
+                    "\"heap_blocks\":%lu,\"heap_growth\":%ld,"
+                    "\"frames\":{\"peak\":%u,\"exhausted\":%lu},\"stack_free\":{",
+                    (unsigned long)snapshot.overruns,
+                    activity_profile_name((ActivityProfile)snapshot.activity.mpu_profile),
+                    activity_profile_name((ActivityProfile)snapshot.activity.motor_profile),
+                    (unsigned long)snapshot.activity.bursts, (unsigned long)snapshot.activity.pretrigger,
+                    (unsigned long)esp_get_free_heap_size(),
+                    (unsigned long)esp_get_minimum_free_heap_size(),
+                    (unsigned long)heap.largest_free_block, (unsigned long)heap.allocated_blocks,
+                    growth, net.frames_peak, (unsigned long)net.frames_exhausted);
+  bool first = true;
+  for (size_t t = 0; t < sizeof(task_names) / sizeof(task_names[0]) && ok; t++)
+  {
+    TaskHandle_t task = xTaskGetHandle(task_names[t]);
+    if (task == nullptr)
+    {
+      continue; // not running in this configuration
+    }
+    ok = append(out, out_len, &pos, "%s\"%s\":%u", first ? "" : ",", task_names[t],
+                (unsigned)uxTaskGetStackHighWaterMark(task));
+    first = false;
+  }
+
+  const I2cBusStats &i2c = i2c_bus_stats();
+  ok = ok && append(out, out_len, &pos,
+                    "},\"i2c\":{\"n\":%lu,\"nack\":%lu,\"timeout\":%lu,\"recoveries\":%lu,"
+                    "\"recovery_failed\":%lu,\"recovery_us\":%lu,\"recovery_max_us\":%lu,"
+                    "\"wait_max_us\":%lu",
+                    (unsigned long)i2c.transactions, (unsigned long)i2c.nacks,
+                    (unsigned long)i2c.timeouts, (unsigned long)i2c.recoveries,
+                    (unsigned long)i2c.recovery_failures, (unsigned long)i2c.recovery_us,
+                    (unsigned long)i2c.recovery_max_us, (unsigned long)i2c.wait_max_us);
+
+  ok = ok && append(out, out_len, &pos,
+                    "},\"rssi\":%d,\"reconnects\":{\"wifi\":%lu,\"mqtt\":%lu},"
+                    "\"flame\":{\"alarms\":%lu,\"resends\":%lu,\"publish_us\":%lu,\"ack_us\":%lu},"
+                    "\"tls\":{\"handshakes\":%lu,\"resumed\":%lu,\"failures\":%lu,\"last_ms\":%lu},"
+                    "\"dropped\":{\"telemetry\":%lu,\"alarm\":%lu,\"flame\":%lu,\"vibration\":%lu,"
+                    "\"adc_frames\":%lu,\"mpu_fifo\":%lu,\"mpu_samples\":%lu,\"log\":%lu,"
+                    "\"journal\":%lu,\"perf\":%lu},"
+                    "\"timestamp_us\":%llu,\"epoch_offset_us\":%lld}",
+                    net.rssi, (unsigned long)net.wifi_reconnects, (unsigned long)net.mqtt_reconnects,
+                    (unsigned long)net.flame_alarms, (unsigned long)net.flame_resends,
+                    (unsigned long)net.flame_publish_us, (unsigned long)net.flame_ack_us,
+                    (unsigned long)net.tls_handshakes, (unsigned long)net.tls_resumed,
+                    (unsigned long)net.tls_failures, (unsigned long)net.tls_last_ms,
+                    (unsigned long)telemetry_queue.dropped(), (unsigned long)alarm_queue.dropped(),
+                    (unsigned long)flame_events.dropped(),
+                    (unsigned long)vibration_queue.dropped(), (unsigned long)adc_dma_overruns,
+                    (unsigned long)mpu_fifo_overflows, (unsigned long)mpu_samples.dropped(),
+                    (unsigned long)log_dropped(), (unsigned long)journal.dropped(),
+                    (unsigned long)perf_snapshots.dropped(), (unsigned long long)clock_us(),
+                    (long long)clock_epoch_offset_us());
+  return ok ? pos : 0;
+}
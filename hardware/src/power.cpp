@@ -0,0 +1,103 @@
+#include <WiFi.h>
+#include <esp_sleep.h>
+
+#include "config.h"
+
+#define LOG_MODULE "power"
+#define LOG_MODULE_LEVEL LOG_LEVEL_POWER
+#include "log.h"
+
+#include "clock.h"
+#include "frame_batcher.h"
+#include "network.h"
+#include "power.h"
+
+struct RtcRecord
+{
+  uint64_t timestamp_us;
+  TelemetryFrame frame;
+};
+
+// RTC slow memory survives deep sleep (8 KiB in total)
+RTC_DATA_ATTR static RtcRecord rtc_records[LOW_POWER_BUFFER_SAMPLES];
+RTC_DATA_ATTR static uint32_t rtc_head = 0; // next slot to write
+RTC_DATA_ATTR static uint32_t rtc_count = 0;
+RTC_DATA_ATTR static WifiCache rtc_wifi_cache;
+
+static FrameBatcher low_power_batcher;
+
+size_t rtc_buffer_add(uint64_t timestamp_us, const TelemetryFrame &frame)
+{
+  rtc_records[rtc_head].timestamp_us = timestamp_us;
+  rtc_records[rtc_head].frame = frame;
+  rtc_head = (rtc_head + 1) % LOW_POWER_BUFFER_SAMPLES;
+  if (rtc_count < LOW_POWER_BUFFER_SAMPLES)
+  {
+    rtc_count++;
+  }
+  return rtc_count;
+}
+
+bool rtc_buffer_flush()
+{
+  if (rtc_count == 0)
+  {
+    return true;
+  }
+
+  uint32_t radio_on = millis();
+  if (!network_connect_once(rtc_wifi_cache, LOW_POWER_WIFI_TIMEOUT_MS))
+  {
+    network_shutdown();
+    return false;
+  }
+
+  low_power_batcher.begin(TELEMETRY_BATCH_VERSION, BATCH_MAX_SAMPLES, UINT32_MAX);
+  uint32_t sent = 0;
+  bool ok = true;
+  while (sent < rtc_count && ok)
+  {
+    uint32_t slot = (rtc_head + LOW_POWER_BUFFER_SAMPLES - rtc_count + sent) % LOW_POWER_BUFFER_SAMPLES;
+    const RtcRecord &record = rtc_records[slot];
+    if (low_power_batcher.append(record.timestamp_us, &record.frame, sizeof(record.frame)))
+    {
+      sent++;
+      if (sent < rtc_count)
+      {
+        continue;
+      }
+    }
+    // frame full (or last record): send what we have
+    low_power_batcher.set_epoch_offset(clock_epoch_offset_us());
+    ok = network_publish_batch(low_power_batcher.data(), low_power_batcher.size());
+    if (!ok)
+    {
+      sent -= low_power_batcher.count();
+    }
+    low_power_batcher.clear();
+  }
+  rtc_count -= sent;
+
+  network_shutdown();
+  LOG_INFO("Flushed %lu samples, radio on %lu ms", (unsigned long)sent,
+           (unsigned long)(millis() - radio_on));
+  return ok;
+}
+
+void low_power_sleep(uint8_t motion_pin)
+{
+  esp_sleep_enable_timer_wakeup((uint64_t)LOW_POWER_SAMPLE_PERIOD_MS * 1000);
+  if (LOW_POWER_WAKE_ON_MOTION)
+  {
+    esp_sleep_enable_ext0_wakeup((gpio_num_t)motion_pin, 0);
+  }
+
+  // let the log task empty its buffer before the CPU stops
+  delay(LOW_POWER_LOG_DRAIN_MS);
+  Serial.flush();
+  if (LOW_POWER_DEEP_SLEEP)
+  {
+    esp_deep_sleep_start();
+  }
+  esp_light_sleep_start();
+}
@@ -0,0 +1,121 @@
+#include <Preferences.h>
+
+#define LOG_MODULE "net"
+#define LOG_MODULE_LEVEL LOG_LEVEL_NET
+#include "log.h"
+
+#include "adc_filter.h"
+#include "config.h"
+#include "network.h"
+#include "runtime_config.h"
+
+static_assert(BATCH_MAX_SAMPLES <= SETTINGS_BATCH_MAX_SAMPLES, "default batch exceeds the settings limit");
+
+SpscRing<Settings, RUNTIME_CONFIG_QUEUE_LEN> settings_updates;
+
+static Settings current;
+
+static void load_defaults(Settings &settings)
+{
+  settings.version = SETTINGS_VERSION;
+  settings.mpu_period_us = MPU_PERIOD_US;
+  settings.motor_period_us = MOTOR_PERIOD_US;
+  settings.flame_period_us = FLAME_PERIOD_US;
+  settings.gas_period_us = GAS_PERIOD_US;
+  settings.dht_period_us = DHT_PERIOD_US;
+  settings.publish_period_us = PUBLISH_PERIOD_US;
+  settings.batch_max_samples = BATCH_MAX_SAMPLES;
+  settings.batch_max_age_ms = BATCH_MAX_AGE_MS;
+  settings.heartbeat_ms = TELEMETRY_EVENT_DRIVEN ? HEARTBEAT_MS : 0;
+  settings.deadband[SETTINGS_DEADBAND_ACCEL] = DEADBAND_ACCEL;
+  settings.deadband[SETTINGS_DEADBAND_GYRO] = DEADBAND_GYRO;
+  settings.deadband[SETTINGS_DEADBAND_TEMPERATURE] = DEADBAND_TEMPERATURE;
+  settings.deadband[SETTINGS_DEADBAND_GAS] = DEADBAND_GAS;
+  settings.deadband[SETTINGS_DEADBAND_DHT_TEMPERATURE] = DEADBAND_DHT_TEMPERATURE;
+  settings.deadband[SETTINGS_DEADBAND_DHT_HUMIDITY] = DEADBAND_DHT_HUMIDITY;
+  settings.deadband[SETTINGS_DEADBAND_MOTOR] = DEADBAND_MOTOR;
+  settings.deadband[SETTINGS_DEADBAND_MOTOR_RMS] = DEADBAND_MOTOR_RMS;
+  settings.gas_alarm_level = GAS_ALARM_LEVEL;
+  settings.gas_lowpass_hz = ADC_GAS_LOWPASS_HZ;
+}
+
+void runtime_config_begin()
+{
+  load_defaults(current);
+
+  Settings stored;
+  Preferences prefs;
+  if (!prefs.begin(RUNTIME_CONFIG_NVS_NAMESPACE, true))
+  {
+    return; // nothing stored yet
+  }
+  size_t stored_len = prefs.getBytesLength("settings");
+  bool loaded = stored_len == sizeof(stored) &&
+                prefs.getBytes("settings", &stored, sizeof(stored)) == sizeof(stored);
+  prefs.end();
+  if (stored_len == 0)
+  {
+    return;
+  }
+
+  // written by a firmware with another layout or other limits
+  char error[96] = "size mismatch";
+  if (!loaded || !settings_validate(stored, error, sizeof(error)))
+  {
+    LOG_WARN("Ignoring stored settings (%s), using defaults", error);
+    return;
+  }
+  current = stored;
+  LOG_INFO("Loaded settings from NVS");
+}
+
+const Settings &runtime_config()
+{
+  return current;
+}
+
+bool runtime_config_update(const uint8_t *payload, size_t len, bool binary, char *error,
+                           size_t error_len)
+{
+  Settings next = current;
+  if (binary)
+  {
+    if (!settings_parse_binary(payload, len, next, error, error_len))
+    {
+      return false;
+    }
+  }
+  else
+  {
+    static char json[RUNTIME_CONFIG_JSON_MAX];
+    if (len >= sizeof(json))
+    {
+      snprintf(error, error_len, "config message over %u bytes", (unsigned)sizeof(json) - 1);
+      return false;
+    }
+    memcpy(json, payload, len);
+    json[len] = '\0';
+    if (!settings_parse_json(json, next, error, error_len))
+    {
+      return false;
+    }
+  }
+
+  if (!settings_updates.push(next))
+  {
+    snprintf(error, error_len, "previous update not applied yet");
+    return false;
+  }
+  current = next;
+
+  Preferences prefs;
+  if (prefs.begin(RUNTIME_CONFIG_NVS_NAMESPACE, false))
+  {
+    if (prefs.putBytes("settings", &current, sizeof(current)) != sizeof(current))
+    {
+      LOG_WARN("Settings applied but not persisted");
+    }
+    prefs.end();
+  }
+  return true;
+}
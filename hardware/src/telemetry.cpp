@@ -0,0 +1,217 @@
+#include <stdarg.h>
+
+#include "clock.h"
+#include "telemetry.h"
+
+SpscRing<TelemetrySample, TELEMETRY_QUEUE_LEN> telemetry_queue;
+SpscRing<VibrationFeatures, VIBRATION_QUEUE_LEN> vibration_queue;
+SpscRing<AlarmEvent, ALARM_QUEUE_LEN> alarm_queue;
+
+static const char *alarm_names[] = {"flame", "gas", "zscore", "rate"};
+static const char *anomaly_channel_names[ANOMALY_CHANNEL_COUNT] = {
+    "gas", "motor", "vibration", "temperature", "temperature_out"};
+
+static const char axis_names[VIBRATION_AXES] = {'x', 'y', 'z'};
+
+// Fixed-point value as a decimal string, e.g. (-1234, 3) -> "-1.234".
+// Integer formatting only: no float (and no soft double) in the sample path.
+#define FIXED_STR_MAX 24 // sign, two 10-digit parts, point, NUL: no truncation warning
+static const char *fixed_str(char (&buf)[FIXED_STR_MAX], int32_t value, uint8_t decimals)
+{
+  static const uint32_t scale[] = {1, 10, 100, 1000};
+  if (decimals > 3)
+  {
+    decimals = 3;
+  }
+  uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+  snprintf(buf, sizeof(buf), "%s%lu.%0*lu", value < 0 ? "-" : "",
+           (unsigned long)(magnitude / scale[decimals]), decimals,
+           (unsigned long)(magnitude % scale[decimals]));
+  return buf;
+}
+
+const char *json_escape(const char *text, char *out, size_t out_len)
+{
+  if (out_len == 0)
+  {
+    return out;
+  }
+  size_t len = 0;
+  for (; *text != '\0'; text++)
+  {
+    unsigned char c = (unsigned char)*text;
+    char escaped[7];
+    size_t n;
+    if (c == '"' || c == '\\')
+    {
+      escaped[0] = '\\';
+      escaped[1] = (char)c;
+      n = 2;
+    }
+    else if (c < 0x20)
+    {
+      n = snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+    }
+    else
+    {
+      escaped[0] = (char)c;
+      n = 1;
+    }
+    if (len + n >= out_len)
+    {
+      break;
+    }
+    memcpy(out + len, escaped, n);
+    len += n;
+  }
+  out[len] = '\0';
+  return out;
+}
+
+size_t format_telemetry_json(const TelemetrySample &sample, char *out, size_t out_len)
+{
+  char ax[FIXED_STR_MAX], ay[FIXED_STR_MAX], az[FIXED_STR_MAX];
+  char gx[FIXED_STR_MAX], gy[FIXED_STR_MAX], gz[FIXED_STR_MAX];
+  char temperature[FIXED_STR_MAX], dht_temperature[FIXED_STR_MAX], dht_humidity[FIXED_STR_MAX];
+  char motor_mean[FIXED_STR_MAX], motor_rms[FIXED_STR_MAX], motor_peak[FIXED_STR_MAX];
+
+  int len = snprintf(out, out_len,
+                     "{\"acceleration_x\":%s,\"acceleration_y\":%s,\"acceleration_z\":%s,"
+                     "\"gyro_x\":%s,\"gyro_y\":%s,\"gyro_z\":%s,"
+                     "\"temperature\":%s,"
+                     "\"flame_status\":%d,"
+                     "\"gas_level\":%d,"
+                     "\"temperature_out\":%s,"
+                     "\"humidity_out\":%s,"
+                     "\"motor_adc\":%d,"
+                     "\"motor_mean\":%s,"
+                     "\"motor_rms\":%s,"
+                     "\"motor_peak\":%s,"
+                     "\"timestamp_us\":%llu,"
+                     "\"epoch_offset_us\":%lld"
+                     "}",
+                     fixed_str(ax, sample.acceleration_x, 3), fixed_str(ay, sample.acceleration_y, 3),
+                     fixed_str(az, sample.acceleration_z, 3),
+                     fixed_str(gx, sample.gyro_x, 3), fixed_str(gy, sample.gyro_y, 3),
+                     fixed_str(gz, sample.gyro_z, 3),
+                     fixed_str(temperature, sample.temperature, 2),
+                     sample.flame_status,
+                     sample.gas_level,
+                     fixed_str(dht_temperature, sample.dht_temperature_deci, 1),
+                     fixed_str(dht_humidity, sample.dht_humidity_deci, 1),
+                     sample.motor_adc_value,
+                     fixed_str(motor_mean, sample.motor_mean_deci, 1),
+                     fixed_str(motor_rms, sample.motor_rms_deci, 1),
+                     fixed_str(motor_peak, sample.motor_peak_deci, 1),
+                     (unsigned long long)sample.timestamp_us,
+                     (long long)clock_epoch_offset_us());
+  return len > 0 && (size_t)len < out_len ? len : 0;
+}
+
+size_t format_alarm_json(const AlarmEvent &event, char *out, size_t out_len)
+{
+  char anomaly[64] = "";
+  if (event.type == ALARM_ZSCORE || event.type == ALARM_RATE)
+  {
+    snprintf(anomaly, sizeof(anomaly), ",\"channel\":\"%s\",\"score\":%.2f",
+             anomaly_channel_names[event.channel], event.score);
+  }
+  else if (event.seq != 0)
+  {
+    snprintf(anomaly, sizeof(anomaly), ",\"seq\":%lu", (unsigned long)event.seq);
+  }
+  int len = snprintf(out, out_len,
+                     "{\"alarm\":\"%s\",\"active\":%s,\"value\":%g%s,"
+                     "\"timestamp_us\":%llu,\"epoch_offset_us\":%lld}",
+                     alarm_names[event.type], event.active ? "true" : "false",
+                     event.value, anomaly, (unsigned long long)event.timestamp_us,
+                     (long long)clock_epoch_offset_us());
+  return len > 0 && (size_t)len < out_len ? len : 0;
+}
+
+static int16_t clamp16(int32_t value)
+{
+  return value < INT16_MIN ? INT16_MIN : value > INT16_MAX ? INT16_MAX : value;
+}
+
+static uint16_t clamp_u16(uint32_t value)
+{
+  return value > UINT16_MAX ? UINT16_MAX : value;
+}
+
+size_t encode_telemetry_binary(const TelemetrySample &sample, TelemetryFrame &frame)
+{
+  frame.version = TELEMETRY_SCHEMA_VERSION;
+  frame.flags = sample.flame_status ? TELEMETRY_FLAG_FLAME : 0;
+  frame.acceleration[0] = clamp16(sample.acceleration_x);
+  frame.acceleration[1] = clamp16(sample.acceleration_y);
+  frame.acceleration[2] = clamp16(sample.acceleration_z);
+  frame.gyro[0] = clamp16(sample.gyro_x);
+  frame.gyro[1] = clamp16(sample.gyro_y);
+  frame.gyro[2] = clamp16(sample.gyro_z);
+  frame.temperature = clamp16(sample.temperature);
+  frame.gas_level = sample.gas_level;
+  frame.dht_temperature_centi = clamp16(sample.dht_temperature_deci * 10);
+  frame.dht_humidity_centi = clamp_u16(sample.dht_humidity_deci * 10);
+  frame.motor_adc = sample.motor_adc_value;
+  frame.motor_mean_deci = sample.motor_mean_deci;
+  frame.motor_rms_deci = sample.motor_rms_deci;
+  frame.motor_peak_deci = sample.motor_peak_deci;
+  return sizeof(frame);
+}
+
+// snprintf that appends at *pos and reports overflow
+static bool append(char *out, size_t out_len, size_t *pos, const char *fmt, ...)
+{
+  if (*pos >= out_len)
+  {
+    return false;
+  }
+  va_list args;
+  va_start(args, fmt);
+  int len = vsnprintf(out + *pos, out_len - *pos, fmt, args);
+  va_end(args);
+  if (len < 0 || (size_t)len >= out_len - *pos)
+  {
+    *pos = out_len;
+    return false;
+  }
+  *pos += len;
+  return true;
+}
+
+size_t format_vibration_json(const VibrationFeatures &features, char *out, size_t out_len)
+{
+  size_t pos = 0;
+  bool ok = append(out, out_len, &pos,
+                   "{\"window\":%u,\"rate_hz\":%.1f,\"timestamp_us\":%llu,\"epoch_offset_us\":%lld",
+                   features.window, features.sample_rate_hz,
+                   (unsigned long long)features.timestamp_us, (long long)clock_epoch_offset_us());
+
+  for (int a = 0; a < VIBRATION_AXES && ok; a++)
+  {
+    const AxisFeatures &axis = features.axis[a];
+    ok = append(out, out_len, &pos,
+                ",\"%c\":{\"rms\":%.4f,\"peak\":%.4f,\"crest\":%.2f,\"peak_hz\":%.1f,\"bands\":[",
+                axis_names[a], axis.rms, axis.peak, axis.crest_factor, axis.peak_hz);
+    for (uint8_t b = 0; b < features.band_count && ok; b++)
+    {
+      ok = append(out, out_len, &pos, b ? ",%.5f" : "%.5f", axis.band_energy[b]);
+    }
+    ok = ok && append(out, out_len, &pos, "]");
+
+    if (features.spectrum_bins > 0)
+    {
+      ok = ok && append(out, out_len, &pos, ",\"spectrum\":[");
+      for (uint8_t s = 0; s < features.spectrum_bins && ok; s++)
+      {
+        ok = append(out, out_len, &pos, s ? ",%.4f" : "%.4f", axis.spectrum[s]);
+      }
+      ok = ok && append(out, out_len, &pos, "]");
+    }
+    ok = ok && append(out, out_len, &pos, "}");
+  }
+  ok = ok && append(out, out_len, &pos, "}");
+
+  return ok ? pos : 0;
+}
@@ -0,0 +1,422 @@
+#include <Preferences.h>
+#include <WiFi.h>
+#include <errno.h>
+#include <lwip/sockets.h>
+
+#define LOG_MODULE "tls"
+#define LOG_MODULE_LEVEL LOG_LEVEL_NET
+#include "log.h"
+
+#include "tls_client.h"
+
+static const int ciphersuites[] = {MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256, 0};
+static const mbedtls_ecp_group_id curves[] = {MBEDTLS_ECP_DP_SECP256R1, MBEDTLS_ECP_DP_NONE};
+static const int sig_hashes[] = {MBEDTLS_MD_SHA256, MBEDTLS_MD_NONE};
+
+// --- Session cache ---
+// RTC memory survives light and deep sleep; NVS is only written after a
+// full handshake, so resumed reconnects do not wear the flash.
+#define TLS_SESSION_MAGIC 0x544c5301u
+struct SessionCache
+{
+  uint32_t magic; // TLS_SESSION_MAGIC when valid
+  uint32_t len;
+  uint8_t data[TLS_SESSION_MAX];
+};
+RTC_DATA_ATTR static SessionCache rtc_session;
+
+static void session_load_nvs()
+{
+  rtc_session.magic = 0;
+  Preferences prefs;
+  if (prefs.begin(TLS_SESSION_NVS_NAMESPACE, true))
+  {
+    size_t len = prefs.getBytes("session", rtc_session.data, sizeof(rtc_session.data));
+    if (len > 0)
+    {
+      rtc_session.len = len;
+      rtc_session.magic = TLS_SESSION_MAGIC;
+    }
+    prefs.end();
+  }
+}
+
+static void session_store(const mbedtls_ssl_session &session, bool to_nvs)
+{
+  size_t len = 0;
+  if (mbedtls_ssl_session_save(&session, rtc_session.data, sizeof(rtc_session.data), &len) != 0)
+  {
+    LOG_WARN("TLS session over %u bytes, not cached", (unsigned)TLS_SESSION_MAX);
+    rtc_session.magic = 0;
+    return;
+  }
+  rtc_session.len = len;
+  rtc_session.magic = TLS_SESSION_MAGIC;
+  if (to_nvs)
+  {
+    Preferences prefs;
+    if (prefs.begin(TLS_SESSION_NVS_NAMESPACE, false))
+    {
+      prefs.putBytes("session", rtc_session.data, len);
+      prefs.end();
+    }
+  }
+}
+
+static void session_forget()
+{
+  rtc_session.magic = 0;
+  Preferences prefs;
+  if (prefs.begin(TLS_SESSION_NVS_NAMESPACE, false))
+  {
+    prefs.remove("session");
+    prefs.end();
+  }
+}
+
+// --- Record I/O on a non-blocking socket ---
+static int bio_send(void *ctx, const unsigned char *buf, size_t len)
+{
+  int n = lwip_send(*(int *)ctx, buf, len, 0);
+  if (n < 0)
+  {
+    return errno == EAGAIN || errno == EWOULDBLOCK ? MBEDTLS_ERR_SSL_WANT_WRITE
+                                                   : MBEDTLS_ERR_NET_SEND_FAILED;
+  }
+  return n;
+}
+
+static int bio_recv(void *ctx, unsigned char *buf, size_t len)
+{
+  int n = lwip_recv(*(int *)ctx, buf, len, 0);
+  if (n < 0)
+  {
+    return errno == EAGAIN || errno == EWOULDBLOCK ? MBEDTLS_ERR_SSL_WANT_READ
+                                                   : MBEDTLS_ERR_NET_RECV_FAILED;
+  }
+  return n; // 0: the peer closed the connection
+}
+
+static bool would_block(int ret)
+{
+  return ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE;
+}
+
+TlsClient::TlsClient()
+{
+  mbedtls_entropy_init(&entropy_);
+  mbedtls_ctr_drbg_init(&drbg_);
+  mbedtls_x509_crt_init(&ca_);
+  mbedtls_x509_crt_init(&cert_);
+  mbedtls_pk_init(&key_);
+  mbedtls_ssl_config_init(&conf_);
+  mbedtls_ssl_init(&ssl_);
+}
+
+bool TlsClient::begin(const char *ca_pem, const char *cert_pem, const char *key_pem,
+                      const char *server_name)
+{
+  if (ready_)
+  {
+    return true;
+  }
+  // PEM lengths include the terminating NUL
+  int ret = mbedtls_ctr_drbg_seed(&drbg_, mbedtls_entropy_func, &entropy_, nullptr, 0);
+  if (ret == 0)
+  {
+    ret = mbedtls_x509_crt_parse(&ca_, (const uint8_t *)ca_pem, strlen(ca_pem) + 1);
+  }
+  if (ret == 0)
+  {
+    ret = mbedtls_x509_crt_parse(&cert_, (const uint8_t *)cert_pem, strlen(cert_pem) + 1);
+  }
+  if (ret == 0)
+  {
+    ret = mbedtls_pk_parse_key(&key_, (const uint8_t *)key_pem, strlen(key_pem) + 1, nullptr, 0);
+  }
+  if (ret == 0)
+  {
+    ret = mbedtls_ssl_config_defaults(&conf_, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                      MBEDTLS_SSL_PRESET_DEFAULT);
+  }
+  if (ret != 0)
+  {
+    LOG_ERROR("TLS setup failed: -0x%04x", (unsigned)-ret);
+    return false;
+  }
+
+  mbedtls_ssl_conf_min_version(&conf_, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+  mbedtls_ssl_conf_ciphersuites(&conf_, ciphersuites);
+  mbedtls_ssl_conf_curves(&conf_, curves);
+  mbedtls_ssl_conf_sig_hashes(&conf_, sig_hashes);
+  mbedtls_ssl_conf_authmode(&conf_, MBEDTLS_SSL_VERIFY_REQUIRED);
+  mbedtls_ssl_conf_ca_chain(&conf_, &ca_, nullptr);
+  mbedtls_ssl_conf_rng(&conf_, mbedtls_ctr_drbg_random, &drbg_);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+  mbedtls_ssl_conf_session_tickets(&conf_, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+  ret = mbedtls_ssl_conf_own_cert(&conf_, &cert_, &key_);
+  if (ret == 0)
+  {
+    ret = mbedtls_ssl_setup(&ssl_, &conf_); // the record buffers, once
+  }
+  if (ret == 0)
+  {
+    ret = mbedtls_ssl_set_hostname(&ssl_, server_name);
+  }
+  if (ret != 0)
+  {
+    LOG_ERROR("TLS setup failed: -0x%04x", (unsigned)-ret);
+    return false;
+  }
+  mbedtls_ssl_set_bio(&ssl_, &fd_, bio_send, bio_recv, nullptr);
+
+  // after power-on the RTC copy is gone, the NVS one is still good
+  if (rtc_session.magic != TLS_SESSION_MAGIC)
+  {
+    session_load_nvs();
+  }
+  ready_ = true;
+  return true;
+}
+
+bool TlsClient::wait_socket(bool readable, uint32_t timeout_ms)
+{
+  fd_set set;
+  FD_ZERO(&set);
+  FD_SET(fd_, &set);
+  struct timeval tv = {(time_t)(timeout_ms / 1000), (suseconds_t)(timeout_ms % 1000 * 1000)};
+  return lwip_select(fd_ + 1, readable ? &set : nullptr, readable ? nullptr : &set, nullptr, &tv) > 0;
+}
+
+bool TlsClient::open_socket(IPAddress ip, uint16_t port)
+{
+  fd_ = lwip_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (fd_ < 0)
+  {
+    return false;
+  }
+  lwip_fcntl(fd_, F_SETFL, lwip_fcntl(fd_, F_GETFL, 0) | O_NONBLOCK);
+
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = (uint32_t)ip;
+  if (lwip_connect(fd_, (struct sockaddr *)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS)
+  {
+    return false;
+  }
+  int error = 0;
+  socklen_t len = sizeof(error);
+  if (!wait_socket(false, TLS_CONNECT_TIMEOUT_MS) ||
+      lwip_getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0)
+  {
+    return false;
+  }
+  int one = 1; // MQTT packets are small and latency matters more than segments
+  lwip_setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return true;
+}
+
+bool TlsClient::handshake()
+{
+  mbedtls_ssl_session_reset(&ssl_);
+
+  // a resumed handshake keeps the master secret, a full one derives a new one
+  uint8_t offered_master[48];
+  bool offered = false;
+  if (rtc_session.magic == TLS_SESSION_MAGIC)
+  {
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    if (mbedtls_ssl_session_load(&session, rtc_session.data, rtc_session.len) == 0 &&
+        mbedtls_ssl_set_session(&ssl_, &session) == 0)
+    {
+      memcpy(offered_master, session.master, sizeof(offered_master));
+      offered = true;
+    }
+    mbedtls_ssl_session_free(&session);
+  }
+
+  uint32_t start = millis();
+  int ret;
+  while ((ret = mbedtls_ssl_handshake(&ssl_)) != 0)
+  {
+    if (!would_block(ret) || millis() - start > TLS_HANDSHAKE_TIMEOUT_MS)
+    {
+      LOG_WARN("TLS handshake failed: -0x%04x%s", (unsigned)-ret,
+               offered ? ", dropping the cached session" : "");
+      if (offered)
+      {
+        session_forget(); // in case the broker chokes on it
+      }
+      stats_.failures++;
+      return false;
+    }
+    wait_socket(ret == MBEDTLS_ERR_SSL_WANT_READ, 50);
+  }
+  uint32_t elapsed_ms = millis() - start;
+
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+  bool resumed = false;
+  if (mbedtls_ssl_get_session(&ssl_, &session) == 0)
+  {
+    resumed = offered && memcmp(session.master, offered_master, sizeof(offered_master)) == 0;
+    // even a resumed session may come with a fresh ticket
+    session_store(session, !resumed);
+  }
+  mbedtls_ssl_session_free(&session);
+
+  stats_.handshakes++;
+  stats_.resumed += resumed;
+  stats_.last_ms = elapsed_ms;
+  stats_.last_resumed = resumed;
+  LOG_INFO("TLS %s handshake in %lu ms", resumed ? "resumed" : "full", (unsigned long)elapsed_ms);
+  return true;
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port)
+{
+  stop();
+  if (!ready_)
+  {
+    return 0;
+  }
+  if (!open_socket(ip, port) || !handshake())
+  {
+    stop();
+    return 0;
+  }
+  return 1;
+}
+
+int TlsClient::connect(const char *host, uint16_t port)
+{
+  IPAddress ip;
+  if (!WiFi.hostByName(host, ip))
+  {
+    return 0;
+  }
+  return connect(ip, port);
+}
+
+size_t TlsClient::write(uint8_t b)
+{
+  return write(&b, 1);
+}
+
+size_t TlsClient::write(const uint8_t *buf, size_t size)
+{
+  size_t sent = 0;
+  uint32_t start = millis();
+  while (fd_ >= 0 && sent < size)
+  {
+    int n = mbedtls_ssl_write(&ssl_, buf + sent, size - sent);
+    if (n > 0)
+    {
+      sent += n;
+    }
+    else if (!would_block(n) || millis() - start > TLS_IO_TIMEOUT_MS)
+    {
+      stop();
+    }
+    else
+    {
+      wait_socket(n == MBEDTLS_ERR_SSL_WANT_READ, 10);
+    }
+  }
+  return sent;
+}
+
+int TlsClient::available()
+{
+  if (fd_ < 0)
+  {
+    return 0;
+  }
+  // processes a pending record, if any, without consuming its data
+  int ret = mbedtls_ssl_read(&ssl_, nullptr, 0);
+  if (ret < 0 && !would_block(ret))
+  {
+    stop();
+    return peeked_ >= 0;
+  }
+  return (peeked_ >= 0) + (int)mbedtls_ssl_get_bytes_avail(&ssl_);
+}
+
+int TlsClient::read()
+{
+  uint8_t b;
+  return read(&b, 1) == 1 ? b : -1;
+}
+
+int TlsClient::read(uint8_t *buf, size_t size)
+{
+  if (size == 0)
+  {
+    return 0;
+  }
+  int got = 0;
+  if (peeked_ >= 0)
+  {
+    buf[got++] = (uint8_t)peeked_;
+    peeked_ = -1;
+    if (size == 1)
+    {
+      return 1;
+    }
+  }
+  if (fd_ < 0)
+  {
+    return got ? got : -1;
+  }
+  int n = mbedtls_ssl_read(&ssl_, buf + got, size - got);
+  if (n > 0)
+  {
+    return got + n;
+  }
+  if (!would_block(n))
+  {
+    stop(); // close notify or a broken record
+  }
+  return got ? got : -1;
+}
+
+int TlsClient::peek()
+{
+  if (peeked_ < 0)
+  {
+    uint8_t b;
+    if (read(&b, 1) == 1)
+    {
+      peeked_ = b;
+    }
+  }
+  return peeked_;
+}
+
+void TlsClient::stop()
+{
+  if (fd_ >= 0)
+  {
+    mbedtls_ssl_close_notify(&ssl_); // best effort, does not wait
+    lwip_close(fd_);
+    fd_ = -1;
+  }
+  peeked_ = -1;
+}
+
+uint8_t TlsClient::connected()
+{
+  if (fd_ >= 0)
+  {
+    // a FIN from the broker only shows up as a zero-length read
+    char c;
+    if (lwip_recv(fd_, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 0)
+    {
+      stop();
+    }
+  }
+  return fd_ >= 0 || peeked_ >= 0;
+}
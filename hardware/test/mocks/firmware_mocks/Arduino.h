@@ -0,0 +1,67 @@
+#pragma once
+
+// Host stand-in for the parts of Arduino-esp32 and FreeRTOS that the
+// natively built sources touch (env:native). Time comes from the host
+// clock; analogRead() from a generator set by the test.
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+
+#define INPUT 0x01
+#define INPUT_PULLUP 0x05
+#define FALLING 0x02
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void *TaskHandle_t;
+typedef void *SemaphoreHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portMAX_DELAY 0xFFFFFFFFu
+#define portYIELD_FROM_ISR(woken) (void)(woken)
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalPinToInterrupt(uint8_t pin);
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode);
+
+// Returns generator(pin, n) for the n-th conversion of that pin, 0 if unset
+int analogRead(uint8_t pin);
+void mock_analog_generator(int (*generator)(uint8_t pin, uint32_t n));
+
+// Tasks run inline on the host: a notify runs the task until it waits for
+// the next one, so whatever the task does for a notify is done when the
+// notify returns. A wait with nothing pending unwinds the task, and its
+// next notify starts it from the top again: tasks keep their state in
+// statics, not in locals of their loop.
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *name, uint32_t stack,
+                                   void *arg, UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t timeout);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+
+// While held, notifies are only counted; releasing runs the tasks that got
+// one. Lets a test look at work still queued for a task.
+void mock_tasks_hold(bool hold);
+
+// Binary semaphores. A take never blocks: nothing else would run meanwhile.
+SemaphoreHandle_t xSemaphoreCreateBinary();
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t timeout);
@@ -0,0 +1,10 @@
+#pragma once
+
+// Attenuation constants only; the ADC itself is not built natively
+typedef enum
+{
+  ADC_ATTEN_DB_0 = 0,
+  ADC_ATTEN_DB_2_5,
+  ADC_ATTEN_DB_6,
+  ADC_ATTEN_DB_11,
+} adc_atten_t;
@@ -0,0 +1,29 @@
+#pragma once
+
+// The pin calls of the I2C bus recovery, against the lines in i2c_fake.h
+#include <stdint.h>
+
+#include <esp_err.h>
+
+typedef int gpio_num_t;
+
+typedef enum
+{
+  GPIO_MODE_INPUT = 1,
+  GPIO_MODE_OUTPUT,
+  GPIO_MODE_INPUT_OUTPUT_OD,
+} gpio_mode_t;
+
+typedef enum
+{
+  GPIO_PULLUP_ONLY = 0,
+  GPIO_FLOATING,
+} gpio_pull_mode_t;
+
+#define GPIO_PULLUP_ENABLE true
+
+esp_err_t gpio_reset_pin(gpio_num_t pin);
+esp_err_t gpio_set_direction(gpio_num_t pin, gpio_mode_t mode);
+esp_err_t gpio_set_pull_mode(gpio_num_t pin, gpio_pull_mode_t pull);
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level);
+int gpio_get_level(gpio_num_t pin);
@@ -0,0 +1,65 @@
+#pragma once
+
+// The master half of the ESP-IDF I2C driver, run against the fake device
+// in i2c_fake.h, so src/i2c_bus.cpp is built natively as it is.
+#include <stddef.h>
+#include <stdint.h>
+
+#include <Arduino.h> // TickType_t
+#include <driver/gpio.h>
+
+typedef int i2c_port_t;
+#define I2C_NUM_0 0
+
+typedef enum
+{
+  I2C_MODE_SLAVE = 0,
+  I2C_MODE_MASTER,
+} i2c_mode_t;
+
+typedef enum
+{
+  I2C_MASTER_WRITE = 0,
+  I2C_MASTER_READ,
+} i2c_rw_t;
+
+typedef enum
+{
+  I2C_MASTER_ACK = 0,
+  I2C_MASTER_NACK,
+  I2C_MASTER_LAST_NACK,
+} i2c_ack_type_t;
+
+typedef struct
+{
+  i2c_mode_t mode;
+  int sda_io_num;
+  int scl_io_num;
+  bool sda_pullup_en;
+  bool scl_pullup_en;
+  struct
+  {
+    uint32_t clk_speed;
+  } master;
+  uint32_t clk_flags;
+} i2c_config_t;
+
+typedef void *i2c_cmd_handle_t;
+
+#define I2C_LINK_RECOMMENDED_SIZE(commands) (2 * (commands) * 20 + 8)
+
+esp_err_t i2c_param_config(i2c_port_t port, const i2c_config_t *conf);
+esp_err_t i2c_driver_install(i2c_port_t port, i2c_mode_t mode, size_t slave_rx_buf,
+                             size_t slave_tx_buf, int intr_flags);
+esp_err_t i2c_driver_delete(i2c_port_t port);
+
+i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t *buffer, uint32_t size);
+void i2c_cmd_link_delete_static(i2c_cmd_handle_t cmd);
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd);
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd);
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd, uint8_t data, bool ack_en);
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd, const uint8_t *data, size_t len, bool ack_en);
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd, uint8_t *data, size_t len, i2c_ack_type_t ack);
+
+// Runs the queued commands; nothing on the host takes real bus time
+esp_err_t i2c_master_cmd_begin(i2c_port_t port, i2c_cmd_handle_t cmd, TickType_t ticks);
@@ -0,0 +1,413 @@
+#include <chrono>
+
+#include <Arduino.h>
+#include <driver/i2c.h>
+
+#include "clock.h"
+#include "i2c_bus.h"
+#include "i2c_fake.h"
+
+static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+unsigned long micros()
+{
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+unsigned long millis()
+{
+  return micros() / 1000;
+}
+
+void delay(unsigned long ms)
+{
+  delayMicroseconds(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  unsigned long until = micros() + us;
+  while ((long)(micros() - until) < 0)
+  {
+  }
+}
+
+void pinMode(uint8_t, uint8_t) {}
+
+int digitalPinToInterrupt(uint8_t pin)
+{
+  return pin;
+}
+
+void attachInterrupt(uint8_t, void (*)(), int) {}
+
+static int (*analog_generator)(uint8_t, uint32_t) = nullptr;
+static uint32_t analog_reads[256];
+
+int analogRead(uint8_t pin)
+{
+  return analog_generator ? analog_generator(pin, analog_reads[pin]++) : 0;
+}
+
+void mock_analog_generator(int (*generator)(uint8_t pin, uint32_t n))
+{
+  analog_generator = generator;
+  memset(analog_reads, 0, sizeof(analog_reads));
+}
+
+// --- Tasks and semaphores, run inline (Arduino.h) ---
+#define MOCK_MAX_TASKS 8
+#define MOCK_MAX_SEMAPHORES 8
+
+struct MockTask
+{
+  TaskFunction_t function;
+  void *arg;
+  uint32_t notifications;
+  bool running;
+};
+
+struct TaskBlocked
+{
+};
+
+static MockTask tasks[MOCK_MAX_TASKS];
+static size_t task_count = 0;
+static MockTask *current_task = nullptr;
+static bool tasks_held = false;
+
+static void run_task(MockTask &task)
+{
+  if (task.running || tasks_held)
+  {
+    return; // picks the notification up at its next wait
+  }
+  MockTask *caller = current_task;
+  current_task = &task;
+  task.running = true;
+  try
+  {
+    task.function(task.arg);
+  }
+  catch (const TaskBlocked &)
+  {
+  }
+  task.running = false;
+  current_task = caller;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *, uint32_t, void *arg,
+                                   UBaseType_t, TaskHandle_t *handle, BaseType_t)
+{
+  if (task_count >= MOCK_MAX_TASKS)
+  {
+    return pdFALSE;
+  }
+  MockTask &task = tasks[task_count++];
+  task = {function, arg, 0, false};
+  if (handle != nullptr)
+  {
+    *handle = &task;
+  }
+  return pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t timeout)
+{
+  if (current_task == nullptr)
+  {
+    return 0;
+  }
+  uint32_t count = current_task->notifications;
+  if (count > 0)
+  {
+    current_task->notifications = clear ? 0 : count - 1;
+    return count;
+  }
+  if (timeout == 0)
+  {
+    return 0;
+  }
+  throw TaskBlocked();
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t handle)
+{
+  MockTask *task = (MockTask *)handle;
+  if (task != nullptr)
+  {
+    task->notifications++;
+    run_task(*task);
+  }
+  return pdTRUE;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t handle, BaseType_t *)
+{
+  xTaskNotifyGive(handle);
+}
+
+void mock_tasks_hold(bool hold)
+{
+  tasks_held = hold;
+  for (size_t i = 0; !hold && i < task_count; i++)
+  {
+    if (tasks[i].notifications > 0)
+    {
+      run_task(tasks[i]);
+    }
+  }
+}
+
+static bool semaphores[MOCK_MAX_SEMAPHORES];
+static size_t semaphore_count = 0;
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+  return semaphore_count < MOCK_MAX_SEMAPHORES ? &semaphores[semaphore_count++] : nullptr;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+  *(bool *)semaphore = true;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t)
+{
+  bool given = *(bool *)semaphore;
+  *(bool *)semaphore = false;
+  return given ? pdTRUE : pdFALSE;
+}
+
+// --- driver/i2c.h and driver/gpio.h against the fake in i2c_fake.h ---
+static I2cFake mpu6050_fake()
+{
+  I2cFake fake = {};
+  fake.address = 0x68;
+  fake.present = true;
+  fake.registers[0x75] = 0x68; // WHO_AM_I
+  return fake;
+}
+I2cFake i2c_fake = mpu6050_fake();
+
+static bool driver_installed = false;
+static uint32_t configured_hz = 0;
+
+esp_err_t i2c_param_config(i2c_port_t, const i2c_config_t *conf)
+{
+  configured_hz = conf->master.clk_speed;
+  return ESP_OK;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t, i2c_mode_t, size_t, size_t, int)
+{
+  if (driver_installed)
+  {
+    return ESP_ERR_INVALID_STATE;
+  }
+  driver_installed = true;
+  i2c_fake.installs++;
+  return ESP_OK;
+}
+
+esp_err_t i2c_driver_delete(i2c_port_t)
+{
+  driver_installed = false;
+  return ESP_OK;
+}
+
+enum FakeOpKind : uint8_t
+{
+  FAKE_START,
+  FAKE_STOP,
+  FAKE_WRITE,
+  FAKE_READ,
+};
+
+struct FakeOp
+{
+  FakeOpKind kind;
+  uint8_t byte; // FAKE_WRITE of a single byte, data is null
+  const uint8_t *data;
+  uint8_t *rx;
+  size_t len;
+};
+
+struct FakeCmd
+{
+  FakeOp ops[8];
+  size_t count;
+};
+
+static FakeCmd fake_cmd;
+
+static esp_err_t queue(i2c_cmd_handle_t cmd, const FakeOp &op)
+{
+  FakeCmd &c = *(FakeCmd *)cmd;
+  if (c.count >= sizeof(c.ops) / sizeof(c.ops[0]))
+  {
+    return ESP_ERR_NO_MEM;
+  }
+  c.ops[c.count++] = op;
+  return ESP_OK;
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t *buffer, uint32_t)
+{
+  if (buffer == nullptr)
+  {
+    return nullptr;
+  }
+  fake_cmd.count = 0;
+  return &fake_cmd;
+}
+
+void i2c_cmd_link_delete_static(i2c_cmd_handle_t) {}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd)
+{
+  return queue(cmd, {FAKE_START, 0, nullptr, nullptr, 0});
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd)
+{
+  return queue(cmd, {FAKE_STOP, 0, nullptr, nullptr, 0});
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd, uint8_t data, bool)
+{
+  return queue(cmd, {FAKE_WRITE, data, nullptr, nullptr, 1});
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd, const uint8_t *data, size_t len, bool)
+{
+  return queue(cmd, {FAKE_WRITE, 0, data, nullptr, len});
+}
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd, uint8_t *data, size_t len, i2c_ack_type_t)
+{
+  return queue(cmd, {FAKE_READ, 0, nullptr, data, len});
+}
+
+esp_err_t i2c_master_cmd_begin(i2c_port_t, i2c_cmd_handle_t cmd, TickType_t)
+{
+  if (!driver_installed)
+  {
+    return ESP_ERR_INVALID_STATE;
+  }
+  i2c_fake.transactions++;
+  i2c_fake.clock_hz = configured_hz;
+  if (i2c_fake.hang > 0 || i2c_fake.sda_held_clocks > 0)
+  {
+    if (i2c_fake.hang > 0)
+    {
+      i2c_fake.hang--;
+    }
+    return ESP_ERR_TIMEOUT;
+  }
+
+  static uint8_t pointer = 0;
+  const FakeCmd &c = *(const FakeCmd *)cmd;
+  bool address_next = false;
+  size_t data_bytes = 0;
+  for (size_t i = 0; i < c.count; i++)
+  {
+    const FakeOp &op = c.ops[i];
+    if (op.kind == FAKE_START)
+    {
+      address_next = true;
+    }
+    else if (op.kind == FAKE_READ)
+    {
+      for (size_t n = 0; n < op.len; n++)
+      {
+        op.rx[n] = i2c_fake.registers[pointer++];
+      }
+      data_bytes += op.len;
+    }
+    else if (op.kind == FAKE_WRITE)
+    {
+      for (size_t n = 0; n < op.len; n++)
+      {
+        uint8_t byte = op.data != nullptr ? op.data[n] : op.byte;
+        if (address_next)
+        {
+          address_next = false;
+          if (!i2c_fake.present || (byte >> 1) != i2c_fake.address)
+          {
+            return ESP_FAIL; // no ACK
+          }
+        }
+        else if (n == 0 && data_bytes == 0)
+        {
+          pointer = byte;
+          data_bytes++;
+        }
+        else
+        {
+          i2c_fake.registers[pointer++] = byte;
+          data_bytes++;
+        }
+      }
+    }
+  }
+  if (data_bytes == 0)
+  {
+    i2c_fake.probes++;
+  }
+  return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t)
+{
+  return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t, gpio_mode_t)
+{
+  return ESP_OK;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t, gpio_pull_mode_t)
+{
+  return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level)
+{
+  if (pin == I2C_SCL_PIN && level == 0)
+  {
+    i2c_fake.scl_pulses++;
+    if (i2c_fake.sda_held_clocks > 0)
+    {
+      i2c_fake.sda_held_clocks--;
+    }
+  }
+  return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t pin)
+{
+  return pin == I2C_SDA_PIN && i2c_fake.sda_held_clocks > 0 ? 0 : 1;
+}
+
+// --- clock.h: host time, never synced ---
+uint64_t clock_us()
+{
+  return micros();
+}
+
+void clock_begin() {}
+
+int64_t clock_epoch_offset_us()
+{
+  return 0;
+}
+
+bool clock_synced()
+{
+  return false;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <Arduino.h>
+
+// The host I2C bus (driver/i2c.h) has one device on it, a fake register
+// file: the first written byte sets the register pointer, further bytes
+// are stored from there on, reads return bytes from there on. Good enough
+// for the MPU6050 in mpu_fifo.cpp. The real src/i2c_bus.cpp runs on top,
+// bus task included (inline, see Arduino.h).
+struct I2cFake
+{
+  uint8_t registers[256];
+  uint8_t address;
+  bool present;
+
+  // Faults, set by the test
+  uint32_t hang;            // transactions to come that end in a driver timeout
+  uint32_t sda_held_clocks; // SCL pulses until a slave stuck mid-byte releases SDA
+
+  // Seen on the bus
+  uint32_t transactions;
+  uint32_t probes;       // address only, no data
+  uint32_t installs;     // driver installs, one per recovery after the first
+  uint32_t scl_pulses;   // clocked by hand
+  uint32_t clock_hz;     // as last configured
+};
+
+extern I2cFake i2c_fake;
@@ -0,0 +1,252 @@
+// Throughput baseline of the sample path, the same code on the host
+// (pio test -e native -f test_bench) and on the board (pio test -e esp32-bench).
+// Every result is one line "BENCH <name> <value> <unit>" for diffing runs.
+
+#include <unity.h>
+
+#include <Arduino.h>
+#ifndef ARDUINO
+#include <i2c_fake.h>
+#endif
+
+#include "adc_filter.h"
+#include "batch_codec.h"
+#include "config.h"
+#include "frame_batcher.h"
+#include "i2c_bus.h"
+#include "mpu_fifo.h"
+#include "network.h"
+#include "telemetry.h"
+
+#define BENCH_SAMPLES 20000
+#define BENCH_ADC_SAMPLES 200000
+#define BENCH_MPU_READS 2000
+
+void setUp() {}
+void tearDown() {}
+
+static void report(const char *name, double value, const char *unit)
+{
+  char line[96];
+  snprintf(line, sizeof(line), "BENCH %s %.1f %s", name, value, unit);
+  TEST_MESSAGE(line);
+}
+
+static double per_second(uint32_t count, uint32_t elapsed_us)
+{
+  return elapsed_us ? count * 1e6 / elapsed_us : 0;
+}
+
+// Plausible, changing values so the encoders do not see a constant
+static TelemetrySample make_sample(uint32_t i)
+{
+  TelemetrySample sample = {};
+  sample.timestamp_us = 1000000 + (uint64_t)i * PUBLISH_PERIOD_US;
+  sample.acceleration_x = (int32_t)(i * 37 % 4000) - 2000;
+  sample.acceleration_y = (int32_t)(i * 53 % 4000) - 2000;
+  sample.acceleration_z = 9807 + (int32_t)(i % 50);
+  sample.gyro_x = (int32_t)(i % 300) - 150;
+  sample.gyro_y = (int32_t)(i * 7 % 300) - 150;
+  sample.gyro_z = (int32_t)(i * 11 % 300) - 150;
+  sample.temperature = 2500 + (int32_t)(i % 100);
+  sample.flame_status = 1;
+  sample.gas_level = 700 + i % 64;
+  sample.dht_temperature_deci = 215;
+  sample.dht_humidity_deci = 480;
+  sample.motor_adc_value = 300 + i % 16;
+  sample.motor_mean_deci = 3050 + i % 100;
+  sample.motor_rms_deci = 120 + i % 10;
+  sample.motor_peak_deci = 300 + i % 30;
+  return sample;
+}
+
+// 1 kHz-ish test tone plus noise and the odd spike, in ADC counts
+static int32_t adc_signal(uint32_t n)
+{
+  int32_t value = 2000 + (int32_t)(n % 10) * 40 + (int32_t)(n * 2654435761u >> 28);
+  return n % 97 == 0 ? 4095 : value;
+}
+
+void bench_mpu_read()
+{
+#ifndef ARDUINO
+  const uint8_t frame[14] = {0x01, 0x00, 0xFF, 0x00, 0x40, 0x00, 0xF1, 0x00, 0, 0x41, 0, 0, 0, 0};
+  memcpy(&i2c_fake.registers[0x3B], frame, sizeof(frame));
+#endif
+  MpuRawSample raw;
+  if (!i2c_bus_begin(I2C_SDA_PIN, I2C_SCL_PIN, 1) || !mpu_begin() || !mpu_read_raw(raw))
+  {
+    TEST_IGNORE_MESSAGE("no MPU6050 on the bus");
+  }
+
+  int32_t sink = 0;
+  uint32_t start = micros();
+  for (int i = 0; i < BENCH_MPU_READS; i++)
+  {
+    mpu_read_raw(raw);
+    sink += mpu_accel_mm_s2(raw.ax) + mpu_gyro_mrad_s(raw.gx) + mpu_temp_centi(raw.temp);
+  }
+  uint32_t elapsed = micros() - start;
+  TEST_ASSERT_NOT_EQUAL(INT32_MIN, sink); // keeps the loop
+  report("mpu_read", per_second(BENCH_MPU_READS, elapsed), "samples/s");
+}
+
+template <typename Chain>
+static double filter_rate(Chain &chain)
+{
+  int32_t out = 0, sink = 0;
+  uint32_t start = micros();
+  for (uint32_t n = 0; n < BENCH_ADC_SAMPLES; n++)
+  {
+    if (chain.process(adc_signal(n), out))
+    {
+      sink += out;
+    }
+  }
+  uint32_t elapsed = micros() - start;
+  TEST_ASSERT_NOT_EQUAL(INT32_MIN, sink);
+  return per_second(BENCH_ADC_SAMPLES, elapsed);
+}
+
+void bench_adc_dma_filters()
+{
+  // the DMA task runs both chains at ADC_SAMPLE_RATE_HZ each
+  MotorDmaFilter motor;
+  GasDmaFilter gas;
+  gas.stage<2>().lowpass(ADC_GAS_LOWPASS_HZ, ADC_SAMPLE_RATE_HZ / ADC_GAS_DECIMATION);
+  report("filter_motor_dma", filter_rate(motor), "samples/s");
+  report("filter_gas_dma", filter_rate(gas), "samples/s");
+}
+
+#ifndef ARDUINO
+static int mock_adc(uint8_t, uint32_t n)
+{
+  return adc_signal(n);
+}
+#endif
+
+void bench_adc_polled()
+{
+#ifndef ARDUINO
+  mock_analog_generator(mock_adc);
+#endif
+  GasPolledFilter gas;
+  int32_t out = 0, sink = 0;
+  const uint32_t readings = BENCH_SAMPLES / 10;
+  uint32_t start = micros();
+  for (uint32_t r = 0; r < readings; r++)
+  {
+    for (int i = 0; i < ADC_POLLED_OVERSAMPLE; i++)
+    {
+      gas.process(analogRead(GAS_PIN), out);
+    }
+    sink += out;
+  }
+  uint32_t elapsed = micros() - start;
+  TEST_ASSERT_NOT_EQUAL(INT32_MIN, sink);
+  report("adc_polled_gas", per_second(readings, elapsed), "readings/s");
+}
+
+void bench_encode_json()
+{
+  char json[TELEMETRY_JSON_MAX];
+  uint64_t bytes = 0;
+  uint32_t start = micros();
+  for (uint32_t i = 0; i < BENCH_SAMPLES; i++)
+  {
+    bytes += format_telemetry_json(make_sample(i), json, sizeof(json));
+  }
+  uint32_t elapsed = micros() - start;
+  report("encode_json", per_second(BENCH_SAMPLES, elapsed), "samples/s");
+  report("encode_json_size", (double)bytes / BENCH_SAMPLES, "bytes/sample");
+}
+
+void bench_encode_binary()
+{
+  TelemetryFrame frame;
+  uint64_t bytes = 0;
+  uint32_t start = micros();
+  for (uint32_t i = 0; i < BENCH_SAMPLES; i++)
+  {
+    bytes += encode_telemetry_binary(make_sample(i), frame);
+  }
+  uint32_t elapsed = micros() - start;
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_SCHEMA_VERSION, frame.version);
+  report("encode_binary", per_second(BENCH_SAMPLES, elapsed), "samples/s");
+  report("encode_binary_size", (double)bytes / BENCH_SAMPLES, "bytes/sample");
+}
+
+static uint8_t compressed[BATCH_MAX_BYTES];
+static uint64_t compressed_bytes;
+static uint32_t compress_us;
+
+static size_t take_batch(FrameBatcher &batcher)
+{
+  static const uint8_t fields[] = {TELEMETRY_FRAME_FIELDS};
+  uint32_t start = micros();
+  size_t len = batch_compress(batcher.data(), batcher.size(), fields, sizeof(fields), compressed,
+                              sizeof(compressed));
+  compress_us += micros() - start;
+  compressed_bytes += len ? len : batcher.size();
+  size_t size = batcher.size();
+  batcher.clear();
+  return size;
+}
+
+void bench_encode_batch()
+{
+  static FrameBatcher batcher;
+  batcher.begin(TELEMETRY_BATCH_VERSION, BATCH_MAX_SAMPLES, BATCH_MAX_AGE_MS);
+  compressed_bytes = 0;
+  compress_us = 0;
+  TelemetryFrame frame;
+  uint64_t bytes = 0;
+  uint32_t start = micros();
+  for (uint32_t i = 0; i < BENCH_SAMPLES; i++)
+  {
+    TelemetrySample sample = make_sample(i);
+    encode_telemetry_binary(sample, frame);
+    if (!batcher.append(sample.timestamp_us, &frame, sizeof(frame)))
+    {
+      bytes += take_batch(batcher);
+      batcher.append(sample.timestamp_us, &frame, sizeof(frame));
+    }
+    else if (batcher.should_flush(sample.timestamp_us))
+    {
+      bytes += take_batch(batcher);
+    }
+  }
+  bytes += batcher.empty() ? 0 : take_batch(batcher);
+  uint32_t elapsed = micros() - start - compress_us;
+  report("encode_batch", per_second(BENCH_SAMPLES, elapsed), "samples/s");
+  report("encode_batch_size", (double)bytes / BENCH_SAMPLES, "bytes/sample");
+  report("compress_batch", per_second(BENCH_SAMPLES, compress_us), "samples/s");
+  report("compress_batch_size", (double)compressed_bytes / BENCH_SAMPLES, "bytes/sample");
+}
+
+int run_tests()
+{
+  UNITY_BEGIN();
+  RUN_TEST(bench_mpu_read);
+  RUN_TEST(bench_adc_dma_filters);
+  RUN_TEST(bench_adc_polled);
+  RUN_TEST(bench_encode_json);
+  RUN_TEST(bench_encode_binary);
+  RUN_TEST(bench_encode_batch);
+  return UNITY_END();
+}
+
+#ifdef ARDUINO
+void setup()
+{
+  delay(2000); // the test runner opens the port after reset
+  run_tests();
+}
+
+void loop() {}
+#else
+int main()
+{
+  return run_tests();
+}
+#endif
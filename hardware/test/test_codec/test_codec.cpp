@@ -0,0 +1,625 @@
+#include <string.h>
+#include <unity.h>
+
+#include <i2c_fake.h>
+
+#include "batch_codec.h"
+#include "delta_patch.h"
+#include "frame_batcher.h"
+#include "frame_pool.h"
+#include "i2c_bus.h"
+#include "mpu_fifo.h"
+#include "ota_transfer.h"
+#include "perf_histogram.h"
+#include "settings.h"
+#include "telemetry.h"
+
+// Idempotent; the bus task runs inline on the host (mocks/Arduino.h)
+void setUp()
+{
+  i2c_bus_begin(I2C_SDA_PIN, I2C_SCL_PIN, 1);
+}
+void tearDown() {}
+
+static TelemetrySample make_sample()
+{
+  TelemetrySample sample = {};
+  sample.timestamp_us = 123456789;
+  sample.acceleration_x = -1234; // mm/s^2
+  sample.acceleration_y = 50000; // clamps to int16 on the wire
+  sample.acceleration_z = 9807;
+  sample.gyro_x = 5;
+  sample.temperature = 2534; // 0.01 degC
+  sample.flame_status = 1;
+  sample.gas_level = 812;
+  sample.dht_temperature_deci = -15;
+  sample.dht_humidity_deci = 456;
+  sample.motor_adc_value = 300;
+  sample.motor_mean_deci = 3005;
+  return sample;
+}
+
+void test_binary_frame_fields()
+{
+  TelemetryFrame frame;
+  TEST_ASSERT_EQUAL(30, encode_telemetry_binary(make_sample(), frame));
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_SCHEMA_VERSION, frame.version);
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_FLAG_FLAME, frame.flags);
+  TEST_ASSERT_EQUAL_INT16(-1234, frame.acceleration[0]);
+  TEST_ASSERT_EQUAL_INT16(INT16_MAX, frame.acceleration[1]);
+  TEST_ASSERT_EQUAL_INT16(2534, frame.temperature);
+  TEST_ASSERT_EQUAL_INT16(-150, frame.dht_temperature_centi);
+  TEST_ASSERT_EQUAL_UINT16(4560, frame.dht_humidity_centi);
+  TEST_ASSERT_EQUAL_UINT16(3005, frame.motor_mean_deci);
+}
+
+void test_json_fixed_point()
+{
+  char json[TELEMETRY_JSON_MAX];
+  size_t len = format_telemetry_json(make_sample(), json, sizeof(json));
+  TEST_ASSERT_EQUAL(strlen(json), len);
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"acceleration_x\":-1.234,"));
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"temperature\":25.34,"));
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"temperature_out\":-1.5,"));
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"timestamp_us\":123456789,"));
+
+  TEST_ASSERT_EQUAL(0, format_telemetry_json(make_sample(), json, len)); // no room for the NUL
+}
+
+void test_flame_alarm_json_carries_seq()
+{
+  AlarmEvent event = {};
+  event.timestamp_us = 42;
+  event.type = ALARM_FLAME;
+  event.active = true;
+  event.value = 1;
+  char json[ALARM_JSON_MAX];
+  format_alarm_json(event, json, sizeof(json));
+  TEST_ASSERT_NULL(strstr(json, "\"seq\""));
+  event.seq = 7;
+  size_t len = format_alarm_json(event, json, sizeof(json));
+  TEST_ASSERT_EQUAL(strlen(json), len);
+  TEST_ASSERT_NOT_NULL(strstr(json, "{\"alarm\":\"flame\",\"active\":true,\"value\":1,\"seq\":7,"));
+  TEST_ASSERT_EQUAL(0, format_alarm_json(event, json, len)); // no room for the NUL
+}
+
+void test_json_escape()
+{
+  char out[32];
+  TEST_ASSERT_EQUAL_STRING("unknown key a\\\"b\\\\c",
+                           json_escape("unknown key a\"b\\c", out, sizeof(out)));
+  TEST_ASSERT_EQUAL_STRING("tab\\u0009", json_escape("tab\t", out, sizeof(out)));
+  // cut short at a whole escape, never half of one
+  char small[4];
+  TEST_ASSERT_EQUAL_STRING("ab", json_escape("ab\"c", small, sizeof(small)));
+}
+
+void test_batch_layout()
+{
+  FrameBatcher batcher;
+  batcher.begin(TELEMETRY_BATCH_VERSION, 3, 500);
+  const uint8_t record[2] = {0xAA, 0xBB};
+  TEST_ASSERT_TRUE(batcher.append(1000000, record, sizeof(record)));
+  TEST_ASSERT_TRUE(batcher.append(1000250, record, sizeof(record)));
+  TEST_ASSERT_FALSE(batcher.should_flush(1000250));
+  TEST_ASSERT_TRUE(batcher.should_flush(1000000 + 500000)); // age
+  batcher.set_epoch_offset(-2);
+
+  const uint8_t *p = batcher.data();
+  TEST_ASSERT_EQUAL(BATCH_HEADER_BYTES + 2 * 6, batcher.size());
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_BATCH_VERSION, p[0]);
+  TEST_ASSERT_EQUAL_UINT8(2, p[1]);
+  uint64_t base;
+  memcpy(&base, p + 2, sizeof(base)); // little-endian host
+  TEST_ASSERT_EQUAL_UINT64(1000000, base);
+  TEST_ASSERT_EQUAL_UINT8(0xFE, p[10]);
+  uint32_t dt;
+  memcpy(&dt, p + BATCH_HEADER_BYTES + 6, sizeof(dt));
+  TEST_ASSERT_EQUAL_UINT32(250, dt);
+
+  TEST_ASSERT_TRUE(batcher.append(1000300, record, sizeof(record)));
+  TEST_ASSERT_FALSE(batcher.append(1000400, record, sizeof(record))); // max_records
+  TEST_ASSERT_FALSE(batcher.append(1, record, sizeof(record)));
+}
+
+// A full batch of slowly drifting samples, with jitter on the timestamps
+static void fill_batch(FrameBatcher &batcher)
+{
+  batcher.begin(TELEMETRY_BATCH_VERSION, 50, 500);
+  TelemetrySample sample = make_sample();
+  for (int i = 0; i < 50; i++)
+  {
+    sample.timestamp_us += 10000 + (i % 3) * 7;
+    sample.acceleration_x += (i % 5) - 2;
+    sample.acceleration_z += (i % 7) - 3;
+    sample.gyro_x = (i % 4) - 2;
+    sample.gas_level += i % 2;
+    sample.motor_mean_deci -= 3;
+    TelemetryFrame frame;
+    encode_telemetry_binary(sample, frame);
+    TEST_ASSERT_TRUE(batcher.append(sample.timestamp_us, &frame, sizeof(frame)));
+  }
+}
+
+void test_batch_compression_round_trip()
+{
+  static const uint8_t fields[] = {TELEMETRY_FRAME_FIELDS};
+  FrameBatcher batcher;
+  fill_batch(batcher);
+
+  uint8_t compressed[BATCH_MAX_BYTES];
+  size_t len = batch_compress(batcher.data(), batcher.size(), fields, sizeof(fields), compressed,
+                              sizeof(compressed));
+  TEST_ASSERT_GREATER_THAN(BATCH_HEADER_BYTES, len);
+  TEST_ASSERT_LESS_THAN(batcher.size() / 4, len); // 1718 bytes raw
+  TEST_ASSERT_EQUAL_UINT8(TELEMETRY_BATCH_VERSION | BATCH_COMPRESSED_FLAG, compressed[0]);
+
+  uint8_t restored[BATCH_MAX_BYTES];
+  TEST_ASSERT_EQUAL(batcher.size(),
+                    batch_decompress(compressed, len, fields, sizeof(fields), restored, sizeof(restored)));
+  TEST_ASSERT_EQUAL_MEMORY(batcher.data(), restored, batcher.size());
+
+  // truncated input is rejected, not read past
+  TEST_ASSERT_EQUAL(0, batch_decompress(compressed, len - 1, fields, sizeof(fields), restored,
+                                        sizeof(restored)));
+}
+
+void test_batch_compression_gives_up_when_not_smaller()
+{
+  static const uint8_t fields[] = {TELEMETRY_FRAME_FIELDS};
+  FrameBatcher batcher;
+  fill_batch(batcher);
+  uint8_t small[64];
+  TEST_ASSERT_EQUAL(0, batch_compress(batcher.data(), batcher.size(), fields, sizeof(fields), small,
+                                      sizeof(small)));
+  // a record layout that does not add up to the frame
+  TEST_ASSERT_EQUAL(0, batch_compress(batcher.data(), batcher.size(), fields, sizeof(fields) - 1,
+                                      small, sizeof(small)));
+}
+
+void test_mpu_begin_sets_ranges_and_motion_interrupt()
+{
+  TEST_ASSERT_TRUE(mpu_begin());
+  TEST_ASSERT_EQUAL_HEX8(0x01, i2c_fake.registers[0x6B]); // awake, PLL clock
+  TEST_ASSERT_EQUAL_HEX8(0x04, i2c_fake.registers[0x1C]); // +-2 g, 0.63 Hz high-pass
+  TEST_ASSERT_EQUAL_HEX8(0x08, i2c_fake.registers[0x1B]); // +-500 deg/s
+  TEST_ASSERT_EQUAL_HEX8(0x40, i2c_fake.registers[0x38]); // motion interrupt only
+  TEST_ASSERT_EQUAL_HEX8(0xA0, i2c_fake.registers[0x37]); // active low, latched
+  TEST_ASSERT_TRUE(mpu_online());
+
+  i2c_fake.present = false; // a missing chip fails instead of hanging setup()
+  TEST_ASSERT_FALSE(mpu_begin());
+  TEST_ASSERT_FALSE(mpu_online());
+  i2c_fake.present = true;
+  TEST_ASSERT_TRUE(mpu_begin());
+}
+
+void test_mpu_burst_read_parses_big_endian()
+{
+  const uint8_t frame[14] = {0xFF, 0x38, 0x00, 0x10, 0x40, 0x00, 0xF1, 0x00,
+                             0x00, 0x41, 0xFF, 0xFF, 0x00, 0x00};
+  memcpy(&i2c_fake.registers[0x3B], frame, sizeof(frame));
+  MpuRawSample raw;
+  TEST_ASSERT_TRUE(mpu_read_raw(raw));
+  TEST_ASSERT_EQUAL_INT16(-200, raw.ax);
+  TEST_ASSERT_EQUAL_INT16(16384, raw.az); // 1 g at +-2 g
+  TEST_ASSERT_EQUAL_INT32(9807, mpu_accel_mm_s2(raw.az));
+  TEST_ASSERT_EQUAL_INT16(-1, raw.gy);
+
+  i2c_fake.present = false;
+  TEST_ASSERT_FALSE(mpu_read_raw(raw));
+  i2c_fake.present = true;
+}
+
+static Settings valid_settings()
+{
+  Settings settings = {};
+  settings.version = SETTINGS_VERSION;
+  settings.mpu_period_us = 5000;
+  settings.motor_period_us = 2000;
+  settings.flame_period_us = 50000;
+  settings.gas_period_us = 100000;
+  settings.dht_period_us = 2000000;
+  settings.publish_period_us = 10000;
+  settings.batch_max_samples = 50;
+  settings.batch_max_age_ms = 500;
+  settings.heartbeat_ms = 10000;
+  settings.gas_alarm_level = 940;
+  settings.gas_lowpass_hz = 10;
+  return settings;
+}
+
+static I2cDevice mpu_direct; // a second handle on the MPU6050, for raw transactions
+static I2cDevice absent;     // nothing answers at its address
+static const uint8_t who_am_i = 0x75;
+
+static void begin_bus_devices()
+{
+  TEST_ASSERT_TRUE(mpu_direct.begin(0x68, 400000));
+  TEST_ASSERT_TRUE(absent.begin(0x50, 100000));
+}
+
+void test_i2c_bus_handshake()
+{
+  begin_bus_devices();
+  uint8_t id = 0;
+  mock_tasks_hold(true);
+  TEST_ASSERT_EQUAL(I2C_PENDING, mpu_direct.post(&who_am_i, 1, &id, 1));
+  TEST_ASSERT_TRUE(mpu_direct.busy());
+  TEST_ASSERT_EQUAL(I2C_BUSY, mpu_direct.post(&who_am_i, 1, &id, 1));
+  TEST_ASSERT_EQUAL(I2C_PENDING, mpu_direct.wait(0));
+  mock_tasks_hold(false);
+  TEST_ASSERT_FALSE(mpu_direct.busy());
+  TEST_ASSERT_EQUAL(I2C_OK, mpu_direct.wait(0));
+  TEST_ASSERT_EQUAL_HEX8(0x68, id);
+
+  // a result nobody collected does not answer the next transaction
+  TEST_ASSERT_EQUAL(I2C_PENDING, mpu_direct.post(&who_am_i, 1, &id, 1));
+  mock_tasks_hold(true);
+  TEST_ASSERT_EQUAL(I2C_PENDING, mpu_direct.post(&who_am_i, 1, &id, 1));
+  TEST_ASSERT_EQUAL(I2C_PENDING, mpu_direct.wait(0));
+  mock_tasks_hold(false);
+  TEST_ASSERT_EQUAL(I2C_OK, mpu_direct.wait(0));
+}
+
+void test_i2c_bus_serves_every_device_at_its_clock()
+{
+  begin_bus_devices();
+  uint8_t id = 0, none = 0;
+  mock_tasks_hold(true);
+  TEST_ASSERT_EQUAL(I2C_PENDING, absent.post(&who_am_i, 1, &none, 1));
+  TEST_ASSERT_EQUAL(I2C_PENDING, mpu_direct.post(&who_am_i, 1, &id, 1));
+  uint32_t nacks = i2c_bus_stats().nacks;
+  mock_tasks_hold(false);
+  TEST_ASSERT_EQUAL(I2C_NACK, absent.wait(0));
+  TEST_ASSERT_EQUAL(I2C_OK, mpu_direct.wait(0));
+  TEST_ASSERT_EQUAL_UINT32(nacks + 1, i2c_bus_stats().nacks);
+  TEST_ASSERT_FALSE(absent.online());
+  TEST_ASSERT_TRUE(mpu_direct.online());
+
+  TEST_ASSERT_EQUAL(I2C_NACK, absent.transfer(&who_am_i, 1, &none, 1));
+  TEST_ASSERT_EQUAL_UINT32(100000, i2c_fake.clock_hz);
+  TEST_ASSERT_EQUAL(I2C_OK, mpu_direct.transfer(&who_am_i, 1, &id, 1));
+  TEST_ASSERT_EQUAL_UINT32(400000, i2c_fake.clock_hz);
+}
+
+void test_i2c_bus_timeout_recovers_and_reprobes()
+{
+  begin_bus_devices();
+  uint8_t id = 0;
+  I2cBusStats before = i2c_bus_stats();
+  uint32_t installs = i2c_fake.installs;
+  uint32_t probes = i2c_fake.probes;
+  i2c_fake.hang = 1;
+  TEST_ASSERT_EQUAL(I2C_TIMEOUT, mpu_direct.transfer(&who_am_i, 1, &id, 1));
+  const I2cBusStats &after = i2c_bus_stats();
+  TEST_ASSERT_EQUAL_UINT32(before.timeouts + 1, after.timeouts);
+  TEST_ASSERT_EQUAL_UINT32(before.recoveries + 1, after.recoveries);
+  TEST_ASSERT_EQUAL_UINT32(before.recovery_failures, after.recovery_failures);
+  TEST_ASSERT_EQUAL_UINT32(installs + 1, i2c_fake.installs); // driver reinstalled
+  TEST_ASSERT_TRUE(i2c_fake.probes > probes);
+  TEST_ASSERT_TRUE(mpu_direct.online()); // answered the re-probe
+  TEST_ASSERT_TRUE(mpu_online());
+  TEST_ASSERT_FALSE(absent.online());
+  TEST_ASSERT_EQUAL(I2C_OK, mpu_direct.transfer(&who_am_i, 1, &id, 1));
+
+  // a slave holding SDA lets go after a few clocks
+  uint32_t pulses = i2c_fake.scl_pulses;
+  i2c_fake.sda_held_clocks = 3;
+  TEST_ASSERT_EQUAL(I2C_TIMEOUT, mpu_direct.transfer(&who_am_i, 1, &id, 1));
+  TEST_ASSERT_EQUAL_UINT32(pulses + 3, i2c_fake.scl_pulses);
+  TEST_ASSERT_EQUAL_UINT32(before.recovery_failures, i2c_bus_stats().recovery_failures);
+  TEST_ASSERT_TRUE(mpu_direct.online());
+
+  // one that never does fails the recovery and takes the devices offline
+  i2c_fake.sda_held_clocks = 100;
+  TEST_ASSERT_EQUAL(I2C_TIMEOUT, mpu_direct.transfer(&who_am_i, 1, &id, 1));
+  TEST_ASSERT_EQUAL_UINT32(before.recovery_failures + 1, i2c_bus_stats().recovery_failures);
+  TEST_ASSERT_FALSE(mpu_direct.online());
+  i2c_fake.sda_held_clocks = 0;
+  TEST_ASSERT_EQUAL(I2C_OK, mpu_direct.transfer(&who_am_i, 1, &id, 1));
+  TEST_ASSERT_TRUE(mpu_direct.online());
+}
+
+void test_settings_json_updates_are_all_or_nothing()
+{
+  Settings settings = valid_settings();
+  char error[96];
+  TEST_ASSERT_TRUE(settings_parse_json("{\"publish_period_us\":5000,\"deadband_gas\":2.5}",
+                                       settings, error, sizeof(error)));
+  TEST_ASSERT_EQUAL_UINT32(5000, settings.publish_period_us);
+
+  TEST_ASSERT_FALSE(settings_parse_json("{\"gas_period_us\":20000,\"publish_period_us\":1}",
+                                        settings, error, sizeof(error)));
+  TEST_ASSERT_EQUAL_UINT32(100000, settings.gas_period_us); // first key not applied either
+  TEST_ASSERT_FALSE(settings_parse_json("{\"nope\":1}", settings, error, sizeof(error)));
+  TEST_ASSERT_EQUAL_STRING("unknown setting 'nope'", error);
+  TEST_ASSERT_FALSE(settings_parse_json("{\"gas_period_us\":20000,}", settings, error, sizeof(error)));
+  TEST_ASSERT_EQUAL_STRING("trailing ',' after 'gas_period_us'", error);
+  const char *not_json_numbers[] = {"0x4e20", "inf", "nan", "+20000", ".5", "020000", "1.", "2e"};
+  for (const char *number : not_json_numbers)
+  {
+    char json[64];
+    snprintf(json, sizeof(json), "{\"deadband_gas\":%s}", number);
+    TEST_ASSERT_FALSE_MESSAGE(settings_parse_json(json, settings, error, sizeof(error)), number);
+  }
+  TEST_ASSERT_EQUAL_UINT32(100000, settings.gas_period_us);
+  TEST_ASSERT_TRUE(settings_parse_json("{\"deadband_gas\":-0.0,\"gas_period_us\":2E4}", settings,
+                                       error, sizeof(error)));
+  TEST_ASSERT_EQUAL_UINT32(20000, settings.gas_period_us);
+}
+
+void test_settings_json_round_trip()
+{
+  Settings settings = valid_settings();
+  settings.deadband[SETTINGS_DEADBAND_MOTOR] = 0.25f;
+  char json[512];
+  char error[96];
+  TEST_ASSERT_GREATER_THAN(0, settings_format_json(settings, json, sizeof(json)));
+  Settings parsed = valid_settings();
+  TEST_ASSERT_TRUE(settings_parse_json(json, parsed, error, sizeof(error)));
+  TEST_ASSERT_EQUAL_MEMORY(&settings, &parsed, sizeof(settings));
+}
+
+void test_histogram_percentiles()
+{
+  PerfHistogram histogram;
+  for (uint32_t i = 1; i <= 1000; i++)
+  {
+    histogram.add(i);
+  }
+  PerfSummary summary = histogram.summary();
+  TEST_ASSERT_EQUAL_UINT32(1000, summary.count);
+  TEST_ASSERT_EQUAL_UINT32(1, summary.min);
+  TEST_ASSERT_EQUAL_UINT32(500, summary.avg);
+  TEST_ASSERT_UINT32_WITHIN(990 / 16, 990, summary.p99);
+}
+
+void test_frame_pool_leases()
+{
+  typedef FramePool<2, 64> Pool;
+  Pool pool;
+  {
+    Pool::Lease a(pool);
+    Pool::Lease b(pool);
+    TEST_ASSERT_TRUE(a && b);
+    TEST_ASSERT_TRUE(a.get() != b.get());
+    Pool::Lease c(pool);
+    TEST_ASSERT_FALSE(c);
+    TEST_ASSERT_EQUAL_UINT32(2, pool.in_use());
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, pool.in_use());
+  TEST_ASSERT_EQUAL_UINT32(2, pool.peak());
+  TEST_ASSERT_EQUAL_UINT32(1, pool.exhausted());
+  Pool::Lease again(pool);
+  TEST_ASSERT_TRUE(again);
+}
+
+struct MemorySource : DeltaSource
+{
+  const uint8_t *data;
+  size_t size;
+  bool read(uint32_t offset, void *dst, size_t len) override
+  {
+    if (offset + len > size)
+    {
+      return false;
+    }
+    memcpy(dst, data + offset, len);
+    return true;
+  }
+};
+
+struct MemorySink : DeltaSink
+{
+  uint8_t data[512];
+  size_t len = 0;
+  bool write(const void *src, size_t n) override
+  {
+    if (len + n > sizeof(data))
+    {
+      return false;
+    }
+    memcpy(data + len, src, n);
+    len += n;
+    return true;
+  }
+};
+
+static size_t put_varint(uint8_t *out, uint64_t v)
+{
+  size_t n = 0;
+  while (v >= 0x80)
+  {
+    out[n++] = (v & 0x7F) | 0x80;
+    v >>= 7;
+  }
+  out[n++] = v;
+  return n;
+}
+
+static size_t put_copy(uint8_t *out, uint32_t len, int64_t offset_delta)
+{
+  size_t n = put_varint(out, (uint64_t)len << 1);
+  return n + put_varint(out + n, ((uint64_t)offset_delta << 1) ^ (uint64_t)(offset_delta >> 63));
+}
+
+static size_t put_insert(uint8_t *out, const char *text)
+{
+  size_t len = strlen(text);
+  size_t n = put_varint(out, (uint64_t)len << 1 | 1);
+  memcpy(out + n, text, len);
+  return n + len;
+}
+
+static size_t put_header(uint8_t *out, uint32_t base_size, uint32_t image_size)
+{
+  DeltaPatchHeader header = {DELTA_PATCH_MAGIC, base_size, image_size};
+  memcpy(out, &header, sizeof(header));
+  return sizeof(header);
+}
+
+void test_delta_patch_in_any_pieces()
+{
+  static const char base[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+  static const char image[] = "abcdef--0123456789XYZklmnopqrst";
+  uint8_t patch[64];
+  size_t n = put_header(patch, sizeof(base) - 1, sizeof(image) - 1);
+  n += put_copy(patch + n, 6, 10);  // "abcdef", source now at 16
+  n += put_insert(patch + n, "--");
+  n += put_copy(patch + n, 10, -16); // back to 0
+  n += put_insert(patch + n, "XYZ");
+  n += put_copy(patch + n, 10, 10); // "klmnopqrst" from 20
+
+  // whole, then one byte at a time: the result must not depend on the split
+  const size_t steps[] = {n, 1, 5};
+  for (size_t step : steps)
+  {
+    MemorySource source;
+    source.data = (const uint8_t *)base;
+    source.size = sizeof(base) - 1;
+    MemorySink sink;
+    DeltaPatcher patcher;
+    patcher.begin(&source, &sink);
+    for (size_t i = 0; i < n; i += step)
+    {
+      TEST_ASSERT_TRUE(patcher.feed(patch + i, i + step < n ? step : n - i));
+    }
+    TEST_ASSERT_TRUE(patcher.complete());
+    TEST_ASSERT_EQUAL_size_t(sizeof(image) - 1, sink.len);
+    TEST_ASSERT_EQUAL_MEMORY(image, sink.data, sink.len);
+  }
+}
+
+void test_delta_patch_rejects_bad_ops()
+{
+  static const char base[] = "0123456789";
+  MemorySource source;
+  source.data = (const uint8_t *)base;
+  source.size = 10;
+  MemorySink sink;
+  DeltaPatcher patcher;
+  uint8_t patch[32];
+
+  // copy past the end of the base
+  size_t n = put_header(patch, 10, 8);
+  n += put_copy(patch + n, 8, 4);
+  patcher.begin(&source, &sink);
+  TEST_ASSERT_FALSE(patcher.feed(patch, n));
+  TEST_ASSERT_TRUE(patcher.failed());
+  TEST_ASSERT_FALSE(patcher.feed(patch, 1)); // stays failed
+
+  // writes past the image size
+  n = put_header(patch, 10, 2);
+  n += put_insert(patch + n, "abc");
+  patcher.begin(&source, &sink);
+  TEST_ASSERT_FALSE(patcher.feed(patch, n));
+
+  // bytes after the image is complete
+  n = put_header(patch, 10, 2);
+  n += put_insert(patch + n, "ab");
+  patch[n++] = 0;
+  patcher.begin(&source, &sink);
+  TEST_ASSERT_FALSE(patcher.feed(patch, n));
+
+  patch[0] ^= 1;
+  patcher.begin(&source, &sink);
+  TEST_ASSERT_FALSE(patcher.feed(patch, sizeof(DeltaPatchHeader)));
+}
+
+static OtaManifest valid_manifest()
+{
+  OtaManifest m = {};
+  m.version = OTA_MANIFEST_VERSION;
+  m.flags = OTA_FLAG_DELTA;
+  m.image_size = 900000;
+  m.transfer_size = 120000;
+  m.base_size = 880000;
+  strcpy(m.firmware_version, "1.4.0");
+  m.signature_len = 70;
+  return m;
+}
+
+void test_ota_manifest_checks()
+{
+  char error[64];
+  OtaManifest out = {};
+  OtaManifest m = valid_manifest();
+  TEST_ASSERT_TRUE(ota_manifest_parse((const uint8_t *)&m, sizeof(m), out, error, sizeof(error)));
+  TEST_ASSERT_EQUAL_STRING("1.4.0", out.firmware_version);
+  TEST_ASSERT_FALSE(ota_manifest_parse((const uint8_t *)&m, sizeof(m) - 1, out, error, sizeof(error)));
+
+  m.flags = 0; // a full image transfers exactly the image
+  TEST_ASSERT_FALSE(ota_manifest_parse((const uint8_t *)&m, sizeof(m), out, error, sizeof(error)));
+  m.transfer_size = m.image_size;
+  TEST_ASSERT_TRUE(ota_manifest_parse((const uint8_t *)&m, sizeof(m), out, error, sizeof(error)));
+
+  m = valid_manifest();
+  memset(m.firmware_version, 'x', sizeof(m.firmware_version)); // not terminated
+  TEST_ASSERT_FALSE(ota_manifest_parse((const uint8_t *)&m, sizeof(m), out, error, sizeof(error)));
+  m = valid_manifest();
+  m.signature_len = OTA_SIGNATURE_MAX + 1;
+  TEST_ASSERT_FALSE(ota_manifest_parse((const uint8_t *)&m, sizeof(m), out, error, sizeof(error)));
+  TEST_ASSERT_EQUAL_STRING("1.4.0", out.firmware_version); // unchanged on failure
+}
+
+void test_ota_transfer_paces_and_retries()
+{
+  OtaTransfer transfer;
+  OtaRequest request;
+  // 1000 bytes in 512-byte chunks at 1024 B/s, 300 ms timeout
+  transfer.begin(1000, 512, 1024, 300, 0);
+  TEST_ASSERT_TRUE(transfer.next_request(0, request));
+  TEST_ASSERT_EQUAL_UINT32(0, request.offset);
+  TEST_ASSERT_EQUAL_UINT32(512, request.len);
+  TEST_ASSERT_FALSE(transfer.next_request(100, request)); // in flight
+
+  TEST_ASSERT_FALSE(transfer.accept(512, 488)); // not the one asked for
+  TEST_ASSERT_TRUE(transfer.accept(0, 512));
+  TEST_ASSERT_FALSE(transfer.accept(0, 512)); // a repeat
+  TEST_ASSERT_FALSE(transfer.next_request(400, request)); // 512 bytes cost 500 ms
+  TEST_ASSERT_TRUE(transfer.next_request(500, request));
+  TEST_ASSERT_EQUAL_UINT32(512, request.offset);
+  TEST_ASSERT_EQUAL_UINT32(488, request.len);
+
+  // lost answer: the same chunk again after the timeout
+  TEST_ASSERT_FALSE(transfer.next_request(799, request));
+  TEST_ASSERT_TRUE(transfer.next_request(800, request));
+  TEST_ASSERT_EQUAL_UINT32(512, request.offset);
+  TEST_ASSERT_EQUAL_UINT32(2, transfer.attempts());
+  TEST_ASSERT_EQUAL_UINT32(1, transfer.retries());
+  TEST_ASSERT_TRUE(transfer.accept(512, 488));
+  TEST_ASSERT_TRUE(transfer.done());
+  TEST_ASSERT_FALSE(transfer.next_request(5000, request));
+}
+
+int run_tests()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_binary_frame_fields);
+  RUN_TEST(test_json_fixed_point);
+  RUN_TEST(test_flame_alarm_json_carries_seq);
+  RUN_TEST(test_json_escape);
+  RUN_TEST(test_batch_layout);
+  RUN_TEST(test_batch_compression_round_trip);
+  RUN_TEST(test_batch_compression_gives_up_when_not_smaller);
+  RUN_TEST(test_mpu_begin_sets_ranges_and_motion_interrupt);
+  RUN_TEST(test_mpu_burst_read_parses_big_endian);
+  RUN_TEST(test_i2c_bus_handshake);
+  RUN_TEST(test_i2c_bus_serves_every_device_at_its_clock);
+  RUN_TEST(test_i2c_bus_timeout_recovers_and_reprobes);
+  RUN_TEST(test_settings_json_updates_are_all_or_nothing);
+  RUN_TEST(test_settings_json_round_trip);
+  RUN_TEST(test_histogram_percentiles);
+  RUN_TEST(test_frame_pool_leases);
+  RUN_TEST(test_delta_patch_in_any_pieces);
+  RUN_TEST(test_delta_patch_rejects_bad_ops);
+  RUN_TEST(test_ota_manifest_checks);
+  RUN_TEST(test_ota_transfer_paces_and_retries);
+  return UNITY_END();
+}
+
+int main()
+{
+  return run_tests();
+}
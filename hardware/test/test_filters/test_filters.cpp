@@ -0,0 +1,157 @@
+#include <unity.h>
+
+#include "activity.h"
+#include "filters.h"
+#include "ring_buffer.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_median_removes_single_spikes()
+{
+  MedianFilter<3> median;
+  const int32_t in[] = {100, 100, 4095, 100, 100, 0, 100};
+  int32_t out = 0;
+  for (int32_t v : in)
+  {
+    TEST_ASSERT_TRUE(median.process(v, out));
+    TEST_ASSERT_EQUAL_INT32(100, out);
+  }
+}
+
+void test_moving_average_fills_then_slides()
+{
+  MovingAverage<4> average;
+  int32_t out = 0;
+  average.process(10, out);
+  TEST_ASSERT_EQUAL_INT32(10, out);
+  average.process(20, out);
+  TEST_ASSERT_EQUAL_INT32(15, out);
+  average.process(30, out);
+  average.process(40, out);
+  TEST_ASSERT_EQUAL_INT32(25, out);
+  average.process(50, out); // 10 leaves the window
+  TEST_ASSERT_EQUAL_INT32(35, out);
+}
+
+void test_cic_decimates_with_unity_gain()
+{
+  CicDecimator<16, 3> cic;
+  int32_t out = 0;
+  int outputs = 0;
+  for (int i = 0; i < 16 * 10; i++)
+  {
+    if (cic.process(-1234, out))
+    {
+      outputs++;
+    }
+  }
+  TEST_ASSERT_EQUAL(10, outputs);
+  TEST_ASSERT_EQUAL_INT32(-1234, out); // settled after ORDER outputs
+}
+
+void test_biquad_lowpass_is_primed_and_passes_dc()
+{
+  Biquad lowpass;
+  lowpass.lowpass(10, 625);
+  int32_t out = 0;
+  lowpass.process(2000, out);
+  TEST_ASSERT_EQUAL_INT32(2000, out); // no ramp from zero
+  for (int i = 0; i < 1000; i++)
+  {
+    lowpass.process(i % 2 ? 2100 : 1900, out); // 312 Hz, far above the cutoff
+  }
+  TEST_ASSERT_INT32_WITHIN(2, 2000, out);
+}
+
+void test_chain_stops_between_decimator_outputs()
+{
+  FilterChain<MedianFilter<3>, CicDecimator<8, 1>, MovingAverage<2>> chain;
+  TEST_ASSERT_EQUAL_UINT32(8, (uint32_t)decltype(chain)::decimation);
+  int32_t out = 0;
+  int outputs = 0;
+  for (int i = 0; i < 64; i++)
+  {
+    if (chain.process(500, out))
+    {
+      outputs++;
+    }
+  }
+  TEST_ASSERT_EQUAL(8, outputs);
+  TEST_ASSERT_EQUAL_INT32(500, out);
+}
+
+void test_chain_stage_access()
+{
+  FilterChain<MedianFilter<3>, Biquad> chain;
+  chain.stage<1>().set(0.5f, 0, 0, 0, 0); // halves the signal
+  int32_t out = 0;
+  chain.process(1000, out);
+  TEST_ASSERT_EQUAL_INT32(500, out);
+}
+
+void test_activity_steps_up_at_once_and_down_after_hold()
+{
+  ActivityController activity;
+  const ActivityThresholds t = {1.0f, 0.5f, 10.0f, 6.0f, 100};
+  TEST_ASSERT_TRUE(activity.begin(t, ACTIVITY_IDLE));
+
+  TEST_ASSERT_FALSE(activity.update(0.9f, 0));
+  TEST_ASSERT_TRUE(activity.update(12.0f, 10)); // straight from idle to burst
+  TEST_ASSERT_EQUAL(ACTIVITY_BURST, activity.profile());
+  TEST_ASSERT_EQUAL_UINT32(1, activity.bursts());
+
+  // between exit and enter: stays, and a dip shorter than the hold is ignored
+  TEST_ASSERT_FALSE(activity.update(7.0f, 20));
+  TEST_ASSERT_FALSE(activity.update(2.0f, 30));
+  TEST_ASSERT_FALSE(activity.update(7.0f, 100));
+  TEST_ASSERT_FALSE(activity.update(2.0f, 110));
+  TEST_ASSERT_FALSE(activity.update(2.0f, 200));
+  TEST_ASSERT_TRUE(activity.update(0.1f, 210));
+  TEST_ASSERT_EQUAL(ACTIVITY_NORMAL, activity.profile());
+
+  // one step at a time: idle needs a hold of its own
+  TEST_ASSERT_FALSE(activity.update(0.1f, 220));
+  TEST_ASSERT_FALSE(activity.wake(300)); // motion restarts the hold
+  TEST_ASSERT_FALSE(activity.update(0.1f, 390));
+  TEST_ASSERT_TRUE(activity.update(0.1f, 400));
+  TEST_ASSERT_EQUAL(ACTIVITY_IDLE, activity.profile());
+
+  TEST_ASSERT_TRUE(activity.wake(410));
+  TEST_ASSERT_EQUAL(ACTIVITY_NORMAL, activity.profile());
+
+  const ActivityThresholds crossed = {1.0f, 2.0f, 10.0f, 6.0f, 100};
+  TEST_ASSERT_FALSE(activity.begin(crossed));
+}
+
+void test_history_ring_keeps_newest()
+{
+  HistoryRing<int, 4> history;
+  TEST_ASSERT_EQUAL(0, (int)history.size());
+  for (int i = 1; i <= 6; i++)
+  {
+    history.push(i);
+  }
+  TEST_ASSERT_EQUAL(4, (int)history.size());
+  TEST_ASSERT_EQUAL(3, history[0]);
+  TEST_ASSERT_EQUAL(6, history[3]);
+}
+
+int run_tests()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_median_removes_single_spikes);
+  RUN_TEST(test_moving_average_fills_then_slides);
+  RUN_TEST(test_cic_decimates_with_unity_gain);
+  RUN_TEST(test_biquad_lowpass_is_primed_and_passes_dc);
+  RUN_TEST(test_chain_stops_between_decimator_outputs);
+  RUN_TEST(test_chain_stage_access);
+  RUN_TEST(test_activity_steps_up_at_once_and_down_after_hold);
+  RUN_TEST(test_history_ring_keeps_newest);
+  return UNITY_END();
+}
+
+int main()
+{
+  return run_tests();
+}
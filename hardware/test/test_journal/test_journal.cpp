@@ -0,0 +1,214 @@
+#include <string.h>
+#include <unity.h>
+
+#include "flash_journal.h"
+
+#define SLOTS_PER_SECTOR (JOURNAL_SECTOR_BYTES / JOURNAL_RECORD_BYTES)
+
+// NOR flash in RAM: erase sets a sector to ones, writes can only clear
+// bits. tear_after cuts the next write short, like power lost mid-write.
+class RamFlash : public JournalFlash
+{
+public:
+  explicit RamFlash(size_t sectors) : size_(sectors * JOURNAL_SECTOR_BYTES)
+  {
+    memset(bytes_, 0xFF, sizeof(bytes_));
+  }
+
+  size_t size() const override { return size_; }
+
+  bool read(uint32_t offset, void *dst, size_t len) override
+  {
+    if (offset + len > size_)
+    {
+      return false;
+    }
+    memcpy(dst, bytes_ + offset, len);
+    return true;
+  }
+
+  bool write(uint32_t offset, const void *src, size_t len) override
+  {
+    if (offset + len > size_)
+    {
+      return false;
+    }
+    if (tear_after >= 0 && (size_t)tear_after < len)
+    {
+      len = tear_after;
+      tear_after = -1;
+    }
+    const uint8_t *p = (const uint8_t *)src;
+    for (size_t i = 0; i < len; i++)
+    {
+      bytes_[offset + i] &= p[i];
+    }
+    return true;
+  }
+
+  bool erase_sector(uint32_t offset) override
+  {
+    if (offset % JOURNAL_SECTOR_BYTES != 0 || offset >= size_)
+    {
+      return false;
+    }
+    memset(bytes_ + offset, 0xFF, JOURNAL_SECTOR_BYTES);
+    erases++;
+    return true;
+  }
+
+  JournalRecord &slot(uint32_t n) { return *(JournalRecord *)(bytes_ + n * JOURNAL_RECORD_BYTES); }
+
+  int tear_after = -1;
+  uint32_t erases = 0;
+
+private:
+  size_t size_;
+  uint8_t bytes_[4 * JOURNAL_SECTOR_BYTES];
+};
+
+void setUp() {}
+void tearDown() {}
+
+static void append_counting(FlashJournal &journal, uint32_t from, uint32_t count)
+{
+  for (uint32_t value = from; value < from + count; value++)
+  {
+    TEST_ASSERT_TRUE(journal.append(&value, sizeof(value), value * 1000ull, 0));
+  }
+}
+
+static uint32_t payload_value(const JournalEntry &entry)
+{
+  uint32_t value;
+  memcpy(&value, entry.record.payload, sizeof(value));
+  return value;
+}
+
+void test_journal_recovers_head_and_tail_after_rescan()
+{
+  RamFlash flash(2);
+  FlashJournal journal;
+  TEST_ASSERT_TRUE(journal.begin(&flash));
+  TEST_ASSERT_EQUAL_UINT32(0, journal.pending());
+  append_counting(journal, 1, 5);
+  journal.consume(2);
+
+  FlashJournal rebooted;
+  TEST_ASSERT_TRUE(rebooted.begin(&flash));
+  TEST_ASSERT_EQUAL_UINT32(3, rebooted.pending());
+  TEST_ASSERT_EQUAL_UINT16(journal.boot_id() + 1, rebooted.boot_id());
+  JournalEntry entries[8];
+  TEST_ASSERT_EQUAL(3, rebooted.read_pending(entries, 8));
+  TEST_ASSERT_EQUAL_UINT32(3, entries[0].record.seq); // tail: oldest unacked
+  TEST_ASSERT_EQUAL_UINT32(3, payload_value(entries[0]));
+  TEST_ASSERT_EQUAL_UINT32(5, entries[2].record.seq);
+
+  // head: after the newest record, sequence numbers carry on
+  append_counting(rebooted, 6, 1);
+  TEST_ASSERT_EQUAL(4, rebooted.read_pending(entries, 8));
+  TEST_ASSERT_EQUAL_UINT32(6, entries[3].record.seq);
+  TEST_ASSERT_EQUAL_UINT16(rebooted.boot_id(), entries[3].record.boot_id);
+  TEST_ASSERT_EQUAL_UINT32(6, flash.slot(5).seq); // right after the old head
+
+  RamFlash small(1);
+  TEST_ASSERT_FALSE(rebooted.begin(&small)); // needs two sectors to wrap
+}
+
+void test_journal_acks_in_place()
+{
+  RamFlash flash(2);
+  FlashJournal journal;
+  journal.begin(&flash);
+  append_counting(journal, 1, 3);
+  uint32_t erases = flash.erases;
+  JournalRecord before = flash.slot(0);
+
+  journal.consume(1);
+  TEST_ASSERT_EQUAL_UINT32(2, journal.pending());
+  TEST_ASSERT_EQUAL_UINT32(erases, flash.erases); // no erase, bits only cleared
+  TEST_ASSERT_EQUAL_UINT32(0, flash.slot(0).acked);
+  before.acked = 0;
+  TEST_ASSERT_EQUAL_MEMORY(&before, &flash.slot(0), sizeof(before)); // CRC still holds
+  TEST_ASSERT_EQUAL_UINT32(JOURNAL_SEQ_ERASED, flash.slot(1).acked);
+
+  journal.consume(10); // more than pending
+  TEST_ASSERT_EQUAL_UINT32(0, journal.pending());
+  FlashJournal rebooted;
+  rebooted.begin(&flash);
+  TEST_ASSERT_EQUAL_UINT32(0, rebooted.pending());
+}
+
+void test_journal_rejects_a_torn_record()
+{
+  RamFlash flash(2);
+  FlashJournal journal;
+  journal.begin(&flash);
+  append_counting(journal, 1, 3);
+  flash.tear_after = 20; // seq, acked and part of the timestamp
+  uint32_t value = 4;
+  journal.append(&value, sizeof(value), 4000, 0);
+
+  FlashJournal rebooted;
+  rebooted.begin(&flash);
+  TEST_ASSERT_EQUAL_UINT32(4, rebooted.pending()); // slots, the torn one included
+  JournalEntry entries[8];
+  TEST_ASSERT_EQUAL(3, rebooted.read_pending(entries, 8));
+  TEST_ASSERT_EQUAL_UINT32(3, entries[2].record.seq);
+  TEST_ASSERT_EQUAL_UINT32(1, rebooted.corrupt());
+
+  // the torn slot is not written over: the next record lands after it
+  append_counting(rebooted, 5, 1);
+  TEST_ASSERT_EQUAL(4, rebooted.read_pending(entries, 8));
+  TEST_ASSERT_EQUAL_UINT32(4, entries[3].record.seq);
+  TEST_ASSERT_EQUAL_UINT32(5, payload_value(entries[3]));
+  TEST_ASSERT_EQUAL_UINT32(5, entries[3].span); // the torn slot counts towards it
+
+  // a record damaged after it was written is skipped in a read, too
+  flash.slot(1).payload[0] ^= 0x01;
+  TEST_ASSERT_EQUAL(3, rebooted.read_pending(entries, 8));
+  TEST_ASSERT_EQUAL_UINT32(3, entries[1].record.seq);
+  TEST_ASSERT_EQUAL_UINT32(3, entries[1].span);
+}
+
+void test_journal_wraps_over_the_oldest_sector()
+{
+  RamFlash flash(2);
+  FlashJournal journal;
+  journal.begin(&flash);
+  const uint32_t slots = 2 * SLOTS_PER_SECTOR;
+  append_counting(journal, 1, slots + SLOTS_PER_SECTOR + 8);
+
+  // entering each sector again dropped its whole content
+  TEST_ASSERT_EQUAL_UINT32(slots, journal.dropped());
+  TEST_ASSERT_EQUAL_UINT32(SLOTS_PER_SECTOR + 8, journal.pending());
+  JournalEntry entries[SLOTS_PER_SECTOR + 8];
+  TEST_ASSERT_EQUAL(SLOTS_PER_SECTOR + 8, journal.read_pending(entries, SLOTS_PER_SECTOR + 8));
+  for (uint32_t i = 0; i < SLOTS_PER_SECTOR + 8; i++)
+  {
+    TEST_ASSERT_EQUAL_UINT32(slots + 1 + i, entries[i].record.seq);
+  }
+  TEST_ASSERT_EQUAL_UINT32(4, flash.erases); // each sector once per lap
+  journal.consume(SLOTS_PER_SECTOR);
+
+  FlashJournal rebooted;
+  rebooted.begin(&flash);
+  TEST_ASSERT_EQUAL_UINT32(8, rebooted.pending());
+  TEST_ASSERT_EQUAL(8, rebooted.read_pending(entries, 8));
+  TEST_ASSERT_EQUAL_UINT32(slots + SLOTS_PER_SECTOR + 1, entries[0].record.seq);
+}
+
+int run_tests()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_journal_recovers_head_and_tail_after_rescan);
+  RUN_TEST(test_journal_acks_in_place);
+  RUN_TEST(test_journal_rejects_a_torn_record);
+  RUN_TEST(test_journal_wraps_over_the_oldest_sector);
+  return UNITY_END();
+}
+
+int main()
+{
+  return run_tests();
+}
@@ -0,0 +1,61 @@
+#!/bin/sh
+# ECDSA P-256 certificates for the TLS listener, written to config/certs.
+#
+#   ./gen_certs.sh          CA and broker certificate (once)
+#   ./gen_certs.sh <name>   client certificate: a device ID (12 hex digits,
+#                           see device_id.h), dashboard / ingest / logger /
+#                           loadgen / ota, or area-<name> for a plant-area bridge.
+#                           For a board, prints the secrets.h lines.
+#
+# SERVER_NAME (default mosquitto) goes into the broker certificate and must
+# match MQTT_SERVER_NAME on the boards and MQTT_BROKER of the services.
+set -e
+DIR="$(dirname "$0")/config/certs"
+SERVER_NAME=${SERVER_NAME:-mosquitto}
+DAYS=${DAYS:-3650}
+mkdir -p "$DIR"
+cd "$DIR"
+
+sign() # <file> <common name> [subject alt names]
+{
+  openssl ecparam -name prime256v1 -genkey -noout -out "$1.key"
+  openssl req -new -key "$1.key" -subj "/CN=$2" -out "$1.csr"
+  if [ -n "$3" ]; then
+    printf "subjectAltName=%s\n" "$3" > "$1.ext"
+    openssl x509 -req -in "$1.csr" -CA ca.crt -CAkey ca.key -CAcreateserial -sha256 \
+      -days "$DAYS" -extfile "$1.ext" -out "$1.crt" 2> /dev/null
+    rm "$1.ext"
+  else
+    openssl x509 -req -in "$1.csr" -CA ca.crt -CAkey ca.key -CAcreateserial -sha256 \
+      -days "$DAYS" -out "$1.crt" 2> /dev/null
+  fi
+  rm "$1.csr"
+}
+
+if [ ! -f ca.key ]; then
+  openssl ecparam -name prime256v1 -genkey -noout -out ca.key
+  openssl req -x509 -new -key ca.key -sha256 -days "$DAYS" -subj "/CN=sensor-ca" -out ca.crt
+fi
+if [ ! -f server.crt ]; then
+  sign server "$SERVER_NAME" "DNS:$SERVER_NAME,DNS:localhost"
+fi
+# the broker runs as its own user inside the container
+chmod 644 server.key
+
+[ $# -eq 0 ] && exit 0
+sign "$1" "$1"
+
+case "$1" in
+  dashboard|ingest|logger|loadgen|ota|area-*) exit 0 ;;
+esac
+pem()
+{
+  printf '#define %s \\\n' "$1"
+  sed 's/.*/  "&\\n" \\/' "$2"
+  printf '\n'
+}
+echo "// secrets.h for $1"
+echo "#define MQTT_SERVER_NAME \"$SERVER_NAME\""
+pem MQTT_CA_CERT ca.crt
+pem MQTT_CLIENT_CERT "$1.crt"
+pem MQTT_CLIENT_KEY "$1.key"
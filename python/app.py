@@ -6,9 +6,14 @@ from dotenv import load_dotenv
 import os
 import json
 import time
-from typing import Any, Dict, List, Optional
+from collections import deque
+from typing import Any, Deque, Dict, List, Optional
 import logging
 
+import telemetry
+from broker import configure_tls
+from store import TimeSeriesStore
+
 # --- LOGGING SETUP ---
 logging.basicConfig(
     level=logging.INFO,
@@ -26,7 +31,24 @@ class AppConfig:
 
     BROKER: str = os.getenv("MQTT_BROKER", "localhost")
     PORT: int = int(os.getenv("MQTT_PORT", 1883))
-    TOPIC: str = os.getenv("MQTT_TOPIC", "sensor/+")
+    # one device ID, or "+" for every device on the broker
+    DEVICE: str = os.getenv("MQTT_DEVICE", "+")
+    # "json" subscribes to sensor/<device>/telemetry, "binary" / "batch" to
+    # the parallel .../telemetry/bin and .../telemetry/batch frames
+    FORMAT: str = os.getenv("MQTT_FORMAT", "batch")
+    # samples and alarms kept per device
+    HISTORY: int = int(os.getenv("DASHBOARD_HISTORY", 100))
+    ALARM_HISTORY: int = int(os.getenv("DASHBOARD_ALARM_HISTORY", 20))
+    # Parquet store written by ingest.py; the History tab reads it
+    STORE_PATH: str = os.getenv("STORE_PATH", "data")
+    HISTORY_POINTS: int = int(os.getenv("DASHBOARD_HISTORY_POINTS", 1000))
+    HISTORY_RANGES: Dict[str, int] = {
+        "5 min": 300,
+        "1 h": 3600,
+        "24 h": 86400,
+        "7 days": 7 * 86400,
+        "90 days": 90 * 86400,
+    }
     KEEPALIVE: int = int(os.getenv("MQTT_KEEPALIVE", 60))
     PAGE_TITLE: str = "Industrial IoT Monitor"
     PAGE_ICON: str = "🏭"
@@ -45,11 +67,76 @@ st.set_page_config(
 class DeviceData:
     def __init__(self, name: str):
         self.name = name
-        self.history: List[Dict[str, Any]] = []
+        # bounded ring buffers: memory per device stays flat however long
+        # the dashboard runs and however many devices report
+        self.history: Deque[Dict[str, Any]] = deque(maxlen=AppConfig.HISTORY)
+        self.alarms: Deque[Dict[str, Any]] = deque(maxlen=AppConfig.ALARM_HISTORY)
+        self.status: Dict[str, Any] = {}
         self.latest: Dict[str, Any] = {}
         self.previous: Dict[str, Any] = {}
         self.last_update: float = time.time()
-        self.max_history: int = 100
+        # journal sequence numbers already shown; replays may repeat
+        self.seen_seq: Deque[int] = deque(maxlen=1000)
+        self._seen_set: set = set()
+        self._frame: Optional[pd.DataFrame] = None
+
+    def _mark_seen(self, seq: int) -> None:
+        if len(self.seen_seq) == self.seen_seq.maxlen:
+            self._seen_set.discard(self.seen_seq[0])
+        self.seen_seq.append(seq)
+        self._seen_set.add(seq)
+
+    def add_samples(self, samples: List[Dict[str, Any]], received: float) -> None:
+        """
+        Appends samples ordered by acquisition time. Each gets a `time` key:
+        the device clock when it is synced, otherwise the receive time.
+        """
+        samples = [s for s in samples if s.get("seq") not in self._seen_set]
+        if not samples:
+            return
+        for sample in samples:
+            stamp = telemetry.device_time(sample)
+            sample["time"] = stamp if stamp is not None else received
+            if "seq" in sample:
+                self._mark_seen(sample["seq"])
+
+        in_order = not self.history or self.history[-1]["time"] <= samples[0]["time"]
+        self.history.extend(samples)
+        if not in_order:
+            # a replayed backlog or a second device clock arrived late
+            ordered = sorted(self.history, key=lambda sample: sample["time"])
+            self.history = deque(ordered, maxlen=AppConfig.HISTORY)
+
+        self.latest = self.history[-1]
+        self.last_update = self.latest["time"]
+        self._frame = None
+
+    def add_alarm(self, alarm: Dict[str, Any], received: float) -> None:
+        # flame alarms are resent until acknowledged; a repeat has the same
+        # seq and edge timestamp
+        if "seq" in alarm and any(
+            a.get("seq") == alarm["seq"] and a.get("timestamp_us") == alarm.get("timestamp_us")
+            for a in self.alarms
+        ):
+            return
+        stamp = telemetry.device_time(alarm)
+        alarm["time"] = stamp if stamp is not None else received
+        self.alarms.append(alarm)
+
+    @property
+    def online(self) -> Optional[bool]:
+        """From the retained birth / last-will message; None if not seen yet."""
+        if not self.status:
+            return None
+        return self.status.get("state") == "online"
+
+    def history_frame(self) -> pd.DataFrame:
+        """History as a DataFrame indexed by acquisition time, built once per update."""
+        if self._frame is None:
+            frame = pd.DataFrame(list(self.history))
+            frame.index = pd.to_datetime(frame["time"], unit="s")
+            self._frame = frame
+        return self._frame
 
 
 class MQTTState:
@@ -63,6 +150,36 @@ def get_mqtt_state() -> MQTTState:
     return MQTTState()
 
 
+@st.cache_resource
+def get_store() -> TimeSeriesStore:
+    return TimeSeriesStore(AppConfig.STORE_PATH)
+
+
+@st.cache_data(ttl=5, show_spinner=False)
+def load_history(device: str, span_s: int) -> pd.DataFrame:
+    """Stored history of the last span_s seconds, from the matching rollup."""
+    end = time.time()
+    return get_store().query(device, end - span_s, end, AppConfig.HISTORY_POINTS)
+
+
+def subscription_topic() -> str:
+    """Telemetry topic filter for the configured wire format."""
+    suffix = {
+        "binary": telemetry.BINARY_SUFFIX,
+        "batch": telemetry.BATCH_SUFFIX,
+    }.get(AppConfig.FORMAT, "")
+    return telemetry.device_topic(AppConfig.DEVICE, telemetry.TELEMETRY_CHANNEL, suffix)
+
+
+def subscription_topics() -> List[str]:
+    """Telemetry, alarms and the retained status of every device."""
+    return [
+        subscription_topic(),
+        telemetry.device_topic(AppConfig.DEVICE, telemetry.ALARM_CHANNEL),
+        telemetry.device_topic(AppConfig.DEVICE, telemetry.STATUS_CHANNEL),
+    ]
+
+
 # --- MQTT CALLBACKS ---
 def on_connect(
     client: mqtt.Client, userdata: Any, flags: Dict, rc: int, properties: Any = None
@@ -79,7 +196,7 @@ def on_connect(
     """
     if rc == 0:
         userdata.connected = True
-        client.subscribe(AppConfig.TOPIC)
+        client.subscribe([(topic, 0) for topic in subscription_topics()])
         logger.info(f"Connected to MQTT Broker: {AppConfig.BROKER}")
     else:
         userdata.connected = False
@@ -106,37 +223,45 @@ def on_message(client: mqtt.Client, userdata: Any, msg: mqtt.MQTTMessage) -> Non
         msg: The actual message object containing topic and payload.
     """
     try:
-        # 1. Wyciągnij nazwę urządzenia z tematu
-        # np. sensor/jadwiga -> jadwiga
-        topic_parts = msg.topic.split("/")
-        device_name = topic_parts[-1] if len(topic_parts) > 1 else "Unknown"
-
-        # 2. Parsuj JSON
-        payload = json.loads(msg.payload.decode())
-
-        # 3. Jeśli to nowe urządzenie, dodaj je do słownika devices
-        if device_name not in userdata.devices:
-            # Tworzymy nową instancję DeviceData
-            userdata.devices[device_name] = DeviceData(device_name)
-            logger.info(f"New Device Detected: {device_name}")
-
-        # 4. Pobierz obiekt konkretnego urządzenia
-        device = userdata.devices[device_name]
+        # 1. Wyciągnij nazwę urządzenia i kanał z tematu
+        # np. sensor/a4cf12ab34cd/telemetry/batch -> a4cf12ab34cd, telemetry
+        topic = telemetry.parse_topic(msg.topic)
+        if topic is None:
+            return
+
+        # 2. Jeśli to nowe urządzenie, dodaj je do słownika devices
+        if topic.device not in userdata.devices:
+            userdata.devices[topic.device] = DeviceData(topic.device)
+            logger.info(f"New Device Detected: {topic.device}")
+        device = userdata.devices[topic.device]
+
+        # 3. Status (birth / LWT) i alarmy to zwykły JSON
+        if topic.channel == telemetry.STATUS_CHANNEL:
+            device.status = json.loads(msg.payload.decode()) if msg.payload else {}
+            logger.info(f"Device {topic.device} is {device.status.get('state', 'unknown')}")
+            return
+        if topic.channel == telemetry.ALARM_CHANNEL:
+            device.add_alarm(json.loads(msg.payload.decode()), time.time())
+            return
+        if topic.channel != telemetry.TELEMETRY_CHANNEL:
+            return
+
+        # 4. Parsuj JSON, ramkę binarną lub paczkę próbek
+        samples = telemetry.decode_samples(msg.topic, msg.payload)
+        if not samples:
+            return
 
         # 5. Zapisz dane W KONKRETNYM URZĄDZENIU (a nie w userdata.latest!)
         if device.latest:
             device.previous = device.latest.copy()
 
-        device.latest = payload
-        device.history.append(payload)
-        device.last_update = time.time()
-
-        # Limit historii
-        if len(device.history) > device.max_history:
-            device.history.pop(0)
+        # Oś czasu z zegara urządzenia, nie z chwili odbioru
+        device.add_samples(samples, time.time())
 
     except json.JSONDecodeError:
         logger.error(f"Invalid JSON received: {msg.payload}")
+    except ValueError as e:
+        logger.error(f"Invalid binary frame received: {e}")
     except Exception as e:
         logger.error(f"Error processing message: {e}")
 
@@ -151,6 +276,7 @@ def start_mqtt_client() -> Optional[mqtt.Client]:
     client.on_connect = on_connect
     client.on_disconnect = on_disconnect
     client.on_message = on_message
+    configure_tls(client)
 
     try:
         client.connect(AppConfig.BROKER, AppConfig.PORT, AppConfig.KEEPALIVE)
@@ -162,8 +288,8 @@ def start_mqtt_client() -> Optional[mqtt.Client]:
 
 
 # --- UI COMPONENTS ---
-def render_sidebar(state: MQTTState):
-    """Renders the sidebar configuration and status."""
+def render_sidebar(state: MQTTState) -> int:
+    """Renders the sidebar configuration and status. Returns the history span (s)."""
     with st.sidebar:
         st.header(f"{AppConfig.PAGE_ICON} {AppConfig.PAGE_TITLE}")
 
@@ -179,10 +305,17 @@ def render_sidebar(state: MQTTState):
 
         st.divider()
         st.subheader("⚙️ Configuration")
-        st.info(f"Devices connected: {len(state.devices)}")
-        st.badge(f"Topic: `{AppConfig.TOPIC}`", color="blue", icon="📓")
+        online = sum(1 for device in list(state.devices.values()) if device.online)
+        st.info(f"Devices: {len(state.devices)} ({online} online)")
+        st.badge(f"Topic: `{subscription_topic()}`", color="blue", icon="📓")
         st.divider()
 
+        st.subheader("🗄️ History")
+        span = st.select_slider(
+            "Range", options=list(AppConfig.HISTORY_RANGES), value="1 h"
+        )
+        return AppConfig.HISTORY_RANGES[span]
+
 
 def calculate_delta(current: float, previous: float) -> Optional[float]:
     """Helper to calculate metric delta."""
@@ -191,12 +324,38 @@ def calculate_delta(current: float, previous: float) -> Optional[float]:
     return round(current - previous, 2)
 
 
-def render_device_tab(device: DeviceData):
+def render_history(device: DeviceData, span_s: int) -> None:
+    """Charts from the store; bucket means, with min/max kept for the gas band."""
+    df = load_history(device.name, span_s)
+    if df.empty:
+        st.info(f"No stored history. Is ingest.py writing to `{AppConfig.STORE_PATH}`?")
+        return
+    means = [
+        c for c in df.columns
+        if c not in ("time", "count") and not c.endswith(("_min", "_max"))
+    ]
+    st.caption(f"{len(df)} points")
+    cols_temp = [c for c in ["temperature", "temperature_out"] if c in means]
+    if cols_temp:
+        st.line_chart(df[cols_temp], height=250)
+    cols_gas = [c for c in ["gas_level", "gas_level_min", "gas_level_max"] if c in df.columns]
+    if cols_gas:
+        st.line_chart(df[cols_gas], height=200)
+    cols_acc = [c for c in means if "acceleration" in c]
+    if cols_acc:
+        st.line_chart(df[cols_acc], height=300)
+
+
+def render_device_tab(device: DeviceData, span_s: int):
     data = device.latest
     prev = device.previous
 
+    status = {True: "🟢 online", False: "🔴 offline", None: "⚪ unknown"}[device.online]
+    if device.status.get("state") == "sleep":
+        status = "💤 sleeping"
     st.caption(
-        f"Last update: {time.strftime('%H:%M:%S', time.localtime(device.last_update))}"
+        f"{status} · Last update: "
+        f"{time.strftime('%H:%M:%S', time.localtime(device.last_update))}"
     )
 
     # --- KPI METRICS ---
@@ -217,7 +376,7 @@ def render_device_tab(device: DeviceData):
                 help="Ambient temperature reading",
                 border=True,
                 chart_data=(
-                    pd.DataFrame(device.history)["temperature"]
+                    device.history_frame()["temperature"]
                     if device.history
                     else None
                 ),
@@ -234,7 +393,7 @@ def render_device_tab(device: DeviceData):
                 border=True,
                 help="Outside temperature reading",
                 chart_data=(
-                    pd.DataFrame(device.history)["temperature_out"]
+                    device.history_frame()["temperature_out"]
                     if device.history
                     else None
                 ),
@@ -251,7 +410,7 @@ def render_device_tab(device: DeviceData):
                 border=True,
                 help="Outside humidity reading",
                 chart_data=(
-                    pd.DataFrame(device.history)["humidity_out"]
+                    device.history_frame()["humidity_out"]
                     if device.history
                     else None
                 ),
@@ -262,17 +421,17 @@ def render_device_tab(device: DeviceData):
             val = data["gas_level"]
             p_val = prev.get("gas_level") if prev else None
             status = (
-                "⚠️ DANGER" if val > 1000 else "⚠️ WARNING" if val > 700 else "✅ SAFE"
+                "⚠️ DANGER" if val > 940 else "⚠️ WARNING" if val > 700 else "✅ SAFE"
             )
             st.metric(
                 "Gas Sensor",
-                f"{val} ({status})",
+                f"{val} mV ({status})",
                 calculate_delta(val, p_val),
                 delta_color="inverse",
                 border=True,
-                help="Gas concentration level (ppm)",
+                help="Gas sensor output, filtered and calibrated on the device (mV)",
                 chart_data=(
-                    pd.DataFrame(device.history)["gas_level"]
+                    device.history_frame()["gas_level"]
                     if device.history
                     else None
                 ),
@@ -284,12 +443,12 @@ def render_device_tab(device: DeviceData):
             p_val = prev.get("motor_adc") if prev else None
             st.metric(
                 "Motor ADC",
-                f"{val}",
+                f"{val} mV",
                 calculate_delta(val, p_val),
                 border=True,
-                help="Motor flow ADC value",
+                help="Motor current sensor output, filtered and calibrated (mV)",
                 chart_data=(
-                    pd.DataFrame(device.history)["motor_adc"]
+                    device.history_frame()["motor_adc"]
                     if device.history
                     else None
                 ),
@@ -317,7 +476,7 @@ def render_device_tab(device: DeviceData):
             help="Acceleration X-axis",
             delta=calculate_delta(acc_x, acc_x_prev),
             chart_data=(
-                pd.DataFrame(device.history)["acceleration_x"]
+                device.history_frame()["acceleration_x"]
                 if device.history
                 else None
             ),
@@ -331,7 +490,7 @@ def render_device_tab(device: DeviceData):
             help="Acceleration Y-axis",
             delta=calculate_delta(acc_y, acc_y_prev),
             chart_data=(
-                pd.DataFrame(device.history)["acceleration_y"]
+                device.history_frame()["acceleration_y"]
                 if device.history
                 else None
             ),
@@ -345,7 +504,7 @@ def render_device_tab(device: DeviceData):
             help="Acceleration Z-axis",
             delta=calculate_delta(acc_z, acc_z_prev),
             chart_data=(
-                pd.DataFrame(device.history)["acceleration_z"]
+                device.history_frame()["acceleration_z"]
                 if device.history
                 else None
             ),
@@ -359,7 +518,7 @@ def render_device_tab(device: DeviceData):
             help="Gyroscope X-axis",
             delta=calculate_delta(gyro_x, gyro_x_prev),
             chart_data=(
-                pd.DataFrame(device.history)["gyro_x"] if device.history else None
+                device.history_frame()["gyro_x"] if device.history else None
             ),
         )
         gyro_y = data.get("gyro_y")
@@ -371,7 +530,7 @@ def render_device_tab(device: DeviceData):
             help="Gyroscope Y-axis",
             delta=calculate_delta(gyro_y, gyro_y_prev),
             chart_data=(
-                pd.DataFrame(device.history)["gyro_y"] if device.history else None
+                device.history_frame()["gyro_y"] if device.history else None
             ),
         )
         gyro_z = data.get("gyro_z")
@@ -383,17 +542,29 @@ def render_device_tab(device: DeviceData):
             help="Gyroscope Z-axis",
             delta=calculate_delta(gyro_z, gyro_z_prev),
             chart_data=(
-                pd.DataFrame(device.history)["gyro_z"] if device.history else None
+                device.history_frame()["gyro_z"] if device.history else None
             ),
         )
 
+    # --- ALARMS ---
+    if device.alarms:
+        with st.expander(f"🚨 Recent alarms ({len(device.alarms)})"):
+            st.dataframe(
+                pd.DataFrame(list(device.alarms)[::-1]), use_container_width=True
+            )
+
     st.divider()
 
     # --- CHARTS ---
     if len(device.history) > 2:
-        df = pd.DataFrame(device.history)
+        df = device.history_frame()
+
+        tab_env, tab_mot, tab_hist = st.tabs(
+            ["🌡️ Environment Charts", "⚙️ Mechanical Analysis", "🗄️ History"]
+        )
 
-        tab_env, tab_mot = st.tabs(["🌡️ Environment Charts", "⚙️ Mechanical Analysis"])
+        with tab_hist:
+            render_history(device, span_s)
 
         with tab_env:
             # Wykres temperatur
@@ -428,7 +599,7 @@ def main():
     state = get_mqtt_state()
 
     # 2. Render Sidebar
-    render_sidebar(state)
+    history_span = render_sidebar(state)
 
     if client is None:
         st.error("🚨 Critical Error: MQTT Broker is unreachable. Please check Docker.")
@@ -442,20 +613,22 @@ def main():
 
     while True:
         with main_container.container():
-            if not state.devices:
-                st.info(f"📡 Waiting for devices on `{AppConfig.TOPIC}`...")
-                st.write("Listening for: `sensor/jadwiga` or similar...")
+            # Sortujemy nazwy, żeby kolejność zakładek nie skakała
+            # (tylko urządzenia, które przysłały już jakieś próbki)
+            device_names = sorted(
+                name for name, device in list(state.devices.items()) if device.latest
+            )
+            if not device_names:
+                st.info(f"📡 Waiting for devices on `{subscription_topic()}`...")
+                st.write("Listening for: `sensor/<device>/telemetry` or similar...")
             else:
-                # Sortujemy nazwy, żeby kolejność zakładek nie skakała
-                device_names = sorted(list(state.devices.keys()))
-
                 # Tworzymy zakładki dla każdego urządzenia
                 # Np. Tab 1: "JADWIGA", Tab 2: "GARAZ"
                 tabs = st.tabs([f"📍 {name.upper()}" for name in device_names])
 
                 for i, name in enumerate(device_names):
                     with tabs[i]:
-                        render_device_tab(state.devices[name])
+                        render_device_tab(state.devices[name], history_span)
 
         time.sleep(0.5)
 
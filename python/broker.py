@@ -0,0 +1,26 @@
+"""
+TLS for the broker connection, shared by app.py, ingest.py and main.py.
+
+The broker only listens on TLS with client certificates
+(mosquitto/config/mosquitto.conf); mosquitto/gen_certs.sh issues them. The
+certificate CN is the username its ACL checks: dashboard, ingest or logger.
+"""
+
+import os
+import ssl
+
+import paho.mqtt.client as mqtt
+
+
+def configure_tls(client: mqtt.Client) -> bool:
+    """Turns on TLS when MQTT_TLS_CA is set. Returns whether it did."""
+    ca = os.getenv("MQTT_TLS_CA")
+    if not ca:
+        return False
+    client.tls_set(
+        ca_certs=ca,
+        certfile=os.getenv("MQTT_TLS_CERT") or None,
+        keyfile=os.getenv("MQTT_TLS_KEY") or None,
+        tls_version=ssl.PROTOCOL_TLS_CLIENT,
+    )
+    return True
@@ -0,0 +1,139 @@
+import os
+import signal
+import sys
+import threading
+import time
+from collections import deque
+from typing import Any, Deque, Dict, Set, Tuple
+
+import paho.mqtt.client as mqtt
+from paho.mqtt.enums import CallbackAPIVersion
+from dotenv import load_dotenv
+
+import telemetry
+from broker import configure_tls
+from store import TimeSeriesStore
+
+# Load environment variables from .env file
+load_dotenv()
+
+
+class Config:
+    """
+    Ingestion settings, from the same .env as the dashboard.
+    """
+
+    def __init__(self):
+        self.broker = os.getenv("MQTT_BROKER", "localhost")
+        self.port = int(os.getenv("MQTT_PORT", 1883))
+        self.device = os.getenv("MQTT_DEVICE", "+")
+        self.store_path = os.getenv("STORE_PATH", "data")
+        # how often due segments are written and old ones pruned
+        self.flush_interval_s = float(os.getenv("STORE_FLUSH_INTERVAL_S", 5))
+        # the binary and batch frames carry the same samples; take one format
+        self.topic = telemetry.device_topic(
+            self.device, telemetry.TELEMETRY_CHANNEL, os.getenv("INGEST_SUFFIX", "batch")
+        )
+
+    def __repr__(self):
+        return (
+            f"Config(broker={self.broker}, port={self.port}, topic={self.topic}, "
+            f"store_path={self.store_path})"
+        )
+
+
+class Ingestor:
+    """Decodes telemetry and appends it to the store, one lock for both threads."""
+
+    def __init__(self, store: TimeSeriesStore):
+        self.store = store
+        self.lock = threading.Lock()
+        self.samples = 0
+        # journal sequence numbers already stored, per device; replays repeat
+        self.seen: Dict[str, Tuple[Deque[int], Set[int]]] = {}
+
+    def _fresh(self, device: str, sample: Dict[str, Any]) -> bool:
+        seq = sample.get("seq")
+        if seq is None:
+            return True
+        order, members = self.seen.setdefault(device, (deque(maxlen=10000), set()))
+        if seq in members:
+            return False
+        if len(order) == order.maxlen:
+            members.discard(order[0])
+        order.append(seq)
+        members.add(seq)
+        return True
+
+    def on_connect(
+        self, client: mqtt.Client, userdata: Any, flags: Dict, rc: int, properties: Any = None
+    ) -> None:
+        if rc == 0:
+            client.subscribe(userdata.topic)
+            print(f"📡 Subscribed to {userdata.topic}")
+        else:
+            print(f"⚠️ Connection failed with code: {rc}")
+
+    def on_message(self, client: mqtt.Client, userdata: Any, msg: mqtt.MQTTMessage) -> None:
+        topic = telemetry.parse_topic(msg.topic)
+        if topic is None:
+            return
+        try:
+            samples = telemetry.decode_samples(msg.topic, msg.payload)
+        except ValueError as e:
+            print(f"⚠️ Dropped a bad frame from {msg.topic}: {e}")
+            return
+
+        received = time.time()
+        for sample in samples:
+            stamp = telemetry.device_time(sample)
+            sample["time"] = stamp if stamp is not None else received
+        with self.lock:
+            samples = [s for s in samples if self._fresh(topic.device, s)]
+            self.store.add_samples(topic.device, samples)
+            self.samples += len(samples)
+
+    def run_flusher(self, interval_s: float) -> None:
+        while True:
+            time.sleep(interval_s)
+            with self.lock:
+                rows = self.store.flush()
+                pruned = self.store.prune()
+                samples, self.samples = self.samples, 0
+            if rows or pruned:
+                print(f"💾 {samples} samples in, {rows} rows written, {pruned} segments pruned")
+
+
+def main():
+    config = Config()
+    print(f"⚙️  Loaded configuration: {config}")
+
+    ingestor = Ingestor(TimeSeriesStore(config.store_path))
+    client = mqtt.Client(callback_api_version=CallbackAPIVersion.VERSION2, userdata=config)
+    client.on_connect = ingestor.on_connect
+    client.on_message = ingestor.on_message
+    configure_tls(client)
+
+    print(f"⏳ Connecting to {config.broker}:{config.port}...")
+    try:
+        client.connect(config.broker, config.port, 60)
+    except Exception as e:
+        print(f"❌ Could not connect to broker: {e}")
+        sys.exit(1)
+
+    threading.Thread(
+        target=ingestor.run_flusher, args=(config.flush_interval_s,), daemon=True
+    ).start()
+    # docker stop: leave the loop and write what is still in memory
+    signal.signal(signal.SIGTERM, lambda *_: client.disconnect())
+    try:
+        client.loop_forever()
+    except KeyboardInterrupt:
+        print("\n🛑 Stopping, writing open segments...")
+        client.disconnect()
+    with ingestor.lock:
+        ingestor.store.flush(force=True)
+
+
+if __name__ == "__main__":
+    main()
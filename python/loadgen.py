@@ -0,0 +1,273 @@
+"""
+Load generator: N simulated boards publishing firmware batch frames, to find
+the throughput ceiling of a broker (or of an area broker and its bridge).
+
+    python loadgen.py record frames.bin --seconds 60
+    python loadgen.py run --devices 200 --rate 2 --duration 60 [--frames frames.bin]
+
+`record` captures the `telemetry/batch` payloads real boards publish, so a
+run replays the same sizes and compression ratios. Without a capture, `run`
+sends uncompressed v2 batches of 50 samples (1718 bytes), the worst case.
+
+Every frame gets its header time rewritten to the send time (with a zero
+epoch offset, so consumers fall back to their receive time), and a probe
+client subscribed to the same topics measures end-to-end latency and loss
+from it. `--probe-broker` points the probe elsewhere, e.g. at the central
+broker while the boards publish to an area broker.
+
+Simulated boards are named `10ad<index>` and publish under `--root`
+(default `loadtest`, which the dashboard and ingest do not read). Use
+`--root sensor` to load them and the bridges too; their topics are only
+forwarded under `sensor/`. All connections use the `loadgen` certificate
+(mosquitto/gen_certs.sh loadgen) from MQTT_TLS_CA / _CERT / _KEY.
+
+One process tops out at a few thousand messages per second; run several
+with different `--first` for more.
+"""
+
+import argparse
+import os
+import struct
+import threading
+import time
+from typing import Any, Dict, List, Optional
+
+import paho.mqtt.client as mqtt
+from paho.mqtt.enums import CallbackAPIVersion
+from dotenv import load_dotenv
+
+import telemetry
+from broker import configure_tls
+
+load_dotenv()
+
+_RECORD = struct.Struct("<I")  # capture file: length-prefixed payloads
+_BATCH_HEADER = struct.Struct("<BBQq")  # batch v2 / v3, plain or compressed
+_FRAME_V3 = struct.Struct("<BB3h3hhHhHHHHH")  # hardware/include/telemetry.h
+_SYS_TOPICS = (
+    "$SYS/broker/clients/connected",
+    "$SYS/broker/load/messages/received/1min",
+    "$SYS/broker/load/messages/sent/1min",
+    "$SYS/broker/load/bytes/received/1min",
+)
+
+
+def synthetic_batch(samples: int = 50, period_us: int = 10000) -> bytes:
+    """Uncompressed v2 batch of plausible v3 frames, 100 Hz by default."""
+    out = bytearray(_BATCH_HEADER.pack(2, samples, 0, 0))
+    for i in range(samples):
+        out += struct.pack("<I", i * period_us)
+        out += _FRAME_V3.pack(
+            3, 0, 12, -40, 9810, 3, -2, 1, 2850, 410 + i % 7, 2310, 4520, 1200 + i, 1180, 35, 60
+        )
+    return bytes(out)
+
+
+def load_frames(path: str) -> List[bytes]:
+    frames = []
+    with open(path, "rb") as f:
+        while header := f.read(_RECORD.size):
+            (size,) = _RECORD.unpack(header)
+            frames.append(f.read(size))
+    if not frames:
+        raise ValueError(f"No frames in {path}")
+    return frames
+
+
+def stamp(frame: bytes, now_us: int) -> Optional[bytes]:
+    """Copy of a v2/v3 batch with its base time set to now_us; None for v1."""
+    if len(frame) < _BATCH_HEADER.size or frame[0] & 0x7F not in (2, 3):
+        return None
+    out = bytearray(frame)
+    struct.pack_into("<Qq", out, 2, now_us, 0)
+    return bytes(out)
+
+
+def new_client(client_id: str) -> mqtt.Client:
+    client = mqtt.Client(callback_api_version=CallbackAPIVersion.VERSION2, client_id=client_id)
+    configure_tls(client)
+    return client
+
+
+def percentile(values: List[float], p: float) -> float:
+    if not values:
+        return float("nan")
+    values = sorted(values)
+    return values[min(len(values) - 1, int(p / 100 * len(values)))]
+
+
+class Probe:
+    """Counts what comes back through the broker, and the broker's $SYS load."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.received = 0
+        self.bytes = 0
+        self.latencies_ms: List[float] = []  # since the last report
+        self.all_latencies_ms: List[float] = []
+        self.sys: Dict[str, str] = {}
+
+    def on_message(self, client: mqtt.Client, userdata: Any, msg: mqtt.MQTTMessage) -> None:
+        if msg.topic.startswith("$SYS/"):
+            self.sys[msg.topic] = msg.payload.decode(errors="replace")
+            return
+        now_us = time.time_ns() // 1000
+        latency_ms = None
+        if len(msg.payload) >= _BATCH_HEADER.size and msg.payload[0] & 0x7F in (2, 3):
+            (sent_us,) = struct.unpack_from("<Q", msg.payload, 2)
+            latency_ms = (now_us - sent_us) / 1000
+        with self.lock:
+            self.received += 1
+            self.bytes += len(msg.payload)
+            if latency_ms is not None:
+                self.latencies_ms.append(latency_ms)
+
+    def take(self) -> tuple[int, int, List[float]]:
+        with self.lock:
+            received, self.received = self.received, 0
+            size, self.bytes = self.bytes, 0
+            latencies, self.latencies_ms = self.latencies_ms, []
+        self.all_latencies_ms += latencies
+        return received, size, latencies
+
+
+def record(args: argparse.Namespace) -> None:
+    topic = telemetry.device_topic(args.device, telemetry.TELEMETRY_CHANNEL, telemetry.BATCH_SUFFIX)
+    out = open(args.file, "wb")
+    count = 0
+
+    def on_message(client: mqtt.Client, userdata: Any, msg: mqtt.MQTTMessage) -> None:
+        nonlocal count
+        out.write(_RECORD.pack(len(msg.payload)) + msg.payload)
+        count += 1
+
+    client = new_client(f"loadgen-record-{os.getpid()}")
+    client.on_connect = lambda c, *_: c.subscribe(topic)
+    client.on_message = on_message
+    client.connect(args.broker, args.port, 60)
+    client.loop_start()
+    print(f"⏺️  Recording {topic} for {args.seconds} s...")
+    time.sleep(args.seconds)
+    client.loop_stop()
+    out.close()
+    print(f"💾 {count} frames written to {args.file}")
+
+
+def run(args: argparse.Namespace) -> None:
+    frames = load_frames(args.frames) if args.frames else [synthetic_batch()]
+    devices = [f"10ad{args.first + i:08x}" for i in range(args.devices)]
+    channel = f"{telemetry.TELEMETRY_CHANNEL}/{telemetry.BATCH_SUFFIX}"
+    topics = [f"{args.root}/{device}/{channel}" for device in devices]
+    print(f"⚙️  {len(devices)} boards x {args.rate}/s, {len(frames)} distinct frames, "
+          f"{sum(map(len, frames)) // len(frames)} bytes average, QoS {args.qos}")
+
+    probe = Probe()
+    probe_client = new_client(f"loadgen-probe-{os.getpid()}")
+    probe_client.on_message = probe.on_message
+    probe_client.on_connect = lambda c, *_: c.subscribe(
+        [(f"{args.root}/+/{channel}", args.qos)] + [(t, 0) for t in _SYS_TOPICS]
+    )
+    probe_client.connect(args.probe_broker or args.broker, args.probe_port or args.port, 60)
+    probe_client.loop_start()
+
+    start = time.monotonic()
+    clients = []
+    for device in devices:
+        client = new_client(device)
+        client.max_queued_messages_set(1000)
+        client.connect(args.broker, args.port, 60)
+        client.loop_start()
+        clients.append(client)
+    print(f"✅ Connected {len(clients)} boards in {time.monotonic() - start:.1f} s")
+    time.sleep(1)  # let the probe's subscription settle
+
+    interval = 1 / (len(clients) * args.rate)
+    sent = failed = total_sent = total_received = 0
+    start = next_report = time.monotonic()
+    k = 0
+    try:
+        while time.monotonic() - start < args.duration:
+            due = start + k * interval
+            now = time.monotonic()
+            if due > now:
+                time.sleep(due - now)
+            i = k % len(clients)
+            payload = stamp(frames[k % len(frames)], time.time_ns() // 1000) or frames[k % len(frames)]
+            info = clients[i].publish(topics[i], payload, qos=args.qos)
+            if info.rc == mqtt.MQTT_ERR_SUCCESS:
+                sent += 1
+            else:
+                failed += 1
+            k += 1
+
+            now = time.monotonic()
+            if now >= next_report + 1:
+                received, size, latencies = probe.take()
+                elapsed = now - next_report
+                total_sent += sent
+                total_received += received
+                behind_ms = max(0.0, (now - (start + k * interval)) * 1000)
+                print(f"t={now - start:5.1f}s  sent {sent / elapsed:7.0f}/s  "
+                      f"recv {received / elapsed:7.0f}/s  {size / elapsed / 1e6:6.2f} MB/s  "
+                      f"latency p50 {percentile(latencies, 50):6.1f} ms "
+                      f"p99 {percentile(latencies, 99):6.1f} ms  failed {failed}"
+                      + (f"  generator {behind_ms:.0f} ms behind" if behind_ms > 100 else ""))
+                sent = failed = 0
+                next_report = now
+    except KeyboardInterrupt:
+        print("\n🛑 Stopped, draining...")
+
+    time.sleep(args.drain)
+    received, _, _ = probe.take()
+    total_sent += sent
+    total_received += received
+    for client in clients:
+        client.disconnect()
+        client.loop_stop()
+    probe_client.disconnect()
+    probe_client.loop_stop()
+
+    lost = total_sent - total_received
+    print("=" * 40)
+    print(f"📤 sent {total_sent}, 📥 received {total_received}, "
+          f"lost {lost} ({100 * lost / max(total_sent, 1):.2f} %)")
+    latencies = probe.all_latencies_ms
+    print(f"⏱️  latency p50 {percentile(latencies, 50):.1f} ms, p99 {percentile(latencies, 99):.1f} ms, "
+          f"max {max(latencies, default=float('nan')):.1f} ms")
+    for topic in _SYS_TOPICS:
+        if topic in probe.sys:
+            print(f"   {topic}: {probe.sys[topic]}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--broker", default=os.getenv("MQTT_BROKER", "localhost"))
+    parser.add_argument("--port", type=int, default=int(os.getenv("MQTT_PORT", 8883)))
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    rec = commands.add_parser("record", help="capture real batch frames to a file")
+    rec.add_argument("file")
+    rec.add_argument("--seconds", type=float, default=60)
+    rec.add_argument("--device", default="+", help="one device ID, or + for all")
+
+    gen = commands.add_parser("run", help="publish from simulated boards")
+    gen.add_argument("--devices", type=int, default=100)
+    gen.add_argument("--rate", type=float, default=2, help="batches per second per board")
+    gen.add_argument("--duration", type=float, default=60, help="seconds")
+    gen.add_argument("--frames", help="capture from `record`; synthetic frames if omitted")
+    gen.add_argument("--qos", type=int, choices=(0, 1), default=0)
+    gen.add_argument("--root", default="loadtest", help="topic root, sensor to go through bridges")
+    gen.add_argument("--first", type=int, default=0, help="index of the first board")
+    gen.add_argument("--probe-broker", help="where the probe subscribes, default --broker")
+    gen.add_argument("--probe-port", type=int)
+    gen.add_argument("--drain", type=float, default=2, help="seconds to wait for stragglers")
+
+    args = parser.parse_args()
+    if args.command == "record":
+        record(args)
+    else:
+        run(args)
+
+
+if __name__ == "__main__":
+    main()
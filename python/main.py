@@ -7,6 +7,9 @@ import paho.mqtt.client as mqtt
 from paho.mqtt.enums import CallbackAPIVersion
 from dotenv import load_dotenv
 
+import telemetry
+from broker import configure_tls
+
 # Load environment variables from .env file
 load_dotenv()
 
@@ -23,10 +26,17 @@ class Config:
         """
         self.broker = os.getenv("MQTT_BROKER", "localhost")
         self.port = int(os.getenv("MQTT_PORT", 1883))
-        self.topic = os.getenv("MQTT_TOPIC", "sensor/all")
+        # one device ID, or "+" for every device on the broker
+        self.device = os.getenv("MQTT_DEVICE", "+")
+        self.topic = telemetry.device_topic(self.device, telemetry.TELEMETRY_CHANNEL)
+        self.binary_topic = f"{self.topic}/{telemetry.BINARY_SUFFIX}"
+        self.batch_topic = f"{self.topic}/{telemetry.BATCH_SUFFIX}"
 
     def __repr__(self):
-        return f"Config(broker={self.broker}, port={self.port}, topic={self.topic})"
+        return (
+            f"Config(broker={self.broker}, port={self.port}, topic={self.topic}, "
+            f"binary_topic={self.binary_topic}, batch_topic={self.batch_topic})"
+        )
 
 
 def on_connect(
@@ -45,8 +55,13 @@ def on_connect(
     if rc == 0:
         print(f"✅ Connected to MQTT Broker!")
         # Subscribing in on_connect ensures we resubscribe if connection is lost
-        client.subscribe(userdata.topic)
-        print(f"📡 Subscribed to topic: {userdata.topic}")
+        client.subscribe(
+            [(userdata.topic, 0), (userdata.binary_topic, 0), (userdata.batch_topic, 0)]
+        )
+        print(
+            f"📡 Subscribed to topics: {userdata.topic}, {userdata.binary_topic}, "
+            f"{userdata.batch_topic}"
+        )
     else:
         print(f"⚠️ Connection failed with code: {rc}")
 
@@ -61,15 +76,19 @@ def on_message(client: mqtt.Client, userdata: Any, msg: mqtt.MQTTMessage):
         msg: The actual message object containing topic and payload.
     """
     try:
-        # 1. Decode payload
-        payload_str = msg.payload.decode()
-
-        # 2. Parse JSON
-        data = json.loads(payload_str)
-
-        # 3. specific display logic
+        # 1. Decode JSON, binary frame or batch, depending on the topic
+        samples = telemetry.decode_samples(msg.topic, msg.payload)
+        if not samples:
+            return
+        data = samples[-1]
+        fmt = telemetry.topic_suffix(msg.topic) or "JSON"
+
+        # 2. specific display logic
         print("\n" + "=" * 40)
-        print(f"📥 Received data from: {msg.topic}")
+        print(
+            f"📥 Received {fmt} data from: {msg.topic} "
+            f"({len(samples)} samples, {len(msg.payload)} bytes)"
+        )
         print("-" * 40)
         print(f"🌡️  Temperature : {data.get('temperature', 'N/A')} °C")
         print(
@@ -82,6 +101,8 @@ def on_message(client: mqtt.Client, userdata: Any, msg: mqtt.MQTTMessage):
 
     except json.JSONDecodeError:
         print(f"⚠️ Failed to decode JSON: {msg.payload}")
+    except ValueError as e:
+        print(f"⚠️ Failed to decode binary frame: {e}")
     except Exception as e:
         print(f"❌ Error processing message: {e}")
 
@@ -108,6 +129,7 @@ def main():
     # 3. Assign Callbacks
     client.on_connect = on_connect
     client.on_message = on_message
+    configure_tls(client)
 
     # 4. Connect to Broker
     print(f"⏳ Connecting to {config.broker}:{config.port}...")
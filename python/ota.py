@@ -0,0 +1,284 @@
+"""
+Firmware updates over MQTT (hardware/include/ota.h).
+
+    python ota.py keygen ota_signing.pem
+    python ota.py push <device> firmware.bin --version 1.1.0 --key ota_signing.pem \\
+        [--base previous.bin] [--wait]
+
+`keygen` makes the ECDSA P-256 signing key and prints the OTA_SIGNING_KEY
+lines for hardware/include/secrets.h. Keep the key off the broker host.
+
+`push` signs the image, sends the manifest to `sensor/<device>/ota` and
+then answers the board's chunk requests on `ota/req` with `ota/data`; the
+board sets the pace. With `--base`, the image the board runs now
+(`.pio/build/<env>/firmware.bin` of that version), only a delta against it
+is sent, usually a small fraction of the image. `--wait` stays until the
+board has booted the new image and passed its health check, or rolled back.
+
+The version must be the FIRMWARE_VERSION the image was built with
+(platformio.ini); the board reports it and refuses to reinstall the running
+one. Connects with the `ota` certificate (mosquitto/gen_certs.sh ota) from
+MQTT_TLS_CA / _CERT / _KEY.
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import struct
+import subprocess
+import sys
+import threading
+import time
+from typing import Any, Dict, List
+
+import paho.mqtt.client as mqtt
+from paho.mqtt.enums import CallbackAPIVersion
+from dotenv import load_dotenv
+
+import telemetry
+from broker import configure_tls
+
+load_dotenv()
+
+OTA_CHANNEL = "ota"
+
+# --- hardware/lib/ota/ota_transfer.h ---
+_MANIFEST = struct.Struct("<BBHIII32s32s32sB72s")
+_MANIFEST_VERSION = 1
+_FLAG_DELTA = 0x01
+_REQUEST = struct.Struct("<II")
+_CHUNK_OFFSET = struct.Struct("<I")
+
+# --- hardware/lib/ota/delta_patch.h ---
+_DELTA_HEADER = struct.Struct("<III")
+_DELTA_MAGIC = 0x31504444
+_BLOCK = 32  # shortest copy worth its op bytes
+_STRIDE = 16  # base positions indexed; matches of _BLOCK + _STRIDE are always found
+
+
+def _varint(value: int) -> bytes:
+    out = bytearray()
+    while value >= 0x80:
+        out.append(value & 0x7F | 0x80)
+        value >>= 7
+    out.append(value)
+    return bytes(out)
+
+
+def _zigzag(value: int) -> int:
+    return (value << 1) ^ (value >> 63)
+
+
+def make_delta(base: bytes, image: bytes) -> bytes:
+    """
+    Copy/insert patch from base to image. Greedy: at every position the
+    longest copy from a block that also occurs in base, else a literal byte.
+    """
+    index: Dict[bytes, int] = {}
+    for i in range(0, len(base) - _BLOCK + 1, _STRIDE):
+        index.setdefault(base[i : i + _BLOCK], i)
+
+    out = bytearray(_DELTA_HEADER.pack(_DELTA_MAGIC, len(base), len(image)))
+    source_pos = 0
+    literal_start = 0
+
+    def flush_literal(end: int) -> None:
+        if end > literal_start:
+            out.extend(_varint((end - literal_start) << 1 | 1))
+            out.extend(image[literal_start:end])
+
+    j = 0
+    while j + _BLOCK <= len(image):
+        src = None
+        # after an insert the old code usually just continues
+        if image[j : j + _BLOCK] == base[source_pos : source_pos + _BLOCK]:
+            src = source_pos
+        else:
+            src = index.get(image[j : j + _BLOCK])
+        if src is None:
+            j += 1
+            continue
+        start, src_start = j, src
+        while start > literal_start and src_start > 0 and image[start - 1] == base[src_start - 1]:
+            start -= 1
+            src_start -= 1
+        end, src_end = j + _BLOCK, src + _BLOCK
+        while end + 64 <= len(image) and image[end : end + 64] == base[src_end : src_end + 64]:
+            end += 64
+            src_end += 64
+        while end < len(image) and src_end < len(base) and image[end] == base[src_end]:
+            end += 1
+            src_end += 1
+
+        flush_literal(start)
+        out.extend(_varint((end - start) << 1))
+        out.extend(_varint(_zigzag(src_start - source_pos)))
+        source_pos = src_end
+        literal_start = j = end
+    flush_literal(len(image))
+    return bytes(out)
+
+
+def apply_delta(base: bytes, patch: bytes) -> bytes:
+    """The board's DeltaPatcher, to check a patch before it is sent."""
+    magic, base_size, image_size = _DELTA_HEADER.unpack_from(patch)
+    if magic != _DELTA_MAGIC or base_size != len(base):
+        raise ValueError("Not a delta patch for this base")
+    out = bytearray()
+    offset = _DELTA_HEADER.size
+    source_pos = 0
+    while len(out) < image_size:
+        tag, offset = telemetry._varint(patch, offset)
+        length = tag >> 1
+        if tag & 1:
+            out += patch[offset : offset + length]
+            offset += length
+        else:
+            delta, offset = telemetry._varint(patch, offset)
+            source_pos += telemetry._unzigzag(delta)
+            out += base[source_pos : source_pos + length]
+            source_pos += length
+    if offset != len(patch) or len(out) != image_size:
+        raise ValueError("Delta patch does not end with the image")
+    return bytes(out)
+
+
+def sign(key: str, image_path: str) -> bytes:
+    """DER ECDSA signature over the SHA-256 of the image."""
+    return subprocess.run(
+        ["openssl", "dgst", "-sha256", "-sign", key, image_path],
+        check=True, capture_output=True,
+    ).stdout
+
+
+def keygen(args: argparse.Namespace) -> None:
+    if os.path.exists(args.key):
+        sys.exit(f"❌ {args.key} exists, not overwriting a signing key")
+    subprocess.run(
+        ["openssl", "ecparam", "-name", "prime256v1", "-genkey", "-noout", "-out", args.key],
+        check=True,
+    )
+    os.chmod(args.key, 0o600)
+    public = subprocess.run(
+        ["openssl", "ec", "-in", args.key, "-pubout"], check=True, capture_output=True, text=True
+    ).stdout
+    print(f"// secrets.h, public half of {args.key}")
+    print("#define OTA_SIGNING_KEY \\")
+    for line in public.splitlines():
+        print(f'  "{line}\\n" \\')
+    print()
+
+
+def build_manifest(args: argparse.Namespace, image: bytes) -> tuple[bytes, bytes]:
+    """The manifest and what is transferred: the patch or the whole image."""
+    if f"{args.version}".encode() + b"\0" not in image:
+        sys.exit(f"❌ {args.image} was not built with FIRMWARE_VERSION \"{args.version}\"")
+    signature = sign(args.key, args.image)
+    flags, transfer, base = 0, image, b""
+    if args.base:
+        with open(args.base, "rb") as f:
+            base = f.read()
+        patch = make_delta(base, image)
+        if apply_delta(base, patch) != image:
+            sys.exit("❌ Delta patch does not rebuild the image")
+        print(f"🧩 Delta {len(patch)} bytes, {100 * len(patch) / len(image):.0f} % of the image")
+        if len(patch) < len(image):
+            flags, transfer = _FLAG_DELTA, patch
+        else:
+            base = b""
+    manifest = _MANIFEST.pack(
+        _MANIFEST_VERSION, flags, 0, len(image), len(transfer), len(base),
+        hashlib.sha256(image).digest(), hashlib.sha256(base).digest() if base else bytes(32),
+        args.version.encode(), len(signature), signature,
+    )
+    return manifest, transfer
+
+
+def push(args: argparse.Namespace) -> None:
+    with open(args.image, "rb") as f:
+        image = f.read()
+    manifest, transfer = build_manifest(args, image)
+    topic = lambda suffix="": telemetry.device_topic(args.device, OTA_CHANNEL, suffix)
+
+    done = threading.Event()
+    result: List[int] = [1]
+    sent = [0]
+    started = time.monotonic()
+
+    def on_connect(client: mqtt.Client, userdata: Any, flags: Dict, rc: int, properties: Any = None):
+        client.subscribe([(topic("req"), 0), (topic("state"), 1)])
+        client.publish(topic(), manifest, qos=1)
+        print(f"📤 Manifest for {args.version} sent to {args.device}, {len(transfer)} bytes to go")
+
+    def on_message(client: mqtt.Client, userdata: Any, msg: mqtt.MQTTMessage) -> None:
+        if msg.topic == topic("req"):
+            offset, length = _REQUEST.unpack(msg.payload)
+            client.publish(
+                topic("data"), _CHUNK_OFFSET.pack(offset) + transfer[offset : offset + length], qos=1
+            )
+            if offset + length > sent[0]:
+                sent[0] = offset + length
+                rate = sent[0] / max(time.monotonic() - started, 1e-3)
+                print(f"\r⏳ {sent[0]}/{len(transfer)} bytes, {rate / 1024:.1f} KiB/s", end="")
+            return
+        if msg.retain:
+            return  # what the board said before this push
+        state = json.loads(msg.payload)
+        print(f"\n📟 {state}")
+        if state["state"] == "failed":
+            done.set()
+        elif state["state"] == "rebooting" and not args.wait:
+            result[0] = 0
+            done.set()
+        elif state.get("rolled_back") == args.version:
+            done.set()
+        elif state["state"] == "idle" and state.get("firmware") == args.version:
+            print(f"✅ {args.device} runs {args.version}")
+            result[0] = 0
+            done.set()
+
+    client = mqtt.Client(
+        callback_api_version=CallbackAPIVersion.VERSION2, client_id=f"ota-{os.getpid()}"
+    )
+    client.on_connect = on_connect
+    client.on_message = on_message
+    configure_tls(client)
+    client.connect(args.broker, args.port, 60)
+    client.loop_start()
+    try:
+        done.wait(args.timeout)
+    except KeyboardInterrupt:
+        print("\n🛑 Stopped; the board abandons the update once its requests go unanswered")
+    client.disconnect()
+    client.loop_stop()
+    sys.exit(result[0])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("--broker", default=os.getenv("MQTT_BROKER", "localhost"))
+    parser.add_argument("--port", type=int, default=int(os.getenv("MQTT_PORT", 8883)))
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    gen = commands.add_parser("keygen", help="make the image signing key")
+    gen.add_argument("key")
+
+    send = commands.add_parser("push", help="update one board")
+    send.add_argument("device", help="device ID, see hardware/include/device_id.h")
+    send.add_argument("image", help="firmware.bin to install")
+    send.add_argument("--version", required=True, help="its FIRMWARE_VERSION")
+    send.add_argument("--key", required=True, help="signing key from keygen")
+    send.add_argument("--base", help="firmware.bin the board runs now, to send a delta")
+    send.add_argument("--wait", action="store_true", help="until the new image is confirmed")
+    send.add_argument("--timeout", type=float, default=1800, help="seconds")
+
+    args = parser.parse_args()
+    if args.command == "keygen":
+        keygen(args)
+    else:
+        push(args)
+
+
+if __name__ == "__main__":
+    main()
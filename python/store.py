@@ -0,0 +1,312 @@
+"""
+Columnar time-series store for decoded telemetry, with rollup tiers.
+
+Samples go into Parquet segments, one directory per tier and device:
+
+    <root>/raw/<device>/<start_ms>-<end_ms>.parquet    every sample
+    <root>/1s/<device>/...                              1 s buckets
+    <root>/1min/<device>/...                            1 min buckets
+    <root>/1h/<device>/...                              1 h buckets
+
+A rollup row holds, per numeric field, `<field>_sum`, `<field>_min` and
+`<field>_max`, plus the bucket `count`. Sums rather than means make rows
+of the same bucket mergeable, which is how late samples (journal replays)
+are handled: those of an already closed bucket collect in one late bucket,
+written once none arrived for STORE_LATE_HOLD_S, and `query()` merges it
+with the row written earlier.
+
+Segment names carry their time range, so a query opens only the files it
+needs. The writer is `ingest.py`; the dashboard only reads.
+"""
+
+import os
+import time
+from dataclasses import dataclass
+from typing import Any, Dict, Iterable, List, Optional, Tuple
+
+import pandas as pd
+
+# Keys of a decoded sample that are not measurements
+META_KEYS = ("time", "timestamp_us", "epoch_offset_us", "uptime_ms", "seq")
+
+RAW_TIER = "raw"
+
+
+@dataclass(frozen=True)
+class Tier:
+    name: str
+    width_s: float  # bucket width, 0 for raw samples
+    retention_s: float  # segments older than this are deleted
+    flush_s: float  # longest a row waits in memory before it is written
+
+
+TIERS: Tuple[Tier, ...] = (
+    Tier(RAW_TIER, 0, float(os.getenv("STORE_RAW_RETENTION_S", 86400)), 30),
+    Tier("1s", 1, float(os.getenv("STORE_1S_RETENTION_S", 7 * 86400)), 30),
+    Tier("1min", 60, float(os.getenv("STORE_1MIN_RETENTION_S", 90 * 86400)), 300),
+    Tier("1h", 3600, float(os.getenv("STORE_1H_RETENTION_S", 5 * 365 * 86400)), 3600),
+)
+
+# Rows per segment before it is written regardless of age
+SEGMENT_ROWS = int(os.getenv("STORE_SEGMENT_ROWS", 20000))
+# A late bucket is written once no sample arrived for it this long
+LATE_HOLD_S = float(os.getenv("STORE_LATE_HOLD_S", 30))
+# Nominal raw sample period, used to size queries (100 Hz firmware default)
+RAW_PERIOD_S = float(os.getenv("STORE_RAW_PERIOD_S", 0.01))
+
+
+def numeric_fields(sample: Dict[str, Any]) -> Iterable[Tuple[str, float]]:
+    for key, value in sample.items():
+        if key not in META_KEYS and isinstance(value, (int, float)):
+            yield key, float(value)
+
+
+class _Bucket:
+    """Running count/sum/min/max of every field over one bucket."""
+
+    __slots__ = ("start", "count", "sums", "mins", "maxs")
+
+    def __init__(self, start: float):
+        self.start = start
+        self.count = 0
+        self.sums: Dict[str, float] = {}
+        self.mins: Dict[str, float] = {}
+        self.maxs: Dict[str, float] = {}
+
+    def add(self, sample: Dict[str, Any]) -> None:
+        self.count += 1
+        for key, value in numeric_fields(sample):
+            if key in self.sums:
+                self.sums[key] += value
+                self.mins[key] = min(self.mins[key], value)
+                self.maxs[key] = max(self.maxs[key], value)
+            else:
+                self.sums[key] = value
+                self.mins[key] = value
+                self.maxs[key] = value
+
+    def row(self) -> Dict[str, float]:
+        row = {"time": self.start, "count": self.count}
+        for key in self.sums:
+            row[f"{key}_sum"] = self.sums[key]
+            row[f"{key}_min"] = self.mins[key]
+            row[f"{key}_max"] = self.maxs[key]
+        return row
+
+
+class _TierWriter:
+    """Open buckets and not yet written rows of one tier and device."""
+
+    def __init__(self, tier: Tier):
+        self.tier = tier
+        self.buckets: Dict[float, _Bucket] = {}
+        # buckets that had closed when more samples came, and when the
+        # last of those came
+        self.late: Dict[float, Tuple[_Bucket, float]] = {}
+        self.newest = 0.0
+        self.rows: List[Dict[str, Any]] = []
+        self.first_row_at: Optional[float] = None
+
+    def add(self, sample: Dict[str, Any], now: float) -> None:
+        stamp = sample["time"]
+        if self.tier.width_s == 0:
+            row = {"time": stamp}
+            row.update(numeric_fields(sample))
+            self._append(row, now)
+            return
+
+        # a bucket closes one width after the newest sample passed its end,
+        # which leaves room for slightly out-of-order batches
+        start = stamp - stamp % self.tier.width_s
+        horizon = max(self.newest, stamp) - 2 * self.tier.width_s
+        if start < horizon and start not in self.buckets:
+            bucket, _ = self.late.get(start) or (_Bucket(start), now)
+            bucket.add(sample)
+            self.late[start] = (bucket, now)
+            self.close_late(now)
+            return
+
+        bucket = self.buckets.get(start)
+        if bucket is None:
+            bucket = self.buckets[start] = _Bucket(start)
+        bucket.add(sample)
+        self.newest = max(self.newest, stamp)
+        for start in [s for s in self.buckets if s < horizon]:
+            self._append(self.buckets.pop(start).row(), now)
+
+    def close_late(self, now: float) -> None:
+        """Writes late buckets that no sample was added to for LATE_HOLD_S."""
+        for start in [s for s, (_, added) in self.late.items() if now - added >= LATE_HOLD_S]:
+            self._append(self.late.pop(start)[0].row(), now)
+
+    def close_all(self) -> None:
+        for start in sorted(self.buckets):
+            self.rows.append(self.buckets.pop(start).row())
+        for start in sorted(self.late):
+            self.rows.append(self.late.pop(start)[0].row())
+
+    def _append(self, row: Dict[str, Any], now: float) -> None:
+        if not self.rows:
+            self.first_row_at = now
+        self.rows.append(row)
+
+    def due(self, now: float) -> bool:
+        if not self.rows:
+            return False
+        if len(self.rows) >= SEGMENT_ROWS:
+            return True
+        return self.first_row_at is not None and now - self.first_row_at >= self.tier.flush_s
+
+    def take(self) -> List[Dict[str, Any]]:
+        rows, self.rows = self.rows, []
+        self.first_row_at = None
+        return rows
+
+
+def _segment_range(name: str) -> Optional[Tuple[float, float]]:
+    """(start, end) in seconds from a segment file name, None if foreign."""
+    if not name.endswith(".parquet"):
+        return None
+    try:
+        start_ms, end_ms = name[: -len(".parquet")].split("-")[:2]
+        return int(start_ms) / 1000, int(end_ms) / 1000
+    except ValueError:
+        return None
+
+
+class TimeSeriesStore:
+    def __init__(self, root: str):
+        self.root = root
+        self._writers: Dict[Tuple[str, str], _TierWriter] = {}
+
+    # --- writing ---
+
+    def add_samples(self, device: str, samples: List[Dict[str, Any]]) -> None:
+        """Adds decoded samples; each needs a `time` key (Unix seconds)."""
+        now = time.time()
+        for tier in TIERS:
+            writer = self._writer(device, tier)
+            for sample in samples:
+                writer.add(sample, now)
+
+    def flush(self, force: bool = False) -> int:
+        """
+        Writes every segment that is full or old enough (all of them, open
+        buckets included, if force). Returns the number of rows written.
+        """
+        now = time.time()
+        written = 0
+        for (device, _), writer in self._writers.items():
+            if force:
+                writer.close_all()
+            else:
+                writer.close_late(now)
+            if force or writer.due(now):
+                rows = writer.take()
+                if rows:
+                    self._write_segment(writer.tier, device, rows)
+                    written += len(rows)
+        return written
+
+    def prune(self) -> int:
+        """Deletes segments past their tier retention. Returns the count."""
+        now = time.time()
+        removed = 0
+        for tier in TIERS:
+            for device in self.devices(tier.name):
+                directory = self._directory(tier.name, device)
+                for name in os.listdir(directory):
+                    span = _segment_range(name)
+                    if span is not None and now - span[1] > tier.retention_s:
+                        os.remove(os.path.join(directory, name))
+                        removed += 1
+        return removed
+
+    def _writer(self, device: str, tier: Tier) -> _TierWriter:
+        key = (device, tier.name)
+        writer = self._writers.get(key)
+        if writer is None:
+            writer = self._writers[key] = _TierWriter(tier)
+        return writer
+
+    def _directory(self, tier: str, device: str) -> str:
+        return os.path.join(self.root, tier, device)
+
+    def _write_segment(self, tier: Tier, device: str, rows: List[Dict[str, Any]]) -> None:
+        frame = pd.DataFrame(rows).sort_values("time")
+        start = int(frame["time"].iloc[0] * 1000)
+        end = int((frame["time"].iloc[-1] + tier.width_s) * 1000)
+        directory = self._directory(tier.name, device)
+        os.makedirs(directory, exist_ok=True)
+        path = os.path.join(directory, f"{start}-{end}.parquet")
+        suffix = 1
+        while os.path.exists(path):
+            path = os.path.join(directory, f"{start}-{end}-{suffix}.parquet")
+            suffix += 1
+        # written under a temporary name so a reader never sees half a file
+        frame.to_parquet(f"{path}.tmp", index=False, compression="zstd")
+        os.replace(f"{path}.tmp", path)
+
+    # --- reading ---
+
+    def devices(self, tier: str = RAW_TIER) -> List[str]:
+        directory = os.path.join(self.root, tier)
+        if not os.path.isdir(directory):
+            return []
+        return sorted(os.listdir(directory))
+
+    @staticmethod
+    def tier_for(span_s: float, max_points: int) -> Tier:
+        """Finest tier that shows span_s in about max_points rows or fewer."""
+        for tier in TIERS:
+            width = tier.width_s or RAW_PERIOD_S
+            if span_s / width <= max_points:
+                return tier
+        return TIERS[-1]
+
+    def query(
+        self, device: str, start: float, end: float, max_points: int = 1000
+    ) -> pd.DataFrame:
+        """
+        Samples or bucket statistics of one device between start and end
+        (Unix seconds), from the tier that matches the span. Indexed by
+        time; rollups have `<field>` (mean), `<field>_min`, `<field>_max`
+        and `count`.
+        """
+        tier = self.tier_for(end - start, max_points)
+        directory = self._directory(tier.name, device)
+        frames = []
+        if os.path.isdir(directory):
+            for name in sorted(os.listdir(directory)):
+                span = _segment_range(name)
+                if span is not None and span[1] >= start and span[0] <= end:
+                    frames.append(pd.read_parquet(os.path.join(directory, name)))
+        if not frames:
+            return pd.DataFrame()
+
+        frame = pd.concat(frames, ignore_index=True)
+        frame = frame[(frame["time"] >= start) & (frame["time"] <= end)]
+        if tier.width_s:
+            frame = _merge_buckets(frame)
+        else:
+            frame = frame.sort_values("time")
+        frame.index = pd.to_datetime(frame["time"], unit="s")
+        return frame
+
+
+def _merge_buckets(frame: pd.DataFrame) -> pd.DataFrame:
+    """Merges partial rows of the same bucket and adds the means."""
+    aggregations = {}
+    for column in frame.columns:
+        if column == "time":
+            continue
+        if column == "count" or column.endswith("_sum"):
+            aggregations[column] = "sum"
+        elif column.endswith("_min"):
+            aggregations[column] = "min"
+        elif column.endswith("_max"):
+            aggregations[column] = "max"
+    merged = frame.groupby("time", as_index=False).agg(aggregations)
+    for column in [c for c in merged.columns if c.endswith("_sum")]:
+        merged[column[: -len("_sum")]] = merged[column] / merged["count"]
+    return merged.drop(columns=[c for c in merged.columns if c.endswith("_sum")])
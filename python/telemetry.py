@@ -0,0 +1,321 @@
+"""
+Decoders for the firmware telemetry wire formats.
+
+Every device publishes under `sensor/<device>/` (hardware/include/device_id.h).
+The same sample goes out as JSON on `sensor/<device>/telemetry`, as a
+packed binary frame on `.../telemetry/bin` (see `TelemetryFrame` in
+hardware/include/telemetry.h) and batched on `.../telemetry/batch`
+(see `FrameBatcher`). All of them decode to the same dictionary keys.
+Alarm edges arrive on `.../alarm`, the retained birth / last-will
+message on `.../status`.
+
+Samples are stamped on the device at acquisition (`timestamp_us`, a
+monotonic microsecond clock) together with the SNTP-derived offset to UTC
+(`epoch_offset_us`); `device_time()` combines the two.
+"""
+
+import json
+import struct
+from typing import Any, Callable, Dict, List, NamedTuple, Optional
+
+TOPIC_ROOT = "sensor"
+TELEMETRY_CHANNEL = "telemetry"
+ALARM_CHANNEL = "alarm"
+STATUS_CHANNEL = "status"
+BINARY_SUFFIX = "bin"
+BATCH_SUFFIX = "batch"
+
+# --- Binary schema v1 (30 bytes, little-endian) ---
+_FRAME_V1 = struct.Struct("<BB3h3hhHhHHHHH")
+_FLAG_FLAME = 0x01
+
+
+def _decode_v1(payload: bytes) -> Dict[str, Any]:
+    (
+        _version,
+        flags,
+        acc_x,
+        acc_y,
+        acc_z,
+        gyro_x,
+        gyro_y,
+        gyro_z,
+        temperature,
+        gas_level,
+        dht_temperature_centi,
+        dht_humidity_centi,
+        motor_adc,
+        motor_mean_deci,
+        motor_rms_deci,
+        motor_peak_deci,
+    ) = _FRAME_V1.unpack(payload)
+
+    return {
+        "acceleration_x": acc_x,
+        "acceleration_y": acc_y,
+        "acceleration_z": acc_z,
+        "gyro_x": gyro_x,
+        "gyro_y": gyro_y,
+        "gyro_z": gyro_z,
+        "temperature": temperature,
+        "flame_status": 1 if flags & _FLAG_FLAME else 0,
+        "gas_level": gas_level,
+        "temperature_out": dht_temperature_centi / 100,
+        "humidity_out": dht_humidity_centi / 100,
+        "motor_adc": motor_adc,
+        "motor_mean": motor_mean_deci / 10,
+        "motor_rms": motor_rms_deci / 10,
+        "motor_peak": motor_peak_deci / 10,
+    }
+
+
+# --- Binary schema v2: v1 layout, finer units ---
+# acceleration mm/s^2, gyro mrad/s, temperature 0.01 degC (v1: whole units)
+def _decode_v2(payload: bytes) -> Dict[str, Any]:
+    sample = _decode_v1(payload)
+    for key in ("acceleration_x", "acceleration_y", "acceleration_z"):
+        sample[key] /= 1000
+    for key in ("gyro_x", "gyro_y", "gyro_z"):
+        sample[key] /= 1000
+    sample["temperature"] /= 100
+    return sample
+
+
+# --- Binary schema v3: v2 units, except gas and motor in calibrated mV ---
+# (v1/v2: raw ADC counts). Same frame as v2, so the same decoder.
+
+# schema version byte -> (frame size, decoder)
+_DECODERS: Dict[int, tuple[int, Callable[[bytes], Dict[str, Any]]]] = {
+    1: (_FRAME_V1.size, _decode_v1),
+    2: (_FRAME_V1.size, _decode_v2),
+    3: (_FRAME_V1.size, _decode_v2),
+}
+
+
+def decode_binary(payload: bytes) -> Dict[str, Any]:
+    """
+    Decodes one binary telemetry frame.
+
+    Raises:
+        ValueError: If the schema version is unknown or the size is wrong.
+    """
+    if not payload:
+        raise ValueError("Empty binary frame")
+
+    version = payload[0]
+    if version not in _DECODERS:
+        raise ValueError(f"Unknown telemetry schema version {version}")
+
+    size, decoder = _DECODERS[version]
+    if len(payload) != size:
+        raise ValueError(
+            f"Schema v{version} frame must be {size} bytes, got {len(payload)}"
+        )
+    return decoder(payload)
+
+
+# --- Batch frames ---
+# v1 header: version, count, base uptime (ms); then count x (dt_ms, frame)
+# v2 header: version, count, base device time (us), epoch offset (us, 0 = the
+#            device clock is not SNTP-synced yet); then count x (dt_us, frame)
+# v3: v2 replayed from the flash journal, each frame preceded by its uint32
+#     journal sequence number; replays can repeat, dedupe on (device, seq)
+_BATCH_LAYOUTS: Dict[int, tuple[struct.Struct, struct.Struct]] = {
+    1: (struct.Struct("<BBI"), struct.Struct("<H")),
+    2: (struct.Struct("<BBQq"), struct.Struct("<I")),
+    3: (struct.Struct("<BBQq"), struct.Struct("<I")),
+}
+_REPLAY_SEQ = struct.Struct("<I")
+_REPLAY_VERSION = 3
+
+# --- Compressed batches (hardware/lib/batcher/batch_codec.h) ---
+# version | 0x80, same header, then per record: varint zig-zag
+# delta-of-delta of dt_us, a changed-field bitmask, and a varint zig-zag
+# delta (wrapping in the field width) for every changed field.
+_COMPRESSED_FLAG = 0x80
+_FRAME_FIELDS = (1, 1) + (2,) * 14  # TELEMETRY_FRAME_FIELDS
+_BATCH_FIELDS: Dict[int, tuple[int, ...]] = {
+    2: _FRAME_FIELDS,
+    3: (4,) + _FRAME_FIELDS,  # ReplayRecord
+}
+
+
+def _varint(payload: bytes, offset: int) -> tuple[int, int]:
+    value = shift = 0
+    while True:
+        if offset >= len(payload):
+            raise ValueError("Compressed batch truncated")
+        byte = payload[offset]
+        offset += 1
+        value |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return value, offset
+        shift += 7
+        if shift > 63:
+            raise ValueError("Varint too long in compressed batch")
+
+
+def _unzigzag(value: int) -> int:
+    return (value >> 1) ^ -(value & 1)
+
+
+def decompress_batch(payload: bytes) -> bytes:
+    """
+    Rebuilds the plain batch frame from a compressed one.
+
+    Raises:
+        ValueError: If the frame is malformed or uses an unknown version.
+    """
+    version = payload[0] & ~_COMPRESSED_FLAG
+    if version not in _BATCH_FIELDS or len(payload) < _BATCH_LAYOUTS[version][0].size:
+        raise ValueError(f"Unknown compressed batch version {version}")
+    header = _BATCH_LAYOUTS[version][0]
+    fields = _BATCH_FIELDS[version]
+    mask_bytes = (len(fields) + 7) // 8
+    count = payload[1]
+
+    out = bytearray(payload[: header.size])
+    out[0] = version
+    offset = header.size
+    prev = [0] * len(fields)
+    dt = t = 0
+    for _ in range(count):
+        dod, offset = _varint(payload, offset)
+        dt += _unzigzag(dod)
+        t += dt
+        if not 0 <= t <= 0xFFFFFFFF:
+            raise ValueError("Compressed batch timestamp out of range")
+        out += struct.pack("<I", t)
+
+        if offset + mask_bytes > len(payload):
+            raise ValueError("Compressed batch truncated")
+        mask = int.from_bytes(payload[offset : offset + mask_bytes], "little")
+        offset += mask_bytes
+        for i, size in enumerate(fields):
+            if mask >> i & 1:
+                delta, offset = _varint(payload, offset)
+                prev[i] = (prev[i] + _unzigzag(delta)) % (1 << (8 * size))
+            out += prev[i].to_bytes(size, "little")
+
+    if offset != len(payload):
+        raise ValueError("Trailing bytes after the last compressed record")
+    return bytes(out)
+
+
+def decode_batch(payload: bytes) -> List[Dict[str, Any]]:
+    """
+    Decodes a batch frame into its samples, oldest first. Each sample gets
+    its acquisition time rebuilt from the delta-encoded timestamps:
+    `timestamp_us` and `epoch_offset_us` (v2, v3), or `uptime_ms` (v1).
+    Replayed samples (v3) also carry their journal `seq`. Compressed
+    frames (version | 0x80) are expanded first.
+
+    Raises:
+        ValueError: If the batch is malformed or uses an unknown version.
+    """
+    if not payload:
+        raise ValueError("Empty batch frame")
+    if payload[0] & _COMPRESSED_FLAG:
+        payload = decompress_batch(payload)
+    version = payload[0]
+    if version not in _BATCH_LAYOUTS:
+        raise ValueError(f"Unknown batch version {version}")
+    header, delta = _BATCH_LAYOUTS[version]
+    if len(payload) < header.size:
+        raise ValueError("Batch frame shorter than its header")
+
+    if version == 1:
+        _, count, base = header.unpack_from(payload)
+        epoch_offset_us = None
+    else:
+        _, count, base, epoch_offset_us = header.unpack_from(payload)
+
+    samples: List[Dict[str, Any]] = []
+    offset = header.size
+    for _ in range(count):
+        if offset + delta.size >= len(payload):
+            raise ValueError("Batch frame truncated")
+        (dt,) = delta.unpack_from(payload, offset)
+        offset += delta.size
+        seq = None
+        if version == _REPLAY_VERSION:
+            if offset + _REPLAY_SEQ.size >= len(payload):
+                raise ValueError("Batch frame truncated")
+            (seq,) = _REPLAY_SEQ.unpack_from(payload, offset)
+            offset += _REPLAY_SEQ.size
+
+        frame_version = payload[offset]
+        if frame_version not in _DECODERS:
+            raise ValueError(f"Unknown telemetry schema version {frame_version}")
+        size, _ = _DECODERS[frame_version]
+
+        sample = decode_binary(payload[offset : offset + size])
+        if epoch_offset_us is None:
+            sample["uptime_ms"] = base + dt
+        else:
+            sample["timestamp_us"] = base + dt
+            sample["epoch_offset_us"] = epoch_offset_us
+        if seq is not None:
+            sample["seq"] = seq
+        samples.append(sample)
+        offset += size
+
+    if offset != len(payload):
+        raise ValueError("Trailing bytes after the last batched sample")
+    return samples
+
+
+def device_time(sample: Dict[str, Any]) -> Optional[float]:
+    """
+    Acquisition time of a sample as a Unix timestamp (seconds), taken from
+    the device clock. None if the sample has no timestamp or the device had
+    not synced its clock yet; callers then fall back to the receive time.
+    """
+    offset = sample.get("epoch_offset_us")
+    if "timestamp_us" not in sample or not offset:
+        return None
+    return (sample["timestamp_us"] + offset) / 1e6
+
+
+class Topic(NamedTuple):
+    device: str
+    channel: str  # "telemetry", "alarm", "status", "diag", ...
+    suffix: str  # format suffix, "" for plain JSON
+
+
+def parse_topic(topic: str) -> Optional[Topic]:
+    """Splits `sensor/<device>/<channel>[/<suffix>]`; None for other topics."""
+    parts = topic.split("/")
+    if len(parts) < 3 or parts[0] != TOPIC_ROOT:
+        return None
+    return Topic(parts[1], parts[2], "/".join(parts[3:]))
+
+
+def device_topic(device: str, channel: str, suffix: str = "") -> str:
+    """Topic (or filter, with device "+") of one device channel."""
+    topic = f"{TOPIC_ROOT}/{device}/{channel}"
+    return f"{topic}/{suffix}" if suffix else topic
+
+
+def topic_suffix(topic: str) -> str:
+    """Format suffix of a telemetry topic ("" for plain JSON)."""
+    last = topic.split("/")[-1]
+    return last if last in (BINARY_SUFFIX, BATCH_SUFFIX) else ""
+
+
+def is_binary_topic(topic: str) -> bool:
+    return topic_suffix(topic) == BINARY_SUFFIX
+
+
+def decode(topic: str, payload: bytes) -> Dict[str, Any]:
+    """Decodes a single-sample telemetry message (JSON or binary)."""
+    if is_binary_topic(topic):
+        return decode_binary(payload)
+    return json.loads(payload.decode())
+
+
+def decode_samples(topic: str, payload: bytes) -> List[Dict[str, Any]]:
+    """Decodes any telemetry message into a list of samples, oldest first."""
+    if topic_suffix(topic) == BATCH_SUFFIX:
+        return decode_batch(payload)
+    return [decode(topic, payload)]
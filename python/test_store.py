@@ -0,0 +1,117 @@
+"""
+Tests of the rollup tiers and the Parquet segments in store.py.
+
+    python -m unittest test_store
+"""
+
+import os
+import tempfile
+import unittest
+
+import store
+from store import LATE_HOLD_S, Tier, TimeSeriesStore, _TierWriter
+
+T0 = 1_699_999_200.0  # a whole hour, so every tier's buckets line up with it
+ONE_S = Tier("1s", 1, 86400, 30)
+
+
+def sample(stamp: float, gas: float) -> dict:
+    return {"time": stamp, "seq": int(stamp * 100), "gas_level": gas}
+
+
+class RollupTest(unittest.TestCase):
+    def test_buckets_close_behind_the_newest_sample(self):
+        writer = _TierWriter(ONE_S)
+        for stamp, gas in ((T0, 10), (T0 + 0.5, 30), (T0 + 1.2, 5)):
+            writer.add(sample(stamp, gas), now=0)
+        self.assertEqual(writer.rows, [])
+        writer.add(sample(T0 + 2.9, 7), now=0)  # more than a width past the end of T0
+        self.assertEqual(
+            writer.rows,
+            [{"time": T0, "count": 2, "gas_level_sum": 40, "gas_level_min": 10, "gas_level_max": 30}],
+        )
+        self.assertEqual(sorted(writer.buckets), [T0 + 1, T0 + 2])
+
+    def test_late_samples_share_one_bucket(self):
+        writer = _TierWriter(ONE_S)
+        writer.add(sample(T0 + 100, 0), now=0)
+        for i in range(50):  # a journal replay of T0 .. T0 + 2
+            writer.add(sample(T0 + i / 25, i), now=1)
+        self.assertEqual(writer.rows, [])
+        self.assertEqual(sorted(writer.late), [T0, T0 + 1])
+
+        writer.close_late(now=1 + LATE_HOLD_S)
+        self.assertEqual([(r["time"], r["count"]) for r in writer.rows], [(T0, 25), (T0 + 1, 25)])
+        self.assertEqual(writer.rows[0]["gas_level_max"], 24)
+        self.assertEqual(writer.late, {})
+
+    def test_late_bucket_waits_while_samples_keep_coming(self):
+        writer = _TierWriter(ONE_S)
+        writer.add(sample(T0 + 100, 0), now=0)
+        writer.add(sample(T0, 1), now=0)
+        writer.add(sample(T0 + 0.5, 2), now=LATE_HOLD_S - 1)
+        writer.close_late(now=LATE_HOLD_S + 1)
+        self.assertEqual(writer.rows, [])
+        writer.close_late(now=2 * LATE_HOLD_S)
+        self.assertEqual(writer.rows[0]["count"], 2)
+
+    def test_close_all_writes_open_and_late_buckets(self):
+        writer = _TierWriter(ONE_S)
+        writer.add(sample(T0 + 100, 0), now=0)
+        writer.add(sample(T0, 1), now=0)
+        writer.close_all()
+        self.assertEqual([r["time"] for r in writer.rows], [T0 + 100, T0])
+        self.assertEqual((writer.buckets, writer.late), ({}, {}))
+
+    def test_raw_tier_keeps_every_sample(self):
+        writer = _TierWriter(store.TIERS[0])
+        writer.add({"time": T0, "seq": 1, "gas_level": 812, "flame_status": 0}, now=5)
+        self.assertEqual(writer.rows, [{"time": T0, "gas_level": 812.0, "flame_status": 0.0}])
+        self.assertEqual(writer.first_row_at, 5)
+
+
+class ParquetTest(unittest.TestCase):
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        self.store = TimeSeriesStore(self.directory.name)
+        # 3 s at 100 Hz, gas counting up
+        self.store.add_samples("dev", [sample(T0 + i / 100, i) for i in range(300)])
+        self.store.flush(force=True)
+
+    def tearDown(self):
+        self.directory.cleanup()
+
+    def test_raw_samples_read_back(self):
+        frame = self.store.query("dev", T0, T0 + 3, max_points=1000)
+        self.assertEqual(len(frame), 300)
+        self.assertEqual(list(frame["gas_level"].iloc[:3]), [0, 1, 2])
+        self.assertEqual(self.store.devices(), ["dev"])
+
+    def test_rollup_rows_read_back_with_means(self):
+        frame = self.store.query("dev", T0, T0 + 3, max_points=10)  # the 1 s tier
+        self.assertEqual(list(frame["time"]), [T0, T0 + 1, T0 + 2])
+        self.assertEqual(list(frame["count"]), [100, 100, 100])
+        self.assertEqual(list(frame["gas_level"]), [49.5, 149.5, 249.5])
+        self.assertEqual(list(frame["gas_level_min"]), [0, 100, 200])
+        self.assertEqual(list(frame["gas_level_max"]), [99, 199, 299])
+        self.assertNotIn("gas_level_sum", frame.columns)
+
+    def test_replay_merges_into_the_written_bucket(self):
+        self.store.add_samples("dev", [sample(T0 + 10, 0)])
+        self.store.add_samples("dev", [sample(T0 + 0.001 * i, 1000 + i) for i in range(10)])
+        self.store.flush(force=True)
+
+        frame = self.store.query("dev", T0, T0 + 3, max_points=10)
+        first = frame.iloc[0]
+        self.assertEqual(first["count"], 110)
+        self.assertEqual(first["gas_level_max"], 1009)
+        self.assertAlmostEqual(first["gas_level"], (4950 + 10045) / 110)
+
+        # one extra row for the replayed bucket, not one per sample
+        directory = os.path.join(self.directory.name, "1s", "dev")
+        rows = sum(len(store.pd.read_parquet(os.path.join(directory, n))) for n in os.listdir(directory))
+        self.assertEqual(rows, 3 + 1 + 1)  # the first 3 s, T0 + 10, the late T0 row
+
+
+if __name__ == "__main__":
+    unittest.main()